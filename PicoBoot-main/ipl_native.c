@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2022 Maciej Kobus
+ *
+ * SPDX-License-Identifier: GPL-2.0-only
+ *
+ * Native helpers for process_ipl.py, loaded through ctypes.
+ *
+ * Bootrom descrambler reversed by segher, see https://github.com/redolution/iplboot
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#define EXPORT __declspec(dllexport)
+#else
+#define EXPORT __attribute__((visibility("default")))
+#endif
+
+/*
+ * Scrambles the payload in place. The keystream is generated by three LFSRs,
+ * one bit per step, and XORed into the data a whole byte at a time.
+ */
+EXPORT void ipl_scramble(uint8_t *data, size_t size)
+{
+    uint32_t t = 0x2953;
+    uint32_t u = 0xD9C2;
+    uint32_t v = 0x3FF1;
+    uint32_t x = 1;
+
+    for (size_t i = 0; i < size; i++) {
+        uint8_t acc = 0;
+
+        for (int bit = 0; bit < 8; bit++) {
+            uint32_t t0 = t & 1;
+            uint32_t t1 = (t >> 1) & 1;
+            uint32_t u0 = u & 1;
+            uint32_t u1 = (u >> 1) & 1;
+            uint32_t v0 = v & 1;
+
+            x ^= t1 ^ v0;
+            x ^= u0 | u1;
+            x ^= (t0 ^ u1 ^ v0) & (t0 ^ u0);
+
+            if (t0 == u0) {
+                v >>= 1;
+                if (v0)
+                    v ^= 0xB3D0;
+            }
+
+            if (t0 == 0) {
+                u >>= 1;
+                if (u0)
+                    u ^= 0xFB10;
+            }
+
+            t >>= 1;
+            if (t0)
+                t ^= 0xA740;
+
+            acc = (acc << 1) | x;
+        }
+
+        data[i] ^= acc;
+    }
+}
+
+/*
+ * Shifts the whole bit stream left by one and duplicates every bit 4 times,
+ * so each input byte becomes one 32-bit word. Returns -1 if the first bit is
+ * set, as it would be shifted out of the stream.
+ */
+EXPORT int ipl_expand(const uint8_t *data, size_t size, uint32_t *out)
+{
+    uint32_t lut[256];
+
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t word = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (b & (1 << bit))
+                word |= 0xFu << (bit * 4);
+        }
+        lut[b] = word;
+    }
+
+    if (size > 0 && (data[0] & 0x80))
+        return -1;
+
+    for (size_t i = 0; i < size; i++) {
+        uint8_t next = i + 1 < size ? data[i + 1] : 0;
+        out[i] = lut[(uint8_t)((data[i] << 1) | (next >> 7))];
+    }
+
+    return 0;
+}
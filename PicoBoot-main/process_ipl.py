@@ -7,8 +7,12 @@
 #
 
 from datetime import datetime
+import array
+import ctypes
 import math
+import os
 import struct
+import subprocess
 import sys
 
 payload_padding = [
@@ -18,7 +22,44 @@ payload_padding = [
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 ]
 
+def load_native():
+    """Loads the C implementation of the hot loops, building it first if needed.
+
+    Returns None if no host C compiler is available, or PICOBOOT_NO_NATIVE is
+    set, in which case the pure Python implementation below is used instead.
+    """
+
+    if os.environ.get('PICOBOOT_NO_NATIVE'):
+        return None
+
+    base = os.path.dirname(os.path.abspath(__file__))
+    source = os.path.join(base, 'ipl_native.c')
+    library = os.path.join(base, 'ipl_native' + ('.dll' if os.name == 'nt' else '.so'))
+
+    try:
+        if not os.path.exists(library) or os.path.getmtime(library) < os.path.getmtime(source):
+            cc = os.environ.get('CC', 'cc')
+            subprocess.run([cc, '-O2', '-shared', '-fPIC', '-o', library, source],
+                           check=True, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+        native = ctypes.CDLL(library)
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+    native.ipl_scramble.argtypes = [ctypes.c_void_p, ctypes.c_size_t]
+    native.ipl_scramble.restype = None
+    native.ipl_expand.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p]
+    native.ipl_expand.restype = ctypes.c_int
+
+    return native
+
+native = load_native()
+
 def scramble(data):
+    if native is not None and len(data) > 0:
+        native.ipl_scramble((ctypes.c_char * len(data)).from_buffer(data), len(data))
+        return data
+
     acc = 0
     nacc = 0
 
@@ -77,54 +118,72 @@ def flatten_dol(data):
     # Entry point, load address, memory image
     return header[56], dol_min, img
 
-def bytes_to_c_array(data):
-    p_list = [data[i:i + 4] for i in range(0, len(data), 4)]
-    return ["0x%08x" % int.from_bytes(b, byteorder='big', signed=False) for b in p_list]
+def write_header_file(f, payload, executable, input_file, output_file, size):
+    """Writes the payload as a C array, one line of four words at a time."""
 
-def generate_header_file(elements, executable, input_file, output_file, size):
-    output = '#include <stdio.h>\n\n'
-    output += '//\n'
-    output += '// Command: {0} {1} {2}\n'.format(executable, input_file, output_file)
-    output += '//\n'
-    output += '// File: {0}, size: {1} bytes\n'.format(input_file, size)
-    output += '//\n'
-    output += '// File generated on {0}\n'.format(datetime.now().strftime("%d.%m.%Y %H:%M:%S"))
-    output += '//\n\n'
-    output += 'uint32_t __in_flash("ipl_data") ipl[]  = {\n\t'
+    f.write('#include <stdio.h>\n\n')
+    f.write('//\n')
+    f.write('// Command: {0} {1} {2}\n'.format(executable, input_file, output_file))
+    f.write('//\n')
+    f.write('// File: {0}, size: {1} bytes\n'.format(input_file, size))
+    f.write('//\n')
+    f.write('// File generated on {0}\n'.format(datetime.now().strftime("%d.%m.%Y %H:%M:%S")))
+    f.write('//\n\n')
+    f.write('uint32_t __in_flash("ipl_data") ipl[]  = {\n\t')
 
-    for num in range(len(elements)):
-        if num > 0 and num % 4 == 0:
-            output += '\n\t'
-        
-        output += elements[num]
+    words = array.array('I', payload)
+    if sys.byteorder == 'little':
+        words.byteswap()
 
-        if num != len(elements):
-            output += ', '
+    for num in range(0, len(words), 4):
+        if num > 0:
+            f.write('\n\t')
 
-    output += '\n};\n'
+        line = words[num:num + 4]
+        f.write(('0x%08x, ' * len(line)) % tuple(line))
 
-    return output
+    f.write('\n};\n')
+
+def write_binary_file(f, payload):
+    """Writes the payload as raw 32-bit words in the Pico's (little endian) byte order."""
+
+    words = array.array('I', payload)
+    words.byteswap()
+    f.write(words.tobytes())
+
+# Every bit of a byte duplicated 4 times, as a big endian 32-bit word
+expand_table = [
+    sum(0xF << (bit * 4) for bit in range(8) if byte & (1 << bit)).to_bytes(4, 'big')
+    for byte in range(256)
+]
 
 def process_scrambled_ipl(ipl, size):
     """Does additional processing to scrambled IPL payload.
 
     Payload used by PicoBoot has to be preprocessed. 
     Whole payload has to be aligned to 1K blocks then every bit needs to be duplicated 4 times.
+    The whole bit stream is also shifted left by one bit, so the first bit must be clear.
     """
-    
-    out2 = int.from_bytes(ipl, byteorder='big', signed=False)
-    out2 = out2 << 1
 
-    binary = ''.join([char * 4 for char in format(out2, 'b')])
-    binary = int(binary, 2)
+    if size > 0 and ipl[0] & 0x80:
+        raise OverflowError("first payload bit would be shifted out")
 
-    payload = binary.to_bytes(size * 4, 'big')
-    
-    return payload
+    if native is not None and size > 0:
+        words = array.array('I', bytes(size * 4))
+        native.ipl_expand(bytes(ipl[:size]), size, words.buffer_info()[0])
+        if sys.byteorder == 'little':
+            words.byteswap()
+        return words.tobytes()
+
+    shifted = ((int.from_bytes(ipl[:size], byteorder='big', signed=False) << 1) & ((1 << (size * 8)) - 1)).to_bytes(size, 'big')
+
+    return b''.join(expand_table[byte] for byte in shifted)
     
 def main():
-    if len(sys.argv) != 4:
+    if len(sys.argv) != 3:
         print(f"Usage: {sys.argv[0]} <executable> <output>")
+        print("Output is written as a C header, or as a raw binary if it ends with .bin")
+        return -1
 
     with open(sys.argv[1], "rb") as f:
         exe = bytearray(f.read())
@@ -162,12 +221,14 @@ def main():
     scrambled_payload = scramble(payload)[0x700:]
     payload_size = len(scrambled_payload);
 
-    byte_groups = bytes_to_c_array(process_scrambled_ipl(scrambled_payload, payload_size))
+    payload = process_scrambled_ipl(scrambled_payload, payload_size)
 
-    output = generate_header_file(byte_groups, sys.argv[0], sys.argv[1], sys.argv[2], size)
-
-    with open(sys.argv[2], "w") as f:
-        f.write(output)
+    if sys.argv[2].endswith(".bin"):
+        with open(sys.argv[2], "wb") as f:
+            write_binary_file(f, payload)
+    else:
+        with open(sys.argv[2], "w", buffering=1 << 20) as f:
+            write_header_file(f, payload, sys.argv[0], sys.argv[1], sys.argv[2], size)
 
 if __name__ == "__main__":
     sys.exit(main())
\ No newline at end of file
@@ -11,7 +11,16 @@
 #include "hardware/dma.h"
 #include "hardware/structs/bus_ctrl.h"
 #include "picoboot.pio.h"
+
+#ifdef IPL_BLOB
+// Payload linked in from ipl.bin, see ipl_blob.S
+extern const uint32_t ipl[];
+extern const uint32_t ipl_end[];
+#define IPL_WORDS ((uint)(ipl_end - ipl))
+#else
 #include "ipl.h"
+#define IPL_WORDS count_of(ipl)
+#endif
 
 const uint PIN_LED = 25;                // Status LED
 const uint PIN_DATA_BASE = 6;           // Base pin used for output, 4 consecutive pins are used 
@@ -95,7 +104,7 @@ void main()
         &c,
         &pio->txf[clocked_output_sm],
         ipl,
-        count_of(ipl),
+        IPL_WORDS,
         true // start immediately
     );
 
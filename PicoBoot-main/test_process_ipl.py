@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+
+#
+# Regression test for process_ipl.py
+#
+# Runs the script on generated DOLs with the native helpers and with the pure
+# Python fallback, and checks both outputs byte for byte against the bit-serial
+# scrambler and string based bit expansion the script originally shipped with.
+#
+
+import os
+import random
+import struct
+import subprocess
+import sys
+import tempfile
+
+import process_ipl
+
+here = os.path.dirname(os.path.abspath(__file__))
+script = os.path.join(here, 'process_ipl.py')
+
+def reference_scramble(data):
+    acc = 0
+    nacc = 0
+
+    t = 0x2953
+    u = 0xD9C2
+    v = 0x3FF1
+
+    x = 1
+
+    it = 0
+    while it < len(data):
+        t0 = t & 1
+        t1 = (t >> 1) & 1
+        u0 = u & 1
+        u1 = (u >> 1) & 1
+        v0 = v & 1
+
+        x ^= t1 ^ v0
+        x ^= u0 | u1
+        x ^= (t0 ^ u1 ^ v0) & (t0 ^ u0)
+
+        if t0 == u0:
+            v >>= 1
+            if v0:
+                v ^= 0xB3D0
+
+        if t0 == 0:
+            u >>= 1
+            if u0:
+                u ^= 0xFB10
+
+        t >>= 1
+        if t0:
+            t ^= 0xA740
+
+        nacc = (nacc + 1) % 256
+        acc = (acc * 2 + x) % 256
+        if nacc == 8:
+            data[it] ^= acc
+            nacc = 0
+            it += 1
+
+    return data
+
+def reference_expand(ipl, size):
+    out2 = int.from_bytes(ipl, byteorder='big', signed=False)
+    out2 = out2 << 1
+
+    binary = ''.join([char * 4 for char in format(out2, 'b')])
+    binary = int(binary, 2)
+
+    return binary.to_bytes(size * 4, 'big')
+
+def reference_header(payload, executable, input_file, output_file, size):
+    elements = ["0x%08x" % int.from_bytes(payload[i:i + 4], byteorder='big', signed=False)
+                for i in range(0, len(payload), 4)]
+
+    output = '#include <stdio.h>\n\n'
+    output += '//\n'
+    output += '// Command: {0} {1} {2}\n'.format(executable, input_file, output_file)
+    output += '//\n'
+    output += '// File: {0}, size: {1} bytes\n'.format(input_file, size)
+    output += '//\n'
+    output += '//\n\n'
+    output += 'uint32_t __in_flash("ipl_data") ipl[]  = {\n\t'
+
+    for num in range(len(elements)):
+        if num > 0 and num % 4 == 0:
+            output += '\n\t'
+
+        output += elements[num] + ', '
+
+    output += '\n};\n'
+
+    return output
+
+def reference_payload(dol):
+    _, _, img = process_ipl.flatten_dol(dol)
+    size = len(img)
+
+    payload = bytearray(0x700) + bytearray(process_ipl.payload_padding) + img
+    payload_size = size + 0x20
+    if payload_size % 1024 != 0:
+        payload += bytearray(-payload_size % 1024)
+
+    scrambled = reference_scramble(payload)[0x700:]
+    return reference_expand(scrambled, len(scrambled)), size
+
+def make_dol(rng, text_size, data_size):
+    """A DOL loading at 0x81300000 with a text and a data section of random bytes."""
+
+    header = [0] * 64
+    header[0] = 0x100
+    header[18] = 0x81300000
+    header[36] = text_size
+    header[7] = 0x100 + text_size
+    header[25] = 0x81300000 + text_size + 0x20
+    header[43] = data_size
+    header[56] = 0x81300000
+
+    body = bytes(rng.getrandbits(8) for _ in range(text_size + data_size))
+    return struct.pack(">64I", *header) + body
+
+def run(dol_path, out_path, native):
+    env = dict(os.environ)
+    if native:
+        env.pop('PICOBOOT_NO_NATIVE', None)
+    else:
+        env['PICOBOOT_NO_NATIVE'] = '1'
+
+    result = subprocess.run([sys.executable, script, dol_path, out_path], env=env,
+                            stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    if result.returncode != 0:
+        return b''
+
+    with open(out_path, 'rb') as f:
+        return f.read()
+
+def main():
+    if process_ipl.native is None:
+        print("No host C compiler, only the Python path can be checked")
+
+    rng = random.Random(0x1B00)
+    failed = 0
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for text_size, data_size in ((0x400, 0x100), (0x2FE0, 0x20), (0x9000, 0x3C00)):
+            name = 'fixture_{0:x}.dol'.format(text_size + data_size)
+            dol = make_dol(rng, text_size, data_size)
+            dol_path = os.path.join(tmp, name)
+            with open(dol_path, 'wb') as f:
+                f.write(dol)
+
+            expected, size = reference_payload(bytearray(dol))
+            expected_bin = b''.join(expected[i:i + 4][::-1] for i in range(0, len(expected), 4))
+
+            for native in (True, False):
+                if native and process_ipl.native is None:
+                    continue
+                path = 'native' if native else 'python'
+
+                out_bin = os.path.join(tmp, 'ipl.bin')
+                if run(dol_path, out_bin, native) != expected_bin:
+                    print("{0}: {1} ipl.bin differs".format(name, path))
+                    failed += 1
+
+                # The generation date is the only line allowed to differ
+                out_h = os.path.join(tmp, 'ipl.h')
+                header = run(dol_path, out_h, native).decode()
+                header = ''.join(line for line in header.splitlines(True) if not line.startswith('// File generated on'))
+                if header != reference_header(expected, script, dol_path, out_h, size):
+                    print("{0}: {1} ipl.h differs".format(name, path))
+                    failed += 1
+
+            print("{0}: {1} bytes checked".format(name, len(expected)))
+
+    if failed:
+        print("FAILED")
+        return 1
+
+    print("OK")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
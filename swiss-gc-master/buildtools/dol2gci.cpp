@@ -1,7 +1,12 @@
 // A very simple tool to repackage a DOL into a GCI file, additionally adding an icon
 // It adjusts the DOL header for that - this should not break any loader but you never
 // know.
+//
+// Several DOLs can be converted in one go (in parallel), and the produced GCI files
+// can be checked for consistency against their DOL.
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
@@ -9,8 +14,14 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 
@@ -22,7 +33,7 @@ using namespace std;
 // useful typedefs
 typedef unsigned char u8;
 typedef unsigned short u16;
-typedef unsigned long u32;
+typedef unsigned int u32;
 
 // DOL icon (CI8 with palette)
 const u8 dol_icon[] = {
@@ -105,38 +116,80 @@ const u8 dol_icon[] = {
 	0x80, 0x88, 0x80, 0x86, 0x80, 0x48, 0x80, 0x46, 0x80, 0x24, 0x80, 0x04, 0x80, 0x02, 0x80, 0x00
 };
 
+#define GCI_HEADER_SIZE  0x40
+#define GCI_BLOCK_SIZE   8192
+#define DOL_HEADER_SIZE  0x100
+#define DOL_SECTIONS     18
+
 // utility functions
-int load( const string & name, void ** data )
+
+// read-only view of a whole file, mapped where the platform allows it
+struct file_view {
+	const u8 *data;
+	size_t size;
+	bool mapped;
+};
+
+bool load( const string & name, file_view & view )
 {
-        size_t size = 0;
-        *data = NULL;
+        view.data = NULL;
+        view.size = 0;
+        view.mapped = false;
         int fd = open( name.c_str(), O_RDONLY|O_BINARY, 0 );
-        if (fd >= 0) {
-                struct stat sb;
-                if ( fstat( fd, &sb ) >= 0) {
-                        assert( sb.st_size > 0 );
-                        void *tmp = malloc( sb.st_size );
-                        if ( tmp!=NULL ) {
-                                if (read( fd, tmp, sb.st_size ) == sb.st_size) {
-                                        *data = tmp;
-                                        size = sb.st_size;
-                                } else {
-                                        free(tmp);
-                                }
+        if (fd < 0)
+                return false;
+        struct stat sb;
+        if ( fstat( fd, &sb ) >= 0 && sb.st_size > 0 ) {
+#ifndef _WIN32
+                void *tmp = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+                if ( tmp != MAP_FAILED ) {
+                        madvise( tmp, sb.st_size, MADV_SEQUENTIAL );
+                        view.data = (const u8 *)tmp;
+                        view.size = sb.st_size;
+                        view.mapped = true;
+                }
+#else
+                void *tmp = malloc( sb.st_size );
+                if ( tmp!=NULL ) {
+                        if (read( fd, tmp, sb.st_size ) == sb.st_size) {
+                                view.data = (const u8 *)tmp;
+                                view.size = sb.st_size;
+                        } else {
+                                free(tmp);
                         }
                 }
-                close( fd );
+#endif
         }
-        return size;
+        close( fd );
+        return view.data != NULL;
+}
+
+void unload( file_view & view )
+{
+#ifndef _WIN32
+        if (view.mapped)
+                munmap( (void *)view.data, view.size );
+        else
+#endif
+        free( (void *)view.data );
+        view.data = NULL;
+        view.size = 0;
 }
 
-void save(const string & name, const void *data, int size)
+bool save(const string & name, const void *data, size_t size)
 {
         int fd = open( name.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_BINARY, 0666 );
-        if (fd >= 0) {
-		write( fd, data, size );
-                close( fd );
+        if (fd < 0)
+                return false;
+        const u8 *ptr = (const u8 *)data;
+        while (size > 0) {
+                ssize_t ret = write( fd, ptr, size );
+                if (ret <= 0)
+                        break;
+                ptr += ret;
+                size -= ret;
         }
+        return close( fd ) == 0 && size == 0;
 }
  
 u32 get_u32be(void const * const buf)
@@ -144,6 +197,11 @@ u32 get_u32be(void const * const buf)
 	return ((u8*)buf)[3] | (((u8*)buf)[2]<<8) | (((u8*)buf)[1]<<16) | (((u8*)buf)[0]<<24);
 }
 
+u16 get_u16be(void const * const buf)
+{
+	return ((u8*)buf)[1] | (((u8*)buf)[0]<<8);
+}
+
 void set_u16be(void * buf, u16 v)
 {
 	((u8*)buf)[1] = v & 0xFF;
@@ -158,54 +216,70 @@ void set_u32be(void * buf, u32 v)
 	((u8*)buf)[0] = (v>>24) & 0xFF;
 }
 
-int main (int argc, char * const argv[]) 
+// strip path from filename, looking for forward and backslash
+string base_name(const string & path)
+{
+	string name = path;
+	size_t i = name.rfind('/');
+	if (i!=string::npos) {
+		name = name.substr(i+1);
+	}
+	i = name.rfind('\\');
+	if (i!=string::npos) {
+		name = name.substr(i+1);
+	}
+	return name;
+}
+
+int icon_size()
 {
-	if (argc != 3 && argc != 4) {
-		fprintf(stderr, "dol2gci <dolfile> <gcifile> [<filename>]\n");
-		return -1;
-	} 
+	return (sizeof(dol_icon) + 31) & ~31;
+}
+
+// memory card style checksum pair over big endian halfwords
+void checksum(const u8 *data, size_t size, u16 *sum, u16 *inv)
+{
+	*sum = *inv = 0;
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		u16 v = get_u16be(data + i);
+		*sum += v;
+		*inv += v ^ 0xFFFF;
+	}
+}
 
-	// strip path from filename, looking for forward and backslash
+struct job {
+	string dol;
+	string gci;
 	string name;
-	unsigned int i;
-	if (argc == 4) {
-		name = argv[3];
-	} else {
-		name = argv[1];
-		i = name.rfind('/');
-		if (i!=string::npos) {
-			name = name.substr(i+1);
-		}
-		i = name.rfind('\\');
-		if (i!=string::npos) {
-			name = name.substr(i+1);
-		}
+	string report;
+	bool ok;
+};
+
+// build the complete GCI image in memory so it can be written with a single call
+bool convert(job & j, vector<u8> & gci)
+{
+	file_view dol;
+	if (!load(j.dol, dol) || dol.size < DOL_HEADER_SIZE) {
+		j.report = "can't read dol " + j.dol;
+		if (dol.data)
+			unload(dol);
+		return false;
 	}
-	
-	// load DOL file
-	u8 *dol_data;
-	int dol_size = load(argv[1], (void**)&dol_data);
-	if (dol_size < 256) {
-		fprintf(stderr, "can't read dol\n");
-		return -1;
-	} 
-	
+
 	// calculate overal size
-	int icon_size = ((sizeof(dol_icon) + 31) & ~31);
-	int data_size = 64 + icon_size + dol_size;
-	int data_blocks = (data_size + 8191) / 8192;
-	
-	// create GCI file
-	int gci_size = 64 + data_blocks * 8192;
-	u8 *gci_data = (u8 *)malloc(gci_size);
-		
+	int data_size = GCI_HEADER_SIZE + icon_size() + dol.size;
+	int data_blocks = (data_size + GCI_BLOCK_SIZE - 1) / GCI_BLOCK_SIZE;
+
+	// create GCI file, padding is left zeroed
+	gci.assign(GCI_HEADER_SIZE + data_blocks * GCI_BLOCK_SIZE, 0);
+	u8 *gci_data = &gci[0];
+
 	// set up GCI header
 	memcpy(gci_data + 0x00, "DOLX", 4);     // Game Code
 	memcpy(gci_data + 0x04, "00", 2);       // maker code
 	gci_data[6] = 0xFF;			// unused/reserved
 	gci_data[7] = 0x00;			// no banner
-	memset(gci_data + 0x08, 0, 32);		// clear name area
-	strncpy((char*)(gci_data + 0x08), name.c_str(), 31); // copy name
+	strncpy((char*)(gci_data + 0x08), j.name.c_str(), 31); // copy name
 	set_u32be(gci_data + 0x28, 0);		// last modification
 	set_u32be(gci_data + 0x2C, 0x140);      // offset image data
 	set_u16be(gci_data + 0x30, 0x0001);     // icon CI8 shared PAL
@@ -216,28 +290,198 @@ int main (int argc, char * const argv[])
 	set_u16be(gci_data + 0x38, data_blocks); // number of 8k blocks in file
 	set_u16be(gci_data + 0x3a, 0xffff);     // unused/reserved
 	set_u32be(gci_data + 0x3c, 0x100);      // comment
-	
+
 	// copy and fix DOL header
-	memcpy(gci_data + 0x40, dol_data, 256);
-	for (i=0; i<18; i++) {
+	memcpy(gci_data + 0x40, dol.data, DOL_HEADER_SIZE);
+	for (int i=0; i<DOL_SECTIONS; i++) {
 		u32 adr = 0x40 + i*4;
 		u32 filepos = get_u32be(gci_data + adr);
-		if (filepos >= 0x100) {
-			set_u32be(gci_data + adr, filepos + 0x40 + icon_size);
+		if (filepos >= DOL_HEADER_SIZE) {
+			set_u32be(gci_data + adr, filepos + 0x40 + icon_size());
 		}
 	}
-		
+
 	// description and icon
-	memset(gci_data + 0x140, 0, 64);
 	strcpy((char*)(gci_data + 0x140), "Dolphin Application");
-	strncpy((char*)(gci_data + 0x160), name.c_str(), 31);
+	strncpy((char*)(gci_data + 0x160), j.name.c_str(), 31);
 	memcpy(gci_data + 0x180, dol_icon, sizeof(dol_icon));
-	
+
 	// copy DOL data
-	memcpy(gci_data + 0x180 + icon_size, dol_data + 256, dol_size - 256);
-	
-	// save GCI file
-	save(argv[2], gci_data, gci_size);	
-		
-	return 0;
+	memcpy(gci_data + 0x180 + icon_size(), dol.data + DOL_HEADER_SIZE, dol.size - DOL_HEADER_SIZE);
+
+	unload(dol);
+	return true;
+}
+
+// check a GCI image for consistency, and against its DOL when one is given
+bool verify(job & j, const u8 *gci_data, size_t gci_size)
+{
+	char line[256];
+
+	if (gci_size < GCI_HEADER_SIZE + GCI_BLOCK_SIZE || (gci_size - GCI_HEADER_SIZE) % GCI_BLOCK_SIZE) {
+		snprintf(line, sizeof(line), "%s: bad size %zu", j.gci.c_str(), gci_size);
+		j.report = line;
+		return false;
+	}
+
+	const u8 *data = gci_data + GCI_HEADER_SIZE;
+	size_t data_size = gci_size - GCI_HEADER_SIZE;
+	u32 blocks = get_u16be(gci_data + 0x38);
+	u32 icon_offset = get_u32be(gci_data + 0x2C);
+	u32 comment_offset = get_u32be(gci_data + 0x3C);
+	const char *error = NULL;
+
+	if (blocks != data_size / GCI_BLOCK_SIZE)
+		error = "block count does not match file size";
+	else if (comment_offset > data_size - 64)
+		error = "comment out of range";
+	else if (icon_offset > data_size - sizeof(dol_icon))
+		error = "icon out of range";
+
+	file_view dol = { NULL, 0, false };
+	if (!error && !j.dol.empty() && (!load(j.dol, dol) || dol.size < DOL_HEADER_SIZE))
+		error = "can't read dol";
+
+	// every DOL section has to be in bounds, and identical to the original if we have it
+	for (int i=0; i<DOL_SECTIONS && !error; i++) {
+		u32 offset = get_u32be(data + i*4);
+		u32 size = get_u32be(data + 0x90 + i*4);
+		if (size == 0)
+			continue;
+		if (offset < DOL_HEADER_SIZE || size > data_size || offset > data_size - size) {
+			error = "section out of range";
+		} else if (dol.data) {
+			u32 dol_offset = get_u32be(dol.data + i*4);
+			if (get_u32be(dol.data + 0x90 + i*4) != size ||
+			    size > dol.size || dol_offset > dol.size - size || offset - dol_offset != GCI_HEADER_SIZE + (u32)icon_size() ||
+			    memcmp(data + offset, dol.data + dol_offset, size))
+				error = "section does not match dol";
+		}
+	}
+	if (!error && dol.data && (memcmp(data + 0x48, dol.data + 0x48, DOL_HEADER_SIZE - 0x48) ||
+	    gci_size < GCI_HEADER_SIZE + 0x140 + icon_size() + dol.size - DOL_HEADER_SIZE))
+		error = "header does not match dol";
+	if (dol.data)
+		unload(dol);
+
+	if (error) {
+		snprintf(line, sizeof(line), "%s: %s", j.gci.c_str(), error);
+		j.report = line;
+		return false;
+	}
+
+	u16 sum, inv;
+	checksum(data, data_size, &sum, &inv);
+	snprintf(line, sizeof(line), "%s: %.4s%.2s \"%.32s\" %u blocks, icon 0x%x, comment 0x%x, checksum %04x/%04x",
+		j.gci.c_str(), (const char *)gci_data, (const char *)gci_data + 4, (const char *)gci_data + 8,
+		blocks, icon_offset, comment_offset, sum, inv);
+	j.report = line;
+	return true;
+}
+
+void run(job & j, bool convert_dol, bool check)
+{
+	if (convert_dol) {
+		vector<u8> gci;
+		j.ok = convert(j, gci);
+		if (j.ok && !save(j.gci, &gci[0], gci.size())) {
+			j.report = "can't write gci " + j.gci;
+			j.ok = false;
+		}
+		if (j.ok && check)
+			j.ok = verify(j, &gci[0], gci.size());
+	} else {
+		file_view gci;
+		if (!load(j.gci, gci)) {
+			j.report = "can't read gci " + j.gci;
+			j.ok = false;
+			return;
+		}
+		j.ok = verify(j, gci.data, gci.size);
+		unload(gci);
+	}
+}
+
+void usage()
+{
+	fprintf(stderr, "dol2gci <dolfile> <gcifile> [<filename>]\n");
+	fprintf(stderr, "dol2gci [-v] [-j <jobs>] -b <dolfile> <gcifile> <filename> [...]\n");
+	fprintf(stderr, "dol2gci -c <gcifile> [<dolfile>]\n");
+	fprintf(stderr, "  -b  convert each <dolfile> <gcifile> <filename> triple\n");
+	fprintf(stderr, "  -v  verify and report each GCI after conversion\n");
+	fprintf(stderr, "  -j  number of parallel conversions (default: all cores)\n");
+	fprintf(stderr, "  -c  verify and report an existing GCI, optionally against its DOL\n");
+}
+
+int main (int argc, char * const argv[]) 
+{
+	vector<job> jobs;
+	bool batch = false, check = false, check_only = false;
+	unsigned int threads = thread::hardware_concurrency();
+	int arg = 1;
+
+	for (; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (!strcmp(argv[arg], "-b")) {
+			batch = true;
+		} else if (!strcmp(argv[arg], "-v")) {
+			check = true;
+		} else if (!strcmp(argv[arg], "-c")) {
+			check_only = true;
+		} else if (!strcmp(argv[arg], "-j") && arg + 1 < argc) {
+			threads = atoi(argv[++arg]);
+		} else {
+			usage();
+			return -1;
+		}
+	}
+
+	int count = argc - arg;
+	if (check_only) {
+		if (batch || (count != 1 && count != 2)) {
+			usage();
+			return -1;
+		}
+		job j = { count == 2 ? argv[arg + 1] : "", argv[arg], "", "", false };
+		jobs.push_back(j);
+	} else if (batch) {
+		if (count == 0 || count % 3) {
+			usage();
+			return -1;
+		}
+		for (; arg < argc; arg += 3) {
+			job j = { argv[arg], argv[arg + 1], argv[arg + 2], "", false };
+			jobs.push_back(j);
+		}
+	} else {
+		if (count != 2 && count != 3) {
+			usage();
+			return -1;
+		}
+		job j = { argv[arg], argv[arg + 1], count == 3 ? argv[arg + 2] : base_name(argv[arg]), "", false };
+		jobs.push_back(j);
+	}
+
+	// hand out jobs to worker threads, results are reported in argument order
+	threads = threads < 1 ? 1 : threads > jobs.size() ? jobs.size() : threads;
+	atomic<size_t> next(0);
+	vector<thread> workers;
+	for (unsigned int i = 1; i < threads; i++) {
+		workers.push_back(thread([&]() {
+			for (size_t n; (n = next++) < jobs.size(); )
+				run(jobs[n], !check_only, check);
+		}));
+	}
+	for (size_t n; (n = next++) < jobs.size(); )
+		run(jobs[n], !check_only, check);
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	int ret = 0;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		if (!jobs[i].report.empty())
+			fprintf(jobs[i].ok ? stdout : stderr, "%s\n", jobs[i].report.c_str());
+		if (!jobs[i].ok)
+			ret = -1;
+	}
+	return ret;
 }
@@ -7,34 +7,35 @@
 #include <math.h>
 
 #include "common.h"
+#include "dolphin/os.h"
 
 // The size of the first GC disc layer in bytes (712880 sectors, 2048 bytes per sector)
-static const u32 DISC_LAYER_SIZE = 0x57058000;
+#define DISC_LAYER_SIZE 0x57058000
 
 // 24 mm
-static const double DISC_INNER_RADIUS = 0.024;
+#define DISC_INNER_RADIUS 0.024
 // 38 mm
-static const double DISC_OUTER_RADIUS = 0.038;
+#define DISC_OUTER_RADIUS 0.038
 // 0.74 um
-static const double DISC_TRACK_PITCH = 0.00000074;
+#define DISC_TRACK_PITCH 0.00000074
 
 // Approximate read speeds at the inner and outer locations of Wii and GC
 // discs. These speeds are approximations of speeds measured on real Wiis.
-static const double DISC_INNER_READ_SPEED = 1024 * 1024 * 2;      // bytes/s
-static const double DISC_OUTER_READ_SPEED = 1024 * 1024 * 3.125;  // bytes/s
+#define DISC_INNER_READ_SPEED (1024 * 1024 * 2.0)    // bytes/s
+#define DISC_OUTER_READ_SPEED (1024 * 1024 * 3.125)  // bytes/s
 
 // The speed at which discs rotate. These have not been directly measured on hardware -
 // rather, the read speeds above have been matched to the closest standard DVD speed
 // (3x for GC and 6x for Wii) and the rotational speeds of those have been used.
-static const double ROTATIONS_PER_SECOND = 28.5;
+#define ROTATIONS_PER_SECOND 28.5
 
 // Experimentally measured seek constants. The time to seek appears to be
 // linear, but short seeks appear to be lower velocity.
-static const double SHORT_SEEK_MAX_DISTANCE = 0.001;   // 1 mm
-static const double SHORT_SEEK_CONSTANT = 0.035;       // seconds
-static const double SHORT_SEEK_VELOCITY_INVERSE = 50;  // inverse: s/m
-static const double LONG_SEEK_CONSTANT = 0.075;        // seconds
-static const double LONG_SEEK_VELOCITY_INVERSE = 4.5;  // inverse: s/m
+#define SHORT_SEEK_MAX_DISTANCE 0.001     // 1 mm
+#define SHORT_SEEK_CONSTANT 0.035         // seconds
+#define SHORT_SEEK_VELOCITY_INVERSE 50.0  // inverse: s/m
+#define LONG_SEEK_CONSTANT 0.075          // seconds
+#define LONG_SEEK_VELOCITY_INVERSE 4.5    // inverse: s/m
 
 // We can approximate the relationship between a byte offset on disc and its
 // radial distance from the center by using an approximation for the length of
@@ -149,3 +150,138 @@ double CalculateRawDiscReadTime(u32 offset, u32 length)
 
   return length / speed;
 }
+
+#ifndef DVD_MATH_FIXED
+OSTick CalculateSeekTicks(u32 offset_from, u32 offset_to)
+{
+  return OSSecondsToTicks(CalculateSeekTime(offset_from, offset_to));
+}
+
+OSTick CalculateRotationalLatencyTicks(u32 offset, OSTime time)
+{
+  return OSSecondsToTicks(CalculateRotationalLatency(offset, OSTicksToSeconds((double)time)));
+}
+
+OSTick CalculateRawDiscReadTicks(u32 offset, u32 length)
+{
+  return OSSecondsToTicks(CalculateRawDiscReadTime(offset, length));
+}
+#else
+// Fixed-point variant of the model above, for callers that only want timebase
+// ticks and would rather not pay for double precision sqrt, fmod and division
+// on every ECC block.
+//
+// Radii are expressed as a fraction of DISC_OUTER_RADIUS in Q31, and angles as
+// a fraction of one rotation in Q32 so that wrapping is free. The radius for
+// an offset is linearly interpolated from a table sampled every 16 MiB, then
+// refined with a single Newton step against the exact squared radius. The
+// ticks-per-byte read speed is linearly interpolated from a second table on
+// the same grid. Both tables are folded to constants by the compiler.
+
+#define DISC_TABLE_SHIFT 24
+#define DISC_TABLE_SIZE ((DISC_LAYER_SIZE >> DISC_TABLE_SHIFT) + 2)
+
+#define DISC_RADIUS_SQUARED(offset)                                                         \
+  ((double)(offset) / DISC_LAYER_SIZE *                                                     \
+       (DISC_OUTER_RADIUS * DISC_OUTER_RADIUS - DISC_INNER_RADIUS * DISC_INNER_RADIUS) +    \
+   DISC_INNER_RADIUS * DISC_INNER_RADIUS)
+#define DISC_RADIUS(offset) __builtin_sqrt(DISC_RADIUS_SQUARED(offset))
+#define DISC_READ_SPEED(offset)                                                             \
+  ((DISC_RADIUS(offset) - DISC_INNER_RADIUS) / (DISC_OUTER_RADIUS - DISC_INNER_RADIUS) *    \
+       (DISC_OUTER_READ_SPEED - DISC_INNER_READ_SPEED) +                                    \
+   DISC_INNER_READ_SPEED)
+
+#define RADIUS_Q31(i)                                                                       \
+  (u32)(DISC_RADIUS((double)(i) * (1 << DISC_TABLE_SHIFT)) / DISC_OUTER_RADIUS * 0x1p31 + 0.5)
+#define TICKS_PER_BYTE_Q16(i)                                                               \
+  (u32)(OS_TIMER_CLOCK / DISC_READ_SPEED((double)(i) * (1 << DISC_TABLE_SHIFT)) * 0x1p16 + 0.5)
+
+#define TABLE4(f, i) f(i), f(i + 1), f(i + 2), f(i + 3)
+#define TABLE16(f, i) TABLE4(f, i), TABLE4(f, i + 4), TABLE4(f, i + 8), TABLE4(f, i + 12)
+#define TABLE89(f)                                                                          \
+  TABLE16(f, 0), TABLE16(f, 16), TABLE16(f, 32), TABLE16(f, 48), TABLE16(f, 64),            \
+      TABLE4(f, 80), TABLE4(f, 84), f(88)
+
+_Static_assert(DISC_TABLE_SIZE == 89, "DVD timing tables are sized for a single layer GC disc");
+
+static const u32 radius_table[DISC_TABLE_SIZE] = {TABLE89(RADIUS_Q31)};
+static const u32 ticks_per_byte_table[DISC_TABLE_SIZE] = {TABLE89(TICKS_PER_BYTE_Q16)};
+
+// (r / DISC_OUTER_RADIUS)^2 in Q62 is RADIUS_SQUARED_BASE + offset * RADIUS_SQUARED_SCALE.
+static const u64 RADIUS_SQUARED_BASE = (u64)(DISC_INNER_RADIUS * DISC_INNER_RADIUS /
+                                             (DISC_OUTER_RADIUS * DISC_OUTER_RADIUS) * 0x1p62);
+static const u32 RADIUS_SQUARED_SCALE =
+    (u32)((1 - DISC_INNER_RADIUS * DISC_INNER_RADIUS / (DISC_OUTER_RADIUS * DISC_OUTER_RADIUS)) /
+              DISC_LAYER_SIZE * 0x1p62 + 0.5);
+
+// Seek slopes in ticks per Q31 radius unit, in Q32.
+static const u32 SHORT_SEEK_MAX_DISTANCE_Q31 =
+    (u32)(SHORT_SEEK_MAX_DISTANCE / DISC_OUTER_RADIUS * 0x1p31);
+static const u32 SHORT_SEEK_SLOPE = (u32)(SHORT_SEEK_VELOCITY_INVERSE * DISC_OUTER_RADIUS *
+                                          OS_TIMER_CLOCK * 0x1p1 + 0.5);
+static const u32 LONG_SEEK_SLOPE = (u32)(LONG_SEEK_VELOCITY_INVERSE * DISC_OUTER_RADIUS *
+                                         OS_TIMER_CLOCK * 0x1p1 + 0.5);
+static const OSTick SHORT_SEEK_TICKS = (OSTick)(SHORT_SEEK_CONSTANT * OS_TIMER_CLOCK + 0.5);
+static const OSTick LONG_SEEK_TICKS = (OSTick)(LONG_SEEK_CONSTANT * OS_TIMER_CLOCK + 0.5);
+
+// Q32 angle per Q31 radius unit in Q16, and per tick in Q32.
+static const u64 TRACK_ANGLE_SCALE = (u64)(DISC_OUTER_RADIUS / DISC_TRACK_PITCH * 0x1p17 + 0.5);
+static const u64 SPIN_ANGLE_SCALE = (u64)(ROTATIONS_PER_SECOND / OS_TIMER_CLOCK * 0x1p64 + 0.5);
+static const u32 TICKS_PER_ROTATION = (u32)(OS_TIMER_CLOCK / ROTATIONS_PER_SECOND + 0.5);
+
+static u32 PhysicalDiscPositionQ31(u32 offset)
+{
+  u32 index = MIN(offset >> DISC_TABLE_SHIFT, DISC_TABLE_SIZE - 2);
+  u32 fraction = offset - (index << DISC_TABLE_SHIFT);
+
+  s32 delta = radius_table[index + 1] - radius_table[index];
+  u32 radius = radius_table[index] + (s32)(((s64)delta * fraction) >> DISC_TABLE_SHIFT);
+
+  // The interpolated radius is within a few ten-thousandths of the true value,
+  // so one Newton step against the exact square is enough to reach full precision.
+  s64 error = (s64)(RADIUS_SQUARED_BASE + (u64)offset * RADIUS_SQUARED_SCALE) -
+              (s64)((u64)radius * radius);
+  return radius + (s32)(error >> 16) / (s32)(radius >> 15);
+}
+
+OSTick CalculateSeekTicks(u32 offset_from, u32 offset_to)
+{
+  const u32 position_from = PhysicalDiscPositionQ31(offset_from);
+  const u32 position_to = PhysicalDiscPositionQ31(offset_to);
+
+  const u32 distance =
+      position_from > position_to ? position_from - position_to : position_to - position_from;
+
+  if (distance < SHORT_SEEK_MAX_DISTANCE_Q31)
+    return (((u64)distance * SHORT_SEEK_SLOPE) >> 32) + SHORT_SEEK_TICKS;
+  else
+    return (((u64)distance * LONG_SEEK_SLOPE) >> 32) + LONG_SEEK_TICKS;
+}
+
+OSTick CalculateRotationalLatencyTicks(u32 offset, OSTime time)
+{
+  const u32 target_angle = ((u64)PhysicalDiscPositionQ31(offset) * TRACK_ANGLE_SCALE) >> 16;
+  // Only bits 32-63 of the 128-bit product are needed, which keeps the spin
+  // phase exact no matter how long the console has been running.
+  const u32 time_hi = (u64)time >> 32, time_lo = time;
+  const u32 start_angle = (((u64)time_lo * (u32)SPIN_ANGLE_SCALE) >> 32) +
+                          time_lo * (u32)(SPIN_ANGLE_SCALE >> 32) +
+                          time_hi * (u32)SPIN_ANGLE_SCALE;
+
+  return ((u64)(target_angle - start_angle) * TICKS_PER_ROTATION) >> 32;
+}
+
+OSTick CalculateRawDiscReadTicks(u32 offset, u32 length)
+{
+  offset += length / 2;
+
+  u32 index = MIN(offset >> DISC_TABLE_SHIFT, DISC_TABLE_SIZE - 2);
+  u32 fraction = offset - (index << DISC_TABLE_SHIFT);
+
+  s32 delta = ticks_per_byte_table[index + 1] - ticks_per_byte_table[index];
+  u32 ticks_per_byte =
+      ticks_per_byte_table[index] + (s32)(((s64)delta * fraction) >> DISC_TABLE_SHIFT);
+
+  return ((u64)length * ticks_per_byte) >> 16;
+}
+#endif
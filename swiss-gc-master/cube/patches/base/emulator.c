@@ -31,6 +31,7 @@
 #include "fifo.h"
 #include "frag.h"
 #include "interrupt.h"
+#include "prefetch.h"
 
 static struct {
 	union {
@@ -1074,10 +1075,8 @@ static bool ppc_dcbz(uint32_t address)
 	return false;
 }
 
-static bool ppc_step(ppc_context_t *context)
+static bool ppc_step(ppc_context_t *context, uint32_t opcode)
 {
-	uint32_t opcode = *(uint32_t *)context->srr0;
-
 	switch (opcode >> 26) {
 		case 31:
 		{
@@ -1156,11 +1155,92 @@ static bool ppc_step(ppc_context_t *context)
 	return false;
 }
 
+/* Instructions that fault on an emulated register are rewritten into a
+ * branch to a stub that enters service_trap without taking an exception.
+ * Should the same instruction later touch anything else, the original is
+ * put back and that site is left to the exception handler from then on. */
+#define TRAP_CACHE_SIZE 32
+
+static struct {
+	int count;
+	struct {
+		uint32_t stub[4];
+		uint32_t *address;
+		uint32_t opcode;
+		bool native;
+	} *entry;
+} trap;
+
+void trap_fast_path(void);
+
+static void write_instruction(uint32_t *a, uint32_t value)
+{
+	*a = value;
+	asm volatile("dcbst 0,%0; sync; icbi 0,%0; isync" :: "r" (a));
+}
+
+static uint32_t trap_branch(unsigned index)
+{
+	return 0x48000000 | (((uint32_t)trap.entry[index].stub - (uint32_t)trap.entry[index].address) & 0x3FFFFFC);
+}
+
+static void trap_insert(uint32_t *address, uint32_t opcode)
+{
+	uint32_t dar; asm("mfdar %0" : "=r" (dar));
+	int index;
+
+	if ((dar >> 16) != 0x0C00 && (dar >> 24) != 0x08)
+		return;
+
+	for (index = 0; index < trap.count; index++)
+		if (trap.entry[index].address == address)
+			break;
+
+	if (index == trap.count) {
+		if (index == TRAP_CACHE_SIZE)
+			return;
+		trap.count++;
+	} else if (trap.entry[index].native && trap.entry[index].opcode == opcode)
+		return;
+
+	trap.entry[index].address = address;
+	trap.entry[index].opcode = opcode;
+	trap.entry[index].native = false;
+	write_instruction(address, trap_branch(index));
+}
+
+static void trap_flush(void)
+{
+	for (int index = 0; index < trap.count; index++) {
+		if (*trap.entry[index].address == trap_branch(index))
+			write_instruction(trap.entry[index].address, trap.entry[index].opcode);
+	}
+
+	trap.count = 0;
+}
+
+ppc_context_t *service_trap(ppc_context_t *context, unsigned index)
+{
+	context->srr0 = (uint32_t)trap.entry[index].address;
+
+	if (ppc_step(context, trap.entry[index].opcode))
+		context->srr0 += 4;
+	else {
+		write_instruction(trap.entry[index].address, trap.entry[index].opcode);
+		trap.entry[index].native = true;
+	}
+
+	return context;
+}
+
 ppc_context_t *service_exception(ppc_context_t *context)
 {
-	if (ppc_step(context))
+	uint32_t opcode = *(uint32_t *)context->srr0;
+
+	if (ppc_step(context, opcode)) {
+		trap_insert((uint32_t *)context->srr0, opcode);
 		context->srr0 += 4;
-	else
+	} else
 		__builtin_trap();
 
 	return context;
@@ -1171,8 +1251,26 @@ void external_interrupt_vector(void);
 
 static void write_branch(void *a, void *b)
 {
-	*(uint32_t *)a = (uint32_t)(b - (OS_BASE_CACHED - 0x48000002));
-	asm volatile("dcbst 0,%0; sync; icbi 0,%0" :: "r" (a));
+	write_instruction(a, (uint32_t)(b - (OS_BASE_CACHED - 0x48000002)));
+}
+
+static void trap_init(void **arenaLo, void **arenaHi)
+{
+	*arenaHi -= OSRoundUp32B(sizeof(*trap.entry) * TRAP_CACHE_SIZE); trap.entry = *arenaHi;
+
+	for (int index = 0; index < TRAP_CACHE_SIZE; index++) {
+		uint32_t *stub = trap.entry[index].stub;
+
+		stub[0] = 0x9421FF50; // stwu r1, -176 (r1)
+		stub[1] = 0x90610014; // stw r3, 8 + 12 (r1)
+		stub[2] = 0x38600000 | index; // li r3, index
+		stub[3] = 0x48000000 | (((uint32_t)trap_fast_path - (uint32_t)&stub[3]) & 0x3FFFFFC);
+
+		for (int i = 0; i < 4; i++)
+			asm volatile("dcbst 0,%0; sync; icbi 0,%0" :: "r" (&stub[i]));
+	}
+
+	asm volatile("isync");
 }
 
 #ifdef BBA
@@ -1185,6 +1283,7 @@ void init(void **arenaLo, void **arenaHi)
 	OSCreateAlarm(&cover_alarm);
 	OSCreateAlarm(&read_alarm);
 
+	trap_init(arenaLo, arenaHi);
 	write_branch((void *)0x80000300, dsi_exception_vector);
 	#ifdef ISR
 	write_branch((void *)0x80000500, external_interrupt_vector);
@@ -1193,6 +1292,12 @@ void init(void **arenaLo, void **arenaHi)
 	#ifdef BBA
 	bba_init(arenaLo, arenaHi);
 	#endif
+	#ifdef PREFETCH
+	prefetch_init(arenaLo, arenaHi);
+	#endif
+	#ifdef CARD_EMULATOR
+	card_init(arenaLo, arenaHi);
+	#endif
 	#ifdef DI_PASSTHROUGH
 	DI[0] = 0b0101010;
 	DI[1] = 0b010;
@@ -1221,5 +1326,12 @@ void idle_thread(void)
 void fini(void)
 {
 	OSDisableInterrupts();
+	trap_flush();
+	#ifdef PREFETCH
+	prefetch_fini();
+	#endif
+	#ifdef CARD_EMULATOR
+	card_fini();
+	#endif
 	reset_devices();
 }
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 #include "common.h"
 #include "dolphin/exi.h"
 #include "dolphin/os.h"
@@ -27,8 +28,17 @@
 #include "emulator_card.h"
 #include "frag.h"
 
+#ifdef CARD_CACHE
+#define CARD_BLOCK_SIZE 8192
+#define CARD_PAGE_SIZE  512
+#define CARD_RETRIES    3
+
+static void carda_read_callback(void *address, uint32_t length);
+static void cardb_read_callback(void *address, uint32_t length);
+#else
 #define carda_read_callback exi0_complete_transfer
 #define cardb_read_callback exi1_complete_transfer
+#endif
 
 static void carda_write_callback(void *address, uint32_t length);
 static void cardb_write_callback(void *address, uint32_t length);
@@ -42,6 +52,13 @@ static struct {
 	frag_callback read_callback;
 	frag_callback write_callback;
 	#endif
+	#ifdef CARD_CACHE
+	struct {
+		void *buffer;
+		uint32_t length;
+		uint32_t offset;
+	} request;
+	#endif
 } card[2] = {
 	{
 		.status = 0b11000001,
@@ -58,6 +75,233 @@ static struct {
 	}
 };
 
+#ifdef CARD_CACHE
+/* Page programs land in a single 8 KiB block buffer and complete at once.
+ * Dirty pages are written back in runs once the card is deselected, and
+ * reprogramming a page before it reaches the device costs no extra write.
+ * Only one device request is outstanding at a time, so card I/O never
+ * takes more than one slot of the device queue.
+ * Pages that fail to write stay dirty. Once CARD_RETRIES attempts in a row
+ * have failed, or while the card reports an error, programs are written
+ * through and only complete once the device has them. Whatever is still
+ * cached when the game resets is written out synchronously by card_fini. */
+static struct {
+	void *buffer;
+	int chan;
+	uint32_t offset;
+	uint16_t dirty;
+	uint16_t writing;
+	uint8_t retries;
+	bool busy;
+} cache = {
+	.chan = -1
+};
+
+static void card_cache_run(void);
+static void carda_program_callback(void *address, uint32_t length);
+static void cardb_program_callback(void *address, uint32_t length);
+
+static uint16_t cache_pages(unsigned chan, uint32_t offset, uint32_t length)
+{
+	if (cache.chan != chan)
+		return 0;
+	if (offset >= cache.offset + CARD_BLOCK_SIZE || offset + length <= cache.offset)
+		return 0;
+
+	uint32_t start = MAX(offset, cache.offset) - cache.offset;
+	uint32_t end = MIN(offset + length, cache.offset + CARD_BLOCK_SIZE) - cache.offset;
+
+	return ((2 << ((end - 1) / CARD_PAGE_SIZE)) - 1) & ~((1 << (start / CARD_PAGE_SIZE)) - 1);
+}
+
+static bool card_read(unsigned chan)
+{
+	while (card[chan].request.length) {
+		void *buffer = card[chan].request.buffer;
+		uint32_t offset = card[chan].request.offset;
+		uint32_t length = MIN(card[chan].request.length, CARD_PAGE_SIZE - offset % CARD_PAGE_SIZE);
+		uint16_t valid = cache.dirty | cache.writing;
+
+		if (cache_pages(chan, offset, length) & valid) {
+			memcpy(buffer, cache.buffer + (offset - cache.offset), length);
+		} else {
+			uint16_t pages = cache_pages(chan, offset, card[chan].request.length) & valid;
+
+			if (pages)
+				length = cache.offset + __builtin_ctz(pages) * CARD_PAGE_SIZE - offset;
+			else
+				length = card[chan].request.length;
+
+			cache.busy = true;
+
+			if (frag_read_async(FRAGS_CARD(chan), buffer, length, offset, card[chan].read_callback))
+				return true;
+
+			cache.busy = false;
+			break;
+		}
+
+		card[chan].request.buffer += length;
+		card[chan].request.length -= length;
+		card[chan].request.offset += length;
+	}
+
+	card[chan].request.buffer = NULL;
+	card[chan].request.length = 0;
+	return false;
+}
+
+static void card_read_callback(unsigned chan, uint32_t length)
+{
+	cache.busy = false;
+
+	if (length) {
+		card[chan].request.buffer += length;
+		card[chan].request.length -= length;
+		card[chan].request.offset += length;
+	} else
+		card[chan].request.length = 0;
+
+	if (!card_read(chan))
+		exi_complete_transfer(chan);
+
+	card_cache_run();
+}
+
+static void carda_read_callback(void *address, uint32_t length)
+{
+	card_read_callback(0, length);
+}
+
+static void cardb_read_callback(void *address, uint32_t length)
+{
+	card_read_callback(1, length);
+}
+
+static bool card_program(unsigned chan)
+{
+	uint32_t offset = card[chan].request.offset;
+	uint32_t block = offset & ~(CARD_BLOCK_SIZE - 1);
+
+	if (cache.retries >= CARD_RETRIES || (card[chan].status & 0b00001000)) {
+		if (cache.busy)
+			return false;
+
+		cache.dirty &= ~cache_pages(chan, offset, CARD_PAGE_SIZE);
+		cache.busy = true;
+
+		if (!frag_write_async(FRAGS_CARD(chan), card[chan].request.buffer, CARD_PAGE_SIZE, offset,
+			chan ? cardb_program_callback : carda_program_callback)) {
+			cache.busy = false;
+			card[chan].status |= 0b00001000;
+			card[chan].request.buffer = NULL;
+			return true;
+		}
+
+		card[chan].request.buffer = NULL;
+		return false;
+	}
+
+	if (cache.chan != chan || cache.offset != block) {
+		if (cache.dirty || cache.writing)
+			return false;
+
+		cache.chan = chan;
+		cache.offset = block;
+	}
+
+	memcpy(cache.buffer + (offset - block), card[chan].request.buffer, CARD_PAGE_SIZE);
+	cache.dirty |= 1 << ((offset - block) / CARD_PAGE_SIZE);
+
+	card[chan].request.buffer = NULL;
+	return true;
+}
+
+static void card_program_callback(unsigned chan, uint32_t length)
+{
+	cache.busy = false;
+
+	if (length == CARD_PAGE_SIZE)
+		cache.retries = 0;
+	else
+		card[chan].status |= 0b00001000;
+
+	exi_complete_transfer(chan);
+	card_cache_run();
+}
+
+static void carda_program_callback(void *address, uint32_t length)
+{
+	card_program_callback(0, length);
+}
+
+static void cardb_program_callback(void *address, uint32_t length)
+{
+	card_program_callback(1, length);
+}
+
+static void card_write_done(uint32_t length)
+{
+	uint16_t written = ((1 << (length / CARD_PAGE_SIZE)) - 1) << __builtin_ctz(cache.writing);
+
+	cache.dirty |= cache.writing & ~written;
+	cache.writing = 0;
+	cache.busy = false;
+
+	if (written)
+		cache.retries = 0;
+	else if (++cache.retries >= CARD_RETRIES)
+		card[cache.chan].status |= 0b00001000;
+}
+
+static void card_write_callback(void *address, uint32_t length)
+{
+	card_write_done(length);
+	card_cache_run();
+}
+
+static void card_cache_run(void)
+{
+	for (int chan = 0; chan < 2; chan++) {
+		if (card[chan].request.buffer && card[chan].command == 0xF2)
+			if (card_program(chan))
+				exi_complete_transfer(chan);
+	}
+
+	if (cache.busy)
+		return;
+
+	for (int chan = 0; chan < 2; chan++) {
+		if (card[chan].request.buffer && card[chan].command == 0x52) {
+			if (card_read(chan))
+				return;
+			exi_complete_transfer(chan);
+		}
+	}
+
+	while (cache.dirty && cache.retries < CARD_RETRIES) {
+		int first = __builtin_ctz(cache.dirty);
+		int count = __builtin_ctz(~(cache.dirty >> first));
+
+		cache.writing = ((1 << count) - 1) << first;
+		cache.dirty &= ~cache.writing;
+		cache.busy = true;
+
+		if (frag_write_async(FRAGS_CARD(cache.chan), cache.buffer + first * CARD_PAGE_SIZE, count * CARD_PAGE_SIZE,
+			cache.offset + first * CARD_PAGE_SIZE, card_write_callback))
+			return;
+
+		card_write_done(0);
+	}
+
+	for (int chan = 0; chan < 2; chan++) {
+		if (card[chan].request.buffer && card[chan].command == 0xF2)
+			if (card_program(chan))
+				exi_complete_transfer(chan);
+	}
+}
+#endif
+
 static void carda_write_callback(void *address, uint32_t length)
 {
 	if (length != 512) card[0].status |= 0b00001000;
@@ -142,7 +386,15 @@ bool card_dma(unsigned chan, uint32_t address, uint32_t length, int type)
 		case 0x52:
 		{
 			if (card[chan].position >= 5 && type == EXI_READ) {
-				#ifdef ASYNC_READ
+				#if defined CARD_CACHE
+				card[chan].request.buffer = buffer;
+				card[chan].request.length = length;
+				card[chan].request.offset = card[chan].offset;
+
+				if (!cache.busy && !card_read(chan))
+					break;
+				return true;
+				#elif defined ASYNC_READ
 				return frag_read_async(FRAGS_CARD(chan), buffer, length, card[chan].offset, card[chan].read_callback);
 				#else
 				frag_read(FRAGS_CARD(chan), buffer, length, card[chan].offset);
@@ -154,7 +406,19 @@ bool card_dma(unsigned chan, uint32_t address, uint32_t length, int type)
 		{
 			if (card[chan].position == 5 && type == EXI_WRITE) {
 				if (card[chan].offset % 512 == 0) {
-					#ifdef ASYNC_READ
+					#if defined CARD_CACHE
+					if (!cache.buffer)
+						return frag_write_async(FRAGS_CARD(chan), buffer, 512, card[chan].offset, card[chan].write_callback);
+
+					card[chan].request.buffer = buffer;
+					card[chan].request.offset = card[chan].offset;
+
+					if (card_program(chan))
+						break;
+
+					card_cache_run();
+					return true;
+					#elif defined ASYNC_READ
 					return frag_write_async(FRAGS_CARD(chan), buffer, 512, card[chan].offset, card[chan].write_callback);
 					#else
 					if (frag_write(FRAGS_CARD(chan), buffer, 512, card[chan].offset) != 512) card[chan].status |= 0b00001000;
@@ -191,12 +455,49 @@ void card_deselect(unsigned chan)
 		}
 		case 0xF2:
 		{
-			if (card[chan].position >= 5)
+			if (card[chan].position >= 5) {
+				#ifdef CARD_CACHE
+				cache.retries = 0;
+				card_cache_run();
+				#endif
 				if (card[chan].status & 0b00000010)
 					exi_interrupt(chan);
+			}
 			break;
 		}
 	}
 
 	card[chan].position = 0;
 }
+
+void card_fini(void)
+{
+	#ifdef CARD_CACHE
+	uint16_t pages = cache.dirty | cache.writing;
+
+	cache.dirty = cache.writing = 0;
+
+	while (EXI[EXI_CHANNEL_0][3] & 0b000001);
+	while (EXI[EXI_CHANNEL_1][3] & 0b000001);
+	while (EXI[EXI_CHANNEL_2][3] & 0b000001);
+
+	while (pages) {
+		int page = __builtin_ctz(pages);
+
+		if (frag_write(FRAGS_CARD(cache.chan), cache.buffer + page * CARD_PAGE_SIZE, CARD_PAGE_SIZE,
+			cache.offset + page * CARD_PAGE_SIZE) != CARD_PAGE_SIZE)
+			card[cache.chan].status |= 0b00001000;
+
+		pages &= ~(1 << page);
+	}
+	#endif
+}
+
+void card_init(void **arenaLo, void **arenaHi)
+{
+	#ifdef CARD_CACHE
+	if (VAR_CARD_IDS[0] || VAR_CARD_IDS[1]) {
+		*arenaHi -= CARD_BLOCK_SIZE; cache.buffer = OSCachedToUncached(*arenaHi);
+	}
+	#endif
+}
@@ -29,7 +29,7 @@
 #define DVD_SECTOR_SIZE    2048
 #define DVD_ECC_BLOCK_SIZE (16 * DVD_SECTOR_SIZE)
 
-#define BUFFER_TRANSFER_RATE (13.5 * 1000 * 1000)
+#define BUFFER_TRANSFER_RATE (13500 * 1000)
 
 static struct {
 	union {
@@ -98,18 +98,18 @@ void dvd_schedule_read(uint32_t offset, uint32_t length, OSAlarmHandler handler)
 
 		if (dvd_offset >= buffer_start && dvd_offset < buffer_end) {
 			ticks += COMMAND_LATENCY_TICKS;
-			ticks += OSSecondsToTicks(chunk_length / BUFFER_TRANSFER_RATE);
+			ticks += chunk_length * OSMillisecondsToTicks(1) / (BUFFER_TRANSFER_RATE / 1000);
 		} else {
 			if (dvd_offset != head_position) {
-				ticks += OSSecondsToTicks(CalculateSeekTime(head_position, dvd_offset));
-				ticks += OSSecondsToTicks(CalculateRotationalLatency(dvd_offset,
-					OSTicksToSeconds((double)(current_time + ticks_until_completion + ticks))));
+				ticks += CalculateSeekTicks(head_position, dvd_offset);
+				ticks += CalculateRotationalLatencyTicks(dvd_offset,
+					current_time + ticks_until_completion + ticks);
 
 				#if READ_SPEED_TIER == 2
 				ticks_until_execution += ticks;
 				#endif
 			} else {
-				ticks += OSSecondsToTicks(CalculateRawDiscReadTime(dvd_offset, DVD_ECC_BLOCK_SIZE));
+				ticks += CalculateRawDiscReadTicks(dvd_offset, DVD_ECC_BLOCK_SIZE);
 			}
 
 			#if READ_SPEED_TIER == 1
@@ -134,8 +134,8 @@ void dvd_schedule_read(uint32_t offset, uint32_t length, OSAlarmHandler handler)
 
 		read_buffer.start_time = current_time + ticks_until_completion;
 		read_buffer.end_time = read_buffer.start_time +
-			(OSTick)OSSecondsToTicks(CalculateRawDiscReadTime(read_buffer.start_offset,
-			read_buffer.end_offset - read_buffer.start_offset));
+			CalculateRawDiscReadTicks(read_buffer.start_offset,
+			read_buffer.end_offset - read_buffer.start_offset);
 	}
 
 	OSSetAlarm(&read_alarm, ticks_until_execution, handler);
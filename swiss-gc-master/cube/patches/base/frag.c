@@ -23,6 +23,9 @@
 #include "common.h"
 #include "dolphin/os.h"
 #include "frag.h"
+#ifdef PREFETCH
+#include "prefetch.h"
+#endif
 
 #define DEVICE_DISC 0
 #ifndef DEVICE_PATCHES
@@ -110,6 +113,10 @@ bool frag_read_write_async(int file, void *buffer, uint32_t length, uint32_t off
 	if (frag_get(file, offset, length, &frag)) {
 		if (frag.device == DEVICE_PATCHES)
 			return do_read_write_async(buffer, frag.size, frag.offset, frag.sector, write, callback);
+		#ifdef PREFETCH
+		else if (!write && prefetch_read(file, buffer, frag.size, offset, callback))
+			return true;
+		#endif
 		else if (!write)
 			return do_read_disc(buffer, frag.size, frag.offset, &frag, callback);
 	#ifdef DIRECT_DISC
@@ -0,0 +1,317 @@
+/*
+ * This file is part of Swiss.
+ *
+ * Swiss is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Swiss is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * with Swiss.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "common.h"
+#include "dolphin/ar.h"
+#include "dolphin/os.h"
+#include "frag.h"
+#include "prefetch.h"
+
+#define PREFETCH_SERVE_MAX 32768
+
+static struct {
+	prefetch_trace_t *trace;
+	uint32_t budget;
+	uint32_t stored;
+	OSAlarm quiet;
+
+	prefetch_table_t *table;
+	uint8_t *sector;
+	uint32_t *sums;
+	int32_t line;
+
+	OSAlarm alarm;
+	void *buffer;
+	uint32_t length;
+	frag_callback callback;
+} prefetch;
+
+static uint32_t prefetch_checksum(const void *data, uint32_t length)
+{
+	const uint32_t *word = data;
+	uint32_t sum = 0x811C9DC5;
+
+	for (; length >= 4; length -= 4)
+		sum = (sum ^ *word++) * 0x01000193;
+
+	return sum;
+}
+
+static bool aram_dma(void *buffer, uint32_t aram, uint32_t length, bool read)
+{
+	uint32_t level = disable_interrupts();
+
+	while (ARGetDMAStatus());
+
+	// A pending interrupt is the game's, leave it for the game to take
+	if (ARGetInterruptStatus()) {
+		restore_interrupts(level);
+		return false;
+	}
+
+	if (read)
+		DCInvalidateRange(buffer, length);
+	else
+		DCFlushRange(buffer, length);
+
+	ARStartDMA(read ? ARAM_DIR_ARAM_TO_MRAM : ARAM_DIR_MRAM_TO_ARAM, OSCachedToPhysical(buffer), aram, length);
+	while (ARGetDMAStatus());
+	ARClearInterrupt();
+
+	restore_interrupts(level);
+	return true;
+}
+
+void prefetch_init(void **arenaLo, void **arenaHi)
+{
+	if (*(uint8_t *)VAR_PREFETCH_SIZE) {
+		*arenaHi -= PREFETCH_TRACE_SIZE; prefetch.trace = *arenaHi;
+
+		memset(prefetch.trace, 0, PREFETCH_TRACE_SIZE);
+		prefetch.trace->magic = PREFETCH_TRACE_MAGIC;
+		memcpy(prefetch.trace->id, (void *)0x80000000, sizeof(prefetch.trace->id));
+		prefetch.budget = *(uint8_t *)VAR_PREFETCH_SIZE << 20;
+
+		OSCreateAlarm(&prefetch.quiet);
+	}
+
+	if (*(uint8_t *)VAR_PREFETCH_WARM) {
+		*arenaHi -= OSRoundUp32B(sizeof(*prefetch.table)); prefetch.table = *arenaHi;
+
+		// Anything pending now was left behind by the loader
+		if (ARGetInterruptStatus())
+			ARClearInterrupt();
+
+		if (!aram_dma(prefetch.table, PREFETCH_ARAM_TABLE, OSRoundUp32B(sizeof(*prefetch.table)), true) ||
+			prefetch.table->magic != PREFETCH_TABLE_MAGIC || prefetch.table->count > PREFETCH_EXTENTS_MAX ||
+			memcmp(prefetch.table->id, (void *)0x80000000, sizeof(prefetch.table->id))) {
+			*arenaHi += OSRoundUp32B(sizeof(*prefetch.table)); prefetch.table = NULL;
+			return;
+		}
+
+		*arenaHi -= PREFETCH_SECTOR_SIZE; prefetch.sector = *arenaHi;
+		*arenaHi -= 32; prefetch.sums = *arenaHi;
+		prefetch.line = -1;
+
+		OSCreateAlarm(&prefetch.alarm);
+	}
+}
+
+static void prefetch_seal(prefetch_trace_t *trace)
+{
+	trace->checksum = prefetch_checksum(trace->id, offsetof(prefetch_trace_t, reads) - offsetof(prefetch_trace_t, id) + trace->count * sizeof(prefetch_read_t));
+	DCFlushRange(trace, PREFETCH_TRACE_SIZE);
+}
+
+static void prefetch_store_next(void);
+
+static void prefetch_stored(void *buffer, uint32_t length)
+{
+	prefetch.stored += length;
+
+	if (length && prefetch.stored < PREFETCH_TRACE_SIZE)
+		prefetch_store_next();
+}
+
+static void prefetch_store_next(void)
+{
+	// Without a file on the patches device the trace only leaves through ARAM on reset
+	frag_write_async(FRAGS_PREFETCH, (void *)prefetch.trace + prefetch.stored,
+		PREFETCH_TRACE_SIZE - prefetch.stored, prefetch.stored, prefetch_stored);
+}
+
+// Ends the recording and writes the trace out, so it's kept however the game is left
+static void prefetch_store(void)
+{
+	uint32_t level = disable_interrupts();
+
+	OSCancelAlarm(&prefetch.quiet);
+	prefetch.budget = 0;
+
+	if (prefetch.trace->count) {
+		prefetch_seal(prefetch.trace);
+		prefetch.stored = 0;
+		prefetch_store_next();
+	}
+
+	restore_interrupts(level);
+}
+
+static void prefetch_quiet(OSAlarm *alarm, OSContext *context)
+{
+	prefetch_store();
+}
+
+static void prefetch_append(prefetch_trace_t *trace, uint32_t offset, uint32_t length)
+{
+	if (trace->count) {
+		prefetch_read_t *last = &trace->reads[trace->count - 1];
+		uint32_t end = last->offset + last->length;
+
+		// Sequential reads grow the last one, only bytes not yet seen are charged
+		if (offset >= last->offset && offset <= end) {
+			if (offset + length > end) {
+				length = MIN(offset + length - end, prefetch.budget);
+				last->length += length;
+				prefetch.budget -= length;
+			}
+			return;
+		}
+	}
+
+	if (trace->count == PREFETCH_TRACE_MAX) {
+		prefetch.budget = 0;
+		return;
+	}
+
+	length = MIN(length, prefetch.budget);
+	trace->reads[trace->count].offset = offset;
+	trace->reads[trace->count].length = length;
+	trace->count++;
+	prefetch.budget -= length;
+}
+
+static void prefetch_record(uint32_t offset, uint32_t length)
+{
+	if (!prefetch.trace || !prefetch.budget)
+		return;
+
+	uint32_t level = disable_interrupts();
+
+	prefetch_append(prefetch.trace, offset, length);
+
+	// The boot is over once the budget is used up or the game stops reading for a while
+	if (!prefetch.budget)
+		prefetch_store();
+	else {
+		OSCancelAlarm(&prefetch.quiet);
+		OSSetAlarm(&prefetch.quiet, OSSecondsToTicks(PREFETCH_QUIET_SECS), prefetch_quiet);
+	}
+
+	restore_interrupts(level);
+}
+
+static prefetch_extent_t *prefetch_find(uint32_t offset)
+{
+	prefetch_extent_t *extents = prefetch.table->extents;
+	int lo = 0, hi = prefetch.table->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (extents[mid].offset <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (!lo || offset - extents[lo - 1].offset >= extents[lo - 1].size)
+		return NULL;
+
+	return &extents[lo - 1];
+}
+
+static bool prefetch_sum(uint32_t index, uint32_t *sum)
+{
+	int32_t line = index / 8;
+
+	if (line != prefetch.line) {
+		prefetch.line = -1;
+
+		if (!aram_dma(prefetch.sums, PREFETCH_ARAM_SUMS + line * 32, 32, true))
+			return false;
+
+		prefetch.line = line;
+	}
+
+	*sum = prefetch.sums[index % 8];
+	return true;
+}
+
+static void prefetch_done(OSAlarm *alarm, OSContext *context)
+{
+	frag_callback callback = prefetch.callback;
+	prefetch.callback = NULL;
+	callback(prefetch.buffer, prefetch.length);
+}
+
+bool prefetch_read(int file, void *buffer, uint32_t length, uint32_t offset, frag_callback callback)
+{
+	prefetch_extent_t *extent;
+	uint32_t done = 0;
+
+	if (file != FRAGS_DISC_1)
+		return false;
+
+	prefetch_record(offset, length);
+
+	if (!prefetch.table || prefetch.callback || !(extent = prefetch_find(offset)))
+		return false;
+
+	length = MIN(length, extent->offset + extent->size - offset);
+	length = MIN(length, PREFETCH_SERVE_MAX);
+
+	while (done < length) {
+		uint32_t position = offset + done - extent->offset;
+		uint32_t sector = position / PREFETCH_SECTOR_SIZE;
+		uint32_t skip = position % PREFETCH_SECTOR_SIZE;
+		uint32_t size = MIN(length - done, PREFETCH_SECTOR_SIZE - skip);
+		uint32_t sum;
+
+		if (!prefetch_sum(extent->sum + sector, &sum) ||
+			!aram_dma(prefetch.sector, extent->aram + sector * PREFETCH_SECTOR_SIZE, PREFETCH_SECTOR_SIZE, true))
+			break;
+
+		// The game has since taken this part of ARAM for itself
+		if (prefetch_checksum(prefetch.sector, PREFETCH_SECTOR_SIZE) != sum) {
+			extent->size = 0;
+			break;
+		}
+
+		memcpy(buffer + done, prefetch.sector + skip, size);
+		done += size;
+	}
+
+	if (!done)
+		return false;
+
+	// Complete from an alarm as the device would, rather than recursing into the caller
+	prefetch.buffer = buffer;
+	prefetch.length = done;
+	prefetch.callback = callback;
+	OSSetAlarm(&prefetch.alarm, 0, prefetch_done);
+	return true;
+}
+
+void prefetch_fini(void)
+{
+	prefetch_trace_t *trace = prefetch.trace;
+
+	if (!trace || !trace->count)
+		return;
+
+	prefetch_seal(trace);
+
+	// Left in ARAM too, for when there's no file on the patches device. The game is done with ARAM
+	while (ARGetDMAStatus());
+	ARStartDMAWrite(OSCachedToPhysical(trace), PREFETCH_ARAM_TRACE, sizeof(*trace));
+	while (ARGetDMAStatus());
+}
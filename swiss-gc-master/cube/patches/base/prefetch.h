@@ -0,0 +1,61 @@
+/*
+ * This file is part of Swiss.
+ *
+ * Swiss is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Swiss is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * with Swiss.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "common.h"
+#include "frag.h"
+
+// Layouts shared with swiss/include/prefetch.h
+
+typedef struct {
+	uint32_t offset;
+	uint32_t length;
+} prefetch_read_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t checksum;
+	uint8_t id[8];
+	uint32_t count;
+	uint32_t reserved[3];
+	prefetch_read_t reads[PREFETCH_TRACE_MAX];
+} prefetch_trace_t;
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+	uint32_t aram;
+	uint32_t sum;
+} prefetch_extent_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t count;
+	uint8_t id[8];
+	uint32_t reserved[4];
+	prefetch_extent_t extents[PREFETCH_EXTENTS_MAX];
+} prefetch_table_t;
+
+void prefetch_init(void **arenaLo, void **arenaHi);
+bool prefetch_read(int file, void *buffer, uint32_t length, uint32_t offset, frag_callback callback);
+void prefetch_fini(void);
+
+#endif /* PREFETCH_H */
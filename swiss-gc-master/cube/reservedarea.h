@@ -36,6 +36,8 @@
 .set VAR_ROUTER_IP,			0x09D0	# router IPv4 address
 .set VAR_SERVER_IP,			0x09D4	# server IPv4 address
 .set VAR_SERVER_PORT,		0x09D8	# server UDP port
+.set VAR_PREFETCH_SIZE,		0x09DA	# boot prefetch size in MB (0 = off)
+.set VAR_PREFETCH_WARM,		0x09DB	# boot prefetch is warmed in ARAM
 
 .set VAR_FLOAT1_6,			0x09E0	# constant 1/6
 .set VAR_FLOAT9_16,			0x09E4	# constant 9/16
@@ -96,6 +98,8 @@ extern char VAR_CLIENT_IP[4];		// client IPv4 address
 extern char VAR_ROUTER_IP[4];		// router IPv4 address
 extern char VAR_SERVER_IP[4];		// server IPv4 address
 extern char VAR_SERVER_PORT[2];		// server UDP port
+extern char VAR_PREFETCH_SIZE[1];	// boot prefetch size in MB (0 = off)
+extern char VAR_PREFETCH_WARM[1];	// boot prefetch is warmed in ARAM
 
 extern char VAR_FLOAT1_6[4];		// constant 1/6
 extern char VAR_FLOAT9_16[4];		// constant 9/16
@@ -137,5 +141,19 @@ extern char VAR_RMODE[4];			// render mode
 #define FRAGS_CARD(n)	(4 + (n))
 #define FRAGS_CARD_A	FRAGS_CARD(0)
 #define FRAGS_CARD_B	FRAGS_CARD(1)
+#define FRAGS_PREFETCH	6
+
+// Boot prefetch, kept at the top of ARAM (0x1000000)
+#define PREFETCH_SECTOR_SIZE	2048
+#define PREFETCH_SIZE_MAX		(8*1024*1024)
+#define PREFETCH_TRACE_MAX		256
+#define PREFETCH_TRACE_SIZE		2560		// trace in whole 512 byte sectors, as stored on the patches device
+#define PREFETCH_QUIET_SECS		3			// a boot is over once it has read nothing for this long
+#define PREFETCH_EXTENTS_MAX	127
+#define PREFETCH_TRACE_MAGIC	0x53504654	// 'SPFT'
+#define PREFETCH_TABLE_MAGIC	0x53504658	// 'SPFX'
+#define PREFETCH_ARAM_TRACE		0x0FFF000	// reads made by the last boot
+#define PREFETCH_ARAM_TABLE		0x0FFE000	// extents warmed for this boot
+#define PREFETCH_ARAM_SUMS		0x0FFA000	// sector checksums, the data sits below
 #endif
 
@@ -20,6 +20,8 @@ extern u8 kenobigc_dbg_bin[];
 #define CHEATS_NAME_LEN			128
 #define CHEATS_MAX_FOR_GAME		400
 #define SINGLE_CHEAT_MAX_LINES	512
+#define CHEATS_SEARCH_DEVICES	4
+#define CHEATS_SEARCH_ALL		((1 << CHEATS_SEARCH_DEVICES) - 1)
 
 // Example:
 /*
@@ -57,6 +59,9 @@ void parseCheats(char *filecontents);
 int getEnabledCheatsSize(void);
 int getEnabledCheatsCount(void);
 CheatEntries* getCheats();
+u32 cheatsSearchIndependent();
+char *readCheats(u32 search, int *found);
+int loadCheats(char *cheats_buffer, bool silent);
 int findCheats(bool silent);
 int applyAllCheats();
 #endif
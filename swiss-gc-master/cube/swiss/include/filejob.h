@@ -0,0 +1,61 @@
+#ifndef FILEJOB_H
+#define FILEJOB_H
+#include <gccore.h>
+#include "deviceHandler.h"
+
+enum {
+	FILE_JOB_COPY = 0,
+	FILE_JOB_MOVE,
+	FILE_JOB_DELETE
+};
+
+enum {
+	FILE_JOB_DONE = 0,
+	FILE_JOB_CANCELLED,
+	FILE_JOB_FAILED
+};
+
+enum {
+	FILE_OP_MKDIR = 0,
+	FILE_OP_COPY,
+	FILE_OP_DELETE,
+	FILE_OP_RMDIR
+};
+
+typedef struct {
+	u8 type;
+	u32 name;		// Offset of the path relative to the job root in names
+	u32 size;
+	u64 location;	// Where the source sits on the device, copies are made in this order
+} file_op;
+
+typedef struct {
+	DEVICEHANDLER_INTERFACE *src;
+	DEVICEHANDLER_INTERFACE *dest;
+	char srcRoot[PATHNAME_MAX];
+	char destRoot[PATHNAME_MAX];
+	file_op *ops;
+	u32 numOps;
+	char *names;
+	u32 namesLength;
+	u32 namesCapacity;
+	u32 next;			// Op to carry on from
+	u32 offset;			// How far into the current copy
+	u64 totalBytes;
+	u64 doneBytes;
+	u8 *buffer;
+	u32 bufferSize;
+	file_handle srcFile;
+	file_handle destFile;
+	file_handle *failed;	// Handle of the file that failed
+} file_job;
+
+// Called before every op and after every chunk copied, return false to cancel
+typedef bool (*file_job_progress)(void *ctx, file_job *job);
+
+bool file_job_init(file_job *job, int kind, DEVICEHANDLER_INTERFACE *src, file_handle *root, DEVICEHANDLER_INTERFACE *dest, const char *destPath);
+int file_job_run(file_job *job, file_job_progress progress, void *ctx);
+const char *file_job_current(file_job *job);
+void file_job_free(file_job *job);
+
+#endif
@@ -14,5 +14,6 @@ int getCurrentDirEntryCount();
 void concat_path(char *pathName, const char *dirName, const char *baseName);
 void concatf_path(char *pathName, const char *dirName, const char *baseName, ...);
 void ensure_path(int deviceSlot, char *path, char *oldPath);
+void ensure_device_path(DEVICEHANDLER_INTERFACE *device, char *path, char *oldPath);
 
 #endif 
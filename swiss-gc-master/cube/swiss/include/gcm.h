@@ -2,6 +2,7 @@
 #define __GCM_H
 
 #include "devices/deviceHandler.h"
+#include "aram/sidestep.h"
 
 /* 	The Retail Game DVD Disk Header 
 	Info source: YAGCD
@@ -98,11 +99,22 @@ typedef struct {
 	u32 tgcFakeOffset;
 } ExecutableFile;
 
-int parse_gcm(file_handle *file, file_handle *file2, ExecutableFile *filesToPatch);
+// The parts of a disc image that parsing it reads, read once and shared
+typedef struct {
+	file_handle *file;
+	DiskHeader *diskHeader;
+	ApploaderHeader apploaderHeader;
+	DOLHEADER dolHeader;
+	char *FST;
+} GCMCache;
+
+const char *gcm_cache_read(GCMCache *cache, file_handle *file, DiskHeader *diskHeader);
+void gcm_cache_free(GCMCache *cache);
+int parse_gcm(GCMCache *cache, GCMCache *cache2, ExecutableFile *filesToPatch);
 void adjust_tgc_fst(char* FST, u32 tgc_base, u32 fileAreaStart, u32 fakeAmount);
 int parse_tgc(file_handle *file, ExecutableFile *filesToPatch, u32 tgc_base, char* tgcname);
 int patch_gcm(ExecutableFile *filesToPatch, int numToPatch);
-void parse_gcm_add(file_handle *file, ExecutableFile *filesToPatch, int *numToPatch, char *fileName);
+void parse_gcm_add(GCMCache *cache, ExecutableFile *filesToPatch, int *numToPatch, char *fileName);
 int read_fst(file_handle *file, file_handle** dir, u64 *usedSpace);
 void get_gcm_banner(file_handle *file, u32 *file_offset, u32 *file_size);
 DiskHeader *get_gcm_header(file_handle *file);
@@ -0,0 +1,45 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+#include <gccore.h>
+#include "deviceHandler.h"
+#include "../../reservedarea.h"
+
+// Layouts shared with patches/base/prefetch.h
+
+typedef struct {
+	u32 offset;
+	u32 length;
+} prefetch_read;
+
+typedef struct {
+	u32 magic;
+	u32 checksum;		// Of everything from id up to the last read
+	u8 id[8];			// Game ID, disc number and version
+	u32 count;
+	u32 reserved[3];
+	prefetch_read reads[PREFETCH_TRACE_MAX];
+} prefetch_trace;
+
+typedef struct {
+	u32 offset;			// Where the extent is on the disc, sector aligned
+	u32 size;
+	u32 aram;			// Where it was put in ARAM
+	u32 sum;			// Index of the checksum for its first sector
+} prefetch_extent;
+
+typedef struct {
+	u32 magic;
+	u32 count;
+	u8 id[8];
+	u32 reserved[4];
+	prefetch_extent extents[PREFETCH_EXTENTS_MAX];
+} prefetch_table;
+
+// Stores the reads the last game made as it booted, if it left any behind
+void prefetch_collect(void);
+// Gives the patches a file on the patches device to store the reads in, however the game is left
+void prefetch_setup(file_frag **fragList, u32 *numFrags);
+// Arms the boot prefetch for the game about to be booted, ARAM from aramLow up is free
+void prefetch_warm(file_handle *file, u32 aramLow);
+
+#endif
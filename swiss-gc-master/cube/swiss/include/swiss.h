@@ -108,6 +108,7 @@ typedef struct {
 	int pauseAVOutput;
 	int emulateReadSpeed;
 	int emulateMemoryCard;
+	int bootPrefetch;
 	int preferCleanBoot;
 	s8 sramHOffset;
 	u8 sramLanguage;
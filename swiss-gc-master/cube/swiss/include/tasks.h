@@ -0,0 +1,35 @@
+#ifndef TASKS_H
+#define TASKS_H
+#include <gccore.h>
+
+#define TASKS_MAX		32
+#define TASK_LANES_MAX	2
+
+enum {
+	TASK_PENDING = 0,
+	TASK_DONE,
+	TASK_FAILED,
+	TASK_SKIPPED
+};
+
+enum {
+	TASKS_DONE = 0,
+	TASKS_CANCELLED,
+	TASKS_FAILED
+};
+
+typedef struct {
+	bool (*run)(void *ctx);	// Returns false if the task failed
+	u32 deps;				// Earlier tasks that have to be done first, one bit each
+	u8 lane;				// Tasks on a lane run one at a time, in the order given
+	u8 state;
+} task;
+
+// Called over and over on the calling thread while the tasks run, waiting a while each time. Return false to cancel
+typedef bool (*tasks_progress)(void *ctx);
+
+// Runs a lane on a thread of its own where it can. The lane stacks are static, so a run started while
+// another is going (from a task, say) runs every lane on the calling thread, as does a lane whose thread can't be made
+int tasks_run(task *tasks, int count, void *ctx, tasks_progress progress, void *progressCtx);
+
+#endif
@@ -21,7 +21,6 @@ void load_auto_dol();
 void print_gecko(const char* fmt, ...);
 bool update_recent();
 int load_existing_entry(char *entry);
-bool deleteFileOrDir(file_handle* entry);
 int formatBytes(char *string, off_t count, blksize_t blocksize, bool metric);
 
 #endif 
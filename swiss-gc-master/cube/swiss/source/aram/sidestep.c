@@ -22,13 +22,27 @@
 #include "patcher.h"
 
 #define ARAMSTART 0x8000
+#define ARAMEND 0x1000000
+#define STREAMCHUNK 0x20000
+
+/*** A loadable section, by file offset and ARAM address ***/
+typedef struct {
+  u32 offset;
+  u32 address;
+  u32 length;
+} SECTION;
 
 /*** A global or two ***/
-static DOLHEADER *dolhdr;
 static u32 minaddress = 0;
 static u32 maxaddress = 0;
+static u32 stagedentry = 0;
 static u32 _entrypoint, _dst, _src, _len;
 
+static unsigned char *streambuf[2];
+static int streamcur;
+static u8 aramline[32] ATTRIBUTE_ALIGN(32);
+static u8 aramzero[32];
+
 typedef int (*BOOTSTUB) (u32 entrypoint, u32 dst, u32 src, int len, u32 invlen, u32 invaddress);
 
 /*--- Auxilliary RAM Support ----------------------------------------------*/
@@ -196,23 +210,172 @@ void ARAMRun(u32 entrypoint, u32 dst, u32 src, u32 len)
 /****************************************************************************
 * ARAMClear
 *
-* To make life easy, just clear out the Auxilliary RAM completely.
+* Zero a range of Auxilliary RAM, rounded out to whole 32 byte lines.
+* Uses the stream buffer, so only call this before the sections go in.
 ****************************************************************************/
-static void ARAMClear(void)
+static void ARAMClear(u32 start, u32 len)
 {
-  int i;
-  unsigned char *buffer = memalign(32, 2048); /*** A little 2k buffer ***/
+  u32 end = (start + len + 31) & ~0x1f;
+  u32 size;
+
+  start &= ~0x1f;
+  if (start >= end)
+    return;
+
+  memset(streambuf[0], 0, STREAMCHUNK);
+  DCFlushRange(streambuf[0], STREAMCHUNK);
+
+  while (start < end)
+  {
+    size = end - start > STREAMCHUNK ? STREAMCHUNK : end - start;
+    AR_StartDMA(ARAM_WRITE, (u32) streambuf[0], start, size);
+    while (AR_GetDMAStatus());
+    start += size;
+  }
+}
+
+/****************************************************************************
+* ARAMPatch
+*
+* Write a few bytes which sit inside a single 32 byte line of ARAM.
+****************************************************************************/
+static void ARAMPatch(unsigned char *src, u32 dst, u32 len)
+{
+  ARAMFetch(aramline, (char *) (dst & ~0x1f), 32);
+  memcpy(aramline + (dst & 0x1f), src, len);
+  DCFlushRange(aramline, 32);
+  AR_StartDMA(ARAM_WRITE, (u32) aramline, dst & ~0x1f, 32);
+  while (AR_GetDMAStatus());
+}
+
+/****************************************************************************
+* ARAMStream
+*
+* Read a section through the reader and DMA it to ARAM as it arrives.
+* The two stream buffers alternate, so the next chunk is being read while
+* the last one is still on its way to ARAM.
+****************************************************************************/
+static int ARAMStream(ARAMREADER read, void *ctx, u32 offset, u32 dst, u32 len)
+{
+  unsigned char *buffer;
+  u32 size;
+
+  /*** Misaligned head ***/
+  if (dst & 0x1f)
+  {
+    size = 32 - (dst & 0x1f);
+    if (size > len)
+      size = len;
+
+    buffer = streambuf[streamcur];
+    if (read(ctx, buffer, offset, size) != size)
+      return 0;
 
-  memset(buffer, 0, 2048);
-  DCFlushRange(buffer, 2048);
+    while (AR_GetDMAStatus());
+    ARAMPatch(buffer, dst, size);
+    offset += size;
+    dst += size;
+    len -= size;
+  }
 
-  for (i = ARAMSTART; i < 0x1000000; i += 2048)
+  while (len >= 32)
   {
-    ARAMPut(buffer, (char *) i, 2048);
+    size = len > STREAMCHUNK ? STREAMCHUNK : len & ~0x1f;
+
+    buffer = streambuf[streamcur];
+    if (read(ctx, buffer, offset, size) != size)
+      return 0;
+
+    DCFlushRange(buffer, size);
     while (AR_GetDMAStatus());
+    AR_StartDMA(ARAM_WRITE, (u32) buffer, dst, size);
+    streamcur ^= 1;
+    offset += size;
+    dst += size;
+    len -= size;
   }
 
-  free(buffer);
+  /*** Misaligned tail ***/
+  if (len)
+  {
+    buffer = streambuf[streamcur];
+    if (read(ctx, buffer, offset, len) != len)
+      return 0;
+
+    while (AR_GetDMAStatus());
+    ARAMPatch(buffer, dst, len);
+  }
+
+  return 1;
+}
+
+static int SectionByAddress(const void *a, const void *b)
+{
+  const SECTION *x = a, *y = b;
+  return x->address < y->address ? -1 : x->address > y->address;
+}
+
+static int SectionByOffset(const void *a, const void *b)
+{
+  const SECTION *x = a, *y = b;
+  return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+/****************************************************************************
+* ARAMStage
+*
+* Clear whatever the sections leave uncovered between minaddress and
+* maxaddress, then stream the sections in file order.
+****************************************************************************/
+static int ARAMStage(ARAMREADER read, void *ctx, SECTION *sect, int count)
+{
+  u32 position = ARAMSTART;
+  u32 end = maxaddress - minaddress + ARAMSTART;
+  int i;
+
+  qsort(sect, count, sizeof(SECTION), SectionByAddress);
+  for (i = 0; i < count; i++)
+  {
+    if (sect[i].address > position)
+      ARAMClear(position, sect[i].address - position);
+    if (sect[i].address + sect[i].length > position)
+      position = sect[i].address + sect[i].length;
+  }
+  ARAMClear(position, end > position ? end - position : 0);
+
+  qsort(sect, count, sizeof(SECTION), SectionByOffset);
+  streamcur = 0;
+  for (i = 0; i < count; i++)
+  {
+    if (!ARAMStream(read, ctx, sect[i].offset, sect[i].address, sect[i].length))
+    {
+      while (AR_GetDMAStatus());
+      return 0;
+    }
+  }
+  while (AR_GetDMAStatus());
+
+  return 1;
+}
+
+static int ARAMStreamAlloc(void)
+{
+  streambuf[0] = memalign(32, STREAMCHUNK);
+  streambuf[1] = memalign(32, STREAMCHUNK);
+  return streambuf[0] && streambuf[1];
+}
+
+static void ARAMStreamFree(void)
+{
+  free(streambuf[0]);
+  free(streambuf[1]);
+  streambuf[0] = streambuf[1] = NULL;
+}
+
+static s32 ARAMReadMemory(void *ctx, void *dst, u32 offset, u32 len)
+{
+  memcpy(dst, (unsigned char *) ctx + offset, len);
+  return len;
 }
 
 /*--- DOL Decoding functions -----------------------------------------------*/
@@ -297,89 +460,132 @@ u32 DOLSize(DOLHEADER *dol)
 }
 
 /****************************************************************************
-* DOLtoARAM
-*
-* Moves the DOL from main memory to ARAM, positioning as it goes
+* ARAMArgs
 *
-* Pass in a memory pointer to a previously loaded DOL
+* Pass a command line, just past the entrypoint
 ****************************************************************************/
-int DOLtoARAM(unsigned char *dol, int argc, char *argv[])
+static void ARAMArgs(u32 entrypoint, int argc, char *argv[])
 {
-  u32 sizeinbytes;
+  struct __argv args;
   int i;
-  struct __argv dolargs;
+
+  args.argvMagic = ARGV_MAGIC;
+  args.argc = argc;
+  args.length = 1;
+
+  for (i = 0; i < argc; i++)
+  {
+    size_t argLength = strlen(argv[i]) + 1;
+    args.length += argLength;
+  }
+  args.commandLine = malloc(args.length);
+
+  unsigned int position = 0;
+  for (i = 0; i < argc; i++)
+  {
+    size_t argLength = strlen(argv[i]) + 1;
+    memcpy(args.commandLine + position, argv[i], argLength);
+    position += argLength;
+  }
+  args.commandLine[args.length - 1] = '\0';
+  DCStoreRange(args.commandLine, args.length);
+
+  ARAMPut((unsigned char *) &args, (char *) (entrypoint - minaddress + 8 + ARAMSTART), sizeof(struct __argv));
+}
+
+/****************************************************************************
+* DOLStreamToARAM
+*
+* Stages a DOL in ARAM without needing the whole file in main memory.
+* Only the header is held, sections are pulled through the reader.
+****************************************************************************/
+int DOLStreamToARAM(ARAMREADER read, void *ctx)
+{
+  DOLHEADER *dolhdr;
+  SECTION sect[MAXTEXTSECTION + MAXDATASECTION];
+  int i, count = 0, ret = 0;
 
   /*** Make sure ARAM subsystem is alive! ***/
   AR_Init(NULL, 0); /*** No stack - we need it all ***/
-  ARAMClear();
+  if (!ARAMStreamAlloc())
+    goto out;
 
   /*** Get DOL header ***/
-  dolhdr = (DOLHEADER *) dol;
+  dolhdr = (DOLHEADER *) streambuf[1];
+  if (read(ctx, dolhdr, 0, DOLHDRLENGTH) != DOLHDRLENGTH)
+    goto out;
 
   /*** First, does this look like a DOL? ***/
   if (dolhdr->textOffset[0] != DOLHDRLENGTH && dolhdr->textOffset[0] != 0x0620)	// DOLX style 
-    return 0;
+    goto out;
 
   /*** Get DOL stats ***/
   DOLMinMax(dolhdr);
-  sizeinbytes = maxaddress - minaddress;
+  if (maxaddress - minaddress > ARAMEND - ARAMSTART)
+    goto out;
 
-  /*** Move all DOL sections into ARAM ***/
-  /*** Move text sections ***/
+  /*** This may seem strange, but in developing d0lLZ we found some with section addresses with zero length ***/
   for (i = 0; i < MAXTEXTSECTION; i++)
   {
-    /*** This may seem strange, but in developing d0lLZ we found some with section addresses with zero length ***/
     if (dolhdr->textAddress[i] && dolhdr->textLength[i])
     {
-      ARAMPut(dol + dolhdr->textOffset[i], (char *) ((dolhdr->textAddress[i] - minaddress) + ARAMSTART),
-              dolhdr->textLength[i]);
+      sect[count].offset = dolhdr->textOffset[i];
+      sect[count].address = dolhdr->textAddress[i] - minaddress + ARAMSTART;
+      sect[count].length = dolhdr->textLength[i];
+      count++;
     }
   }
 
-  /*** Move data sections ***/
   for (i = 0; i < MAXDATASECTION; i++)
   {
     if (dolhdr->dataAddress[i] && dolhdr->dataLength[i])
     {
-      ARAMPut(dol + dolhdr->dataOffset[i], (char *) ((dolhdr->dataAddress[i] - minaddress) + ARAMSTART),
-              dolhdr->dataLength[i]);
+      sect[count].offset = dolhdr->dataOffset[i];
+      sect[count].address = dolhdr->dataAddress[i] - minaddress + ARAMSTART;
+      sect[count].length = dolhdr->dataLength[i];
+      count++;
     }
   }
 
-  /*** Pass a command line ***/
-  if (argc)
-  {
-    dolargs.argvMagic = ARGV_MAGIC;
-    dolargs.argc = argc;
-    dolargs.length = 1;
+  stagedentry = dolhdr->entryPoint;
+  ret = ARAMStage(read, ctx, sect, count);
 
-    for (i = 0; i < argc; i++)
-    {
-      size_t argLength = strlen(argv[i]) + 1;
-      dolargs.length += argLength;
-    }
-    dolargs.commandLine = malloc(dolargs.length);
-
-    unsigned int position = 0;
-    for (i = 0; i < argc; i++)
-    {
-      size_t argLength = strlen(argv[i]) + 1;
-      memcpy(dolargs.commandLine + position, argv[i], argLength);
-      position += argLength;
-    }
-    dolargs.commandLine[dolargs.length - 1] = '\0';
-    DCStoreRange(dolargs.commandLine, dolargs.length);
-
-    ARAMPut((unsigned char *) &dolargs, (char *) (dolhdr->entryPoint - minaddress + 8 + ARAMSTART), sizeof(struct __argv));
-  }
+out:
+  ARAMStreamFree();
+  return ret;
+}
 
-  /*** Now go run it ***/
-  ARAMRun(dolhdr->entryPoint, minaddress, ARAMSTART, sizeinbytes);
+/****************************************************************************
+* DOLtoARAM
+*
+* Moves the DOL from main memory to ARAM, positioning as it goes
+*
+* Pass in a memory pointer to a previously loaded DOL
+****************************************************************************/
+int DOLtoARAM(unsigned char *dol, int argc, char *argv[])
+{
+  if (!DOLStreamToARAM(ARAMReadMemory, dol))
+    return 0;
 
   /*** Will never return ***/
+  ARAMBootStaged(argc, argv);
   return 1;
 }
 
+/****************************************************************************
+* ARAMStagedEnd
+*
+* End of the ARAM taken by what was last staged, or by what DOLtoARAM would
+* stage for the DOL given
+****************************************************************************/
+u32 ARAMStagedEnd(DOLHEADER *dol)
+{
+  if (dol)
+    DOLMinMax(dol);
+
+  return maxaddress - minaddress + ARAMSTART;
+}
+
 static void ELFMinMax(Elf32_Ehdr *ehdr, Elf32_Phdr *phdr)
 {
   int i;
@@ -400,81 +606,99 @@ static void ELFMinMax(Elf32_Ehdr *ehdr, Elf32_Phdr *phdr)
   }
 }
 
-int ELFtoARAM(unsigned char *elf, int argc, char *argv[])
+/****************************************************************************
+* ELFStreamToARAM
+*
+* As DOLStreamToARAM, for the PT_LOAD segments of an ELF
+****************************************************************************/
+int ELFStreamToARAM(ARAMREADER read, void *ctx)
 {
-  Elf32_Ehdr *ehdr;
-  Elf32_Phdr *phdr;
-  u32 sizeinbytes;
-  int i;
-  struct __argv args;
+  Elf32_Ehdr ehdr;
+  Elf32_Phdr *phdr = NULL;
+  SECTION *sect = NULL;
+  u32 phsize;
+  int i, count = 0, ret = 0;
 
   /*** Make sure ARAM subsystem is alive! ***/
   AR_Init(NULL, 0); /*** No stack - we need it all ***/
-  ARAMClear();
+  if (!ARAMStreamAlloc())
+    goto out;
 
   /*** First, does this look like an ELF? ***/
-  if (!valid_elf_image(elf))
-    return 0;
+  if (read(ctx, streambuf[1], 0, sizeof(Elf32_Ehdr)) != sizeof(Elf32_Ehdr))
+    goto out;
+  if (!valid_elf_image(streambuf[1]))
+    goto out;
 
   /*** Get ELF headers ***/
-  ehdr = (Elf32_Ehdr *) elf;
-  phdr = (Elf32_Phdr *) (elf + ehdr->e_phoff);
+  memcpy(&ehdr, streambuf[1], sizeof(Elf32_Ehdr));
+  phsize = ehdr.e_phnum * sizeof(Elf32_Phdr);
+  phdr = malloc(phsize);
+  sect = malloc(ehdr.e_phnum * sizeof(SECTION));
+  if (!phdr || !sect)
+    goto out;
+  if (read(ctx, phdr, ehdr.e_phoff, phsize) != phsize)
+    goto out;
 
   /*** Get ELF stats ***/
-  ELFMinMax(ehdr, phdr);
-  sizeinbytes = maxaddress - minaddress;
+  ELFMinMax(&ehdr, phdr);
+  if (maxaddress - minaddress > ARAMEND - ARAMSTART)
+    goto out;
 
-  /*** Move all ELF segments into ARAM ***/
-  for (i = 0; i < ehdr->e_phnum; i++)
+  for (i = 0; i < ehdr.e_phnum; i++)
   {
-    if (phdr[i].p_type == PT_LOAD)
+    if (phdr[i].p_type == PT_LOAD && phdr[i].p_filesz)
     {
-      ARAMPut(elf + phdr[i].p_offset, (char *) ((phdr[i].p_vaddr - minaddress) + ARAMSTART), phdr[i].p_filesz);
+      sect[count].offset = phdr[i].p_offset;
+      sect[count].address = phdr[i].p_vaddr - minaddress + ARAMSTART;
+      sect[count].length = phdr[i].p_filesz;
+      count++;
     }
   }
 
-  /*** Pass a command line ***/
-  if (argc)
-  {
-    args.argvMagic = ARGV_MAGIC;
-    args.argc = argc;
-    args.length = 1;
-
-    for (i = 0; i < argc; i++)
-    {
-      size_t argLength = strlen(argv[i]) + 1;
-      args.length += argLength;
-    }
-    args.commandLine = malloc(args.length);
+  stagedentry = ehdr.e_entry;
+  ret = ARAMStage(read, ctx, sect, count);
 
-    unsigned int position = 0;
-    for (i = 0; i < argc; i++)
-    {
-      size_t argLength = strlen(argv[i]) + 1;
-      memcpy(args.commandLine + position, argv[i], argLength);
-      position += argLength;
-    }
-    args.commandLine[args.length - 1] = '\0';
-    DCStoreRange(args.commandLine, args.length);
-
-    ARAMPut((unsigned char *) &args, (char *) (ehdr->e_entry - minaddress + 8 + ARAMSTART), sizeof(struct __argv));
-  }
+out:
+  free(sect);
+  free(phdr);
+  ARAMStreamFree();
+  return ret;
+}
 
-  /*** Now go run it ***/
-  ARAMRun(ehdr->e_entry, minaddress, ARAMSTART, sizeinbytes);
+int ELFtoARAM(unsigned char *elf, int argc, char *argv[])
+{
+  if (!ELFStreamToARAM(ARAMReadMemory, elf))
+    return 0;
 
   /*** Will never return ***/
+  ARAMBootStaged(argc, argv);
   return 1;
 }
 
+/****************************************************************************
+* ARAMBootStaged
+*
+* Runs whatever DOLStreamToARAM or ELFStreamToARAM last staged
+****************************************************************************/
+void ARAMBootStaged(int argc, char *argv[])
+{
+  if (argc)
+    ARAMArgs(stagedentry, argc, argv);
+
+  /*** Now go run it ***/
+  ARAMRun(stagedentry, minaddress, ARAMSTART, maxaddress - minaddress);
+}
+
 int BINtoARAM(unsigned char *bin, int len, unsigned int entrypoint)
 {
   /*** Make sure ARAM subsystem is alive! ***/
   AR_Init(NULL, 0); /*** No stack - we need it all ***/
-  ARAMClear();
 
-  /*** Move BIN into ARAM ***/
+  /*** Move BIN into ARAM, only the padding to 32 bytes needs clearing ***/
   ARAMPut(bin, (char *) ARAMSTART, len);
+  if (len & 0x1f)
+    ARAMPatch(aramzero, ARAMSTART + len, 32 - (len & 0x1f));
 
   /*** Now go run it ***/
   ARAMRun(entrypoint, entrypoint, ARAMSTART, len);
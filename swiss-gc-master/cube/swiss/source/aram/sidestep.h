@@ -33,8 +33,15 @@ typedef struct {
     unsigned int unused[MAXTEXTSECTION];
 } DOLHEADER;
 
+/*** Reads len bytes at offset into dst, returns the number read ***/
+typedef s32 (*ARAMREADER)(void *ctx, void *dst, u32 offset, u32 len);
+
 u32 DOLSize(DOLHEADER *dol);
+int DOLStreamToARAM(ARAMREADER read, void *ctx);
+int ELFStreamToARAM(ARAMREADER read, void *ctx);
+void ARAMBootStaged(int argc, char *argv[]);
 int DOLtoARAM(unsigned char *dol, int argc, char *argv[]);
+u32 ARAMStagedEnd(DOLHEADER *dol);
 int ELFtoARAM(unsigned char *elf, int argc, char *argv[]);
 int BINtoARAM(unsigned char *bin, int len, unsigned int entrypoint);
 
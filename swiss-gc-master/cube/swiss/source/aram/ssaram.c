@@ -11,8 +11,6 @@
 static u8 aramfix[2048] ATTRIBUTE_ALIGN(32);
 
 #define ARAMSTART  0x8000
-#define ARAM_READ  1
-#define ARAM_WRITE 0
 
 /****************************************************************************
 * ARAMPut
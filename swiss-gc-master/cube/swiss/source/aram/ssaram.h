@@ -5,6 +5,9 @@
 #ifndef __SSARAM__
 #define __SSARAM__
 
+#define ARAM_READ  1
+#define ARAM_WRITE 0
+
 void ARAMPut(unsigned char *src, char *dst, int len);
 void ARAMFetch(unsigned char *dst, char *src, int len);
 
@@ -24,6 +24,7 @@
 #include "FrameBufferMagic.h"
 
 static CheatEntries _cheats;
+static u32 (*_codes)[2];
 
 void printCheats(void) {
 	int i = 0, j = 0;
@@ -61,28 +62,26 @@ int getEnabledCheatsCount(void) {
 	return enabled;
 }
 
-static char *validCodeValues = "0123456789AaBbCcDdEeFf";
+static const char hexValues[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
 // Checks that the line contains a valid code in the format of "01234567 89ABCDEF"
 int isValidCode(char *code) {
-	int i, j;
+	int i;
 	
-	if(strlen(code) < 17) return 0; // Not in format
 	for(i = 0; i < 16; i++) {
-		if(i == 8 && code[i] != ' ') 
-			return 0; // No space separating the two values
-		if(i == 8)
-			continue;
-		int found = 0;
-		for(j = 0; j < strlen(validCodeValues); j++) {
-			if(code[i] == validCodeValues[j]) {
-				found = 1;
-				break;
-			}
+		if(i == 8) {
+			if(code[i] != ' ')
+				return 0; // No space separating the two values
 		}
-		if(!found) return 0; 	// Wasn't a valid hexadecimal value
+		else if(!hexValues[(u8)code[i]])
+			return 0;	// Wasn't a valid hexadecimal value
 	}
 
-	return 1;
+	return code[16] != '\0';
 }
 
 int containsXX(char *line) {
@@ -93,90 +92,101 @@ int containsXX(char *line) {
 			;
 }
 
+// Same result as strtoul(str, NULL, 16) for the digits isValidCode has checked
+static u32 parseHex(const char *str) {
+	u32 value = 0;
+	while(*str == ' ') str++;
+	for(; hexValues[(u8)*str]; str++) {
+		if(value >> 28)
+			return 0xFFFFFFFF;
+		value = (value << 4) | (hexValues[(u8)*str] - 1);
+	}
+	return value;
+}
+
+// Returns the next non-empty line, terminated in place, like strtok_r with "\n"
+static char *nextLine(char **ctx) {
+	char *line = *ctx;
+	while(*line == '\n') line++;
+	if(!*line) {
+		*ctx = line;
+		return NULL;
+	}
+	char *end = strchr(line, '\n');
+	if(end) {
+		*end = 0;
+		*ctx = end + 1;
+	}
+	else {
+		*ctx = line + strlen(line);
+	}
+	return line;
+}
+
 /** 
 	Given a char array with the contents of a .txt, 
-	this method will allocate and return a populated Parameters struct 
+	this method will populate the cheats list in a single pass.
+	All codes live in one allocation, no code line is shorter than 17 characters.
 */
 void parseCheats(char *filecontents) {
-	char *line = NULL, *prevLine = NULL, *linectx = NULL;
-	int numCheats = 0;
-	line = strtok_r( filecontents, "\n", &linectx );
+	char *line = NULL, *prevLine = NULL, *linectx = filecontents;
+	int numCheats = 0, numCodes = 0;
 
 	// Free previous
-	if(_cheats.num_cheats > 0) {
-		int i;
-		for(i = 0; i < _cheats.num_cheats; i++) {
-			if(_cheats.cheat[i].codes) {
-				free(_cheats.cheat[i].codes);
-			}
-		}
-	}
+	free(_codes);
 	memset(&_cheats, 0, sizeof(CheatEntries));
+	_codes = malloc(sizeof *_codes * (strlen(filecontents) / 17 + 1));
+	if(!_codes) {
+		return;
+	}
 	
-	CheatEntry *curCheat = NULL;	// The current one we're parsing
+	line = nextLine(&linectx);
 	while( line != NULL && numCheats < CHEATS_MAX_FOR_GAME) {
-		//print_gecko("Line [%s]\r\n", line);
-		
 		if(isValidCode(line)) {		// The line looks like a valid code
+			CheatEntry *curCheat = &_cheats.cheat[numCheats];
 			if(prevLine != NULL) {
-				curCheat = &_cheats.cheat[numCheats];
-				strncpy(curCheat->name, prevLine, strlen(prevLine) > CHEATS_NAME_LEN ? CHEATS_NAME_LEN-1:strlen(prevLine));
-				if(curCheat->name[strlen(curCheat->name)-1] == '\r')
-					curCheat->name[strlen(curCheat->name)-1] = 0;
-				//print_gecko("Cheat Name: [%s]\r\n", prevLine);
+				int len = strlen(prevLine);
+				if(len > CHEATS_NAME_LEN-1) len = CHEATS_NAME_LEN-1;
+				if(len && prevLine[len-1] == '\r') len--;
+				memcpy(curCheat->name, prevLine, len);
 			}
 			int unsupported = 0;
-			u32 *codesBuf = (u32*)calloc(1, sizeof(u32) * 2 * SINGLE_CHEAT_MAX_LINES);
-			
-			// Add this valid code as the first code for this cheat
-			codesBuf[(curCheat->num_codes << 1)+0] = (u32)strtoul(line, NULL, 16);
-			codesBuf[(curCheat->num_codes << 1)+1] = (u32)strtoul(line+8, NULL, 16);
-			curCheat->num_codes++;
+			curCheat->codes = &_codes[numCodes];
 			
-			line = strtok_r( NULL, "\n", &linectx);
-			// Keep going until we're out of codes for this cheat
-			while( line != NULL) {
-				if(curCheat->num_codes == SINGLE_CHEAT_MAX_LINES) {
-					unsupported = 1;
+			// Add this valid code as the first code for this cheat, keep going until we're out of codes for this cheat
+			do {
+				curCheat->codes[curCheat->num_codes][0] = parseHex(line);
+				curCheat->codes[curCheat->num_codes][1] = parseHex(line+8);
+				curCheat->num_codes++;
+				
+				line = nextLine(&linectx);
+				if(line == NULL) {
 					break;
 				}
 				// If a code contains "XX" in it, it is unsupported, discard it entirely
-				if(containsXX(line)) {
+				if(curCheat->num_codes == SINGLE_CHEAT_MAX_LINES || containsXX(line)) {
 					unsupported = 1;
 					break;
 				}
-				if(isValidCode(line)) {
-					// Add this valid code
-					codesBuf[(curCheat->num_codes << 1)+0] = (u32)strtoul(line, NULL, 16);
-					codesBuf[(curCheat->num_codes << 1)+1] = (u32)strtoul(line+8, NULL, 16);
-					curCheat->num_codes++;
-				}
-				else {
-					break;
-				}
-				line = strtok_r( NULL, "\n", &linectx);
-			}
+			} while(isValidCode(line));
 			
 			if(unsupported) {
 				memset(curCheat, 0, sizeof(CheatEntry));
 				while(line != NULL && strlen(line) >=2) {
-					line = strtok_r( NULL, "\n", &linectx);	// finish this unsupported cheat.
+					line = nextLine(&linectx);	// finish this unsupported cheat.
 				}
 			}
 			else {
 				numCheats++;
-				// Alloc and store it.
-				print_gecko("Allocating %i bytes for %i codes\r\n", sizeof *curCheat->codes * curCheat->num_codes, curCheat->num_codes);
-				curCheat->codes = calloc(1, sizeof *curCheat->codes * curCheat->num_codes );
-				memcpy(curCheat->codes, codesBuf, sizeof *curCheat->codes * curCheat->num_codes);
+				numCodes += curCheat->num_codes;
 			}
-			free(codesBuf);
 		}
 		prevLine = line;
 		// And round we go again
-		line = strtok_r( NULL, "\n", &linectx);
+		line = nextLine(&linectx);
 	}
 	_cheats.num_cheats = numCheats;
+	print_gecko("Parsed %i cheats with %i codes\r\n", numCheats, numCodes);
 	//printCheats();
 }
 
@@ -227,69 +237,83 @@ int kenobi_get_maxsize() {
 	return CHEATS_MAX_SIZE((swissSettings.wiirdDebug ? kenobigc_dbg_bin_size : kenobigc_bin_size));
 }
 
-int findCheats(bool silent) {
-	char trimmedGameId[8], testBuffer[8];
-	memset(trimmedGameId, 0, 8);
-	memcpy(trimmedGameId, (char*)&GCMDisk, 6);
-	file_handle *cheatsFile = calloc(1, sizeof(file_handle));
-	concatf_path(cheatsFile->name, devices[DEVICE_CUR]->initial->name, "swiss/cheats/%.6s.txt", trimmedGameId);
+static bool openCheats(DEVICEHANDLER_INTERFACE *device, file_handle *cheatsFile, const char *gameId) {
+	char testBuffer[8];
+	memset(cheatsFile, 0, sizeof(file_handle));
+	concatf_path(cheatsFile->name, device->initial->name, "swiss/cheats/%.6s.txt", gameId);
 	print_gecko("Looking for cheats file @ [%s]\r\n", cheatsFile->name);
+	return device->readFile(cheatsFile, &testBuffer, 8) == 8;
+}
 
-	devices[DEVICE_TEMP] = devices[DEVICE_CUR];
+// The current device is 0, then SD in all slots
+static DEVICEHANDLER_INTERFACE *cheatsSearchDevice(int i) {
+	DEVICEHANDLER_INTERFACE *searchDevices[CHEATS_SEARCH_DEVICES] = {devices[DEVICE_CUR], &__device_sd_a, &__device_sd_b, &__device_sd_c};
+	return searchDevices[i];
+}
 
-	// Check SD in all slots if we're not already running from SD, or if we fail from current device
-	ensure_path(DEVICE_TEMP, "swiss", NULL);
-	ensure_path(DEVICE_TEMP, "swiss/cheats", "cheats");	// TODO kill this off in our next major release.
-	if(devices[DEVICE_TEMP]->readFile(cheatsFile, &testBuffer, 8) != 8) {
-		// Try SD slots now
-		if(devices[DEVICE_CUR] != &__device_sd_a) {
-			devices[DEVICE_TEMP] = &__device_sd_a;
-		}
-		else {
-			devices[DEVICE_TEMP] = &__device_sd_b;
+// The devices cheats are searched on that don't share an EXI channel with the current device,
+// so can be read from while it is busy, one bit each
+u32 cheatsSearchIndependent() {
+	s32 channel = getExiChannelByLocation(devices[DEVICE_CUR]->location);
+	u32 search = 0;
+	for(int i = 1; i < CHEATS_SEARCH_DEVICES; i++) {
+		if(channel < 0 || getExiChannelByLocation(cheatsSearchDevice(i)->location) != channel) {
+			search |= 1 << i;
 		}
-		memset(cheatsFile, 0, sizeof(file_handle));
-		concatf_path(cheatsFile->name, devices[DEVICE_TEMP]->initial->name, "swiss/cheats/%.6s.txt", trimmedGameId);
-		print_gecko("Looking for cheats file @ [%s]\r\n", cheatsFile->name);
-
-		deviceHandler_setStatEnabled(0);
-		devices[DEVICE_TEMP]->init(cheatsFile);
-		ensure_path(DEVICE_TEMP, "swiss", NULL);
-		ensure_path(DEVICE_TEMP, "swiss/cheats", "cheats");	// TODO kill this off in our next major release.
-		if(devices[DEVICE_TEMP]->readFile(cheatsFile, &testBuffer, 8) != 8) {
-			if(devices[DEVICE_TEMP] == &__device_sd_b) {
-				devices[DEVICE_TEMP] = &__device_sd_c;	// We already tried A & failed, so last thing to try is SP2 slot.
-			}
-			else if (devices[DEVICE_CUR] != &__device_sd_b) {
-				devices[DEVICE_TEMP] = &__device_sd_b;
-				memset(cheatsFile, 0, sizeof(file_handle));
-				concatf_path(cheatsFile->name, devices[DEVICE_TEMP]->initial->name, "swiss/cheats/%.6s.txt", trimmedGameId);
-				print_gecko("Looking for cheats file @[%s]\r\n", cheatsFile->name);
+	}
+	return search;
+}
 
-				devices[DEVICE_TEMP]->init(cheatsFile);
-				ensure_path(DEVICE_TEMP, "swiss", NULL);
-				ensure_path(DEVICE_TEMP, "swiss/cheats", "cheats");	// TODO kill this off in our next major release.
-				if(devices[DEVICE_TEMP]->readFile(cheatsFile, &testBuffer, 8) != 8) {
-					devices[DEVICE_TEMP] = &__device_sd_c; // Last thing to try is SP2 slot.
-				}
-			}
-			if (devices[DEVICE_TEMP] == &__device_sd_c && devices[DEVICE_CUR] != &__device_sd_c) {
-				memset(cheatsFile, 0, sizeof(file_handle));
-				concatf_path(cheatsFile->name, devices[DEVICE_TEMP]->initial->name, "swiss/cheats/%.6s.txt", trimmedGameId);
-				print_gecko("Looking for cheats file @[%s]\r\n", cheatsFile->name);
+// Looks for this game's cheats file on the devices cheats are searched on that are in search, one bit each.
+// SD in a slot we're already running from is passed over. Returns the first found, or NULL, and which one that was
+// in found (CHEATS_SEARCH_DEVICES if none). Only the device handlers are touched, so it can be run off the main thread
+char *readCheats(u32 search, int *found) {
+	char trimmedGameId[8];
+	memset(trimmedGameId, 0, 8);
+	memcpy(trimmedGameId, (char*)&GCMDisk, 6);
+	file_handle *cheatsFile = calloc(1, sizeof(file_handle));
+	char *cheats_buffer = NULL;
 
-				devices[DEVICE_TEMP]->init(cheatsFile);
-				ensure_path(DEVICE_TEMP, "swiss", NULL);
-				ensure_path(DEVICE_TEMP, "swiss/cheats", "cheats");	// TODO kill this off in our next major release.
-				if(devices[DEVICE_TEMP]->readFile(cheatsFile, &testBuffer, 8) != 8) {
-					devices[DEVICE_TEMP] = NULL; // All three have failed.
-				}
-			}
+	DEVICEHANDLER_INTERFACE *device = NULL;
+	int i;
+	for(i = 0; i < CHEATS_SEARCH_DEVICES; i++) {
+		device = cheatsSearchDevice(i);
+		if(!(search & (1 << i)) || (i > 0 && device == devices[DEVICE_CUR])) {
+			continue;
+		}
+		if(i > 0) {
+			memset(cheatsFile, 0, sizeof(file_handle));
+			concatf_path(cheatsFile->name, device->initial->name, "swiss/cheats/%.6s.txt", trimmedGameId);
+			device->init(cheatsFile);
+		}
+		if(openCheats(device, cheatsFile, trimmedGameId)) {
+			break;
+		}
+		// Only move a legacy cheats folder into place when the file isn't where it should be
+		ensure_device_path(device, "swiss", NULL);
+		ensure_device_path(device, "swiss/cheats", "cheats");	// TODO kill this off in our next major release.
+		if(openCheats(device, cheatsFile, trimmedGameId)) {
+			break;
+		}
+	}
+	if(found) {
+		*found = i;
+	}
+	if(i < CHEATS_SEARCH_DEVICES && cheatsFile->size != 0) {
+		print_gecko("Cheats file found with size %i\r\n", cheatsFile->size);
+		cheats_buffer = calloc(1, cheatsFile->size + 1);
+		if(cheats_buffer) {
+			device->seekFile(cheatsFile, 0, DEVICE_HANDLER_SEEK_SET);
+			device->readFile(cheatsFile, cheats_buffer, cheatsFile->size);
 		}
-		deviceHandler_setStatEnabled(1);
 	}
-	// Still fail?
-	if(devices[DEVICE_TEMP] == NULL || cheatsFile->size == 0) {
+	free(cheatsFile);
+	return cheats_buffer;
+}
+
+// Parses and frees what readCheats found
+int loadCheats(char *cheats_buffer, bool silent) {
+	if(!cheats_buffer) {
 		if(!silent) {
 			while(PAD_ButtonsHeld(0) & PAD_BUTTON_Y);
 			uiDrawObj_t *msgBox = DrawMessageBox(D_INFO,"No cheats file found.\nPress A to continue.");
@@ -298,18 +322,10 @@ int findCheats(bool silent) {
 			while(PAD_ButtonsHeld(0) & PAD_BUTTON_A);
 			DrawDispose(msgBox);
 		}
-		free(cheatsFile);
 		return 0;
 	}
-	print_gecko("Cheats file found with size %i\r\n", cheatsFile->size);
-	char *cheats_buffer = calloc(1, cheatsFile->size + 1);
-	if(cheats_buffer) {
-		devices[DEVICE_TEMP]->seekFile(cheatsFile, 0, DEVICE_HANDLER_SEEK_SET);
-		devices[DEVICE_TEMP]->readFile(cheatsFile, cheats_buffer, cheatsFile->size);
-		parseCheats(cheats_buffer);
-		free(cheats_buffer);
-		free(cheatsFile);
-	}
+	parseCheats(cheats_buffer);
+	free(cheats_buffer);
 	if(!silent && _cheats.num_cheats == 0) {
 		while(PAD_ButtonsHeld(0) & PAD_BUTTON_Y);
 		uiDrawObj_t *msgBox = DrawMessageBox(D_INFO,"Empty or unreadable cheats file found.\nPress A to continue.");
@@ -321,14 +337,23 @@ int findCheats(bool silent) {
 	return _cheats.num_cheats;
 }
 
+int findCheats(bool silent) {
+	deviceHandler_setStatEnabled(0);
+	char *cheats_buffer = readCheats(CHEATS_SEARCH_ALL, NULL);
+	deviceHandler_setStatEnabled(1);
+	return loadCheats(cheats_buffer, silent);
+}
+
+// Enables cheats in file order, skipping any that no longer fit
 int applyAllCheats() {
-	int i = 0, j = 0;
+	int i = 0, applied = 0, size = 0, maxSize = kenobi_get_maxsize();
 	for(i = 0; i < _cheats.num_cheats; i++) {
 		CheatEntry *cheat = &_cheats.cheat[i];
-		cheat->enabled = 1;
-		if(getEnabledCheatsSize() > kenobi_get_maxsize())
-			cheat->enabled = 0;
-		j++;
+		cheat->enabled = size + ((cheat->num_codes*2)*4) <= maxSize;
+		if(cheat->enabled) {
+			size += ((cheat->num_codes*2)*4);
+			applied++;
+		}
 	}
-	return j;
+	return applied;
 }
@@ -11,6 +11,7 @@
 #include "swiss.h"
 #include "main.h"
 #include "config.h"
+#include "configdb.h"
 #include "settings.h"
 
 // This is an example Swiss settings entry (sits at the top of global.ini)
@@ -53,6 +54,7 @@
 #define SWISS_BASE_DIR "swiss"
 #define SWISS_SETTINGS_DIR "swiss/settings"
 #define SWISS_GAME_SETTINGS_DIR "swiss/settings/game"
+#define SWISS_GAME_SETTINGS_DB "swiss/settings/games.db"
 
 // Tries to init the current config device
 bool config_set_device() {
@@ -133,6 +135,49 @@ void config_file_delete(char* filename) {
 	free(configFile);
 }
 
+// Per-game settings used to be one .ini file each, bring them into the store
+static void config_import_games() {
+	file_handle dir;
+	memset(&dir, 0, sizeof(file_handle));
+	concat_path(dir.name, devices[DEVICE_CONFIG]->initial->name, SWISS_GAME_SETTINGS_DIR);
+	
+	file_handle *dirEntries = NULL;
+	int imported = 0;
+	bool hideUnknownFileTypes = swissSettings.hideUnknownFileTypes;
+	swissSettings.hideUnknownFileTypes = false;
+	int dirEntryCount = devices[DEVICE_CONFIG]->readDir(&dir, &dirEntries, IS_FILE);
+	swissSettings.hideUnknownFileTypes = hideUnknownFileTypes;
+	
+	for(int i = 0; i < dirEntryCount; i++) {
+		char *name = getRelativeName(dirEntries[i].name);
+		if(dirEntries[i].fileAttrib != IS_FILE || strlen(name) != 8 || strcasecmp(name + 4, ".ini")) {
+			continue;
+		}
+		concat_path(txtbuffer, SWISS_GAME_SETTINGS_DIR, name);
+		char* configData = config_file_read(txtbuffer);
+		if(configData) {
+			imported += configdb_put(name, configData, strlen(configData));
+			free(configData);
+		}
+	}
+	free(dirEntries);
+	print_gecko("config_import_games: imported %i files\r\n", imported);
+	configdb_sync();
+}
+
+static int configDbDevice = -1;
+
+// Reads in the per-game settings store once per config device
+static void config_load_db() {
+	if(configDbDevice == swissSettings.configDeviceId) {
+		return;
+	}
+	configDbDevice = swissSettings.configDeviceId;
+	if(!configdb_load(SWISS_GAME_SETTINGS_DB)) {
+		config_import_games();
+	}
+}
+
 int config_update_global(bool checkConfigDevice) {
 	if(checkConfigDevice && !config_set_device()) return 0;
 
@@ -192,6 +237,7 @@ int config_update_global(bool checkConfigDevice) {
 	fprintf(fp, "Digital Trigger Level=%hhu\r\n", swissSettings.triggerLevel);
 	fprintf(fp, "Emulate Read Speed=%s\r\n", emulateReadSpeedStr[swissSettings.emulateReadSpeed]);
 	fprintf(fp, "Emulate Memory Card=%s\r\n", swissSettings.emulateMemoryCard ? "Yes":"No");
+	fprintf(fp, "Boot Prefetch=%s\r\n", bootPrefetchStr[swissSettings.bootPrefetch]);
 	fprintf(fp, "Prefer Clean Boot=%s\r\n", swissSettings.preferCleanBoot ? "Yes":"No");
 	fprintf(fp, "#!!Swiss Settings End!!\r\n\r\n");
 	fclose(fp);
@@ -237,13 +283,11 @@ int config_update_recent(bool checkConfigDevice) {
 }
 
 
-int config_update_game(ConfigEntry* entry, bool checkConfigDevice) {
-	if(checkConfigDevice && !config_set_device()) return 0;
-
+static bool config_store_game(ConfigEntry* entry) {
 	char *configString = NULL;
 	size_t len = 0;
 	FILE *fp = open_memstream(&configString, &len);
-	if(!fp) return 0;
+	if(!fp) return false;
 
 	fprintf(fp, "# Game specific configuration file. Created by Swiss\r\n");
 	fprintf(fp, "ID=%.4s\r\n", entry->game_id);
@@ -265,13 +309,24 @@ int config_update_game(ConfigEntry* entry, bool checkConfigDevice) {
 	fprintf(fp, "Prefer Clean Boot=%s\r\n", entry->preferCleanBoot ? "Yes":"No");
 	fclose(fp);
 
+	// Also written out as a plain .ini, for anyone backing up or sharing settings by hand
+	concatf_path(txtbuffer, SWISS_GAME_SETTINGS_DIR, "%.4s.ini", entry->game_id);
+	config_file_write(txtbuffer, configString);
+
+	bool res = configdb_put(entry->game_id, configString, len);
+	free(configString);
+	return res;
+}
+
+int config_update_game(ConfigEntry* entry, bool checkConfigDevice) {
+	if(checkConfigDevice && !config_set_device()) return 0;
+
 	ensure_path(DEVICE_CONFIG, SWISS_BASE_DIR, NULL);
 	ensure_path(DEVICE_CONFIG, SWISS_SETTINGS_DIR, NULL);
 	ensure_path(DEVICE_CONFIG, SWISS_GAME_SETTINGS_DIR, NULL);
+	config_load_db();
 	
-	concatf_path(txtbuffer, SWISS_GAME_SETTINGS_DIR, "%.4s.ini", entry->game_id);
-	int res = config_file_write(txtbuffer, configString);
-	free(configString);
+	int res = config_store_game(entry) && configdb_sync();
 	if(checkConfigDevice) {
 		config_unset_device();
 	}
@@ -577,8 +632,9 @@ void config_parse_legacy(char *configData, void (*progress_indicator)(char*, int
 	 int i;
 	 for(i = 0; i < configEntriesCount; i++) {
 		 progress_indicator("Migrating settings to new format.", 1, (int)(((float)i / (float)configEntriesCount) * 100));
-		 config_update_game(&configEntries[i], false);
+		 config_store_game(&configEntries[i]);
 	 }
+	 configdb_sync();
 	 // Write out a new swiss.ini
 	 config_update_global(false);
 	 // Write out new recent.ini
@@ -681,6 +737,14 @@ void config_parse_global(char *configData) {
 				else if(!strcmp("Emulate Memory Card", name)) {
 					swissSettings.emulateMemoryCard = !strcmp("Yes", value);
 				}
+				else if(!strcmp("Boot Prefetch", name)) {
+					for(int i = 0; i < 4; i++) {
+						if(!strcmp(bootPrefetchStr[i], value)) {
+							swissSettings.bootPrefetch = i;
+							break;
+						}
+					}
+				}
 				else if(!strcmp("Prefer Clean Boot", name)) {
 					swissSettings.preferCleanBoot = !strcmp("Yes", value);
 				}
@@ -986,18 +1050,24 @@ void config_find(ConfigEntry *entry) {
 	// Fill out defaults
 	config_defaults(entry);
 	
-	if(!config_set_device()) {
-		return;
+	if(configDbDevice != swissSettings.configDeviceId) {
+		if(!config_set_device()) {
+			return;
+		}
+		config_load_db();
+		config_unset_device();
 	}
-	print_gecko("config_find: Looking for config file with ID %s\r\n",entry->game_id);
-	// See if we have an actual config file for this game
-	concatf_path(txtbuffer, SWISS_GAME_SETTINGS_DIR, "%.4s.ini", entry->game_id);
-	char* configEntry = config_file_read(txtbuffer);
-	if(configEntry) {
-		config_parse_game(configEntry, entry);
-		free(configEntry);
+	print_gecko("config_find: Looking for config with ID %s\r\n",entry->game_id);
+	// See if we have settings stored for this game
+	u32 len;
+	const char* configData = configdb_find(entry->game_id, &len);
+	if(configData) {
+		char* configEntry = strndup(configData, len);
+		if(configEntry) {
+			config_parse_game(configEntry, entry);
+			free(configEntry);
+		}
 	}
-	config_unset_device();
 }
 
 /** 
@@ -1016,6 +1086,9 @@ int config_init(void (*progress_indicator)(char*, int, int)) {
 	ensure_path(DEVICE_CONFIG, SWISS_SETTINGS_DIR, NULL);
 	ensure_path(DEVICE_CONFIG, SWISS_GAME_SETTINGS_DIR, NULL);
 	
+	// Load the per-game settings
+	config_load_db();
+	
 	// Read config (legacy /swiss.ini format)
 	char* configData = config_file_read(SWISS_SETTINGS_FILENAME_LEGACY);
 	if(configData != NULL) {
@@ -23,6 +23,8 @@ typedef struct {
 	int preferCleanBoot;
 } ConfigEntry;
 
+bool config_set_device();
+void config_unset_device();
 void config_find(ConfigEntry *entry);
 int config_update_game(ConfigEntry *entry, bool checkConfigDevice);
 int config_update_global(bool checkConfigDevice);
@@ -0,0 +1,306 @@
+/* -----------------------------------------------------------
+      configdb.c - Keyed store for the per-game settings.
+
+	The store is a log of records, each holding the .ini text of
+	one game's settings. A record is superseded by any later one
+	with the same game ID. The whole log is read once and indexed
+	by game ID, so a lookup costs no device access at all.
+
+	Updates are appended to the end of the log. A torn append is
+	caught by the record checksum, the log is then cut back to the
+	last good record and rewritten on the next update, as it is
+	once dead records outweigh live ones.
+   ----------------------------------------------------------- */
+
+#include <gccore.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <malloc.h>
+#include "swiss.h"
+#include "deviceHandler.h"
+#include "configdb.h"
+#include "xxhash/xxhash.h"
+
+#define CONFIGDB_MAGIC 0x53434442	// 'SCDB'
+#define CONFIGDB_COMPACT_MIN (32*1024)
+
+typedef struct {
+	u32 magic;
+	u32 checksum;	// XXH32 of the rest of the record, padding included
+	char id[4];
+	u32 length;		// Length of the body that follows
+} ConfigRecord;
+
+#define RECORD_SIZE(length) (sizeof(ConfigRecord) + (((length) + 3) & ~3))
+
+static struct {
+	char path[PATHNAME_MAX];
+	u8 *log;		// Image of the log file
+	u32 length;
+	u32 capacity;
+	u32 synced;		// Bytes of the log known to be on the device
+	u32 live;		// Bytes of the log taken by current records
+	bool rewrite;	// The log on the device is torn
+	u32 *index;		// Open addressed on the game ID, holds record offset + 1
+	u32 mask;
+	u32 count;
+} db;
+
+static u32 *index_slot(const char *id) {
+	u32 key;
+	memcpy(&key, id, 4);
+	key *= 0x9E3779B1;
+	u32 i = (key ^ (key >> 16)) & db.mask;
+	while(db.index[i]) {
+		ConfigRecord *record = (ConfigRecord*)(db.log + db.index[i] - 1);
+		if(!memcmp(record->id, id, 4)) {
+			break;
+		}
+		i = (i + 1) & db.mask;
+	}
+	return &db.index[i];
+}
+
+static bool index_grow(void) {
+	if(db.index && (db.count + 1) * 4 <= (db.mask + 1) * 3) {
+		return true;
+	}
+	u32 *old = db.index;
+	u32 oldSize = old ? db.mask + 1 : 0;
+	u32 size = old ? oldSize * 2 : 64;
+	db.index = calloc(size, sizeof(u32));
+	if(!db.index) {
+		db.index = old;
+		return false;
+	}
+	db.mask = size - 1;
+	for(u32 i = 0; i < oldSize; i++) {
+		if(old[i]) {
+			ConfigRecord *record = (ConfigRecord*)(db.log + old[i] - 1);
+			*index_slot(record->id) = old[i];
+		}
+	}
+	free(old);
+	return true;
+}
+
+// Points the index at the record at offset, retiring whatever it replaces
+static bool index_insert(u32 offset) {
+	if(!index_grow()) {
+		return false;
+	}
+	ConfigRecord *record = (ConfigRecord*)(db.log + offset);
+	u32 *slot = index_slot(record->id);
+	if(*slot) {
+		ConfigRecord *old = (ConfigRecord*)(db.log + *slot - 1);
+		db.live -= RECORD_SIZE(old->length);
+	} else {
+		db.count++;
+	}
+	*slot = offset + 1;
+	db.live += RECORD_SIZE(record->length);
+	return true;
+}
+
+static void index_reset(void) {
+	if(db.index) {
+		memset(db.index, 0, (db.mask + 1) * sizeof(u32));
+	}
+	db.count = 0;
+	db.live = 0;
+}
+
+static u32 record_checksum(ConfigRecord *record) {
+	return XXH32(record->id, RECORD_SIZE(record->length) - offsetof(ConfigRecord, id), CONFIGDB_MAGIC);
+}
+
+// Returns the size of the valid record at offset, 0 if there isn't one
+static u32 record_check(u32 offset) {
+	if(db.length - offset < sizeof(ConfigRecord)) {
+		return 0;
+	}
+	ConfigRecord *record = (ConfigRecord*)(db.log + offset);
+	if(record->magic != CONFIGDB_MAGIC || record->length > db.length - offset - sizeof(ConfigRecord)) {
+		return 0;
+	}
+	u32 size = RECORD_SIZE(record->length);
+	if(size > db.length - offset || record->checksum != record_checksum(record)) {
+		return 0;
+	}
+	return size;
+}
+
+static file_handle *db_file(const char *suffix) {
+	file_handle *file = calloc(1, sizeof(file_handle));
+	if(file) {
+		snprintf(file->name, PATHNAME_MAX, "%s%s", db.path, suffix);
+	}
+	return file;
+}
+
+bool configdb_load(const char *path) {
+	free(db.log);
+	db.log = NULL;
+	db.length = db.capacity = db.synced = 0;
+	db.rewrite = false;
+	index_reset();
+	concat_path(db.path, devices[DEVICE_CONFIG]->initial->name, (char*)path);
+
+	file_handle *file = db_file("");
+	if(!file) {
+		return false;
+	}
+	if(devices[DEVICE_CONFIG]->readFile(file, NULL, 0) != 0) {
+		// Interrupted while swapping in a compacted log?
+		file_handle *temp = db_file(".tmp");
+		if(temp && devices[DEVICE_CONFIG]->readFile(temp, NULL, 0) == 0) {
+			devices[DEVICE_CONFIG]->renameFile(temp, file->name);
+		}
+		free(temp);
+		if(devices[DEVICE_CONFIG]->readFile(file, NULL, 0) != 0) {
+			free(file);
+			return false;
+		}
+	}
+	db.log = malloc(file->size + 1);
+	if(!db.log || devices[DEVICE_CONFIG]->readFile(file, db.log, file->size) != file->size) {
+		// Keep away from a log we couldn't read rather than write over it
+		print_gecko("configdb_load: failed to read %s\r\n", file->name);
+		devices[DEVICE_CONFIG]->closeFile(file);
+		db.path[0] = '\0';
+		free(file);
+		return true;
+	}
+	db.length = db.capacity = file->size;
+	devices[DEVICE_CONFIG]->closeFile(file);
+
+	u32 offset = 0, size;
+	while((size = record_check(offset)) && index_insert(offset)) {
+		offset += size;
+	}
+	db.rewrite = offset != file->size;
+	db.length = db.synced = offset;
+	print_gecko("configdb_load: %i games in %i bytes, %i live\r\n", db.count, db.length, db.live);
+	free(file);
+	return true;
+}
+
+const char *configdb_find(const char *id, u32 *length) {
+	if(!db.count) {
+		return NULL;
+	}
+	u32 offset = *index_slot(id);
+	if(!offset) {
+		return NULL;
+	}
+	ConfigRecord *record = (ConfigRecord*)(db.log + offset - 1);
+	*length = record->length;
+	return (const char*)(record + 1);
+}
+
+bool configdb_put(const char *id, const char *body, u32 length) {
+	u32 size = RECORD_SIZE(length);
+	if(db.capacity - db.length < size) {
+		u32 capacity = db.capacity * 2 > db.length + size ? db.capacity * 2 : db.length + size;
+		u8 *log = realloc(db.log, capacity);
+		if(!log) {
+			return false;
+		}
+		db.log = log;
+		db.capacity = capacity;
+	}
+	ConfigRecord *record = (ConfigRecord*)(db.log + db.length);
+	record->magic = CONFIGDB_MAGIC;
+	memcpy(record->id, id, 4);
+	record->length = length;
+	memcpy(record + 1, body, length);
+	memset((u8*)(record + 1) + length, 0, size - sizeof(ConfigRecord) - length);
+	record->checksum = record_checksum(record);
+	if(!index_insert(db.length)) {
+		return false;
+	}
+	db.length += size;
+	return true;
+}
+
+// Drops superseded records and writes the whole log out again
+static bool configdb_compact(void) {
+	u8 *log = malloc(db.live + 1);
+	if(!log) {
+		return false;
+	}
+	u32 length = 0;
+	for(u32 offset = 0; offset < db.length; ) {
+		ConfigRecord *record = (ConfigRecord*)(db.log + offset);
+		u32 size = RECORD_SIZE(record->length);
+		if(*index_slot(record->id) == offset + 1) {
+			memcpy(log + length, record, size);
+			length += size;
+		}
+		offset += size;
+	}
+	free(db.log);
+	db.log = log;
+	db.length = db.capacity = length;
+	index_reset();
+	for(u32 offset = 0; offset < db.length; offset += RECORD_SIZE(((ConfigRecord*)(db.log + offset))->length)) {
+		index_insert(offset);
+	}
+
+	// Never leave the device without a whole log, swap the new one in by renaming
+	file_handle *temp = db_file(".tmp");
+	file_handle *file = db_file("");
+	bool ret = false;
+	if(temp && file) {
+		devices[DEVICE_CONFIG]->deleteFile(temp);
+		if(devices[DEVICE_CONFIG]->writeFile(temp, db.log, db.length) == db.length &&
+			!devices[DEVICE_CONFIG]->closeFile(temp)) {
+			devices[DEVICE_CONFIG]->deleteFile(file);
+			ret = !devices[DEVICE_CONFIG]->renameFile(temp, file->name);
+		}
+		devices[DEVICE_CONFIG]->closeFile(temp);
+	}
+	free(temp);
+	free(file);
+	print_gecko("configdb_compact: %i games in %i bytes\r\n", db.count, db.length);
+	return ret;
+}
+
+// Writes the records past the synced length onto the end of the log
+static bool configdb_append(void) {
+	file_handle *file = db_file("");
+	if(!file) {
+		return false;
+	}
+	// The device only appends to a file whose size was read and that is written at its end,
+	// a log that isn't the size last synced is rewritten instead
+	u32 length = db.length - db.synced;
+	bool ret = !db.synced || (devices[DEVICE_CONFIG]->readFile(file, NULL, 0) == 0 && file->size == db.synced);
+	devices[DEVICE_CONFIG]->closeFile(file);
+	if(ret) {
+		devices[DEVICE_CONFIG]->seekFile(file, db.synced, DEVICE_HANDLER_SEEK_SET);
+		ret = devices[DEVICE_CONFIG]->writeFile(file, db.log + db.synced, length) == length;
+		ret &= devices[DEVICE_CONFIG]->closeFile(file) == 0;
+	}
+	free(file);
+	return ret;
+}
+
+bool configdb_sync(void) {
+	if(db.synced == db.length && !db.rewrite) {
+		return true;
+	}
+	if(!db.path[0]) {
+		return false;
+	}
+	u32 dead = db.length - db.live;
+	if(db.rewrite || (dead > db.live && dead > CONFIGDB_COMPACT_MIN) || !configdb_append()) {
+		db.rewrite = !configdb_compact();
+	}
+	if(db.rewrite) {
+		return false;
+	}
+	db.synced = db.length;
+	return true;
+}
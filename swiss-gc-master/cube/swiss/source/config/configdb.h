@@ -0,0 +1,24 @@
+/* -----------------------------------------------------------
+      configdb.h - Keyed store for the per-game settings.
+
+	Every game's settings live as one checksummed record in a
+	single log file on the config device. The log is read once
+	and indexed in memory, updates are appended and the log is
+	compacted when it is mostly dead records.
+   ----------------------------------------------------------- */
+
+#ifndef __CONFIGDB_H
+#define __CONFIGDB_H
+
+#include <gccore.h>
+
+// Loads the store from the config device, returns false if there was none
+bool configdb_load(const char *path);
+// Returns the record body for a game ID (not NUL terminated), NULL if not found
+const char *configdb_find(const char *id, u32 *length);
+// Replaces the record for a game ID in memory, call configdb_sync to store it
+bool configdb_put(const char *id, const char *body, u32 length);
+// Writes pending records out, compacting the log if due
+bool configdb_sync(void);
+
+#endif
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <malloc.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <time.h>
@@ -15,6 +16,7 @@
 #include "swiss.h"
 #include "patcher.h"
 #include "deviceHandler.h"
+#include "xxhash/xxhash.h"
 
 DEVICEHANDLER_INTERFACE* allDevices[MAX_DEVICES];	// All devices registered in Swiss
 DEVICEHANDLER_INTERFACE* devices[MAX_DEVICE_SLOTS];	// Currently used devices
@@ -99,6 +101,21 @@ DEVICEHANDLER_INTERFACE* getDeviceFromPath(char *path) {
 	return NULL;
 }
 
+// The EXI channel a device at location is reached over, -1 if it isn't on EXI
+s32 getExiChannelByLocation(u32 location) {
+	switch(location) {
+		case LOC_MEMCARD_SLOT_A:
+		case LOC_SERIAL_PORT_1:
+		case LOC_SYSTEM:
+			return EXI_CHANNEL_0;
+		case LOC_MEMCARD_SLOT_B:
+			return EXI_CHANNEL_1;
+		case LOC_SERIAL_PORT_2:
+			return EXI_CHANNEL_2;
+	}
+	return -1;
+}
+
 const char* getHwNameByLocation(u32 location) {
 	DEVICEHANDLER_INTERFACE *device = getDeviceByLocation(location);
 	if(device != NULL) {
@@ -235,3 +252,173 @@ FILE* openFileStream(int deviceSlot, file_handle *file)
 		(fpos_t (*)(void *, fpos_t, int))devices[deviceSlot]->seekFile,
 		(int (*)(void *))devices[deviceSlot]->closeFile);
 }
+
+// Chunked reads, a reader thread keeps the device busy on the next chunk while the last one is consumed.
+// There is one reader stack, a call made while it is in use (or when no thread can be had) reads inline.
+#define CHUNK_STACK_SIZE	(32*1024)
+#define CHUNK_PRIORITY		50
+
+typedef struct {
+	DEVICEHANDLER_INTERFACE *device;
+	file_handle *file;
+	u8 *buffer;			// Destination, or NULL to cycle through scratch
+	u8 *scratch[2];
+	u32 length;
+	u32 chunkSize;
+	u32 landed;			// Chunks read in full
+	u32 consumed;		// Chunks handed to the consumer
+	s32 status;			// Negative on a read error
+	bool quit;
+	mutex_t mutex;
+	cond_t cond;
+} chunk_reader;
+
+static u8 chunk_stack[CHUNK_STACK_SIZE];
+static bool chunk_stack_busy = false;
+
+static u8 *chunk_data(chunk_reader *reader, u32 chunk) {
+	return reader->buffer ? reader->buffer + chunk * reader->chunkSize : reader->scratch[chunk & 1];
+}
+
+static void *chunk_producer(void *arg) {
+	chunk_reader *reader = arg;
+	u32 chunks = (reader->length + reader->chunkSize - 1) / reader->chunkSize;
+	
+	LWP_MutexLock(reader->mutex);
+	for(u32 chunk = 0; chunk < chunks && !reader->quit; chunk++) {
+		// Scratch only holds two chunks, wait for the older one to be let go of
+		while(!reader->buffer && chunk - reader->consumed >= 2 && !reader->quit) {
+			LWP_CondWait(reader->cond, reader->mutex);
+		}
+		if(reader->quit) {
+			break;
+		}
+		LWP_MutexUnlock(reader->mutex);
+		
+		u32 size = MIN(reader->chunkSize, reader->length - chunk * reader->chunkSize);
+		s32 ret = reader->device->readFile(reader->file, chunk_data(reader, chunk), size);
+		
+		LWP_MutexLock(reader->mutex);
+		if(ret != size) {
+			reader->status = ret < 0 ? ret : -1;
+			LWP_CondBroadcast(reader->cond);
+			break;
+		}
+		reader->landed++;
+		LWP_CondBroadcast(reader->cond);
+	}
+	LWP_MutexUnlock(reader->mutex);
+	return NULL;
+}
+
+// Reads and consumes one chunk at a time on the calling thread
+static s32 readFileChunkedInline(chunk_reader *reader, bool (*consume)(void *ctx, void *data, u32 offset, u32 length), void *ctx) {
+	for(u32 offset = 0; offset < reader->length; offset += reader->chunkSize) {
+		u32 size = MIN(reader->chunkSize, reader->length - offset);
+		u8 *data = reader->buffer ? reader->buffer + offset : reader->scratch[0];
+		s32 ret = reader->device->readFile(reader->file, data, size);
+		if(ret != size) {
+			return ret < 0 ? ret : -1;
+		}
+		if(!consume(ctx, data, offset, size)) {
+			return offset;
+		}
+	}
+	return reader->length;
+}
+
+// Reads length bytes from the current offset, handing each chunk to consume as it lands.
+// With no buffer the chunks only live until consume returns. Stops early if consume returns false.
+s32 readFileChunked(int deviceSlot, file_handle *file, void *buffer, u32 length, u32 chunkSize, bool (*consume)(void *ctx, void *data, u32 offset, u32 length), void *ctx) {
+	chunk_reader reader = {
+		.device = devices[deviceSlot],
+		.file = file,
+		.buffer = buffer,
+		.length = length,
+		.chunkSize = chunkSize,
+	};
+	u32 chunks = (length + chunkSize - 1) / chunkSize;
+	s32 ret = length;
+	
+	if(!buffer) {
+		reader.scratch[0] = memalign(32, chunkSize);
+		reader.scratch[1] = memalign(32, chunkSize);
+		if(!reader.scratch[0] || !reader.scratch[1]) {
+			free(reader.scratch[0]);
+			free(reader.scratch[1]);
+			return -1;
+		}
+	}
+	if(chunk_stack_busy) {
+		ret = readFileChunkedInline(&reader, consume, ctx);
+		free(reader.scratch[0]);
+		free(reader.scratch[1]);
+		return ret;
+	}
+	chunk_stack_busy = true;
+	lwp_t thread = LWP_THREAD_NULL;
+	LWP_MutexInit(&reader.mutex, false);
+	LWP_CondInit(&reader.cond);
+	if(LWP_CreateThread(&thread, chunk_producer, &reader, chunk_stack, CHUNK_STACK_SIZE, CHUNK_PRIORITY) < 0) {
+		LWP_CondDestroy(reader.cond);
+		LWP_MutexDestroy(reader.mutex);
+		ret = readFileChunkedInline(&reader, consume, ctx);
+		free(reader.scratch[0]);
+		free(reader.scratch[1]);
+		chunk_stack_busy = false;
+		return ret;
+	}
+	
+	for(u32 chunk = 0; chunk < chunks; chunk++) {
+		LWP_MutexLock(reader.mutex);
+		while(reader.landed <= chunk && !reader.status) {
+			LWP_CondWait(reader.cond, reader.mutex);
+		}
+		bool landed = reader.landed > chunk;
+		LWP_MutexUnlock(reader.mutex);
+		if(!landed) {
+			ret = reader.status;
+			break;
+		}
+		
+		u32 offset = chunk * chunkSize;
+		if(!consume(ctx, chunk_data(&reader, chunk), offset, MIN(chunkSize, length - offset))) {
+			ret = offset;
+			break;
+		}
+		LWP_MutexLock(reader.mutex);
+		reader.consumed++;
+		LWP_CondBroadcast(reader.cond);
+		LWP_MutexUnlock(reader.mutex);
+	}
+	
+	LWP_MutexLock(reader.mutex);
+	reader.quit = true;
+	LWP_CondBroadcast(reader.cond);
+	LWP_MutexUnlock(reader.mutex);
+	LWP_JoinThread(thread, NULL);
+	LWP_CondDestroy(reader.cond);
+	LWP_MutexDestroy(reader.mutex);
+	free(reader.scratch[0]);
+	free(reader.scratch[1]);
+	chunk_stack_busy = false;
+	return ret;
+}
+
+static bool hash_chunk(void *ctx, void *data, u32 offset, u32 length) {
+	XXH3_64bits_update(ctx, data, length);
+	return true;
+}
+
+// Reads length bytes from the current offset into buffer, hashing it with XXH3 on the way in
+s32 readFileHashed(int deviceSlot, file_handle *file, void *buffer, u32 length, u64 *hash) {
+	XXH3_state_t *state = XXH3_createState();
+	if(!state) {
+		return -1;
+	}
+	XXH3_64bits_reset(state);
+	s32 ret = readFileChunked(deviceSlot, file, buffer, length, READ_CHUNK_SIZE, hash_chunk, state);
+	*hash = XXH3_64bits_digest(state);
+	XXH3_freeState(state);
+	return ret;
+}
@@ -108,6 +108,7 @@ typedef char* (* _fn_status)(file_handle*);
 #define EMU_AUDIO_STREAMING	0x4
 #define EMU_MEMCARD			0x8
 #define EMU_BUS_ARBITER		0x10
+#define EMU_BOOT_PREFETCH	0x20
 
 // Device locations
 #define LOC_MEMCARD_SLOT_A 	0x1
@@ -211,6 +212,7 @@ extern DEVICEHANDLER_INTERFACE* getDeviceByUniqueId(u8 id);
 extern DEVICEHANDLER_INTERFACE* getDeviceByLocation(u32 location);
 extern DEVICEHANDLER_INTERFACE* getDeviceFromPath(char *path);
 extern const char* getHwNameByLocation(u32 location);
+extern s32 getExiChannelByLocation(u32 location);
 
 #define MAX_FRAGS 40
 
@@ -219,5 +221,10 @@ extern void print_frag_list(file_frag *fragList, u32 totFrags);
 
 extern FILE* openFileStream(int deviceSlot, file_handle *file);
 
+#define READ_CHUNK_SIZE (128*1024)
+
+extern s32 readFileChunked(int deviceSlot, file_handle *file, void *buffer, u32 length, u32 chunkSize, bool (*consume)(void *ctx, void *data, u32 offset, u32 length), void *ctx);
+extern s32 readFileHashed(int deviceSlot, file_handle *file, void *buffer, u32 length, u64 *hash);
+
 #endif
 
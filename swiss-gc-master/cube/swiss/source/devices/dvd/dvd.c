@@ -426,6 +426,8 @@ int DVD_LowRead64(void* dst, u32 len, uint64_t offset)
 	
 	if ((((u32)dst) & 0xC0000000) == 0x80000000) // cached?
 		dvd[0] = 0x2E;
+	// Drop stale lines before the DMA starts, so none get written back over it
+	DCInvalidateRange(dst, len);
 	dvd[1] = 0;
 	dvd[2] = 0xA8000000;
 	dvd[3] = offset >> 2;
@@ -435,7 +437,6 @@ int DVD_LowRead64(void* dst, u32 len, uint64_t offset)
 	dvd[7] = 3; // enable reading!
 	while (dvd[7] & 1);
 
-	DCInvalidateRange(dst, len);
 	if (dvd[0] & 0x4)
 		return 1;
 	return 0;
@@ -444,30 +445,41 @@ int DVD_LowRead64(void* dst, u32 len, uint64_t offset)
 /* 
 DVD_Read(void* dst, uint64_t offset, int len)
   Reads from any offset and handles alignment from device
+  Whole sectors destined for a 32 byte aligned buffer are read straight into it
+  with a single command, only the unaligned head/tail goes through bounce_buffer.
   Synchronous function.
     return -1 if offset is out of range
 */
+static u8 bounce_buffer[2048] __attribute__((aligned(32)));
+
 s32 DVD_Read(void* dst, uint64_t offset, u32 len)
 {
 	u32 ol = len;
 	s32 ret = 0;	
-	u8 *sector_buffer = (u8*)memalign(32,2048);
 	while (len)
 	{
-		uint32_t sector = offset / 2048;
-		ret |= DVD_LowRead64(sector_buffer, 2048, sector * 2048);
 		uint32_t off = offset & 2047;
+		if (!off && len >= 2048 && !((u32)dst & 31))
+		{
+			u32 rl = len & ~2047;
+			ret |= DVD_LowRead64(dst, rl, offset);
+
+			offset += rl;
+			len -= rl;
+			dst += rl;
+			continue;
+		}
+		ret |= DVD_LowRead64(bounce_buffer, 2048, offset - off);
 
 		int rl = 2048 - off;
 		if (rl > len)
 			rl = len;
-		memcpy(dst, sector_buffer + off, rl);	
+		memcpy(dst, bounce_buffer + off, rl);	
 
 		offset += rl;
 		len -= rl;
 		dst += rl;
 	}
-	free(sector_buffer);
 	if(ret)
 		return -1;
 
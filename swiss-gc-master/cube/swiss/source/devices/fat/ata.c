@@ -308,6 +308,19 @@ u32 _ataDriveIdentify(int chn) {
 		ataDriveInfo.sizeInGigaBytes = (u32)((ataDriveInfo.sizeInSectors<<9) / 1024 / 1024 / 1024);
 	}
 	
+	// Use READ/WRITE MULTIPLE if the drive can move more than one sector per DRQ block
+	u16 multiple = buffer[ATA_IDENT_MULTIPLE] & 0xFF;
+	if(multiple > 1) {
+		while(ataReadStatusReg(chn) & ATA_SR_BSY);
+		ataWriteByte(chn, ATA_REG_DEVICE, ATA_HEAD_USE_LBA);
+		ataWriteByte(chn, ATA_REG_SECCOUNT, (u8)multiple);
+		ataWriteByte(chn, ATA_REG_COMMAND, ATA_CMD_SETMULT);
+		while((tmp = ataReadStatusReg(chn)) & ATA_SR_BSY);
+		if(!(tmp & ATA_SR_ERR)) {
+			ataDriveInfo.multipleSectors = multiple;
+		}
+	}
+	
 	i = 20;
 	// copy serial string
 	memcpy(&ataDriveInfo.serial[0], &buffer[ATA_IDENT_SERIAL],20);
@@ -327,6 +340,7 @@ u32 _ataDriveIdentify(int chn) {
 	
 	print_gecko("%d GB HDD Connected\r\n", ataDriveInfo.sizeInGigaBytes);
 	print_gecko("LBA 48-Bit Mode %s\r\n", ataDriveInfo.lba48Support ? "Supported" : "Not Supported");
+	print_gecko("Sectors Per DRQ Block: %i\r\n", ataDriveInfo.multipleSectors ? ataDriveInfo.multipleSectors : 1);
 	if(!ataDriveInfo.lba48Support) {
 		print_gecko("Cylinders: %i\r\n",ataDriveInfo.cylinders);
 		print_gecko("Heads Per Cylinder: %i\r\n",ataDriveInfo.heads);
@@ -411,12 +425,10 @@ int ataUnlock(int chn, int useMaster, char *password, int command)
 	return !(ataReadErrorReg(chn) & ATA_ER_ABRT);
 }
 
-// Reads sectors from the specified lba, for the specified slot
-// Returns 0 on success, -1 on failure.
-int _ataReadSector(int chn, u64 lba, u32 *Buffer)
+// Programs the device, LBA and sector count registers and issues the command.
+// The maximum count (256 or 65536) is encoded as 0 by the register masking.
+static void _ataIssueCommand(int chn, u64 lba, u32 count, u8 command)
 {
-	u32 temp = 0;
-  	
   	// Wait for drive to be ready (BSY to clear)
 	while(ataReadStatusReg(chn) & ATA_SR_BSY);
   	
@@ -432,113 +444,130 @@ int _ataReadSector(int chn, u64 lba, u32 *Buffer)
   		
 	// check if drive supports LBA 48-bit
 	if(ataDriveInfo.lba48Support) {  		
-		ataWriteByte(chn, ATA_REG_SECCOUNT, 0);								// Sector count (Hi)
+		ataWriteByte(chn, ATA_REG_SECCOUNT, (u8)((count>>8) & 0xFF));		// Sector count (Hi)
 		ataWriteByte(chn, ATA_REG_LBALO, (u8)((lba>>24)& 0xFF));			// LBA 4
 		ataWriteByte(chn, ATA_REG_LBAMID, (u8)((lba>>32) & 0xFF));			// LBA 5
 		ataWriteByte(chn, ATA_REG_LBAHI, (u8)((lba>>40) & 0xFF));			// LBA 6
-		ataWriteByte(chn, ATA_REG_SECCOUNT, 1);								// Sector count (Lo)
+		ataWriteByte(chn, ATA_REG_SECCOUNT, (u8)(count & 0xFF));			// Sector count (Lo)
 		ataWriteByte(chn, ATA_REG_LBALO, (u8)(lba & 0xFF));					// LBA 1
   		ataWriteByte(chn, ATA_REG_LBAMID, (u8)((lba>>8) & 0xFF));			// LBA 2
   		ataWriteByte(chn, ATA_REG_LBAHI, (u8)((lba>>16) & 0xFF));			// LBA 3
 	}
 	else {
-		ataWriteByte(chn, ATA_REG_SECCOUNT, 1);								// Sector count
+		ataWriteByte(chn, ATA_REG_SECCOUNT, (u8)(count & 0xFF));			// Sector count
 		ataWriteByte(chn, ATA_REG_LBALO, (u8)(lba & 0xFF));					// LBA Lo
   		ataWriteByte(chn, ATA_REG_LBAMID, (u8)((lba>>8) & 0xFF));			// LBA Mid
   		ataWriteByte(chn, ATA_REG_LBAHI, (u8)((lba>>16) & 0xFF));			// LBA Hi
 	}
 
-	// Write the appropriate read command
-  	ataWriteByte(chn, ATA_REG_COMMAND, ataDriveInfo.lba48Support ? ATA_CMD_READSECTEXT : ATA_CMD_READSECT);
+	// Write the command
+  	ataWriteByte(chn, ATA_REG_COMMAND, command);
+}
 
+// Waits for the drive to finish the current DRQ block
+// Returns the status register, or 0 when the drive is ready for data
+static u8 _ataWaitDataRequest(int chn)
+{
+	u8 temp;
+	
 	// Wait for BSY to clear
 	while((temp = ataReadStatusReg(chn)) & ATA_SR_BSY);
 	
 	// If the error bit was set, fail.
-	if(temp & ATA_SR_ERR) {
-		print_gecko("Error: %02X", ataReadErrorReg(chn));
-		return 1;
+	if(temp & (ATA_SR_ERR | ATA_SR_DF)) {
+		print_gecko("Error: %02X\r\n", ataReadErrorReg(chn));
+		return temp | ATA_SR_ERR;
 	}
-
-	// Wait for drive to request data transfer
-	while(!(ataReadStatusReg(chn) & ATA_SR_DRQ));
 	
-	// read data from drive
-	ata_read_buffer(chn, Buffer);
-
-	temp = ataReadStatusReg(chn);
-	// If the error bit was set, fail.
-	if(temp & ATA_SR_ERR) {
-		return 1;
+	// Wait for drive to request data transfer
+	while(!((temp = ataReadStatusReg(chn)) & ATA_SR_DRQ)) {
+		if(temp & ATA_SR_ERR) {
+			return temp;
+		}
 	}
-	return temp & ATA_SR_ERR;
+	return 0;
 }
 
-// Writes sectors to the specified lba, for the specified slot
-// Returns 0 on success, -1 on failure.
-int _ataWriteSector(int chn, u64 lba, u32 *Buffer)
+// Maximum number of sectors a single command may transfer
+static inline u32 _ataMaxSectors(void)
 {
-	u32 i, temp;
-  	
-  	// Wait for drive to be ready (BSY to clear)
-	while(ataReadStatusReg(chn) & ATA_SR_BSY);
-  	
-	// Select the device differently based on 28 or 48bit mode
-	if(ataDriveInfo.lba48Support) {
-		// Select the device (ATA_HEAD_USE_LBA is 0x40 for master, 0x50 for slave)
-		ataWriteByte(chn, ATA_REG_DEVICE, ATA_HEAD_USE_LBA);
+	return ataDriveInfo.lba48Support ? ATA_MAX_SECTORS_LBA48 : ATA_MAX_SECTORS_LBA28;
+}
+
+// Reads count sectors from the specified lba with a single command, for the specified slot
+// The data phase is streamed one DRQ block at a time, 512 bytes per EXI transfer
+// Returns 0 on success, non-zero on failure.
+int _ataReadSectors(int chn, u64 lba, u32 count, u32 *Buffer)
+{
+	u32 i, block = ataDriveInfo.multipleSectors;
+	u8 command;
+	
+	if(block) {
+		command = ataDriveInfo.lba48Support ? ATA_CMD_READMULTEXT : ATA_CMD_READMULT;
 	}
 	else {
-		// Select the device (ATA_HEAD_USE_LBA is 0x40 for master, 0x50 for slave)
-		ataWriteByte(chn, ATA_REG_DEVICE, 0xE0 | (u8)((lba >> 24) & 0x0F));
+		command = ataDriveInfo.lba48Support ? ATA_CMD_READSECTEXT : ATA_CMD_READSECT;
+		block = 1;
 	}
-  		
-	// check if drive supports LBA 48-bit
-	if(ataDriveInfo.lba48Support) {  		
-		ataWriteByte(chn, ATA_REG_SECCOUNT, 0);								// Sector count (Hi)
-		ataWriteByte(chn, ATA_REG_LBALO, (u8)((lba>>24)& 0xFF));			// LBA 4
-		ataWriteByte(chn, ATA_REG_LBAMID, (u8)((lba>>32) & 0xFF));			// LBA 4
-		ataWriteByte(chn, ATA_REG_LBAHI, (u8)((lba>>40) & 0xFF));			// LBA 5
-  		ataWriteByte(chn, ATA_REG_SECCOUNT, 1);								// Sector count (Lo)
-		ataWriteByte(chn, ATA_REG_LBALO, (u8)(lba & 0xFF));					// LBA 1
-  		ataWriteByte(chn, ATA_REG_LBAMID, (u8)((lba>>8) & 0xFF));			// LBA 2
-  		ataWriteByte(chn, ATA_REG_LBAHI, (u8)((lba>>16) & 0xFF));			// LBA 3
-	}
-	else {
-  		ataWriteByte(chn, ATA_REG_SECCOUNT, 1);								// Sector count
-		ataWriteByte(chn, ATA_REG_LBALO, (u8)(lba & 0xFF));					// LBA Lo
-  		ataWriteByte(chn, ATA_REG_LBAMID, (u8)((lba>>8) & 0xFF));			// LBA Mid
-  		ataWriteByte(chn, ATA_REG_LBAHI, (u8)((lba>>16) & 0xFF));			// LBA Hi
+	_ataIssueCommand(chn, lba, count, command);
+	
+	while(count) {
+		if(_ataWaitDataRequest(chn)) {
+			return 1;
+		}
+		// read a whole DRQ block from the drive
+		for(i = 0; i < block && count; i++) {
+			ata_read_buffer(chn, Buffer);
+			Buffer += 512/4;
+			count--;
+		}
 	}
-
-	// Write the appropriate write command
-  	ataWriteByte(chn, ATA_REG_COMMAND, ataDriveInfo.lba48Support ? ATA_CMD_WRITESECTEXT : ATA_CMD_WRITESECT);
-
-  	// Wait for BSY to clear
-	while((temp = ataReadStatusReg(chn)) & ATA_SR_BSY);
 	
 	// If the error bit was set, fail.
-	if(temp & ATA_SR_ERR) {
-		print_gecko("Error: %02X", ataReadErrorReg(chn));
-		return 1;
-	}
-	// Wait for drive to request data transfer
-	while(!(ataReadStatusReg(chn) & ATA_SR_DRQ));
+	return ataReadStatusReg(chn) & ATA_SR_ERR;
+}
 
-	// Write data to the drive
-	u16 *ptr = (u16*)Buffer;
-	for (i=0; i<256; i++) {
-		ataWriteu16(chn, ptr[i]);
+// Writes count sectors to the specified lba with a single command, for the specified slot
+// The data phase is streamed one DRQ block at a time, 512 bytes per EXI transfer
+// Returns 0 on success, non-zero on failure.
+int _ataWriteSectors(int chn, u64 lba, u32 count, u32 *Buffer)
+{
+	u32 i, j, temp, block = ataDriveInfo.multipleSectors;
+	u8 command;
+	
+	if(block) {
+		command = ataDriveInfo.lba48Support ? ATA_CMD_WRITEMULTEXT : ATA_CMD_WRITEMULT;
+	}
+	else {
+		command = ataDriveInfo.lba48Support ? ATA_CMD_WRITESECTEXT : ATA_CMD_WRITESECT;
+		block = 1;
+	}
+	_ataIssueCommand(chn, lba, count, command);
+	
+	while(count) {
+		if(_ataWaitDataRequest(chn)) {
+			return 1;
+		}
+		// Write a whole DRQ block to the drive
+		for(i = 0; i < block && count; i++) {
+			if(_ideexi_version == IDE_EXI_V1) {
+				u16 *ptr = (u16*)Buffer;
+				for (j=0; j<256; j++) {
+					ataWriteu16(chn, ptr[j]);
+				}
+			}
+			else {
+				ata_write_buffer(chn, Buffer);
+			}
+			Buffer += 512/4;
+			count--;
+		}
 	}
 	
 	// Wait for the write to finish
-	while(ataReadStatusReg(chn) & ATA_SR_BSY);
+	while((temp = ataReadStatusReg(chn)) & ATA_SR_BSY);
 	
-	temp = ataReadStatusReg(chn);
 	// If the error bit was set, fail.
-	if(temp & ATA_SR_ERR) {
-		return 1;
-	}
 	return temp & ATA_SR_ERR;
 }
 
@@ -547,16 +576,17 @@ int _ataWriteSector(int chn, u64 lba, u32 *Buffer)
 int ataReadSectors(int chn, u64 sector, unsigned int numSectors, unsigned char *dest) 
 {
 	int ret = 0;
+	u32 count, max = _ataMaxSectors();
 	while(numSectors) {
+		count = numSectors < max ? numSectors : max;
 		//print_gecko("Reading, sec %08X, numSectors %i, dest %08X ..\r\n", (u32)(sector&0xFFFFFFFF),numSectors, (u32)dest);
-		if((ret=_ataReadSector(chn,sector,(u32*)dest))) {
+		if((ret=_ataReadSectors(chn,sector,count,(u32*)dest))) {
 			print_gecko("(%08X) Failed to read!..\r\n", ret);
 			return -1;
 		}
-		//print_hdd_sector((u32*)dest);
-		dest+=512;
-		sector++;
-		numSectors--;
+		dest+=count*512;
+		sector+=count;
+		numSectors-=count;
 	}
 	return 0;
 }
@@ -566,14 +596,16 @@ int ataReadSectors(int chn, u64 sector, unsigned int numSectors, unsigned char *
 int ataWriteSectors(int chn, u64 sector,unsigned int numSectors, unsigned char *src) 
 {
 	int ret = 0;
+	u32 count, max = _ataMaxSectors();
 	while(numSectors) {
-		if((ret=_ataWriteSector(chn,sector,(u32*)src))) {
+		count = numSectors < max ? numSectors : max;
+		if((ret=_ataWriteSectors(chn,sector,count,(u32*)src))) {
 			print_gecko("(%08X) Failed to write!..\r\n", ret);
 			return -1;
 		}
-		src+=512;
-		sector++;
-		numSectors--;
+		src+=count*512;
+		sector+=count;
+		numSectors-=count;
 	}
 	return 0;
 }
@@ -66,6 +66,11 @@ extern int _ideexi_version;
 #define ATA_CMD_READSECTEXT	0x24
 #define ATA_CMD_WRITESECT	0x30
 #define ATA_CMD_WRITESECTEXT 0x34
+#define ATA_CMD_READMULT	0xC4
+#define ATA_CMD_READMULTEXT	0x29
+#define ATA_CMD_WRITEMULT	0xC5
+#define ATA_CMD_WRITEMULTEXT 0x39
+#define ATA_CMD_SETMULT		0xC6
 #define ATA_CMD_UNLOCK		0xF2
 #define ATA_CMD_SECURITY_DISABLE	0xF6
 
@@ -76,11 +81,16 @@ extern int _ideexi_version;
 #define ATA_IDENT_SECTORS	6			// number of sectors per track
 #define ATA_IDENT_SERIAL		10		// Drive serial (20 characters)
 #define ATA_IDENT_MODEL			27		// Drive model name (40 characters)
+#define ATA_IDENT_MULTIPLE		47		// Maximum sectors per DRQ block for READ/WRITE MULTIPLE (low byte)
 #define ATA_IDENT_LBASECTORS	60		// Number of sectors in LBA translation mode
 #define ATA_IDENT_COMMANDSET	83		// Command sets supported
 #define ATA_IDENT_LBA48SECTORS	100		// Number of sectors in LBA 48-bit mode
 #define ATA_IDENT_LBA48MASK		0x4		// Mask for LBA support in the command set top byte
 
+// Maximum sectors per command, a sector count of 0 selects these
+#define ATA_MAX_SECTORS_LBA28	256
+#define ATA_MAX_SECTORS_LBA48	65536
+
 // typedefs
 // drive info structure
 typedef struct 
@@ -91,6 +101,7 @@ typedef struct
 	u32  heads;		// per cylinder
 	u32  sectors;	// per track
 	int  lba48Support;
+	u32  multipleSectors;	// sectors per DRQ block, 0 if READ/WRITE MULTIPLE is unused
 	char model[48];
 	char serial[24];
 } typeDriveInfo;
@@ -178,12 +178,15 @@ s32 deviceHandler_FAT_readFile(file_handle* file, void* buffer, u32 length) {
 s32 deviceHandler_FAT_writeFile(file_handle* file, void* buffer, u32 length) {
 	if(!file->ffsFp) {
 		file->ffsFp = malloc(sizeof(FIL));
-		if(f_open(file->ffsFp, file->name, FA_CREATE_ALWAYS | FA_WRITE ) != FR_OK) {
+		// Only a write at the very end of a file the caller has read the size of appends to it
+		bool append = file->offset && file->offset == file->size;
+		if(f_open(file->ffsFp, file->name, (append ? FA_OPEN_EXISTING : FA_CREATE_ALWAYS) | FA_WRITE ) != FR_OK) {
 			free(file->ffsFp);
 			file->ffsFp = NULL;
 			return -1;
 		}
-		f_expand(file->ffsFp, file->offset + length, 1);
+		if(!append)
+			f_expand(file->ffsFp, file->offset + length, 1);
 	}
 	f_lseek(file->ffsFp, file->offset);
 	
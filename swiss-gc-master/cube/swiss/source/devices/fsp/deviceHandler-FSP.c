@@ -16,6 +16,7 @@
 #include "exi.h"
 #include "bba.h"
 #include "patcher.h"
+#include "prefetch.h"
 
 extern int net_initialized;
 static FSP_SESSION *fsp_session;
@@ -170,6 +171,8 @@ s32 deviceHandler_FSP_setupFile(file_handle* file, file_handle* file2, Executabl
 			// Device slot (0, 1 or 2)
 			*(vu8*)VAR_EXI_SLOT = (u8)(devices[DEVICE_PATCHES] == &__device_sd_a ? EXI_CHANNEL_0:(devices[DEVICE_PATCHES] == &__device_sd_b ? EXI_CHANNEL_1:EXI_CHANNEL_2));
 			*(vu32**)VAR_EXI_REGS = ((vu32(*)[5])0xCC006800)[*(vu8*)VAR_EXI_SLOT];
+			// Somewhere for the boot prefetch to keep what the game reads
+			prefetch_setup(&fragList, &numFrags);
 		}
 	}
 	
@@ -304,7 +307,7 @@ DEVICEHANDLER_INTERFACE __device_fsp = {
 	"Configurable via the settings screen",
 	{TEX_SAMBA, 140, 64, 140, 64},
 	FEAT_READ|FEAT_WRITE|FEAT_BOOT_GCM|FEAT_HYPERVISOR|FEAT_AUDIO_STREAMING,
-	EMU_READ|EMU_AUDIO_STREAMING,
+	EMU_READ|EMU_AUDIO_STREAMING|EMU_BOOT_PREFETCH,
 	LOC_SERIAL_PORT_1,
 	&initial_FSP,
 	(_fn_test)&deviceHandler_FSP_test,
@@ -174,78 +174,77 @@ s64 deviceHandler_CARD_seekFile(file_handle* file, s64 where, u32 type){
 	return file->offset;
 }
 
-int CARD_ReadUnaligned(card_file *cardfile, void *buffer, unsigned int length, unsigned int offset, int slot) {
-	void *dst = buffer;
-	u8 *read_buffer = (u8*)memalign(32,card_sectorsize[slot]);
-	int ret = CARD_ERROR_READY;
-	print_gecko("Unaligned read dst %08X offset %08X length %i\r\n", dst, offset, length);
-	// Unaligned because we're in the middle of a sector, read partial
-	ret = CARD_Read(cardfile, read_buffer, card_sectorsize[slot], offset-(offset&0x1ff));
-	print_gecko("CARD_Read offset %08X length %i\r\n", offset-(offset&0x1ff), card_sectorsize[slot]);
+// CARD_Read wants 512 byte aligned offsets/lengths and a 32 byte aligned buffer
+#define CARD_READ_ALIGN 512
+static u8 card_bounce[CARD_READ_ALIGN] __attribute__((aligned(32)));
+
+// Sometimes reads fail the first time stupidly, retry at least once.
+static s32 card_read_retry(card_file *cardfile, void *buffer, u32 length, u32 offset) {
+	s32 ret = CARD_Read(cardfile, buffer, length, offset);
+	if(ret == CARD_ERROR_BUSY) {
+		print_gecko("Read retry\r\n");
+		usleep(2000);
+		ret = CARD_Read(cardfile, buffer, length, offset);
+	}
+	return ret;
+}
+
+// Opens the file once and keeps the card_file around in file->fp until closeFile
+static s32 card_open_cached(file_handle* file, int slot, card_file **cardfile) {
+	if(file->fp) {
+		*cardfile = (card_file*)file->fp;
+		return CARD_ERROR_READY;
+	}
+	*cardfile = (card_file*)malloc(sizeof(card_file));
+	if(!*cardfile) {
+		return -1;
+	}
+	char *filename = getRelativeName(file->name);
+	s32 ret = CARD_Open(slot, filename, *cardfile);
+	print_gecko("Tried to open: [%s] in slot %s got res: %i\r\n",filename, slot ? "B":"A", ret);
 	if(ret != CARD_ERROR_READY) {
-		free(read_buffer);
+		free(*cardfile);
 		return ret;
 	}
+	file->fp = *cardfile;
+	return ret;
+}
 
-	int amountRead = card_sectorsize[slot]-(offset&0x1ff);
-	int amountToCopy = length > amountRead ? amountRead : length;
-	memcpy(dst, read_buffer+(offset&0x1ff), amountToCopy);
-	dst += amountToCopy;
-	length -= amountToCopy;
-	offset += amountToCopy;
-	if(length != 0) {
-		print_gecko("Unaligned read leftovers offset %08X length %i\r\n", offset, length);
-		// At least this will be aligned
-		ret = CARD_Read(cardfile, read_buffer, card_sectorsize[slot], offset);
-		print_gecko("CARD_Read offset %08X length %i\r\n", offset, card_sectorsize[slot]);
-		if(ret != CARD_ERROR_READY) {
-			free(read_buffer);
-			return ret;
-		}
-		memcpy(dst, read_buffer, length);
+s32 deviceHandler_CARD_closeFile(file_handle* file) {
+	int ret = 0;
+	if(file && file->fp) {
+		ret = CARD_Close((card_file*)file->fp);
+		free(file->fp);
+		file->fp = NULL;
 	}
-
-	free(read_buffer);
 	return ret;
 }
 
-
 s32 deviceHandler_CARD_readFile(file_handle* file, void* buffer, u32 length){
-	card_file cardfile;
+	card_file *cardfile;
 	void *dst = buffer;
 	card_dir* cd = (card_dir*)&file->other;
-	char *filename = getRelativeName(file->name);
-	unsigned int slot = (!strncmp((const char*)initial_CARDB.name, file->name, 7)), ret = 0;
+	unsigned int slot = (!strncmp((const char*)initial_CARDB.name, file->name, 7));
+	s32 ret = 0;
 
 	if(cd->company[0] == '\0' && cd->gamecode[0] == '\0') {
 		// Find the file we don't know about and populate this file_handle if we find it.
 		if(!findFile(file)) {
 			return CARD_ERROR_NOFILE;
 		}
-		CARD_SetCompany((const char*)cd->company);
-		CARD_SetGamecode((const char*)cd->gamecode);
-	} 
-	else {
-		CARD_SetCompany((const char*)cd->company);
-		CARD_SetGamecode((const char*)cd->gamecode);
 	}
+	CARD_SetCompany((const char*)cd->company);
+	CARD_SetGamecode((const char*)cd->gamecode);
 	int swissFile = !strncmp((const char*)cd->gamecode, "SWIS", 4)
 				 && !strncmp((const char*)cd->company, "S0", 2);
 	
 	// Open the file based on the slot & file name
-	ret = CARD_Open(slot,filename, &cardfile);
-
-	print_gecko("Tried to open: [%s] in slot %s got res: %i\r\n",filename, slot ? "B":"A", ret);
-
+	ret = card_open_cached(file, slot, &cardfile);
 	if(ret != CARD_ERROR_READY)	return ret;
 
-	u8 *read_buffer = (u8*)memalign(32,card_sectorsize[slot]);
-	if(!read_buffer) {
-		return -1;
-	}
-
 	/* Read from the file */
 	u32 amountRead = 0;
+	u32 fileEnd = file->size;
 	// If this file was put here by swiss, then skip the first 8192 bytes
 	if(swissFile && !isCopyGCIMode) {
 		print_gecko("Swiss copied file detected, skipping icon\r\n");
@@ -255,7 +254,7 @@ s32 deviceHandler_CARD_readFile(file_handle* file, void* buffer, u32 length){
 		// Write out a .GCI
 		card_stat cardstat;
 		GCI gci;
-		CARD_GetStatus(slot, cardfile.filenum, &cardstat);
+		CARD_GetStatus(slot, cardfile->filenum, &cardstat);
 		memset(&gci, 0, sizeof(GCI));
 		memcpy(&gci.gamecode,cardstat.gamecode,4);
 		memcpy(&gci.company,cardstat.company,2);
@@ -274,28 +273,30 @@ s32 deviceHandler_CARD_readFile(file_handle* file, void* buffer, u32 length){
 		dst+=sizeof(GCI);
 		length-=sizeof(GCI);
 		amountRead += sizeof(GCI);
+		fileEnd = cardstat.len;
 	}
-	while(length > 0 && file->offset < file->size) {
-		int readsize = length > card_sectorsize[slot] ? card_sectorsize[slot] : length;
+	while(length > 0 && file->offset < fileEnd) {
+		u32 offset = file->offset;
+		u32 readsize = (fileEnd - offset) < length ? (fileEnd - offset) : length;
 		print_gecko("Need to read: [%i] more bytes\r\n", length);
 		
-		if(file->offset&0x1ff) {
-			ret = CARD_ReadUnaligned(&cardfile, read_buffer, card_sectorsize[slot], file->offset, slot);
+		if(!(offset & (CARD_READ_ALIGN-1)) && !((u32)dst & 31) && readsize >= CARD_READ_ALIGN) {
+			// Whole sectors straight into the destination, one request for the run
+			readsize &= ~(CARD_READ_ALIGN-1);
+			ret = card_read_retry(cardfile, dst, readsize, offset);
+			print_gecko("Read: [%i] bytes ret [%i] from offset [%i]\r\n", readsize, ret, offset);
 		}
 		else {
-			ret = CARD_Read(&cardfile, read_buffer, card_sectorsize[slot], file->offset);
-			// Sometimes reads fail the first time stupidly, retry at least once.
-			print_gecko("Read: [%i] bytes ret [%i] from offset [%i]\r\n",card_sectorsize[slot],ret, file->offset);
-			if(ret == CARD_ERROR_BUSY) {
-				print_gecko("Read retry\r\n");
-				usleep(2000);
-				ret = CARD_Read(&cardfile, read_buffer, card_sectorsize[slot], file->offset);
+			// Unaligned head/tail, bounce one sector
+			u32 off = offset & (CARD_READ_ALIGN-1);
+			if(readsize > CARD_READ_ALIGN - off) {
+				readsize = CARD_READ_ALIGN - off;
 			}
+			ret = card_read_retry(cardfile, card_bounce, CARD_READ_ALIGN, offset - off);
+			if(ret == CARD_ERROR_READY)
+				memcpy(dst, card_bounce + off, readsize);
 		}
-		
-		if(ret == CARD_ERROR_READY)
-			memcpy(dst,read_buffer,readsize);
-		else 
+		if(ret != CARD_ERROR_READY)
 			return ret;
 		dst+=readsize;
 		file->offset += readsize;
@@ -306,9 +307,7 @@ s32 deviceHandler_CARD_readFile(file_handle* file, void* buffer, u32 length){
 	if(swissFile && length != 0) {
 		amountRead+= length;
 	}
-	DCFlushRange(dst, amountRead);
-	CARD_Close(&cardfile);
-	free(read_buffer);   
+	DCFlushRange(buffer, amountRead);
 
 	return amountRead;
 }
@@ -330,6 +329,11 @@ s32 deviceHandler_CARD_writeFile(file_handle* file, void* data, u32 length) {
 	
 	card_file cardfile;
 	unsigned int slot = (!strncmp((const char*)initial_CARDB.name, file->name, 7)), ret = 0;
+	if(!length) {
+		return 0;
+	}
+	// Drop any handle cached by readFile, the GCI may name a different file
+	deviceHandler_CARD_closeFile(file);
 	unsigned int adj_length = (length % 8192 == 0 ? length : (length + (8192-length%8192)))+8192;
 	char *filename = NULL;
 	char fname[CARD_FILENAMELEN+1];
@@ -379,13 +383,11 @@ s32 deviceHandler_CARD_writeFile(file_handle* file, void* data, u32 length) {
 	}
 	
 	// The file exists by now, write at offset.
-	int amount_written = 0;
-	while(amount_written != adj_length) {
-		ret = CARD_Write(&cardfile, tmpBuffer+amount_written, card_sectorsize[slot], file->offset);
-		file->offset += card_sectorsize[slot];
-		amount_written += card_sectorsize[slot];
-		print_gecko("Tried to write: [%s] in slot %s got res: %i\r\n",filename, slot ? "B":"A", ret);
-		if(ret != CARD_ERROR_READY) break;
+	// CARD_Write erases and programs every erase block in the run, so hand it the whole batch.
+	ret = CARD_Write(&cardfile, tmpBuffer, adj_length, file->offset);
+	print_gecko("Tried to write: [%s] in slot %s got res: %i\r\n",filename, slot ? "B":"A", ret);
+	if(ret == CARD_ERROR_READY) {
+		file->offset += adj_length;
 	}
 	
 	card_stat cardstat;
@@ -478,6 +480,7 @@ s32 deviceHandler_CARD_init(file_handle* file){
 }
 
 s32 deviceHandler_CARD_deinit(file_handle* file) {
+	deviceHandler_CARD_closeFile(file);
 	if(file) {
 		int slot = (!strncmp((const char*)initial_CARDB.name, file->name, 7));
 		card_init[slot] = 0;
@@ -504,6 +507,7 @@ s32 deviceHandler_CARD_deleteFile(file_handle* file) {
 		CARD_SetGamecode((const char*)cd->gamecode);
 	}
 	print_gecko("Deleting: %s from slot %i\r\n", filename, slot);
+	deviceHandler_CARD_closeFile(file);
 	
 	int ret = CARD_Delete(slot, filename);
 	if(ret != CARD_ERROR_READY) {
@@ -519,10 +523,6 @@ s32 deviceHandler_CARD_renameFile(file_handle* file, char* name) {
 	return 0;	// TODO Implement
 }
 
-s32 deviceHandler_CARD_closeFile(file_handle* file) {
-    return 0;
-}
-
 bool deviceHandler_CARD_test_a() {
 	s32 memSize = 0, sectSize = 0;
 	return ((initialize_card(0)==CARD_ERROR_READY) && (CARD_ProbeEx(0, &memSize,&sectSize)==CARD_ERROR_READY));
@@ -8,6 +8,7 @@
 #include <malloc.h>
 #include <ogc/dvd.h>
 #include <ogc/machine/processor.h>
+#include <ogc/lwp_watchdog.h>
 #include <sdcard/gcsd.h>
 #include "deviceHandler.h"
 #include "gui/FrameBufferMagic.h"
@@ -38,6 +39,27 @@ struct qoobEntryHeader {
 
 char iplBlock[256] __attribute__((aligned(32)));
 
+#define QOOB_FLASH_SIZE (0x200000)
+#define QOOB_NUM_BLOCKS (QOOB_FLASH_SIZE / QOOB_BLOCK_SIZE)
+
+// Allocation state of every 64KB block, built once per session
+#define QOOB_BLOCK_EMPTY 0
+#define QOOB_BLOCK_USED  1
+static u8 qoobBlockMap[QOOB_NUM_BLOCKS];
+static bool qoobBlockMapValid = false;
+
+static void qoob_map_entry(u32 block, u32 entry_type, u32 num_blocks) {
+	u32 i, idx = block / QOOB_BLOCK_SIZE;
+	if(entry_type == 0xFFFFFFFF) {
+		qoobBlockMap[idx] = QOOB_BLOCK_EMPTY;
+		return;
+	}
+	if(!num_blocks) num_blocks = 1;
+	for(i = 0; i < num_blocks && idx + i < QOOB_NUM_BLOCKS; i++) {
+		qoobBlockMap[idx + i] = QOOB_BLOCK_USED;
+	}
+}
+
 file_handle initial_Qoob =
 	{ "qoob:/",       // directory
 	  0ULL,     // fileBase (u64)
@@ -155,16 +177,19 @@ s32 deviceHandler_Qoob_readDir(file_handle* ffile, file_handle** dir, u32 type)
 				++i;
 				
 				print_gecko("Found [%08X] entry, %08X in size\r\n", entryHeader.entry_type, entryHeader.num_blocks);
+				qoob_map_entry(block, entryHeader.entry_type, entryHeader.num_blocks);
 				block += (entryHeader.num_blocks * QOOB_BLOCK_SIZE);
 				break;
 			}
 			default:
 				print_gecko("unknown/empty block found at %08X [%08X]\r\n", block, entryHeader.entry_type);
+				qoob_map_entry(block, entryHeader.entry_type, 1);
 				block += QOOB_BLOCK_SIZE;
 				break;
 		}
 	}
 	initial_Qoob_info.freeSpace = initial_Qoob_info.totalSpace - usedSpace;
+	qoobBlockMapValid = true;
 	DrawDispose(msgBox);
 	return num_entries;
 }
@@ -187,88 +212,330 @@ s32 deviceHandler_Qoob_readFile(file_handle* file, void* buffer, u32 length) {
 extern unsigned char rom_read(int addr);
 extern void rom_write(int addr, unsigned char c);
 
-int erase_sector(int addr)
-{
+// Flash geometry and program mode, probed via CFI once per session
+typedef struct {
+	u32 numBlocks;
+	u32 blockSize;
+} qoobEraseRegion;
+
+static struct {
+	bool probed;
+	bool cfi;
+	u32 writeBuffer;		// bytes per Write to Buffer command, 1 if unsupported
+	int numRegions;
+	qoobEraseRegion regions[4];
+} qoobFlash;
+
+static void qoob_flash_reset() {
+	rom_write(0, 0xF0);
+}
+
+static void qoob_flash_unlock() {
 	rom_write(0xAAA, 0xAA);
 	rom_write(0x555, 0x55);
+}
+
+static u16 qoob_cfi_read16(int addr) {
+	return rom_read(addr) | (rom_read(addr + 2) << 8);
+}
+
+static void qoob_flash_probe() {
+	if(qoobFlash.probed) return;
+	memset(&qoobFlash, 0, sizeof(qoobFlash));
+	qoobFlash.probed = true;
+	qoobFlash.writeBuffer = 1;
+	
+	// CFI query, byte mode addresses
+	qoob_flash_reset();
+	rom_write(0xAA, 0x98);
+	if(rom_read(0x20) == 'Q' && rom_read(0x22) == 'R' && rom_read(0x24) == 'Y') {
+		int i;
+		qoobFlash.cfi = true;
+		// Write to Buffer is an AMD/Spansion command set feature
+		u16 cmdSet = qoob_cfi_read16(0x26);
+		u8 bufferBits = rom_read(0x54);
+		if(cmdSet == 0x0002 && bufferBits > 0) {
+			// The word count is a single byte on an 8 bit bus
+			qoobFlash.writeBuffer = 1 << (bufferBits > 8 ? 8 : bufferBits);
+		}
+		u32 total = 0;
+		bool fits = true;
+		qoobFlash.numRegions = rom_read(0x58);
+		if(qoobFlash.numRegions > 4) qoobFlash.numRegions = 4;
+		for(i = 0; i < qoobFlash.numRegions; i++) {
+			qoobFlash.regions[i].numBlocks = qoob_cfi_read16(0x5A + i*8) + 1;
+			qoobFlash.regions[i].blockSize = qoob_cfi_read16(0x5E + i*8) * 256;
+			if(!qoobFlash.regions[i].blockSize) qoobFlash.regions[i].blockSize = 128;
+			// A block is read back whole into a QOOB_BLOCK_SIZE buffer
+			if(qoobFlash.regions[i].blockSize > QOOB_BLOCK_SIZE) fits = false;
+			total += qoobFlash.regions[i].numBlocks * qoobFlash.regions[i].blockSize;
+		}
+		// Older top boot parts list their regions bottom up, flip them like Linux does
+		u16 ext = qoob_cfi_read16(0x2A) * 2;
+		int last = qoobFlash.numRegions - 1;
+		if(ext && rom_read(ext) == 'P' && rom_read(ext + 0x1E) == 3 && last > 0
+			&& qoobFlash.regions[0].blockSize < qoobFlash.regions[last].blockSize) {
+			for(i = 0; i < last - i; i++) {
+				qoobEraseRegion tmp = qoobFlash.regions[i];
+				qoobFlash.regions[i] = qoobFlash.regions[last - i];
+				qoobFlash.regions[last - i] = tmp;
+			}
+		}
+		// Fall back to the stock layout if the geometry doesn't add up
+		if(total != QOOB_FLASH_SIZE || !fits) {
+			qoobFlash.numRegions = 0;
+		}
+	}
+	qoob_flash_reset();
+	print_gecko("Qoob flash: CFI %s, write buffer %i bytes, %i erase regions\r\n",
+		qoobFlash.cfi ? "found" : "missing", qoobFlash.writeBuffer, qoobFlash.numRegions);
+}
+
+// Returns the erase block containing addr
+static void qoob_flash_block(u32 addr, u32 *start, u32 *size) {
+	int i;
+	u32 base = 0;
+	for(i = 0; i < qoobFlash.numRegions; i++) {
+		u32 regionSize = qoobFlash.regions[i].numBlocks * qoobFlash.regions[i].blockSize;
+		if(addr < base + regionSize) {
+			*size = qoobFlash.regions[i].blockSize;
+			*start = base + ((addr - base) / *size) * *size;
+			return;
+		}
+		base += regionSize;
+	}
+	// Bottom boot layout of the stock chip: 16K, 8K, 8K, 32K, then 64K blocks
+	if(addr >= 0x10000) {
+		*start = addr & ~0xFFFF;
+		*size = 0x10000;
+	}
+	else if(addr >= 0x8000) {
+		*start = 0x8000;
+		*size = 0x8000;
+	}
+	else if(addr >= 0x4000) {
+		*start = addr & ~0x1FFF;
+		*size = 0x2000;
+	}
+	else {
+		*start = 0;
+		*size = 0x4000;
+	}
+}
+
+// Worst case for a block erase, programs are far quicker
+#define QOOB_FLASH_TIMEOUT (20*1000)
+
+// Waits for an embedded erase/program operation to finish (DQ6 stops toggling), false if it never does
+static bool qoob_flash_wait(int addr) {
+	u64 startTime = gettime();
+	while (rom_read(addr) != rom_read(addr)) {
+		if(diff_msec(startTime, gettime()) > QOOB_FLASH_TIMEOUT) return false;
+	}
+	return true;
+}
+
+// Waits for a programmed byte to read back, false if it never does
+static bool qoob_flash_wait_data(int addr, u8 data) {
+	u64 startTime = gettime();
+	while (rom_read(addr) != data) {
+		if(diff_msec(startTime, gettime()) > QOOB_FLASH_TIMEOUT) return false;
+	}
+	return true;
+}
+
+static bool qoob_flash_erase_block(u32 addr) {
+	qoob_flash_unlock();
 	rom_write(0xAAA, 0x80);
-	rom_write(0xAAA, 0xAA);
-	rom_write(0x555, 0x55);
+	qoob_flash_unlock();
 	rom_write(addr, 0x30);
-	printf("\r%08x erase..\n", addr);
-	while (rom_read(addr) != rom_read(addr));
-	return 0;
+	print_gecko("erase_sector(%08X)\r\n", addr);
+	return qoob_flash_wait(addr);
 }
 
-int is_eraseblock(int addr)
-{
-	if (addr >= 0x10000)
-		return !(addr & 0xFFFF);
-	return ((addr == 0) || (addr == 0x4000) || (addr == 0x6000) || (addr == 0x8000));
+// Programs the bytes of data that differ from cur, which must only need 1 -> 0 bit changes.
+// Returns false if the chip stopped responding, the caller has to reset it.
+static bool qoob_flash_program(u32 addr, const u8 *data, const u8 *cur, u32 len) {
+	u32 i = 0;
+	if(qoobFlash.writeBuffer > 1) {
+		while(i < len) {
+			if(data[i] == cur[i]) {
+				i++;
+				continue;
+			}
+			// Fill up to the end of this write buffer page
+			u32 end = ((addr + i) | (qoobFlash.writeBuffer - 1)) + 1 - addr;
+			if(end > len) end = len;
+			u32 start = i, j;
+			while(end > start && data[end-1] == cur[end-1]) end--;
+			u32 sector, sectorSize;
+			qoob_flash_block(addr + start, &sector, &sectorSize);
+			qoob_flash_unlock();
+			rom_write(sector, 0x25);
+			rom_write(sector, end - start - 1);
+			for(j = start; j < end; j++) {
+				rom_write(addr + j, data[j]);
+			}
+			rom_write(sector, 0x29);
+			if(!qoob_flash_wait_data(addr + end - 1, data[end-1])) {
+				return false;
+			}
+			i = end;
+		}
+		return true;
+	}
+	// Unlock bypass, two bus cycles per byte
+	qoob_flash_unlock();
+	rom_write(0xAAA, 0x20);
+	bool ok = true;
+	for(; i < len; i++) {
+		if(data[i] == cur[i]) continue;
+		rom_write(addr + i, 0xA0);
+		rom_write(addr + i, data[i]);
+		if(!qoob_flash_wait_data(addr + i, data[i])) {
+			ok = false;
+			break;
+		}
+	}
+	rom_write(0, 0x90);
+	rom_write(0, 0x00);
+	return ok;
+}
+
+static bool qoob_is_erased(const u8 *buf, u32 len) {
+	while(len--) {
+		if(*buf++ != 0xFF) return false;
+	}
+	return true;
 }
 
 int erase_qoob_rom(u32 dest, int len)
 {
-	rom_write(0xAAA, 0xAA); rom_write(0x555, 0x55); rom_write(0xAAA, 0x20);
-	int addr;
+	qoob_flash_probe();
+	u8 *cur = memalign(32, QOOB_BLOCK_SIZE);
+	if(!cur) return -1;
+	int ret = 0;
+	u32 addr = dest;
 	print_gecko("erasing...\r\n");
-	for (addr = dest; addr < (dest + len); ++addr) {
-		if (is_eraseblock(addr)) {
-			print_gecko("erase_sector(%08X)\r\n", addr);
-			erase_sector(addr);
+	while (addr < dest + len) {
+		u32 start, size;
+		qoob_flash_block(addr, &start, &size);
+		// Only whole blocks starting in the range get erased
+		if(start == addr) {
+			__SYS_ReadROM(cur, size, start);
+			if(!qoob_is_erased(cur, size) && !qoob_flash_erase_block(start)) {
+				print_gecko("erase timed out in block %08X\r\n", start);
+				ret = -1;
+				break;
+			}
 		}
+		addr = start + size;
 	}
-	return 0;
+	qoob_flash_reset();
+	free(cur);
+	return ret;
 }
 
+// Writes len bytes at dest, one erase block at a time. Blocks that already hold the data
+// are left alone, blocks that only need bits cleared are programmed without an erase and
+// anything else in an erased block outside the range is written back.
 int write_qoob_rom(unsigned char *src, u32 dest, int len)
 {
 	print_gecko("Writing %08X to dest %08X with length %i\r\n", src, dest, len);
-	// CFI query
-	rom_write(0xAA, 0x98);
-
-	print_gecko("CFI data:\r\n");
-	int addr;
-	for (addr = 0; addr < 0x100; addr += 0x10)
-	{
-		int i;
-		for (i=0; i<0x10; i += 2)
-			print_gecko("%02x ", rom_read(addr + i));
-
-		for (i=0; i<0x10; i += 2)
-		{
-			int v = rom_read(addr + i);
-			print_gecko("%c", v >= 0x20 ? v : '.');
-		}
-		print_gecko("\r\n");
-	}
+	qoob_flash_probe();
 	
-	print_gecko("man id:\r\n");
-	int i;
-	for (i=0; i<10; ++i)
-	{
-		rom_write(0, 0xF0);
-		rom_write(0xAAA, 0xAA); rom_write(0x555, 0x55); rom_write(0xAAA, 0x90);
-		print_gecko("%02x ", rom_read(i * 2));
+	u8 *cur = memalign(32, QOOB_BLOCK_SIZE);
+	u8 *target = memalign(32, QOOB_BLOCK_SIZE);
+	if(!cur || !target) {
+		free(cur);
+		free(target);
+		return -1;
 	}
-	print_gecko("\r\n");
-	
-	erase_qoob_rom(dest, len);
-	
-	print_gecko("flashing...\r\n");
-	while (len)
-	{
-		rom_write(dest, 0xA0);
-		rom_write(dest, *src);
-		while (rom_read(dest) != *src);
-		++src;
-		++dest;
-		--len;
+	int ret = 0;
+	u32 addr = dest, end = dest + len;
+	while (addr < end) {
+		u32 start, size, i;
+		qoob_flash_block(addr, &start, &size);
+		u32 lo = addr - start;
+		u32 hi = (end < start + size ? end : start + size) - start;
+		
+		__SYS_ReadROM(cur, size, start);
+		memcpy(target, cur, size);
+		memcpy(target + lo, src + (addr - dest), hi - lo);
+		if(memcmp(cur + lo, target + lo, hi - lo)) {
+			bool needsErase = false;
+			for(i = lo; i < hi; i++) {
+				if((cur[i] & target[i]) != target[i]) {
+					needsErase = true;
+					break;
+				}
+			}
+			bool ok;
+			if(needsErase) {
+				ok = qoob_flash_erase_block(start);
+				if(ok) {
+					memset(cur, 0xFF, size);
+					ok = qoob_flash_program(start, target, cur, size);
+				}
+			}
+			else {
+				ok = qoob_flash_program(start + lo, target + lo, cur + lo, hi - lo);
+			}
+			qoob_flash_reset();
+			if(!ok) {
+				print_gecko("timed out in block %08X\r\n", start);
+				ret = -1;
+				break;
+			}
+			
+			// Verify what ended up in the block
+			__SYS_ReadROM(cur, size, start);
+			if(memcmp(cur, target, size)) {
+				print_gecko("verify failed in block %08X\r\n", start);
+				ret = -1;
+				break;
+			}
+		}
+		else {
+			print_gecko("block %08X unchanged\r\n", start);
+		}
+		addr = start + hi;
 	}
+	free(cur);
+	free(target);
 	print_gecko("done!\r\n");
-	return 0;
+	return ret;
 }
 
+// Fills in the block map by reading the entry header of every allocation unit.
+static void qoob_build_block_map() {
+	u32 block = 0;
+	qoobEntryHeader entryHeader;
+	while(block < QOOB_FLASH_SIZE) {
+		__SYS_ReadROM(iplBlock, sizeof(qoobEntryHeader), block);
+		memcpy(&entryHeader, &iplBlock, sizeof(qoobEntryHeader));
+		switch(entryHeader.entry_type) {
+			case QOOB_FILE_APPL:
+			case QOOB_FILE_BIOS:
+			case QOOB_FILE_QPIC:
+			case QOOB_FILE_QCFG:
+			case QOOB_FILE_QCHT:
+			case QOOB_FILE_QCHE:
+			case QOOB_FILE_BIN:	
+			case QOOB_FILE_DOL:	
+			case QOOB_FILE_ELF:	
+			case QOOB_FILE_SWIS:
+				qoob_map_entry(block, entryHeader.entry_type, entryHeader.num_blocks);
+				block += (entryHeader.num_blocks ? entryHeader.num_blocks : 1) * QOOB_BLOCK_SIZE;
+				break;
+			default:
+				qoob_map_entry(block, entryHeader.entry_type, 1);
+				block += QOOB_BLOCK_SIZE;
+				break;
+		}
+	}
+	qoobBlockMapValid = true;
+}
 
 // Assumes a single call to write a file.
 s32 deviceHandler_Qoob_writeFile(file_handle* file, void* buffer, u32 length) {
@@ -276,71 +543,29 @@ s32 deviceHandler_Qoob_writeFile(file_handle* file, void* buffer, u32 length) {
 
 	if(!file->fileBase) {
 		// check for enough contiguous blocks because files can only be contiguous
-		u32 block = 0;
+		u32 i, run = 0;
 		u32 largestEmptyBlock = 0;
 		u32 largestEmptyBlockSize = 0;
-		u32 emptyBlock = 0;
-		u32 emptyBlockSize = 0;
 		
-		while(block <0x200000) {
-			memset(iplBlock, 0, 256);
-			__SYS_ReadROM(iplBlock,sizeof(qoobEntryHeader),block);
-			qoobEntryHeader entryHeader;
-			memcpy(&entryHeader, &iplBlock, sizeof(qoobEntryHeader));
-			print_gecko("Checking block at %08X\r\n", block);
-			switch(entryHeader.entry_type) {
-				case QOOB_FILE_APPL:
-				case QOOB_FILE_BIOS:
-				case QOOB_FILE_QPIC:
-				case QOOB_FILE_QCFG:
-				case QOOB_FILE_QCHT:
-				case QOOB_FILE_QCHE:
-				case QOOB_FILE_BIN:	
-				case QOOB_FILE_DOL:	
-				case QOOB_FILE_ELF:	
-				case QOOB_FILE_SWIS:
-					if(emptyBlock) {
-						if(emptyBlockSize > largestEmptyBlockSize) {
-							largestEmptyBlock = emptyBlock;
-							largestEmptyBlockSize = emptyBlockSize;
-							print_gecko("Largest empty block so far is %08X with size %08X\r\n", largestEmptyBlock, largestEmptyBlockSize);
-						}
-						emptyBlock = 0;
-						emptyBlockSize = 0;
-					}
-					print_gecko("Found [%08X] entry, %08X in size\r\n", entryHeader.entry_type, entryHeader.num_blocks);
-					block += (entryHeader.num_blocks * QOOB_BLOCK_SIZE);
-					break;
-				case 0xFFFFFFFF:
-					print_gecko("empty block found at %08X [%08X]\r\n", block, entryHeader.entry_type);
-					if(!emptyBlock) {
-						emptyBlock = block;
-					}
-					emptyBlockSize += QOOB_BLOCK_SIZE;
-					block += QOOB_BLOCK_SIZE;
-					break;
-				default:
-					print_gecko("unknown block found at %08X [%08X]\r\n", block, entryHeader.entry_type);
-					if(emptyBlock) {
-						if(emptyBlockSize > largestEmptyBlockSize) {
-							largestEmptyBlock = emptyBlock;
-							largestEmptyBlockSize = emptyBlockSize;
-							print_gecko("Largest empty block so far is %08X with size %08X\r\n", largestEmptyBlock, largestEmptyBlockSize);
-						}
-						emptyBlock = 0;
-						emptyBlockSize = 0;
-					}
-					block += QOOB_BLOCK_SIZE;
-					break;
-			}
+		if(!qoobBlockMapValid) {
+			qoob_build_block_map();
 		}
-		// If we were looking at an empty block but didn't terminate it:
-		if(emptyBlock) {
-			if(emptyBlockSize > largestEmptyBlockSize) {
-				largestEmptyBlock = emptyBlock;
-				largestEmptyBlockSize = emptyBlockSize;
-				print_gecko("Largest empty block so far is %08X with size %08X\r\n", largestEmptyBlock, largestEmptyBlockSize);
+		for(i = 0; i <= QOOB_NUM_BLOCKS; i++) {
+			if(i < QOOB_NUM_BLOCKS && qoobBlockMap[i] == QOOB_BLOCK_EMPTY) {
+				run++;
+				continue;
 			}
+			// A fileBase of 0 means "not allocated", so never hand out block 0
+			u32 runStart = (i - run) * QOOB_BLOCK_SIZE;
+			if(run && !runStart) {
+				runStart += QOOB_BLOCK_SIZE;
+				run--;
+			}
+			if(run && run * QOOB_BLOCK_SIZE > largestEmptyBlockSize) {
+				largestEmptyBlock = runStart;
+				largestEmptyBlockSize = run * QOOB_BLOCK_SIZE;
+			}
+			run = 0;
 		}
 		if(largestEmptyBlock) {
 			print_gecko("Largest empty block found at %08X with size %08X\r\n", largestEmptyBlock, largestEmptyBlockSize);
@@ -361,18 +586,27 @@ s32 deviceHandler_Qoob_writeFile(file_handle* file, void* buffer, u32 length) {
 		entryHeader.entry_type = endsWith(file->name,".dol") ? QOOB_FILE_ELF /*yes, these go in as "ELF" */ : QOOB_FILE_SWIS;
 		entryHeader.num_blocks = (length >> 16) + (length % (QOOB_BLOCK_SIZE-1) > 0 ? 1 : 0);
 		snprintf(&entryHeader.entry_name[0], 64, "%s", getRelativeName(file->name));
-		write_qoob_rom((unsigned char*)&entryHeader, file->fileBase, sizeof(qoobEntryHeader));
+		if(write_qoob_rom((unsigned char*)&entryHeader, file->fileBase, sizeof(qoobEntryHeader))) {
+			return -1;
+		}
+		qoob_map_entry(file->fileBase, entryHeader.entry_type, entryHeader.num_blocks);
 	}	
 	
 	// Write the file out
-	s32 written = write_qoob_rom((unsigned char*)buffer, file->fileBase + sizeof(qoobEntryHeader), length);
+	s32 written = write_qoob_rom((unsigned char*)buffer, file->fileBase + sizeof(qoobEntryHeader) + file->offset, length);
 	file->size += length;
 	file->offset += length;
 	return !written ? length : -1;
 }
 
 s32 deviceHandler_Qoob_deleteFile(file_handle* file) {
-	erase_qoob_rom(file->fileBase, file->size);
+	if(erase_qoob_rom(file->fileBase, file->size)) {
+		return -1;
+	}
+	u32 block;
+	for(block = file->fileBase; block < file->fileBase + file->size; block += QOOB_BLOCK_SIZE) {
+		qoob_map_entry(block, 0xFFFFFFFF, 1);
+	}
 	return 0;
 }
 
@@ -413,6 +647,8 @@ s32 deviceHandler_Qoob_init(file_handle* file) {
 }
 
 s32 deviceHandler_Qoob_deinit(file_handle* file) {
+	qoobBlockMapValid = false;
+	qoobFlash.probed = false;
 	ipl_set_config(6);
 	return 0;
 }
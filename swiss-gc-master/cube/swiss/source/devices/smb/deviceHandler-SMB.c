@@ -22,11 +22,15 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <malloc.h>
 #include <network.h>
 #include <ogcsys.h>
 #include <smb.h>
 #include <sys/dir.h>
+#include <sys/iosupport.h>
+#include <limits.h>
+#include <sys/param.h>
 #include <sys/statvfs.h>
 #include <sys/stat.h>
 #include "swiss.h"
@@ -43,6 +47,17 @@
 extern int net_initialized;
 int smb_initialized = 0;
 
+// Read-ahead window and write coalescing for an open file, kept in file->fp
+#define SMB_BUFFER_SIZE (64*1024)
+
+typedef struct {
+	int fd;
+	bool write;
+	u32 offset;		// File offset of buffer[0]
+	u32 length;		// Bytes valid for reads, or waiting to be written
+	u8 buffer[SMB_BUFFER_SIZE] __attribute__((aligned(32)));
+} smb_file;
+
 file_handle initial_SMB =
 	{ "smb:/", // file name
 	  0ULL,      // discoffset (u64)
@@ -92,45 +107,57 @@ void init_samba() {
 }
 
 s32 deviceHandler_SMB_readDir(file_handle* ffile, file_handle** dir, u32 type){	
-   	
-	DIR* dp = opendir( ffile->name );
-	if(!dp) return -1;
-	struct dirent *entry;
+	
+	// Walk the devoptab directly rather than through readdir, dirnext hands
+	// back the size and mode from the FIND listing so no entry needs a stat
+	const devoptab_t* dotab = GetDeviceOpTab(ffile->name);
+	if(!dotab || !dotab->diropen_r) return -1;
+	DIR_ITER dirState = { .device = FindDevice(ffile->name), .dirStruct = malloc(dotab->dirStateSize) };
+	if(!dirState.dirStruct) return -1;
+	if(!dotab->diropen_r(_REENT, &dirState, ffile->name)) {
+		free(dirState.dirStruct);
+		return -1;
+	}
+	char filename[NAME_MAX+1];
 	struct stat fstat;
 	
 	// Set everything up to read
 	int num_entries = 1, i = 1;
-	*dir = malloc( num_entries * sizeof(file_handle) );
-	memset(*dir,0,sizeof(file_handle) * num_entries);
+	*dir = calloc(sizeof(file_handle), num_entries);
 	concat_path((*dir)[0].name, ffile->name, "..");
 	(*dir)[0].fileAttrib = IS_SPECIAL;
 	
 	// Read each entry of the directory
-	while( (entry = readdir(dp)) != NULL ){
-		if(!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+	while( !dotab->dirnext_r(_REENT, &dirState, filename, &fstat) ){
+		if(!strcmp(filename, ".") || !strcmp(filename, "..")) {
 			continue;
 		}
 		// Do we want this one?
-		if((type == -1 || ((entry->d_type == DT_DIR) ? (type==IS_DIR) : (type==IS_FILE)))) {
-			if(entry->d_type == DT_REG) {
-				if(!checkExtension(entry->d_name)) continue;
+		if((type == -1 || (S_ISDIR(fstat.st_mode) ? (type==IS_DIR) : (type==IS_FILE)))) {
+			if(!S_ISDIR(fstat.st_mode)) {
+				if(!checkExtension(filename)) continue;
 			}
-			// Make sure we have room for this one
+			// Make sure we have room for this one, growing geometrically
 			if(i == num_entries){
-				++num_entries;
+				num_entries *= 2;
 				*dir = realloc( *dir, num_entries * sizeof(file_handle) ); 
 			}
 			memset(&(*dir)[i], 0, sizeof(file_handle));
-			concat_path((*dir)[i].name, ffile->name, entry->d_name);
-			stat((*dir)[i].name, &fstat);
+			concat_path((*dir)[i].name, ffile->name, filename);
 			(*dir)[i].size       = fstat.st_size;
 			(*dir)[i].fileAttrib = S_ISDIR(fstat.st_mode) ? IS_DIR : IS_FILE;
 			++i;
 		}
 	}
 	
-	closedir(dp);
-	return num_entries;
+	dotab->dirclose_r(_REENT, &dirState);
+	free(dirState.dirStruct);
+	
+	// Give back the slack
+	if(i != num_entries) {
+		*dir = realloc( *dir, i * sizeof(file_handle) );
+	}
+	return i;
 }
 
 s64 deviceHandler_SMB_seekFile(file_handle* file, s64 where, u32 type){
@@ -140,32 +167,109 @@ s64 deviceHandler_SMB_seekFile(file_handle* file, s64 where, u32 type){
 	return file->offset;
 }
 
-s32 deviceHandler_SMB_readFile(file_handle* file, void* buffer, u32 length){
-	if(!file->fp) {
-		file->fp = fopen(file->name, "rb");
+static s32 smb_flush(smb_file* sf) {
+	if(!sf->write || !sf->length) {
+		return 0;
 	}
-	if(!file->fp) return -1;
-	if(file->size <= 0) {
-		fseek(file->fp, 0, SEEK_END);
-		file->size = ftell(file->fp);
+	u32 length = sf->length;
+	sf->length = 0;
+	if(lseek(sf->fd, sf->offset, SEEK_SET) != sf->offset || write(sf->fd, sf->buffer, length) != length) {
+		return -1;
 	}
+	return 0;
+}
+
+s32 deviceHandler_SMB_closeFile(file_handle* file);
+
+static smb_file* smb_open(file_handle* file, bool write) {
+	smb_file* sf = file->fp;
+	if(sf && sf->write != write) {
+		deviceHandler_SMB_closeFile(file);
+		sf = NULL;
+	}
+	if(!sf) {
+		sf = memalign(32, sizeof(smb_file));
+		if(!sf) return NULL;
+		sf->fd = open(file->name, write ? O_WRONLY|O_CREAT|O_TRUNC : O_RDONLY, 0666);
+		if(sf->fd < 0) {
+			free(sf);
+			return NULL;
+		}
+		sf->write = write;
+		sf->offset = 0;
+		sf->length = 0;
+		file->fp = sf;
+		if(!write) {
+			file->size = lseek(sf->fd, 0, SEEK_END);
+		}
+	}
+	return sf;
+}
+
+s32 deviceHandler_SMB_readFile(file_handle* file, void* buffer, u32 length){
+	smb_file* sf = smb_open(file, false);
+	if(!sf) return -1;
 	
-	fseek(file->fp, file->offset, SEEK_SET);
-	size_t bytes_read = fread(buffer, 1, length, file->fp);
-	file->offset = ftell(file->fp);
-	return bytes_read;
+	u32 done = 0;
+	while(done < length) {
+		// Serve what we can from the read-ahead window
+		if(file->offset >= sf->offset && file->offset < sf->offset + sf->length) {
+			u32 size = MIN(length - done, sf->offset + sf->length - file->offset);
+			memcpy((u8*)buffer + done, &sf->buffer[file->offset - sf->offset], size);
+			file->offset += size;
+			done += size;
+			continue;
+		}
+		// Big reads go straight to the caller, small ones refill the window
+		if(lseek(sf->fd, file->offset, SEEK_SET) != file->offset) break;
+		if(length - done >= SMB_BUFFER_SIZE) {
+			ssize_t ret = read(sf->fd, (u8*)buffer + done, length - done);
+			if(ret <= 0) break;
+			file->offset += ret;
+			done += ret;
+		}
+		else {
+			ssize_t ret = read(sf->fd, sf->buffer, SMB_BUFFER_SIZE);
+			sf->offset = file->offset;
+			sf->length = ret > 0 ? ret : 0;
+			if(ret <= 0) break;
+		}
+	}
+	return done;
 }
 
 s32 deviceHandler_SMB_writeFile(file_handle* file, void* buffer, u32 length){
-	if(!file->fp) {
-		file->fp = fopen(file->name, "wb");
+	smb_file* sf = smb_open(file, true);
+	if(!sf) return -1;
+	if(!length) {
+		return smb_flush(sf);
 	}
-	if(!file->fp) return -1;
 	
-	fseek(file->fp, file->offset, SEEK_SET);
-	size_t bytes_written = fwrite(buffer, 1, length, file->fp);
-	file->offset = ftell(file->fp);
-	return bytes_written;
+	// Only contiguous writes get coalesced
+	if(sf->length && file->offset != sf->offset + sf->length) {
+		if(smb_flush(sf)) return -1;
+	}
+	u32 done = 0;
+	while(done < length) {
+		if(!sf->length) {
+			sf->offset = file->offset;
+			if(length - done >= SMB_BUFFER_SIZE) {
+				if(lseek(sf->fd, file->offset, SEEK_SET) != file->offset) break;
+				ssize_t ret = write(sf->fd, (u8*)buffer + done, length - done);
+				if(ret <= 0) break;
+				file->offset += ret;
+				done += ret;
+				continue;
+			}
+		}
+		u32 size = MIN(length - done, SMB_BUFFER_SIZE - sf->length);
+		memcpy(&sf->buffer[sf->length], (u8*)buffer + done, size);
+		sf->length += size;
+		file->offset += size;
+		done += size;
+		if(sf->length == SMB_BUFFER_SIZE && smb_flush(sf)) return -1;
+	}
+	return done;
 }
 
 s32 deviceHandler_SMB_init(file_handle* file) {
@@ -196,7 +300,10 @@ s32 deviceHandler_SMB_init(file_handle* file) {
 s32 deviceHandler_SMB_closeFile(file_handle* file) {
 	int ret = 0;
 	if(file && file->fp) {
-		ret = fclose(file->fp);
+		smb_file* sf = file->fp;
+		ret = smb_flush(sf);
+		if(close(sf->fd) && !ret) ret = -1;
+		free(sf);
 		file->fp = NULL;
 	}
 	return ret;
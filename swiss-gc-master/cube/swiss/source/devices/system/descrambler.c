@@ -0,0 +1,135 @@
+/* descrambler.c
+	- bootrom IPL descrambler
+ */
+
+#include <stdbool.h>
+#include <gctypes.h>
+#include "descrambler.h"
+
+// bootrom descrambler reversed by segher
+// Copyright 2008 Segher Boessenkool <segher@kernel.crashing.org>
+//
+// The keystream covers 0x100-0x1AFF00 and never changes, so the LFSR state is
+// recorded every DESCRAMBLER_CHECKPOINT bytes as it is first generated, and
+// any later read starts from the nearest one instead of from the top.
+#define DESCRAMBLER_START		0x100
+#define DESCRAMBLER_END			0x1AFF00
+#define DESCRAMBLER_CHECKPOINT	0x2000
+
+typedef struct {
+	u16 t, u, v;
+	u8 x;
+} descrambler_state;
+
+static descrambler_state descrambler_checkpoints[(DESCRAMBLER_END - DESCRAMBLER_START + DESCRAMBLER_CHECKPOINT - 1) / DESCRAMBLER_CHECKPOINT] = {
+	{ 0x2953, 0xd9c2, 0x3ff1, 1 }
+};
+static unsigned int descrambler_num_checkpoints = 1;
+
+// Where the last read left off, so sequential reads carry straight on
+static descrambler_state descrambler_cursor;
+static unsigned int descrambler_cursor_pos;
+
+// t clocks every step, so its next 8 output bits and its state 8 steps on
+// come from its low bits alone
+static u8 descrambler_t0[512], descrambler_t1[512];
+static u16 descrambler_tnext[256];
+static bool descrambler_tables_ready;
+
+static void descrambler_init_tables(void) {
+	for (int i = 0; i < 512; i++) {
+		u16 t = i;
+		u8 t0 = 0, t1 = 0;
+
+		for (int bit = 0; bit < 8; bit++) {
+			t0 = (t0 << 1) | (t & 1);
+			t1 = (t1 << 1) | ((t >> 1) & 1);
+			t = (t >> 1) ^ (t & 1 ? 0xa740 : 0);
+		}
+		descrambler_t0[i] = t0;
+		descrambler_t1[i] = t1;
+		if (i < 256)
+			descrambler_tnext[i] = t;
+	}
+	descrambler_tables_ready = true;
+}
+
+static u8 descrambler_byte(descrambler_state *s) {
+	u16 u = s->u;
+	u16 v = s->v;
+	u8 x = s->x;
+	u8 t0s = descrambler_t0[s->t & 0x1ff];
+	u8 t1s = descrambler_t1[s->t & 0x1ff];
+	u8 acc = 0;
+
+	for (int bit = 7; bit >= 0; bit--) {
+		u32 t0 = (t0s >> bit) & 1;
+		u32 t1 = (t1s >> bit) & 1;
+		u32 u0 = u & 1;
+		u32 u1 = (u >> 1) & 1;
+		u32 v0 = v & 1;
+
+		x ^= t1 ^ v0;
+		x ^= (u0 | u1);
+		x ^= (t0 ^ u1 ^ v0) & (t0 ^ u0);
+
+		// v clocks when t0 == u0, u when t0 == 0; kept branchless
+		u32 vclk = t0 == u0;
+		u32 uclk = t0 ^ 1;
+		v = (v >> vclk) ^ (-(vclk & v0) & 0xb3d0);
+		u = (u >> uclk) ^ (-(uclk & u0) & 0xfb10);
+
+		acc = 2*acc + x;
+	}
+
+	s->t = (s->t >> 8) ^ descrambler_tnext[s->t & 0xff];
+	s->u = u;
+	s->v = v;
+	s->x = x;
+	return acc;
+}
+
+void descrambler(unsigned int offset, void* buffer, unsigned int length) {
+	unsigned char* data = buffer;
+	unsigned int end = offset + length;
+	descrambler_state s;
+	unsigned int pos;
+
+	if (offset < DESCRAMBLER_START) {
+		data += DESCRAMBLER_START - offset;
+		offset = DESCRAMBLER_START;
+	}
+	if (end > DESCRAMBLER_END)
+		end = DESCRAMBLER_END;
+	if (offset >= end)
+		return;
+
+	if (!descrambler_tables_ready)
+		descrambler_init_tables();
+
+	// Start from the closest known state at or before offset
+	unsigned int index = (offset - DESCRAMBLER_START) / DESCRAMBLER_CHECKPOINT;
+	if (index >= descrambler_num_checkpoints)
+		index = descrambler_num_checkpoints - 1;
+	s = descrambler_checkpoints[index];
+	pos = DESCRAMBLER_START + index * DESCRAMBLER_CHECKPOINT;
+	if (descrambler_cursor_pos > pos && descrambler_cursor_pos <= offset) {
+		s = descrambler_cursor;
+		pos = descrambler_cursor_pos;
+	}
+
+	for (; pos < end; pos++) {
+		if ((pos - DESCRAMBLER_START) % DESCRAMBLER_CHECKPOINT == 0) {
+			index = (pos - DESCRAMBLER_START) / DESCRAMBLER_CHECKPOINT;
+			if (index == descrambler_num_checkpoints)
+				descrambler_checkpoints[descrambler_num_checkpoints++] = s;
+		}
+		if (pos >= offset)
+			*data++ ^= descrambler_byte(&s);
+		else
+			descrambler_byte(&s);
+	}
+
+	descrambler_cursor = s;
+	descrambler_cursor_pos = pos;
+}
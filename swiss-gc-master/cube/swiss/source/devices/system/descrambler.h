@@ -0,0 +1,11 @@
+/* descrambler.h
+	- bootrom IPL descrambler
+ */
+
+#ifndef DESCRAMBLER_H
+#define DESCRAMBLER_H
+
+// XORs the IPL keystream for [offset, offset + length) into buffer
+void descrambler(unsigned int offset, void* buffer, unsigned int length);
+
+#endif
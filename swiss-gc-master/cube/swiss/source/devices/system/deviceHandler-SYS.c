@@ -5,6 +5,7 @@
 
 #include <malloc.h>
 #include "deviceHandler-SYS.h"
+#include "descrambler.h"
 #include "main.h"
 #include "dvd.h"
 #include "files.h"
@@ -96,63 +97,6 @@ device_info* deviceHandler_SYS_info(file_handle* file) {
 	return &initial_SYS_info;
 }
 
-static void descrambler(unsigned int offset, void* buffer, unsigned int length) {
-	// bootrom descrambler reversed by segher
-	// Copyright 2008 Segher Boessenkool <segher@kernel.crashing.org>
-
-	unsigned char* data = buffer;
-	unsigned int descrambled_length = 0x100;
-
-	unsigned char acc = 0;
-	unsigned char nacc = 0;
-
-	unsigned short t = 0x2953;
-	unsigned short u = 0xd9c2;
-	unsigned short v = 0x3ff1;
-
-	unsigned char x = 1;
-	unsigned int it = offset < 0x100 ? 0x100 - offset : 0;
-
-	while (it < length) {
-		int t0 = t & 1;
-		int t1 = (t >> 1) & 1;
-		int u0 = u & 1;
-		int u1 = (u >> 1) & 1;
-		int v0 = v & 1;
-
-		x ^= t1 ^ v0;
-		x ^= (u0 | u1);
-		x ^= (t0 ^ u1 ^ v0) & (t0 ^ u0);
-
-		if (t0 == u0) {
-			v >>= 1;
-			if (v0)
-				v ^= 0xb3d0;
-		}
-
-		if (t0 == 0) {
-			u >>= 1;
-			if (u0)
-				u ^= 0xfb10;
-		}
-
-		t >>= 1;
-		if (t0)
-			t ^= 0xa740;
-
-		nacc++;
-		acc = 2*acc + x;
-		if (nacc == 8) {
-			if (descrambled_length >= 0x1aff00)
-				it++;
-			else if (descrambled_length >= offset)
-				data[it++] ^= acc;
-			descrambled_length++;
-			nacc = 0;
-		}
-	}
-}
-
 bool load_rom_ipl(DEVICEHANDLER_INTERFACE* device, void** buffer, unsigned int* length) {
 	file_handle* file = calloc(1, sizeof(file_handle));
 	concat_path(file->name, device->initial->name, "swiss/patches/ipl.bin");
@@ -19,6 +19,8 @@
 #include "gui/IPLFontWrite.h"
 
 #define WKF_BUF_SIZE 0x8000
+#define WKF_SECTOR_SIZE 0x800
+#define WKF_DMA_MAX 0x40000		// keeps a single read well within the completion poll
 u8 wkfBuffer[WKF_BUF_SIZE] ATTRIBUTE_ALIGN (32);    // 16 DVD Sectors
 
 static int wkfInitialized = 0;
@@ -122,13 +124,14 @@ void __wkfReadSectors(void* dst, unsigned int len, u64 offset) {
 	else {
 		wkfWriteOffset(0);
 	}
+	// Drop stale lines before the DMA starts, so none get written back over it
+	DCInvalidateRange(dst, len);
 	wkf[2] = 0xA8000000;
 	wkf[3] = (offset > 0x3FFFFFFFFLL) ? 0:((u32)(offset >> 2));
 	wkf[4] = len;
 	wkf[5] = (u32)dst;
 	wkf[6] = len;
 	wkf[7] = 3; // DMA | START
-	DCInvalidateRange(dst, len);
 	
 	int retries = 1000000;
 	while(( wkf[7] & 1) && retries) {
@@ -293,18 +296,43 @@ void wkfCheckSwitches() {
 	}
 }
 
+// Clamps a read so it never spans the 16GB boundary, above which the offset register is used
+static u32 __wkfReadSpan(u64 offset, u32 len)
+{
+	if(len > WKF_DMA_MAX) {
+		len = WKF_DMA_MAX;
+	}
+	if(offset <= 0x3FFFFFFFFLL && offset + len > 0x400000000LL) {
+		len = (u32)(0x400000000LL - offset);
+	}
+	return len;
+}
+
+// Whole sectors destined for a 32 byte aligned buffer are read straight into it,
+// only the unaligned head/tail goes through wkfBuffer.
 void wkfRead(void* dst, int len, u64 offset)
 {
 	u8 *sector_buffer = &wkfBuffer[0];
 	while (len)
 	{
-		__wkfReadSectors(sector_buffer, WKF_BUF_SIZE, (offset-(offset%WKF_BUF_SIZE)));
-		u32 off = (u32)((u32)(offset) & (WKF_BUF_SIZE-1));
-
-		int rl = WKF_BUF_SIZE - off;
-		if (rl > len)
-			rl = len;
-		memcpy(dst, sector_buffer + off, rl);	
+		u32 off = (u32)offset & (WKF_SECTOR_SIZE-1);
+		int rl;
+		if (!off && len >= WKF_SECTOR_SIZE && !((u32)dst & 31))
+		{
+			rl = __wkfReadSpan(offset, len & ~(WKF_SECTOR_SIZE-1));
+			__wkfReadSectors(dst, rl, offset);
+		}
+		else
+		{
+			u32 span = (off + len + WKF_SECTOR_SIZE-1) & ~(WKF_SECTOR_SIZE-1);
+			span = __wkfReadSpan(offset - off, span < WKF_BUF_SIZE ? span : WKF_BUF_SIZE);
+			__wkfReadSectors(sector_buffer, span, offset - off);
+
+			rl = span - off;
+			if (rl > len)
+				rl = len;
+			memcpy(dst, sector_buffer + off, rl);	
+		}
 
 		offset += rl;
 		len -= rl;
@@ -0,0 +1,293 @@
+/* filejob.c
+	- copies, moves and deletes whole directory trees
+ */
+
+#include <gccore.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "swiss.h"
+#include "util.h"
+#include "files.h"
+#include "filejob.h"
+
+#define FILE_JOB_BUFFER_SIZE (256*1024)
+
+static bool op_push(file_op **ops, u32 *count, u8 type, u32 name, u32 size, u64 location) {
+	// Grows at powers of two
+	if(!*count || (*count >= 16 && !(*count & (*count - 1)))) {
+		file_op *grown = realloc(*ops, (*count ? *count * 2 : 16) * sizeof(file_op));
+		if(!grown) {
+			return false;
+		}
+		*ops = grown;
+	}
+	(*ops)[(*count)++] = (file_op){ .type = type, .name = name, .size = size, .location = location };
+	return true;
+}
+
+// Adds parent/name to the name pool, returns its offset or -1
+static s32 name_push(file_job *job, u32 parent, const char *name) {
+	u32 parentLength = job->names ? strlen(&job->names[parent]) : 0;
+	u32 length = parentLength + (parentLength ? 1 : 0) + strlen(name) + 1;
+	if(job->namesCapacity - job->namesLength < length) {
+		u32 capacity = job->namesCapacity * 2 > job->namesLength + length ? job->namesCapacity * 2 : job->namesLength + length;
+		char *names = realloc(job->names, capacity);
+		if(!names) {
+			return -1;
+		}
+		job->names = names;
+		job->namesCapacity = capacity;
+	}
+	u32 offset = job->namesLength;
+	char *path = &job->names[offset];
+	memcpy(path, &job->names[parent], parentLength);
+	if(parentLength) {
+		path[parentLength++] = '/';
+	}
+	strcpy(path + parentLength, name);
+	job->namesLength += length;
+	return offset;
+}
+
+static void job_handle(file_handle *file, const char *root, const char *name, s32 fileAttrib) {
+	memset(file, 0, sizeof(file_handle));
+	if(*name) {
+		concat_path(file->name, root, name);
+	}
+	else {
+		strlcpy(file->name, root, PATHNAME_MAX);
+	}
+	file->fileAttrib = fileAttrib;
+}
+
+static int op_compare(const void *a, const void *b) {
+	const file_op *opA = a, *opB = b;
+	if(opA->location != opB->location) {
+		return opA->location < opB->location ? -1 : 1;
+	}
+	return opA->name < opB->name ? -1 : opA->name > opB->name;
+}
+
+// Adds an entry of the directory at dir, directories are walked once every one before them is
+static bool job_add(file_job *job, u32 dir, const char *name, bool isDir, u32 size, u64 location, file_op **dirs, u32 *numDirs, file_op **files, u32 *numFiles) {
+	s32 path = name_push(job, dir, name);
+	if(path < 0) {
+		return false;
+	}
+	if(isDir) {
+		return op_push(dirs, numDirs, FILE_OP_MKDIR, path, 0, 0);
+	}
+	return op_push(files, numFiles, FILE_OP_COPY, path, size, location);
+}
+
+// FatFs hands out a directory an entry at a time, so nothing the size of a listing is held
+static bool job_list_fat(file_job *job, file_handle *dirHandle, u32 dir, file_op **dirs, u32 *numDirs, file_op **files, u32 *numFiles) {
+	DIRF *dp = malloc(sizeof(DIRF));
+	FILINFO *entry = malloc(sizeof(FILINFO));
+	bool ret = dp && entry && f_opendir(dp, dirHandle->name) == FR_OK;
+	if(ret) {
+		while(ret && f_readdir(dp, entry) == FR_OK && entry->fname[0] != '\0') {
+			ret = job_add(job, dir, entry->fname, entry->fattrib & AM_DIR, entry->fsize, 0, dirs, numDirs, files, numFiles);
+		}
+		f_closedir(dp);
+	}
+	free(entry);
+	free(dp);
+	return ret;
+}
+
+static bool job_list(file_job *job, file_handle *dirHandle, u32 dir, file_op **dirs, u32 *numDirs, file_op **files, u32 *numFiles) {
+	if(job->src->features & FEAT_FAT_FUNCS) {
+		return job_list_fat(job, dirHandle, dir, dirs, numDirs, files, numFiles);
+	}
+	// Every entry has to be seen, whatever the browser is set to show
+	bool showHiddenFiles = swissSettings.showHiddenFiles;
+	bool hideUnknownFileTypes = swissSettings.hideUnknownFileTypes;
+	swissSettings.showHiddenFiles = true;
+	swissSettings.hideUnknownFileTypes = false;
+	file_handle *dirEntries = NULL;
+	int dirEntryCount = job->src->readDir(dirHandle, &dirEntries, -1);
+	swissSettings.showHiddenFiles = showHiddenFiles;
+	swissSettings.hideUnknownFileTypes = hideUnknownFileTypes;
+
+	bool ret = dirEntryCount >= 0;
+	for(int i = 0; i < dirEntryCount && ret; i++) {
+		if(dirEntries[i].fileAttrib == IS_FILE || dirEntries[i].fileAttrib == IS_DIR) {
+			ret = job_add(job, dir, getRelativeName(dirEntries[i].name), dirEntries[i].fileAttrib == IS_DIR,
+						dirEntries[i].size, dirEntries[i].fileBase, dirs, numDirs, files, numFiles);
+		}
+	}
+	free(dirEntries);
+	return ret;
+}
+
+// Walks the tree under root one directory at a time, so at most a single directory listing is ever held
+static bool job_walk(file_job *job, file_handle *root, file_op **dirs, u32 *numDirs, file_op **files, u32 *numFiles) {
+	s32 name = name_push(job, 0, "");
+	if(name < 0) {
+		return false;
+	}
+	if(root->fileAttrib != IS_DIR) {
+		return op_push(files, numFiles, FILE_OP_COPY, name, root->size, root->fileBase);
+	}
+	if(!op_push(dirs, numDirs, FILE_OP_MKDIR, name, 0, 0)) {
+		return false;
+	}
+
+	bool ret = true;
+	// Directories are only ever appended, anything past next is still to be listed
+	for(u32 next = 0; ret && next < *numDirs; ) {
+		u32 dir = (*dirs)[next++].name;
+		file_handle dirHandle;
+		job_handle(&dirHandle, job->srcRoot, &job->names[dir], IS_DIR);
+		ret = job_list(job, &dirHandle, dir, dirs, numDirs, files, numFiles);
+	}
+	return ret;
+}
+
+bool file_job_init(file_job *job, int kind, DEVICEHANDLER_INTERFACE *src, file_handle *root, DEVICEHANDLER_INTERFACE *dest, const char *destPath) {
+	memset(job, 0, sizeof(file_job));
+	job->src = src;
+	job->dest = dest;
+	strlcpy(job->srcRoot, root->name, PATHNAME_MAX);
+	if(destPath) {
+		strlcpy(job->destRoot, destPath, PATHNAME_MAX);
+	}
+
+	file_op *dirs = NULL, *files = NULL;
+	u32 numDirs = 0, numFiles = 0;
+	bool ret = job_walk(job, root, &dirs, &numDirs, &files, &numFiles);
+	if(ret) {
+		// Directories are listed parents first, so they're made in order and removed in reverse
+		u32 numOps = (kind != FILE_JOB_DELETE ? numDirs + numFiles : 0) + (kind != FILE_JOB_COPY ? numFiles + numDirs : 0);
+		job->ops = malloc((numOps + 1) * sizeof(file_op));
+		ret = job->ops != NULL;
+	}
+	if(ret && kind != FILE_JOB_DELETE) {
+		for(u32 i = 0; i < numDirs; i++) {
+			job->ops[job->numOps++] = dirs[i];
+		}
+		if(numFiles) {
+			qsort(files, numFiles, sizeof(file_op), op_compare);
+			for(u32 i = 0; i < numFiles; i++) {
+				job->ops[job->numOps++] = files[i];
+				job->totalBytes += files[i].size;
+			}
+			job->bufferSize = FILE_JOB_BUFFER_SIZE;
+			job->buffer = memalign(32, job->bufferSize);
+			ret = job->buffer != NULL;
+		}
+	}
+	if(ret && kind != FILE_JOB_COPY) {
+		for(u32 i = 0; i < numFiles; i++) {
+			job->ops[job->numOps] = files[i];
+			job->ops[job->numOps++].type = FILE_OP_DELETE;
+		}
+		for(u32 i = numDirs; i-- > 0; ) {
+			job->ops[job->numOps] = dirs[i];
+			job->ops[job->numOps++].type = FILE_OP_RMDIR;
+		}
+	}
+	free(dirs);
+	free(files);
+	print_gecko("file_job_init: %i ops, %i dirs, %i files, %llu bytes\r\n", job->numOps, numDirs, numFiles, job->totalBytes);
+	if(!ret) {
+		file_job_free(job);
+	}
+	return ret;
+}
+
+static int job_copy(file_job *job, file_op *op, file_job_progress progress, void *ctx) {
+	const char *name = &job->names[op->name];
+	if(!job->offset) {
+		job_handle(&job->srcFile, job->srcRoot, name, IS_FILE);
+		job_handle(&job->destFile, job->destRoot, name, IS_FILE);
+	}
+	while(job->offset < op->size) {
+		u32 amountToCopy = op->size - job->offset < job->bufferSize ? op->size - job->offset : job->bufferSize;
+		job->src->seekFile(&job->srcFile, job->offset, DEVICE_HANDLER_SEEK_SET);
+		if(job->src->readFile(&job->srcFile, job->buffer, amountToCopy) != amountToCopy) {
+			// Retry the read
+			job->src->seekFile(&job->srcFile, job->offset, DEVICE_HANDLER_SEEK_SET);
+			if(job->src->readFile(&job->srcFile, job->buffer, amountToCopy) != amountToCopy) {
+				job->failed = &job->srcFile;
+				return FILE_JOB_FAILED;
+			}
+		}
+		job->dest->seekFile(&job->destFile, job->offset, DEVICE_HANDLER_SEEK_SET);
+		if(job->dest->writeFile(&job->destFile, job->buffer, amountToCopy) != amountToCopy) {
+			job->failed = &job->destFile;
+			return FILE_JOB_FAILED;
+		}
+		job->offset += amountToCopy;
+		job->doneBytes += amountToCopy;
+		if(!progress(ctx, job)) {
+			return FILE_JOB_CANCELLED;
+		}
+	}
+	job->src->closeFile(&job->srcFile);
+	if(job->dest->writeFile(&job->destFile, NULL, 0) != 0 || job->dest->closeFile(&job->destFile) != 0) {
+		job->failed = &job->destFile;
+		return FILE_JOB_FAILED;
+	}
+	job->offset = 0;
+	return FILE_JOB_DONE;
+}
+
+// Runs the job from wherever it stopped, a cancelled or failed job can be run again to resume it
+int file_job_run(file_job *job, file_job_progress progress, void *ctx) {
+	job->failed = NULL;
+	while(job->next < job->numOps) {
+		file_op *op = &job->ops[job->next];
+		const char *name = &job->names[op->name];
+		if(!progress(ctx, job)) {
+			return FILE_JOB_CANCELLED;
+		}
+		switch(op->type) {
+			case FILE_OP_MKDIR:
+				// Already being there is fine, a missing one shows up as soon as a file is written to it
+				job_handle(&job->destFile, job->destRoot, name, IS_DIR);
+				if(job->dest->makeDir) {
+					job->dest->makeDir(&job->destFile);
+				}
+				break;
+			case FILE_OP_COPY:
+			{
+				int ret = job_copy(job, op, progress, ctx);
+				if(ret != FILE_JOB_DONE) {
+					return ret;
+				}
+				break;
+			}
+			case FILE_OP_DELETE:
+			case FILE_OP_RMDIR:
+				job_handle(&job->srcFile, job->srcRoot, name, op->type == FILE_OP_RMDIR ? IS_DIR : IS_FILE);
+				if(job->src->deleteFile(&job->srcFile)) {
+					job->failed = &job->srcFile;
+					return FILE_JOB_FAILED;
+				}
+				break;
+		}
+		job->next++;
+	}
+	return FILE_JOB_DONE;
+}
+
+// Path of the entry the job is on, relative to where it started
+const char *file_job_current(file_job *job) {
+	return job->next < job->numOps ? &job->names[job->ops[job->next].name] : "";
+}
+
+void file_job_free(file_job *job) {
+	if(job->src) {
+		job->src->closeFile(&job->srcFile);
+	}
+	if(job->dest) {
+		job->dest->closeFile(&job->destFile);
+	}
+	free(job->ops);
+	free(job->names);
+	free(job->buffer);
+	memset(job, 0, sizeof(file_job));
+}
@@ -119,23 +119,28 @@ void concatf_path(char *pathName, const char *dirName, const char *baseName, ...
 
 // Either renames a path to a new one, or creates one.
 void ensure_path(int deviceSlot, char *path, char *oldPath) {
+	ensure_device_path(devices[deviceSlot], path, oldPath);
+}
+
+// As ensure_path, for a device that needn't be in a slot.
+void ensure_device_path(DEVICEHANDLER_INTERFACE *device, char *path, char *oldPath) {
 	file_handle fhFullPath = { .fileAttrib = IS_DIR };
-	concat_path(fhFullPath.name, devices[deviceSlot]->initial->name, path);
+	concat_path(fhFullPath.name, device->initial->name, path);
 	if(oldPath) {
 		file_handle fhOldFullPath = { .fileAttrib = IS_DIR };
-		concat_path(fhOldFullPath.name, devices[deviceSlot]->initial->name, oldPath);
-		if(devices[deviceSlot]->renameFile) {
-			if(devices[deviceSlot]->renameFile(&fhOldFullPath, fhFullPath.name)) {
-				if(devices[deviceSlot]->makeDir) {
-					devices[deviceSlot]->makeDir(&fhFullPath);
+		concat_path(fhOldFullPath.name, device->initial->name, oldPath);
+		if(device->renameFile) {
+			if(device->renameFile(&fhOldFullPath, fhFullPath.name)) {
+				if(device->makeDir) {
+					device->makeDir(&fhFullPath);
 				}
 			}
 		}
-		else if(devices[deviceSlot]->makeDir) {
-			devices[deviceSlot]->makeDir(&fhFullPath);
+		else if(device->makeDir) {
+			device->makeDir(&fhFullPath);
 		}
 	}
-	else if(devices[deviceSlot]->makeDir) {
-		devices[deviceSlot]->makeDir(&fhFullPath);
+	else if(device->makeDir) {
+		device->makeDir(&fhFullPath);
 	}
 }
@@ -118,19 +118,13 @@ void get_gcm_banner(file_handle *file, u32 *file_offset, u32 *file_size) {
 }
 
 // Add a file to our current filesToPatch based on fileName
-void parse_gcm_add(file_handle *file, ExecutableFile *filesToPatch, int *numToPatch, char *fileName) {
-	DiskHeader *diskHeader = get_gcm_header(file);
-	if(!diskHeader) return;
-	
-	char *FST = get_fst(file, diskHeader->FSTOffset, diskHeader->FSTSize);
-	if(!FST) return;
+void parse_gcm_add(GCMCache *cache, ExecutableFile *filesToPatch, int *numToPatch, char *fileName) {
+	if(!cache->FST) return;
 	
 	u32 file_offset, file_size;
-	get_fst_details(FST, fileName, &file_offset, &file_size);
-	free(FST);
-	free(diskHeader);
+	get_fst_details(cache->FST, fileName, &file_offset, &file_size);
 	if(file_offset != -1) {
-		filesToPatch[*numToPatch].file = file;
+		filesToPatch[*numToPatch].file = cache->file;
 		filesToPatch[*numToPatch].offset = file_offset;
 		filesToPatch[*numToPatch].size = file_size;
 		filesToPatch[*numToPatch].type = endsWith(fileName,".prs") ? PATCH_OTHER_PRS:PATCH_OTHER;
@@ -213,12 +207,48 @@ u32 calc_elf_segments_size(file_handle *file, u32 file_offset, u32 *file_size) {
 	return size;
 }
 
+// Reads the disc header, apploader header, main DOL header and FST of file, or takes a disc header already read from it.
+// A missing header or FST leaves nothing to parse, returns what failed to be read if it can't be booted at all
+const char *gcm_cache_read(GCMCache *cache, file_handle *file, DiskHeader *diskHeader) {
+	memset(cache, 0, sizeof(GCMCache));
+	cache->file = file;
+	if(diskHeader) {
+		cache->diskHeader = memalign(32, sizeof(DiskHeader));
+		if(!cache->diskHeader) return NULL;
+		memcpy(cache->diskHeader, diskHeader, sizeof(DiskHeader));
+	}
+	else {
+		cache->diskHeader = get_gcm_header(file);
+		if(!cache->diskHeader) return NULL;
+	}
+	
+	devices[DEVICE_CUR]->seekFile(file,0x2440,DEVICE_HANDLER_SEEK_SET);
+	if(devices[DEVICE_CUR]->readFile(file,&cache->apploaderHeader,sizeof(ApploaderHeader)) != sizeof(ApploaderHeader)) {
+		return "Failed to read Apploader Header";
+	}
+	if(cache->diskHeader->DOLOffset != 0) {
+		devices[DEVICE_CUR]->seekFile(file,cache->diskHeader->DOLOffset,DEVICE_HANDLER_SEEK_SET);
+		if(devices[DEVICE_CUR]->readFile(file,&cache->dolHeader,DOLHDRLENGTH) != DOLHDRLENGTH) {
+			return "Failed to read Main DOL Header";
+		}
+	}
+	cache->FST = get_fst(file, cache->diskHeader->FSTOffset, cache->diskHeader->FSTSize);
+	return NULL;
+}
+
+void gcm_cache_free(GCMCache *cache) {
+	free(cache->diskHeader);
+	free(cache->FST);
+	memset(cache, 0, sizeof(GCMCache));
+}
+
 // Returns the number of filesToPatch and fills out the filesToPatch array passed in (pre-allocated)
-int parse_gcm(file_handle *file, file_handle *file2, ExecutableFile *filesToPatch) {
+int parse_gcm(GCMCache *cache, GCMCache *cache2, ExecutableFile *filesToPatch) {
+	file_handle *file = cache->file;
 	char	filename[256];
 	int		dolOffset = 0, dolSize = 0, numFiles = 0;
 
-	DiskHeader *diskHeader = get_gcm_header(file);
+	DiskHeader *diskHeader = cache->diskHeader;
 	if(!diskHeader) return 0;
 	if(diskHeader->MaxFSTSize > GCMDisk.MaxFSTSize) {
 		GCMDisk.MaxFSTSize = diskHeader->MaxFSTSize;
@@ -226,15 +256,10 @@ int parse_gcm(file_handle *file, file_handle *file2, ExecutableFile *filesToPatc
 
 	// Patch the apploader too!
 	// Calc Apploader size
-	ApploaderHeader apploaderHeader;
-	devices[DEVICE_CUR]->seekFile(file,0x2440,DEVICE_HANDLER_SEEK_SET);
-	if(devices[DEVICE_CUR]->readFile(file,&apploaderHeader,sizeof(ApploaderHeader)) != sizeof(ApploaderHeader)) {
-		DrawPublish(DrawMessageBox(D_FAIL, "Failed to read Apploader Header"));
-		while(1);
-	}
+	ApploaderHeader *apploaderHeader = &cache->apploaderHeader;
 	filesToPatch[numFiles].file = file;
 	filesToPatch[numFiles].offset = 0x2440;
-	filesToPatch[numFiles].size = sizeof(ApploaderHeader) + ((apploaderHeader.size + 31) & ~31) + ((apploaderHeader.rebootSize + 31) & ~31);
+	filesToPatch[numFiles].size = sizeof(ApploaderHeader) + ((apploaderHeader->size + 31) & ~31) + ((apploaderHeader->rebootSize + 31) & ~31);
 	filesToPatch[numFiles].type = PATCH_APPLOADER;
 	sprintf(filesToPatch[numFiles].name, "apploader.img");
 	numFiles++;
@@ -242,22 +267,16 @@ int parse_gcm(file_handle *file, file_handle *file2, ExecutableFile *filesToPatc
 	if(diskHeader->DOLOffset != 0) {
 		// Multi-DOL games may re-load the main DOL, so make sure we patch it too.
 		// Calc size
-		DOLHEADER dolhdr;
-		devices[DEVICE_CUR]->seekFile(file,diskHeader->DOLOffset,DEVICE_HANDLER_SEEK_SET);
-		if(devices[DEVICE_CUR]->readFile(file,&dolhdr,DOLHDRLENGTH) != DOLHDRLENGTH) {
-			DrawPublish(DrawMessageBox(D_FAIL, "Failed to read Main DOL Header"));
-			while(1);
-		}
 		filesToPatch[numFiles].file = file;
 		filesToPatch[numFiles].offset = dolOffset = diskHeader->DOLOffset;
-		filesToPatch[numFiles].size = dolSize = DOLSize(&dolhdr);
+		filesToPatch[numFiles].size = dolSize = DOLSize(&cache->dolHeader);
 		filesToPatch[numFiles].hash = get_gcm_boot_hash(diskHeader);
 		filesToPatch[numFiles].type = PATCH_DOL;
 		sprintf(filesToPatch[numFiles].name, "default.dol");
 		numFiles++;
 	}
 
-	char *FST = get_fst(file, diskHeader->FSTOffset, diskHeader->FSTSize);
+	char *FST = cache->FST;
 	if(!FST) return 0;
 
 	u32 entries=*(unsigned int*)&FST[8];
@@ -326,11 +345,9 @@ int parse_gcm(file_handle *file, file_handle *file2, ExecutableFile *filesToPatc
 			}
 		} 
 	}
-	free(FST);
-	free(diskHeader);
 	
-	if(file2) {
-		numFiles += parse_gcm(file2, NULL, &filesToPatch[numFiles]);
+	if(cache2) {
+		numFiles += parse_gcm(cache2, NULL, &filesToPatch[numFiles]);
 	}
 	// This need to be last.
 	filesToPatch[numFiles].file = file;
@@ -529,7 +546,7 @@ int patch_gcm(ExecutableFile *filesToPatch, int numToPatch) {
 		void *buffer = memalign(32, sizeToRead);
 		
 		devices[DEVICE_CUR]->seekFile(fileToPatch->file,fileToPatch->offset,DEVICE_HANDLER_SEEK_SET);
-		int ret = devices[DEVICE_CUR]->readFile(fileToPatch->file,buffer,sizeToRead);
+		int ret = readFileHashed(DEVICE_CUR,fileToPatch->file,buffer,sizeToRead,&fileToPatch->hash);
 		print_gecko("Read from %08X Size %08X - Result: %08X\r\n", fileToPatch->offset, sizeToRead, ret);
 		if(ret != sizeToRead) {
 			DrawDispose(progBox);			
@@ -538,8 +555,6 @@ int patch_gcm(ExecutableFile *filesToPatch, int numToPatch) {
 			DrawDispose(msgBox);
 			return 0;
 		}
-		fileToPatch->hash = XXH3_64bits(buffer, sizeToRead);
-		
 		u8 *oldBuffer = NULL, *newBuffer = NULL;
 		if(fileToPatch->type == PATCH_DOL_PRS || fileToPatch->type == PATCH_OTHER_PRS) {
 			ret = pso_prs_decompress_buf(buffer, &newBuffer, fileToPatch->size);
@@ -81,9 +81,24 @@ static char fbTextBuffer[256];
 #define VIDEO_PRIORITY 100
 static char  video_thread_stack[VIDEO_STACK_SIZE];
 static lwp_t video_thread;
-static mutex_t _videomutex;
+static mutex_t _videomutex;	// Guards the event tree, held only while snapshotting it
+static mutex_t _framemutex;	// Held by the video thread for a whole frame, GPU drain included
 static int threadAlive = 0;
 
+// Display list caching
+#define DISPLIST_MIN_SIZE (1024)
+#define DISPLIST_MAX_SIZE (256*1024)
+static u32 videoCacheGen = 0;	// Bumped to re-record everything (video mode, backdrop)
+
+typedef struct videoFrameEntry {
+	void *dispList;
+	u32 dispListSize;
+} videoFrameEntry_t;
+
+static videoFrameEntry_t *videoFrame = NULL;
+static int videoFrameCount = 0;
+static int videoFrameCapacity = 0;
+
 enum VideoEventType
 {
 	EV_TEXOBJ = 0,
@@ -151,6 +166,7 @@ typedef struct drawStyledLabelEvent {
 	bool showCaret;
 	int caretPosition;
 	GXColor caretColor;
+	textLayout_t *layout;
 } drawStyledLabelEvent_t;
 
 typedef struct drawSelectableButtonEvent {
@@ -160,6 +176,7 @@ typedef struct drawSelectableButtonEvent {
 	int y2;
 	int mode;
 	char *msg;
+	textLayout_t *layout;
 } drawSelectableButtonEvent_t;
 
 typedef struct drawBoxEvent {
@@ -181,6 +198,7 @@ typedef struct drawFileBrowserButtonEvent {
 	bool isAutoLoadEntry;
 	bool isCarousel;	// Draw this as a full "card" style
 	int distFromMiddle;	// 0 = full, -1 spine only but large then gradually getting smaller as dist increases from 0
+	textLayout_t *nameLayout;	// displayName when drawn fitted, laid out on first draw
 } drawFileBrowserButtonEvent_t;
 
 typedef struct drawMenuButtonsEvent {
@@ -252,6 +270,7 @@ static void clearNestedEvent(uiDrawObj_t *event) {
 				//printf("Clear Nested EV_STYLEDLABEL\r\n");
 				free(((drawStyledLabelEvent_t*)event->data)->string);
 			}
+			FreeTextLayout(((drawStyledLabelEvent_t*)event->data)->layout);
 		}
 		else if(event->type == EV_FILEBROWSERBUTTON) {
 			if(((drawFileBrowserButtonEvent_t*)event->data)->displayName) {
@@ -267,12 +286,14 @@ static void clearNestedEvent(uiDrawObj_t *event) {
 				}
 				free(((drawFileBrowserButtonEvent_t*)event->data)->file);
 			}
+			FreeTextLayout(((drawFileBrowserButtonEvent_t*)event->data)->nameLayout);
 		}
 		else if(event->type == EV_SELECTABLEBUTTON) {
 			if(((drawSelectableButtonEvent_t*)event->data)->msg) {
 				//printf("Clear Nested EV_SELECTABLEBUTTON\r\n");
 				free(((drawSelectableButtonEvent_t*)event->data)->msg);
 			}
+			FreeTextLayout(((drawSelectableButtonEvent_t*)event->data)->layout);
 		}
 		else if(event->type == EV_TOOLTIP) {
 			if(((drawTooltipEvent_t*)event->data)->tooltip) {
@@ -283,6 +304,9 @@ static void clearNestedEvent(uiDrawObj_t *event) {
 		//printf("Clear Nested event->data\r\n");
 		free(event->data);
 	}
+	if(event && event->dispList) {
+		free(event->dispList);
+	}
 	if(event) {
 		//printf("Clear event\r\n");
 		memset(event, 0, sizeof(uiDrawObj_t));
@@ -290,31 +314,6 @@ static void clearNestedEvent(uiDrawObj_t *event) {
 	}
 }
 
-static void disposeEvent(uiDrawObj_t *event) {
-	if(videoEventQueue == NULL) {
-		return;
-	}
-
-	// See if this is in our root event queue
-	uiDrawObjQueue_t *current = videoEventQueue->next;
-	uiDrawObjQueue_t *previous = videoEventQueue;
-	// First node is what we're after.
-	while (current != NULL) {
-		if(current->event == event) {
-			//print_gecko("Disposing event %08X\r\n", (u32)current);
-			clearNestedEvent(current->event);
-			if(previous != NULL) {
-				previous->next = current->next;
-			}
-		}
-		else {
-			previous = current;
-		}
-		current = current->next;
-    }
-}
-
-
 static void init_textures() 
 {
 	TPL_OpenTPLFromMemory(&imagesTPL, (void *)images_tpl, images_tpl_size);
@@ -822,16 +821,7 @@ static void _DrawSelectableButton(uiDrawObj_t *evt) {
 		_DrawSimpleBox( x1, data->y1, x2-x1, data->y2-data->y1+2, 0, noColor, borderColor);
 	}
 	
-	if(data->msg) {
-		float scale = GetTextScaleToFitInWidth(data->msg, (x2-x1)-(borderSize*2));
-		// Adjust font when we can't fit vertically too
-		int availHeight = data->y2 - data->y1 - 4;
-		if(GetFontHeight(scale) > availHeight) {
-			int fullHeight = GetFontHeight(1.0f);
-			scale = (float)availHeight / (float)fullHeight;
-		}
-		drawString(data->x1 + borderSize+3, data->y1+2, data->msg, scale, false, defaultColor);
-	}
+	drawTextLayout(data->layout, data->x1 + borderSize+3, data->y1+2, defaultColor);
 }
 
 // External
@@ -845,6 +835,18 @@ uiDrawObj_t* DrawSelectableButton(int x1, int y1, int x2, int y2, const char *me
 	eventData->mode = mode;
 	if(message) {
 		eventData->msg = strdup(message);
+		int borderSize = 4;
+		//determine length of the text ourselves if x2 == -1
+		x1 = (x2 == -1) ? x1+2:x1;
+		x2 = (x2 == -1) ? GetTextSizeInPixels(eventData->msg)+x1+(borderSize*2)+6 : x2;
+		float scale = GetTextScaleToFitInWidth(eventData->msg, (x2-x1)-(borderSize*2));
+		// Adjust font when we can't fit vertically too
+		int availHeight = y2 - y1 - 4;
+		if(GetFontHeight(scale) > availHeight) {
+			int fullHeight = GetFontHeight(1.0f);
+			scale = (float)availHeight / (float)fullHeight;
+		}
+		eventData->layout = LayoutText(eventData->msg, scale, 0, false);
 	}
 	uiDrawObj_t *event = calloc(1, sizeof(uiDrawObj_t));
 	event->type = EV_SELECTABLEBUTTON;
@@ -923,7 +925,7 @@ static void _DrawStyledLabel(uiDrawObj_t *evt) {
 			if(data->color.a >= 255) data->fadingDirection = -1;
 			else if(data->color.a <= 15) data->fadingDirection = 1;
 		}
-		drawString(data->x, data->y, data->string, data->size, data->centered, data->color);
+		drawTextLayout(data->layout, data->x, data->y, data->color);
 	}
 }
 
@@ -942,6 +944,7 @@ uiDrawObj_t* DrawStyledLabel(int x, int y, const char *string, float size, bool
 	eventData->size = size;
 	eventData->centered = centered;
 	eventData->color = color;
+	eventData->layout = LayoutText(eventData->string, size, 0, centered);
 	uiDrawObj_t *event = calloc(1, sizeof(uiDrawObj_t));
 	event->type = EV_STYLEDLABEL;
 	event->data = eventData;
@@ -957,6 +960,8 @@ uiDrawObj_t* DrawStyledLabelWithCaret(int x, int y, const char *string, float si
 	eventData->showCaret = true;
 	eventData->fadingDirection = 1;
 	eventData->caretColor = eventData->color;
+	FreeTextLayout(eventData->layout);	// Drawn with the caret every frame instead
+	eventData->layout = NULL;
 	return event;
 }
 
@@ -975,6 +980,7 @@ uiDrawObj_t* DrawLabel(int x, int y, const char *string)
 	eventData->size = 1.0f;
 	eventData->centered = false;
 	eventData->color = defaultColor;
+	eventData->layout = LayoutText(eventData->string, 1.0f, 0, false);
 	uiDrawObj_t *event = calloc(1, sizeof(uiDrawObj_t));
 	event->type = EV_STYLEDLABEL;
 	event->data = eventData;
@@ -997,6 +1003,7 @@ uiDrawObj_t* DrawFadingLabel(int x, int y, const char *string, float size)
 	eventData->centered = false;
 	eventData->color = (GXColor) {255, 255, 255, 0};
 	eventData->fadingDirection = 1;
+	eventData->layout = LayoutText(eventData->string, size, 0, false);
 	uiDrawObj_t *event = calloc(1, sizeof(uiDrawObj_t));
 	event->type = EV_STYLEDLABEL;
 	event->data = eventData;
@@ -1086,8 +1093,10 @@ static void _DrawFileBrowserButton(uiDrawObj_t *evt) {
 			}
 			
 			// fullGameName displays some titles with incorrect encoding, use displayName instead
-			float scale = GetTextScaleToFitInWidth(data->displayName, (data->x2-data->x1)-(borderSize*2));
-			drawString(x_mid, data->y1+(borderSize*2)+10, data->displayName, scale, true, defaultColor);
+			if(!data->nameLayout) {
+				data->nameLayout = LayoutText(data->displayName, 1.0f, (data->x2-data->x1)-(borderSize*2), true);
+			}
+			drawTextLayout(data->nameLayout, x_mid, data->y1+(borderSize*2)+10, defaultColor);
 			
 			// Print specific stats
 			if(file->fileAttrib==IS_FILE) {
@@ -1199,8 +1208,12 @@ static void _DrawFileBrowserButton(uiDrawObj_t *evt) {
 
 		// fullGameName displays some titles with incorrect encoding, use displayName instead
 		if(data->mode == B_SELECTED) {
-			float scale = GetTextScaleToFitInWidthWithMax(data->displayName, (data->x2-data->x1-96-40)-(borderSize*2), 0.6f);
-			drawString(data->x1 + borderSize+8+96, data->y1+(data->y2-data->y1)/2-GetFontHeight(scale)/2, data->displayName, scale, false, defaultColor);
+			if(!data->nameLayout) {
+				data->nameLayout = LayoutText(data->displayName, 0.6f, (data->x2-data->x1-96-40)-(borderSize*2), false);
+			}
+			if(data->nameLayout) {
+				drawTextLayout(data->nameLayout, data->x1 + borderSize+8+96, data->y1+(data->y2-data->y1)/2-GetFontHeight(data->nameLayout->scale)/2, defaultColor);
+			}
 		} else {
 			drawStringEllipsis(data->x1 + borderSize+8+96, data->y1+(data->y2-data->y1)/2-GetFontHeight(0.6f)/2, data->displayName, 0.6f, false, defaultColor, false, (data->x2-data->x1-96-40)-(borderSize*2));
 		}
@@ -1446,6 +1459,7 @@ void DrawUpdateProgressBar(uiDrawObj_t *evt, int percent) {
 	LWP_MutexLock(_videomutex);
 	drawProgressEvent_t *data = (drawProgressEvent_t*)evt->data;
 	data->percent = percent;
+	evt->dirty = true;
 	LWP_MutexUnlock(_videomutex);
 }
 
@@ -1456,6 +1470,7 @@ void DrawUpdateProgressBarDetail(uiDrawObj_t *evt, int percent, int speed, int t
 	data->speed = speed;
 	data->timestart = timestart;
 	data->timeremain = timeremain;
+	evt->dirty = true;
 	LWP_MutexUnlock(_videomutex);
 }
 
@@ -1463,6 +1478,7 @@ void DrawUpdateMenuButtons(int selection) {
 	LWP_MutexLock(_videomutex);
 	drawMenuButtonsEvent_t *data = (drawMenuButtonsEvent_t*)buttonPanel->data;
 	data->selection = selection;
+	buttonPanel->dirty = true;
 	LWP_MutexUnlock(_videomutex);
 }
 
@@ -1470,6 +1486,7 @@ void DrawUpdateFileBrowserButton(uiDrawObj_t *evt, int mode) {
 	LWP_MutexLock(_videomutex);
 	drawFileBrowserButtonEvent_t *data = (drawFileBrowserButtonEvent_t*)evt->data;
 	data->mode = mode;
+	evt->dirty = true;
 	LWP_MutexUnlock(_videomutex);
 }
 
@@ -2024,9 +2041,111 @@ static void videoDrawEvent(uiDrawObj_t *videoEvent) {
 		default:
 			break;
 	}
-	if(videoEvent->child != NULL) {
-		videoDrawEvent(videoEvent->child);
+}
+
+// Events whose output changes every frame on its own
+static bool isAnimatedEvent(uiDrawObj_t *videoEvent) {
+	switch(videoEvent->type) {
+		case EV_PROGRESS:
+			return ((drawProgressEvent_t*)videoEvent->data)->miniMode || ((drawProgressEvent_t*)videoEvent->data)->indeterminate;
+		case EV_STYLEDLABEL:
+			return ((drawStyledLabelEvent_t*)videoEvent->data)->fadingDirection != 0;
+		case EV_TITLEBAR:
+			return true;	// Clock
+		default:
+			return false;
+	}
+}
+
+// Size of the event data drawing it advances, see isAnimatedEvent
+static size_t animatedStateSize(uiDrawObj_t *videoEvent) {
+	switch(videoEvent->type) {
+		case EV_PROGRESS:
+			return sizeof(drawProgressEvent_t);
+		case EV_STYLEDLABEL:
+			return sizeof(drawStyledLabelEvent_t);
+		default:
+			return 0;
+	}
+}
+
+// Record the GX output of a single event into its display list, growing it as needed.
+// Every attempt draws from the same state, so animations step once a frame however many it takes.
+static bool recordEvent(uiDrawObj_t *videoEvent) {
+	union {
+		drawProgressEvent_t progress;
+		drawStyledLabelEvent_t styledLabel;
+	} state;
+	size_t stateSize = animatedStateSize(videoEvent);
+	if(stateSize) {
+		memcpy(&state, videoEvent->data, stateSize);
+	}
+	u32 capacity = videoEvent->dispListCapacity ? videoEvent->dispListCapacity : DISPLIST_MIN_SIZE;
+	for(; capacity <= DISPLIST_MAX_SIZE; capacity <<= 1) {
+		if(stateSize) {
+			memcpy(videoEvent->data, &state, stateSize);
+		}
+		if(capacity != videoEvent->dispListCapacity) {
+			free(videoEvent->dispList);
+			videoEvent->dispList = memalign(32, capacity);
+			videoEvent->dispListCapacity = videoEvent->dispList ? capacity : 0;
+			if(!videoEvent->dispList) {
+				break;
+			}
+		}
+		DCInvalidateRange(videoEvent->dispList, capacity);
+		GX_BeginDispList(videoEvent->dispList, capacity);
+		videoDrawEvent(videoEvent);
+		videoEvent->dispListSize = GX_EndDispList();
+		if(videoEvent->dispListSize) {
+			videoEvent->dirty = false;
+			videoEvent->generation = videoCacheGen;
+			return true;
+		}
+	}
+	// The caller draws it in immediate mode instead
+	if(stateSize) {
+		memcpy(videoEvent->data, &state, stateSize);
+	}
+	videoEvent->dispListSize = 0;
+	return false;
+}
+
+static void callVideoFrame() {
+	int i;
+	for(i = 0; i < videoFrameCount; i++) {
+		GX_CallDispList(videoFrame[i].dispList, videoFrame[i].dispListSize);
+	}
+	videoFrameCount = 0;
+}
+
+// Add the display list of an event to this frame, recording it first if stale
+static void snapshotEvent(uiDrawObj_t *videoEvent) {
+	if(videoEvent->type == EV_CONTAINER) {
+		return;
+	}
+	if(!videoEvent->dispListSize || videoEvent->dirty || videoEvent->generation != videoCacheGen || isAnimatedEvent(videoEvent)) {
+		if(!recordEvent(videoEvent)) {
+			// Keep the draw order and fall back to immediate mode
+			callVideoFrame();
+			videoDrawEvent(videoEvent);
+			return;
+		}
+	}
+	if(videoFrameCount == videoFrameCapacity) {
+		int capacity = videoFrameCapacity ? videoFrameCapacity*2 : 64;
+		videoFrameEntry_t *frame = realloc(videoFrame, capacity * sizeof(videoFrameEntry_t));
+		if(!frame) {
+			callVideoFrame();
+			GX_CallDispList(videoEvent->dispList, videoEvent->dispListSize);
+			return;
+		}
+		videoFrame = frame;
+		videoFrameCapacity = capacity;
 	}
+	videoFrame[videoFrameCount].dispList = videoEvent->dispList;
+	videoFrame[videoFrameCount].dispListSize = videoEvent->dispListSize;
+	videoFrameCount++;
 }
 
 static void markDisposed(uiDrawObj_t *evt)
@@ -2048,45 +2167,46 @@ static void *videoUpdate(void *videoEventQueue) {
 	while(threadAlive) {
 		whichfb ^= 1;
 		//frames++;
+		LWP_MutexLock(_framemutex);
 		LWP_MutexLock(_videomutex);
-		// Mark events recursively as disposed
-		uiDrawObjQueue_t *videoEventQueueEntry = (uiDrawObjQueue_t*)videoEventQueue;
-		while(videoEventQueueEntry != NULL) {
+		// Free events marked for disposal, the root event always stays
+		uiDrawObjQueue_t **link = &((uiDrawObjQueue_t*)videoEventQueue)->next;
+		while(*link != NULL) {
+			uiDrawObjQueue_t *videoEventQueueEntry = *link;
 			uiDrawObj_t *videoEvent = videoEventQueueEntry->event;
 			if(videoEvent->disposed) {
 				markDisposed(videoEvent);
+				clearNestedEvent(videoEvent);
+				*link = videoEventQueueEntry->next;
+				free(videoEventQueueEntry);
+				continue;
 			}
-			videoEventQueueEntry = videoEventQueueEntry->next;
+			link = &videoEventQueueEntry->next;
 		}
-		// Free events
-		videoEventQueueEntry = (uiDrawObjQueue_t*)videoEventQueue;
+		
+		// Snapshot the display lists of every event, re-recording only what changed
+		uiDrawObjQueue_t *videoEventQueueEntry = (uiDrawObjQueue_t*)videoEventQueue;
 		while(videoEventQueueEntry != NULL) {
 			uiDrawObj_t *videoEvent = videoEventQueueEntry->event;
-			// Remove any video events marked for disposal
-			if(videoEvent->disposed) {
-				disposeEvent(videoEvent);
-				videoEventQueueEntry = (uiDrawObjQueue_t*)videoEventQueue;
-				continue;
+			while(videoEvent != NULL) {
+				snapshotEvent(videoEvent);
+				videoEvent = videoEvent->child;
 			}
 			videoEventQueueEntry = videoEventQueueEntry->next;
 		}
+		LWP_MutexUnlock(_videomutex);
 		
 		// Draw out every event
-		videoEventQueueEntry = (uiDrawObjQueue_t*)videoEventQueue;
-		while(videoEventQueueEntry != NULL) {
-			uiDrawObj_t *videoEvent = videoEventQueueEntry->event;
-			videoDrawEvent(videoEvent);
-			videoEventQueueEntry = videoEventQueueEntry->next;
-		}
+		callVideoFrame();
 		
 		//Copy EFB->XFB
 		GX_SetCopyClear((GXColor){0, 0, 0, 0xFF}, GX_MAX_Z24);
 		GX_CopyDisp(xfb[whichfb],GX_TRUE);
 		GX_DrawDone();
 
-		LWP_MutexUnlock(_videomutex);
 		VIDEO_SetNextFramebuffer(xfb[whichfb]);
 		VIDEO_Flush();
+		LWP_MutexUnlock(_framemutex);
 		VIDEO_WaitVSync();
 	}
 	return NULL;
@@ -2117,9 +2237,13 @@ void DrawAddChild(uiDrawObj_t *parent, uiDrawObj_t *child)
 
 void DrawDispose(uiDrawObj_t *evt)
 {
+	// Waits out the frame in flight, its display lists may still point at textures
+	// the caller frees once this returns. The next frame drops the event unseen
+	LWP_MutexLock(_framemutex);
 	LWP_MutexLock(_videomutex);
 	evt->disposed = true;
 	LWP_MutexUnlock(_videomutex);
+	LWP_MutexUnlock(_framemutex);
 }
 
 void DrawInit() {
@@ -2131,6 +2255,7 @@ void DrawInit() {
 	DrawAddChild(container, buttonPanel);
 	DrawPublish(container);
 	LWP_MutexInit(&_videomutex, 0);
+	LWP_MutexInit(&_framemutex, 0);
 	threadAlive = 1;
 	LWP_CreateThread(&video_thread, videoUpdate, videoEventQueue, video_thread_stack, VIDEO_STACK_SIZE, VIDEO_PRIORITY);
 }
@@ -2203,18 +2328,25 @@ void DrawLoadBackdrop() {
 		TPL_CloseTPLFile(&backdropTPL);
 		free(backdropFile);
 	}
+	LWP_MutexLock(_videomutex);
+	videoCacheGen++;
+	LWP_MutexUnlock(_videomutex);
 }
 
 void DrawShutdown() {
 	LWP_MutexDestroy(_videomutex);
 	threadAlive = 0;
 	LWP_JoinThread(video_thread, NULL);
+	LWP_MutexDestroy(_framemutex);
 	GX_SetCurrentGXThread();
 }
 
 void DrawVideoMode(GXRModeObj *videoMode)
 {
+	LWP_MutexLock(_framemutex);
 	LWP_MutexLock(_videomutex);
 	setVideoMode(videoMode);
+	videoCacheGen++;
 	LWP_MutexUnlock(_videomutex);
+	LWP_MutexUnlock(_framemutex);
 }
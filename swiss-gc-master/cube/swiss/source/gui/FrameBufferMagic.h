@@ -45,6 +45,11 @@ typedef struct uiDrawObj {
 	void *data;
 	struct uiDrawObj *child;
 	bool disposed;
+	bool dirty;				// GX output must be recorded again
+	u32 generation;			// Cache generation the display list was recorded in
+	void *dispList;			// Recorded GX output of this object (not its children)
+	u32 dispListSize;
+	u32 dispListCapacity;
 } uiDrawObj_t;
 
 enum TextureId
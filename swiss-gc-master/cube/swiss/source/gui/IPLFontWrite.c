@@ -12,20 +12,20 @@
 #include <stdlib.h>
 #include <ogcsys.h>
 #include <string.h>
+#include <math.h>
 #include "IPLFontWrite.h"
 
 extern void __SYS_ReadROM(void *buf,u32 len,u32 offset);
 extern void usleep(int s);
 
 #define FONT_TEX_SIZE_I4 ((512*512)>>1)
-#define FONT_SIZE_ANSI (288 + 131072)
 #define STRHEIGHT_OFFSET 0
 
 typedef struct {
 	u16 s[256], t[256], font_size[256], fheight;
 } CHAR_INFO;
 
-static unsigned char fontFont[ 0x40000 ] __attribute__((aligned(32)));
+static unsigned char fontFont[ FONT_TEX_SIZE_I4 ] __attribute__((aligned(32)));
 
 u16 frameWidth;
 CHAR_INFO fontChars;
@@ -37,108 +37,132 @@ GXColor deSelectedColor = (GXColor) {80,80,73,255};
 /****************************************************************************
  * YAY0 Decoding
  ****************************************************************************/
-/* Yay0 decompression */
-void decodeYay0(unsigned char *s, unsigned char *d)
-{
-	int i, j, k, p, q, cnt;
-
-	i = *(unsigned long *)(s + 4);	  // size of decoded data
-	j = *(unsigned long *)(s + 8);	  // link table
-	k = *(unsigned long *)(s + 12);	 // byte chunks and count modifiers
+// Room for the font header and width table, which precede the sheet image
+#define FONT_HEADER_SIZE 0x200
 
-	q = 0;					// current offset in dest buffer
-	cnt = 0;				// mask bit counter
-	p = 16;					// current offset in mask table
+// I2 byte to the two I4 bytes it expands to. Both formats use 8x8 tiles, so
+// the I4 sheet is simply the I2 sheet with every byte doubled up in place.
+static u8 i2toi4[256][2];
 
-	unsigned long r22 = 0, r5;
-	
-	do
-	{
-		// if all bits are done, get next mask
-		if(cnt == 0)
-		{
-			// read word from mask data block
-			r22 = *(unsigned long *)(s + p);
-			p += 4;
-			cnt = 32;   // bit counter
-		}
-		// if next bit is set, chunk is non-linked
-		if(r22 & 0x80000000)
-		{
-			// get next byte
-			*(unsigned char *)(d + q) = *(unsigned char *)(s + k);
-			k++, q++;
-		}
-		// do copy, otherwise
-		else
-		{
-			// read 16-bit from link table
-			int r26 = *(unsigned short *)(s + j);
-			j += 2;
-			// 'offset'
-			int r25 = q - (r26 & 0xfff);
-			// 'count'
-			int r30 = r26 >> 12;
-			if(r30 == 0)
-			{
-				// get 'count' modifier
-				r5 = *(unsigned char *)(s + k);
-				k++;
-				r30 = r5 + 18;
-			}
-			else r30 += 2;
-			// do block copy
-			unsigned char *pt = ((unsigned char*)d) + r25;
-			int i;
-			for(i=0; i<r30; i++)
-			{
-				*(unsigned char *)(d + q) = *(unsigned char *)(pt - 1);
-				q++, pt++;
-			}
-		}
-		// next bit in mask
-		r22 <<= 1;
-		cnt--;
+static void initI2toI4(void)
+{
+	int v;
+	for (v = 0; v < 256; v++) {
+		i2toi4[v][0] = ((v>>6)&3)*0x50 + ((v>>4)&3)*0x05;
+		i2toi4[v][1] = ((v>>2)&3)*0x50 + ((v)&3)*0x05;
+	}
+}
 
-	} while(q < i);
+// Byte n of the decoded font, read back from wherever it was stored
+static inline u8 fontByte(u8 *header, u8 *sheet, u32 sheet_offset, u32 n)
+{
+	if (n < sheet_offset)
+		return header[n];
+	u8 *p = sheet + ((n - sheet_offset) << 1);
+	return (p[0] & 0xC0) | ((p[0] & 3) << 4) | ((p[1] & 0xC0) >> 4) | (p[1] & 3);
 }
 
-void convertI2toI4(void *dst, void *src, int xres, int yres)
+static inline void fontPut(u8 *header, u8 *sheet, u32 sheet_offset, u32 n, u8 v)
 {
-	// I4 has 8x8 tiles
-	int x, y;
-	unsigned char *d = (unsigned char*)dst;
-	unsigned char *s = (unsigned char*)src;
+	if (n < sheet_offset) {
+		if (n < FONT_HEADER_SIZE)
+			header[n] = v;
+	} else {
+		u8 *p = sheet + ((n - sheet_offset) << 1);
+		p[0] = i2toi4[v][0];
+		p[1] = i2toi4[v][1];
+	}
+}
 
-	for (y = 0; y < yres; y += 8)
-		for (x = 0; x < xres; x += 8)
-		{
-			int iy, ix;
-			for (iy = 0; iy < 8; ++iy, s+=2)
-			{
-				for (ix = 0; ix < 2; ++ix)
-				{
-					int v = s[ix];
-					*d++ = (((v>>6)&3)<<6) | (((v>>6)&3)<<4) | (((v>>4)&3)<<2) | ((v>>4)&3);
-					*d++ = (((v>>2)&3)<<6) | (((v>>2)&3)<<4) | (((v)&3)<<2) | ((v)&3);
+/* Yay0 decompression of the IPL font, straight to an I4 sheet.
+ * The header and width table go to header, the I2 sheet image is expanded
+ * into sheet as it is decoded. Back-references are resolved against the
+ * expanded output, so no intermediate I2 copy of the font is kept. */
+void decodeYay0FontI4(u8 *s, u8 *header, u8 *sheet)
+{
+	u32 size = *(u32 *)(s + 4);	// size of decoded data
+	u32 j = *(u32 *)(s + 8);	// link table
+	u32 k = *(u32 *)(s + 12);	// byte chunks and count modifiers
+	u32 p = 16;			// current offset in mask table
+	u32 q = 0;			// current offset in decoded data
+	u32 sheet_offset = ~0;		// unknown until the header is decoded
+
+	while (q < size) {
+		// consume the mask a word at a time
+		u32 mask = *(u32 *)(s + p);
+		int cnt = 32;
+		p += 4;
+
+		while (cnt && q < size) {
+			// a run of set bits is a run of literal bytes
+			int run = mask == 0xFFFFFFFF ? cnt : __builtin_clz(~mask);
+			if (run > cnt) run = cnt;
+			if (run > size - q) run = size - q;
+			if (run) {
+				int n;
+				for (n = 0; n < run; n++)
+					fontPut(header, sheet, sheet_offset, q++, s[k++]);
+				mask <<= run - 1;
+				mask <<= 1;
+				cnt -= run;
+			} else {
+				u16 link = *(u16 *)(s + j);
+				u32 dist = (link & 0xfff) + 1;
+				u32 count = link >> 12;
+				u32 from = q - dist;
+				j += 2;
+				count = count ? count + 2 : s[k++] + 18;
+				if (count > size - q) count = size - q;
+
+				if (from >= sheet_offset) {
+					u8 *d = sheet + ((q - sheet_offset) << 1);
+					u8 *f = sheet + ((from - sheet_offset) << 1);
+					if (count <= dist) {
+						memcpy(d, f, count << 1);
+					} else {
+						u32 n;
+						for (n = 0; n < count << 1; n++)
+							d[n] = f[n];
+					}
+					q += count;
+				} else {
+					for (; count; count--)
+						fontPut(header, sheet, sheet_offset, q++, fontByte(header, sheet, sheet_offset, from++));
 				}
+				mask <<= 1;
+				cnt--;
+			}
+
+			// once the header is in, move anything past the sheet image offset over to the sheet
+			if (sheet_offset == ~0 && q >= sizeof(sys_fontheader)) {
+				u32 n;
+				sheet_offset = ((sys_fontheader *)header)->sheet_image;
+				if (sheet_offset > FONT_HEADER_SIZE)
+					sheet_offset = FONT_HEADER_SIZE;
+				// the I4 sheet only has room for a 512x512 texture
+				if (size > sheet_offset + (FONT_TEX_SIZE_I4 >> 1))
+					size = sheet_offset + (FONT_TEX_SIZE_I4 >> 1);
+				for (n = sheet_offset; n < q; n++)
+					fontPut(header, sheet, sheet_offset, n, header[n]);
 			}
 		}
+	}
 }
 
 void init_font(void)
 {
-	void* fontArea = memalign(32,FONT_SIZE_ANSI);
-	memset(fontArea,0,FONT_SIZE_ANSI);
-	void* packed_data = (void*)(((u32)fontArea+119072)&~31);
-	void* unpacked_data = (void*)((u32)fontArea+288);
+	u8 header[FONT_HEADER_SIZE] __attribute__((aligned(32)));
+	void* packed_data = memalign(32,0x3000);
 	__SYS_ReadROM(packed_data,0x3000,0x1FCF00);
-	decodeYay0(packed_data,unpacked_data);
-
-	sys_fontheader *fontData = (sys_fontheader*)unpacked_data;
 
-	convertI2toI4((void*)fontFont, (void*)((u32)unpacked_data+fontData->sheet_image), fontData->sheet_width, fontData->sheet_height);
+	initI2toI4();
+	memset(header,0,FONT_HEADER_SIZE);
+	memset(fontFont,0,FONT_TEX_SIZE_I4);
+	decodeYay0FontI4(packed_data,header,fontFont);
 	DCFlushRange(fontFont, FONT_TEX_SIZE_I4);
+	free(packed_data);
+
+	sys_fontheader *fontData = (sys_fontheader*)header;
 
 	int i;
 	for (i=0; i<256; ++i)
@@ -148,7 +172,7 @@ void init_font(void)
 		if ((c < fontData->first_char) || (c > fontData->last_char)) c = fontData->inval_char;
 		else c -= fontData->first_char;
 
-		fontChars.font_size[i] = ((unsigned char*)fontData)[fontData->width_table + c];
+		fontChars.font_size[i] = header[fontData->width_table + c];
 
 		int r = c / fontData->sheet_column;
 		c %= fontData->sheet_column;
@@ -158,8 +182,6 @@ void init_font(void)
 	}
 	
 	fontChars.fheight = fontData->cell_height;
-
-	free(fontArea);
 }
 
 void drawFontInit(void)
@@ -189,7 +211,7 @@ void drawFontInit(void)
 	//set vertex attribute formats here
 	GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_POS, GX_POS_XYZ, GX_S16, 0);
 	GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_CLR0, GX_CLR_RGBA, GX_RGBA8, 0);
-	GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_TEX0, GX_TEX_ST, GX_F32, 0);
+	GX_SetVtxAttrFmt(GX_VTXFMT1, GX_VA_TEX0, GX_TEX_ST, GX_U16, 9);	// Texels on the 512x512 sheet
 
 	//enable textures
 	GX_SetNumChans (1);
@@ -220,105 +242,6 @@ void drawFontInit(void)
 	GX_SetCullMode (GX_CULL_NONE);
 }
 
-void drawString(int x, int y, char *string, float scale, bool centered, GXColor fontColor)
-{
-	if(string == NULL) {
-		return;
-	}
-	drawFontInit();
-	if(centered)
-	{
-		int strWidth = 0;
-		int strHeight = (fontChars.fheight+STRHEIGHT_OFFSET) * scale;
-		char* string_work = string;
-		while(*string_work)
-		{
-			unsigned char c = *string_work;
-			strWidth += (int) fontChars.font_size[c] * scale;
-			string_work++;
-		}
-		x = (int) x - strWidth/2;
-		y = (int) y - strHeight/2;
-	}
-
-	while (*string)
-	{
-		unsigned char c = *string;
-		if(c == '\n') break;
-		int i;
-		GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
-		for (i=0; i<4; i++) {
-			int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
-			int t = (i & 2) ? fontChars.fheight : 1;
-			float s0 = ((float) (fontChars.s[c] + s))/512;
-			float t0 = ((float) (fontChars.t[c] + t))/512;
-			s = (int) s * scale;
-			t = (int) t * scale;
-			GX_Position3s16(x + s, y + t, 0);
-			GX_Color4u8(fontColor.r, fontColor.g, fontColor.b, fontColor.a);
-			GX_TexCoord2f32(s0, t0);
-		}
-		GX_End();
-
-		x += (int) fontChars.font_size[c] * scale;
-		string++;
-	}
-}
-
-void drawStringWithCaret(int x, int y, char *string, float scale, bool centered, GXColor fontColor, int caretPosition, GXColor caretColor)
-{
-	if(string == NULL) {
-		string = "";
-	}
-	drawFontInit();
-	if(centered)
-	{
-		int strWidth = 0;
-		int strHeight = (fontChars.fheight+STRHEIGHT_OFFSET) * scale;
-		char* string_work = string;
-		while(*string_work)
-		{
-			unsigned char c = *string_work;
-			strWidth += (int) fontChars.font_size[c] * scale;
-			string_work++;
-		}
-		x = (int) x - strWidth/2;
-		y = (int) y - strHeight/2;
-	}
-
-	int pos = 0;
-	while (*string || pos <= caretPosition)
-	{
-		unsigned char c = *string;
-		if(pos == caretPosition) { 
-			c = '|';
-		}
-		if(c == '\n') break;
-		int i;
-		GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
-		for (i=0; i<4; i++) {
-			int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
-			int t = (i & 2) ? fontChars.fheight : 1;
-			float s0 = ((float) (fontChars.s[c] + s))/512;
-			float t0 = ((float) (fontChars.t[c] + t))/512;
-			s = (int) s * scale;
-			t = (int) t * scale;
-			GX_Position3s16(x + s, y + t, 0);
-			if(pos == caretPosition)
-				GX_Color4u8(caretColor.r, caretColor.g, caretColor.b, caretColor.a);
-			else
-				GX_Color4u8(fontColor.r, fontColor.g, fontColor.b, fontColor.a);
-			GX_TexCoord2f32(s0, t0);
-		}
-		GX_End();
-
-		x += (int) fontChars.font_size[c] * scale;
-		if(pos != caretPosition)
-			string++;
-		pos++;
-	}
-}
-
 int GetCharsThatFitInWidth(char *string, int max, float scale)
 {
 	int strWidth = 0;
@@ -340,13 +263,37 @@ int GetCharsThatFitInWidth(char *string, int max, float scale)
 	return charCount;
 }
 
-// maxSize is how far we can draw, abbreviate with "..." if we're going to exceed it.
-void drawStringEllipsis(int x, int y, char *string, float scale, bool centered, GXColor fontColor, bool rotateVertical, int maxSize)
+// 4 vertices of x, y, s, t per glyph
+#define GLYPH_VERTICES 16
+#define GLYPH_STACK_MAX 128
+
+static void layoutGlyph(s16 *v, int x, int y, unsigned char c, float scale, bool rotateVertical)
 {
-	if(string == NULL) {
-		return;
+	int i;
+	for (i=0; i<4; i++) {
+		int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
+		int t = (i & 2) ? fontChars.fheight : 1;
+		v[2] = fontChars.s[c] + s;
+		v[3] = fontChars.t[c] + t;
+		s = (int) s * scale;
+		t = (int) t * scale;
+		if(rotateVertical) {
+			v[0] = x + t;
+			v[1] = y - s;
+		} else {
+			v[0] = x + s;
+			v[1] = y + t;
+		}
+		v += 4;
 	}
-	drawFontInit();
+}
+
+// Lays out the glyphs of a string relative to where it will be drawn and returns how many
+// there are, filling in at most maxGlyphs of them. Stops at the first newline, abbreviates
+// with "..." past maxSize if it's not 0, and puts a '|' glyph at caretPosition if it's not -1.
+static int layoutString(s16 *v, int maxGlyphs, char *string, float scale, bool centered, bool rotateVertical, int maxSize, int caretPosition)
+{
+	int x = 0, y = 0;
 	if(centered)
 	{
 		int strWidth = 0;
@@ -358,16 +305,17 @@ void drawStringEllipsis(int x, int y, char *string, float scale, bool centered,
 			strWidth += (int) fontChars.font_size[c] * scale;
 			string_work++;
 		}
-		x = (int) x - strWidth/2;
-		y = (int) y - strHeight/2;
+		x = -strWidth/2;
+		y = -strHeight/2;
 	}
 
 	int len = strlen(string);
-	int chars_to_draw = GetCharsThatFitInWidth(string, maxSize-12, scale);
+	int chars_to_draw = maxSize ? GetCharsThatFitInWidth(string, maxSize-12, scale) : -1;
 	int dots_to_write = 0;
-	while (*string || dots_to_write)
+	int pos = 0, numGlyphs = 0;
+	while (dots_to_write || *string || pos <= caretPosition)
 	{
-		unsigned char c = *string;
+		unsigned char c;
 		if(dots_to_write) {
 			c = '.';
 			dots_to_write --;
@@ -375,38 +323,30 @@ void drawStringEllipsis(int x, int y, char *string, float scale, bool centered,
 				break;
 			}
 		}
+		else {
+			c = pos == caretPosition ? '|' : *string;
+		}
 		if(c == '\n') break;
 
-		int i;
-		GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
-		for (i=0; i<4; i++) {
-			int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
-			int t = (i & 2) ? fontChars.fheight : 1;
-			float s0 = ((float) (fontChars.s[c] + s))/512;
-			float t0 = ((float) (fontChars.t[c] + t))/512;
-			s = (int) s * scale;
-			t = (int) t * scale;
-			if(rotateVertical) {
-				GX_Position3s16(x + t, y - s, 0);
-			} else {
-				GX_Position3s16(x + s, y + t, 0);
-			}
-			GX_Color4u8(fontColor.r, fontColor.g, fontColor.b, fontColor.a);
-			GX_TexCoord2f32(s0, t0);
+		if(numGlyphs < maxGlyphs) {
+			layoutGlyph(v, x, y, c, scale, rotateVertical);
+			v += GLYPH_VERTICES;
 		}
-		GX_End();
+		numGlyphs++;
 
+		// Whole pixel advances, as when the pen was kept in positive screen coordinates
 		if(rotateVertical) {
-			y -= (int) fontChars.font_size[c] * scale;
+			y -= (int) ceilf(fontChars.font_size[c] * scale);
 		} else {
-			x += (int) fontChars.font_size[c] * scale;
+			x += (int) (fontChars.font_size[c] * scale);
 		}
 
-		string++;
+		if(pos != caretPosition && *string)
+			string++;
+		pos++;
 		len--;
 		chars_to_draw--;
-		maxSize -= (int) fontChars.font_size[c] * scale;
-		
+
 		// check if we've started (or about to start) our ellipses abbreviation
 		if(len > 0 && chars_to_draw == 0) {
 			if(dots_to_write == 0) {
@@ -414,6 +354,109 @@ void drawStringEllipsis(int x, int y, char *string, float scale, bool centered,
 			}
 		}
 	}
+	return numGlyphs;
+}
+
+// All glyphs of a string go out in a single batch
+static void drawGlyphs(s16 *v, int numGlyphs, int x, int y, GXColor fontColor, int caretGlyph, GXColor caretColor)
+{
+	if(!numGlyphs) {
+		return;
+	}
+	int i;
+	GX_Begin(GX_QUADS, GX_VTXFMT1, numGlyphs*4);
+	for (i=0; i<numGlyphs*4; i++) {
+		GXColor color = (i>>2) == caretGlyph ? caretColor : fontColor;
+		GX_Position3s16(x + v[0], y + v[1], 0);
+		GX_Color4u8(color.r, color.g, color.b, color.a);
+		GX_TexCoord2u16(v[2], v[3]);
+		v += 4;
+	}
+	GX_End();
+}
+
+static void drawLaidOut(int x, int y, char *string, float scale, bool centered, GXColor fontColor, bool rotateVertical, int maxSize, int caretPosition, GXColor caretColor)
+{
+	s16 stackVertices[GLYPH_STACK_MAX*GLYPH_VERTICES];
+	s16 *v = stackVertices;
+	int numGlyphs = layoutString(v, GLYPH_STACK_MAX, string, scale, centered, rotateVertical, maxSize, caretPosition);
+	if(numGlyphs > GLYPH_STACK_MAX) {
+		v = malloc(numGlyphs*GLYPH_VERTICES*sizeof(s16));
+		if(!v) {
+			return;
+		}
+		layoutString(v, numGlyphs, string, scale, centered, rotateVertical, maxSize, caretPosition);
+	}
+	drawGlyphs(v, numGlyphs, x, y, fontColor, caretPosition < 0 ? -1 : caretPosition, caretColor);
+	if(v != stackVertices) {
+		free(v);
+	}
+}
+
+void drawString(int x, int y, char *string, float scale, bool centered, GXColor fontColor)
+{
+	if(string == NULL) {
+		return;
+	}
+	drawFontInit();
+	drawLaidOut(x, y, string, scale, centered, fontColor, false, 0, -1, fontColor);
+}
+
+void drawStringWithCaret(int x, int y, char *string, float scale, bool centered, GXColor fontColor, int caretPosition, GXColor caretColor)
+{
+	if(string == NULL) {
+		string = "";
+	}
+	drawFontInit();
+	drawLaidOut(x, y, string, scale, centered, fontColor, false, 0, caretPosition, caretColor);
+}
+
+// maxSize is how far we can draw, abbreviate with "..." if we're going to exceed it.
+void drawStringEllipsis(int x, int y, char *string, float scale, bool centered, GXColor fontColor, bool rotateVertical, int maxSize)
+{
+	if(string == NULL) {
+		return;
+	}
+	drawFontInit();
+	drawLaidOut(x, y, string, scale, centered, fontColor, rotateVertical, maxSize, -1, fontColor);
+}
+
+textLayout_t* LayoutText(char *string, float scale, int fitWidth, bool centered)
+{
+	if(string == NULL) {
+		return NULL;
+	}
+	textLayout_t *layout = calloc(1, sizeof(textLayout_t));
+	if(!layout) {
+		return NULL;
+	}
+	layout->width = GetTextSizeInPixels(string);
+	layout->scale = fitWidth > 0 ? GetTextScaleToFitInWidthWithMax(string, fitWidth, scale) : scale;
+	layout->numGlyphs = layoutString(NULL, 0, string, layout->scale, centered, false, 0, -1);
+	layout->vertices = malloc(layout->numGlyphs*GLYPH_VERTICES*sizeof(s16));
+	if(!layout->vertices) {
+		free(layout);
+		return NULL;
+	}
+	layoutString(layout->vertices, layout->numGlyphs, string, layout->scale, centered, false, 0, -1);
+	return layout;
+}
+
+void drawTextLayout(textLayout_t *layout, int x, int y, GXColor fontColor)
+{
+	if(layout == NULL) {
+		return;
+	}
+	drawFontInit();
+	drawGlyphs(layout->vertices, layout->numGlyphs, x, y, fontColor, -1, fontColor);
+}
+
+void FreeTextLayout(textLayout_t *layout)
+{
+	if(layout) {
+		free(layout->vertices);
+		free(layout);
+	}
 }
 
 int GetFontHeight(float scale)
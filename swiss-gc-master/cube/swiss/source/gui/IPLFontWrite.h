@@ -18,6 +18,14 @@ extern GXColor disabledColor;
 extern GXColor deSelectedColor;
 extern char txtbuffer[2048];
 
+// A string laid out once, to be drawn as many times as needed
+typedef struct textLayout {
+	int width;			// Unscaled width in pixels
+	float scale;		// Scale the glyphs were laid out at, after fitting
+	int numGlyphs;
+	s16 *vertices;		// x, y, s, t of 4 vertices per glyph, relative to the draw position
+} textLayout_t;
+
 void init_font(void);
 void drawString(int x, int y, char *string, float scale, bool centered, GXColor fontColor);
 void drawStringWithCaret(int x, int y, char *string, float scale, bool centered, GXColor fontColor, int caretPosition, GXColor caretColor);
@@ -26,5 +34,8 @@ int GetFontHeight(float scale);
 int GetTextSizeInPixels(char *string);
 float GetTextScaleToFitInWidth(char *string, int width);
 float GetTextScaleToFitInWidthWithMax(char *string, int width, float max);
+textLayout_t* LayoutText(char *string, float scale, int fitWidth, bool centered);
+void drawTextLayout(textLayout_t *layout, int x, int y, GXColor fontColor);
+void FreeTextLayout(textLayout_t *layout);
 
 #endif
@@ -34,6 +34,7 @@ char *forcePollRateStr[] = {"No", "VSync", "1000Hz", "500Hz", "350Hz", "300Hz",
 char *invertCStickStr[] = {"No", "X", "Y", "X&Y"};
 char *disableVideoPatchesStr[] = {"None", "Game", "All"};
 char *emulateReadSpeedStr[] = {"No", "Yes", "Wii"};
+char *bootPrefetchStr[] = {"Off", "2 MB", "4 MB", "8 MB"};
 char *igrTypeStr[] = {"Disabled", "Reboot", "igr.dol"};
 char *aveCompatStr[] = {"CMPV-DOL", "GCVideo", "AVE-RVL", "AVE N-DOL"};
 char *fileBrowserStr[] = {"Standard", "Carousel"};
@@ -68,6 +69,7 @@ static char *tooltips_game_global[PAGE_GAME_GLOBAL_MAX+1] = {
 	"Boot through IPL:\n\nWhen enabled, games will be booted with the GameCube\nlogo screen and Main Menu accessible with patches applied.",
 	NULL,
 	NULL,
+	"Boot Prefetch:\n\nRecords what a game reads as it starts, up to the size set.\nOn the next boot that data is loaded into ARAM beforehand\nand read from there instead of over the network.\n\nLoading 8 MB beforehand takes about 6.5 seconds over FSP and\nsaves the game about 4.5, trading a wait in Swiss for fewer\nstalls in the game.\n\nThe reads are stored on the SD card holding the patches once\nthe game has booted, or otherwise left for Swiss on a reset.",
 	NULL,
 	NULL,
 	"Pause for resolution change:\n\nWhen enabled, a change in active video resolution will pause\nthe game for 2 seconds.",
@@ -293,10 +295,12 @@ uiDrawObj_t* settings_draw_page(int page_num, int option, ConfigEntry *gameConfi
 		DrawAddChild(page, DrawLabel(page_x_ofs_key, 65, "Global Game Settings (3/5):"));
 		bool enabledVideoPatches = swissSettings.disableVideoPatches < 2;
 		bool emulatedMemoryCard = devices[DEVICE_CUR] == NULL || (devices[DEVICE_CUR]->emulable & EMU_MEMCARD);
+		bool emulatedBootPrefetch = devices[DEVICE_CUR] == NULL || (devices[DEVICE_CUR]->emulable & EMU_BOOT_PREFETCH);
 		drawSettingEntryString(page, &page_y_ofs, "In-Game Reset:", igrTypeStr[swissSettings.igrType], option == SET_IGR, true);
 		drawSettingEntryString(page, &page_y_ofs, "Boot through IPL:", bs2BootStr[swissSettings.bs2Boot], option == SET_BS2BOOT, true);
 		drawSettingEntryBoolean(page, &page_y_ofs, "Boot without prompts:", swissSettings.autoBoot, option == SET_AUTOBOOT, true);
 		drawSettingEntryBoolean(page, &page_y_ofs, "Emulate Memory Card:", swissSettings.emulateMemoryCard, option == SET_EMULATE_MEMCARD, emulatedMemoryCard);
+		drawSettingEntryString(page, &page_y_ofs, "Boot Prefetch:", bootPrefetchStr[swissSettings.bootPrefetch], option == SET_BOOT_PREFETCH, emulatedBootPrefetch);
 		drawSettingEntryBoolean(page, &page_y_ofs, "Force Video Active:", swissSettings.forceVideoActive, option == SET_FORCE_VIDACTIVE, enabledVideoPatches);
 		drawSettingEntryString(page, &page_y_ofs, "Disable Video Patches:", disableVideoPatchesStr[swissSettings.disableVideoPatches], option == SET_ENABLE_VIDPATCH, true);
 		drawSettingEntryBoolean(page, &page_y_ofs, "Pause for resolution change:", swissSettings.pauseAVOutput, option == SET_PAUSE_AVOUTPUT, true);
@@ -569,6 +573,15 @@ void settings_toggle(int page, int option, int direction, ConfigEntry *gameConfi
 				if(devices[DEVICE_CUR] == NULL || (devices[DEVICE_CUR]->emulable & EMU_MEMCARD))
 					swissSettings.emulateMemoryCard ^= 1;
 			break;
+			case SET_BOOT_PREFETCH:
+				if(devices[DEVICE_CUR] == NULL || (devices[DEVICE_CUR]->emulable & EMU_BOOT_PREFETCH)) {
+					swissSettings.bootPrefetch += direction;
+					if(swissSettings.bootPrefetch > 3)
+						swissSettings.bootPrefetch = 0;
+					if(swissSettings.bootPrefetch < 0)
+						swissSettings.bootPrefetch = 3;
+				}
+			break;
 			case SET_FORCE_VIDACTIVE:
 				if(swissSettings.disableVideoPatches < 2)
 					swissSettings.forceVideoActive ^= 1;
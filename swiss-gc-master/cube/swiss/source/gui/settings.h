@@ -68,6 +68,7 @@ enum SETTINGS_GAME_GLOBAL {
 	SET_BS2BOOT,
 	SET_AUTOBOOT,
 	SET_EMULATE_MEMCARD,
+	SET_BOOT_PREFETCH,
 	SET_FORCE_VIDACTIVE,
 	SET_ENABLE_VIDPATCH,
 	SET_PAUSE_AVOUTPUT,
@@ -131,6 +132,7 @@ extern char *forcePollRateStr[];
 extern char *invertCStickStr[];
 extern char *disableVideoPatchesStr[];
 extern char *emulateReadSpeedStr[];
+extern char *bootPrefetchStr[];
 extern char *igrTypeStr[];
 extern char *aveCompatStr[];
 extern char *fileBrowserStr[];
@@ -28,6 +28,7 @@
 #include "exi.h"
 #include "httpd.h"
 #include "config.h"
+#include "prefetch.h"
 #include "gui/FrameBufferMagic.h"
 #include "gui/IPLFontWrite.h"
 #include "devices/deviceHandler.h"
@@ -216,6 +217,7 @@ int main(int argc, char *argv[])
 	// Read Swiss settings
 	config_init(&config_migration);
 	config_parse_args(argc, argv);
+	prefetch_collect();
 	
 	// Swiss video mode force
 	GXRModeObj *forcedMode = getVideoModeFromSwissSetting(swissSettings.uiVMode);
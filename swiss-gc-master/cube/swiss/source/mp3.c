@@ -12,10 +12,142 @@
 static int useShuffle = 0;
 static int volume = 255;
 
+// Read-ahead ring, filled by a producer thread with large sequential reads
+#define MP3_RING_SIZE		(512*1024)
+#define MP3_READ_SIZE		(64*1024)
+#define MP3_STACK_SIZE		(16*1024)
+#define MP3_PRIORITY		50
+
+static u8 mp3_stack[MP3_STACK_SIZE];
+static lwp_t mp3_thread = LWP_THREAD_NULL;
+static mutex_t mp3_mutex = LWP_MUTEX_NULL;
+static cond_t mp3_cond = LWP_COND_NULL;
+static u8 *mp3_ring;
+static file_handle *mp3_file;
+static u32 mp3_pos;		// File offset the decoder reads next
+static u32 mp3_fill;	// Bytes buffered from mp3_pos on
+static u32 mp3_gen;		// Bumped on every flush, so in-flight reads are dropped
+static s32 mp3_status;	// 0 while more data may come, else EOF (0 read) or the error
+static bool mp3_done;
+static bool mp3_quit;
+
+static void *mp3_producer(void *arg) {
+	LWP_MutexLock(mp3_mutex);
+	while(!mp3_quit) {
+		u32 offset = mp3_pos + mp3_fill;
+		if(mp3_done || MP3_RING_SIZE - mp3_fill < MP3_READ_SIZE || offset >= mp3_file->size) {
+			if(!mp3_done && offset >= mp3_file->size) {
+				mp3_done = true;
+				mp3_status = 0;
+				LWP_CondBroadcast(mp3_cond);
+			}
+			LWP_CondWait(mp3_cond, mp3_mutex);
+			continue;
+		}
+		// Never wrap within a read, the tail end gets topped up next time round
+		u32 index = offset % MP3_RING_SIZE;
+		u32 size = MIN(MP3_READ_SIZE, MIN(MP3_RING_SIZE - index, mp3_file->size - offset));
+		u32 gen = mp3_gen;
+		LWP_MutexUnlock(mp3_mutex);
+		
+		// Only this thread writes past mp3_fill, so the ring can take the read directly
+		devices[DEVICE_CUR]->seekFile(mp3_file,offset,DEVICE_HANDLER_SEEK_SET);
+		s32 ret = devices[DEVICE_CUR]->readFile(mp3_file,&mp3_ring[index],size);
+		
+		LWP_MutexLock(mp3_mutex);
+		if(gen == mp3_gen) {
+			if(ret > 0) {
+				mp3_fill += ret;
+			}
+			if(ret != size) {
+				mp3_done = true;
+				mp3_status = ret < 0 ? ret : 0;
+			}
+			LWP_CondBroadcast(mp3_cond);
+		}
+	}
+	LWP_MutexUnlock(mp3_mutex);
+	return NULL;
+}
+
+static void mp3_ring_start(file_handle *file) {
+	mp3_file = file;
+	mp3_pos = mp3_fill = 0;
+	mp3_gen = 0;
+	mp3_status = 0;
+	mp3_done = mp3_quit = false;
+	LWP_MutexInit(&mp3_mutex, false);
+	LWP_CondInit(&mp3_cond);
+	mp3_thread = LWP_THREAD_NULL;
+	mp3_ring = memalign(32, MP3_RING_SIZE);
+	if(mp3_ring && LWP_CreateThread(&mp3_thread, mp3_producer, NULL, mp3_stack, MP3_STACK_SIZE, MP3_PRIORITY) < 0) {
+		mp3_thread = LWP_THREAD_NULL;
+		free(mp3_ring);
+		mp3_ring = NULL;
+	}
+	// Without the ring or a producer, mp3Reader goes to the device itself
+}
+
+static void mp3_ring_stop(void) {
+	LWP_MutexLock(mp3_mutex);
+	mp3_quit = true;
+	LWP_CondBroadcast(mp3_cond);
+	LWP_MutexUnlock(mp3_mutex);
+	if(mp3_thread != LWP_THREAD_NULL) {
+		LWP_JoinThread(mp3_thread, NULL);
+		mp3_thread = LWP_THREAD_NULL;
+	}
+	LWP_CondDestroy(mp3_cond);
+	LWP_MutexDestroy(mp3_mutex);
+	free(mp3_ring);
+	mp3_ring = NULL;
+}
+
+// Moves the read position, keeping whatever is already buffered past it
+static void mp3_ring_seek(u32 offset) {
+	LWP_MutexLock(mp3_mutex);
+	if(offset >= mp3_pos && offset - mp3_pos <= mp3_fill) {
+		mp3_fill -= offset - mp3_pos;
+	}
+	else {
+		mp3_fill = 0;
+		mp3_done = false;
+		mp3_gen++;
+	}
+	mp3_pos = offset;
+	LWP_CondBroadcast(mp3_cond);
+	LWP_MutexUnlock(mp3_mutex);
+}
+
+static u32 mp3_ring_tell(void) {
+	return mp3_pos;
+}
+
 s32 mp3Reader(void *cbdata, void *dst, s32 size) {
-	file_handle *file = cbdata;
-	devices[DEVICE_CUR]->seekFile(file,file->offset,DEVICE_HANDLER_SEEK_SET);
-	int ret = devices[DEVICE_CUR]->readFile(file,dst,size);
+	LWP_MutexLock(mp3_mutex);
+	if(mp3_thread == LWP_THREAD_NULL) {
+		devices[DEVICE_CUR]->seekFile(mp3_file,mp3_pos,DEVICE_HANDLER_SEEK_SET);
+		s32 ret = devices[DEVICE_CUR]->readFile(mp3_file,dst,size);
+		if(ret > 0) {
+			mp3_pos += ret;
+		}
+		LWP_MutexUnlock(mp3_mutex);
+		return ret;
+	}
+	while(!mp3_fill && !mp3_done && !mp3_quit) {
+		LWP_CondWait(mp3_cond, mp3_mutex);
+	}
+	s32 ret = mp3_fill ? MIN(size, mp3_fill) : mp3_status;
+	if(ret > 0) {
+		u32 index = mp3_pos % MP3_RING_SIZE;
+		u32 first = MIN(ret, MP3_RING_SIZE - index);
+		memcpy(dst, &mp3_ring[index], first);
+		memcpy((u8*)dst + first, &mp3_ring[0], ret - first);
+		mp3_pos += ret;
+		mp3_fill -= ret;
+		LWP_CondBroadcast(mp3_cond);
+	}
+	LWP_MutexUnlock(mp3_mutex);
 	return ret;
 }
 
@@ -28,7 +160,7 @@ uiDrawObj_t* updatescreen_mp3(file_handle *file, int state, int numFiles, int cu
 	DrawAddChild(player, DrawStyledLabel(640/2, 160, txtbuffer, scale, true, defaultColor));
 	memset(txtbuffer, 0, 256);
 	sprintf(txtbuffer, "------------------------------");
-	float percentPlayed = (float)(((float)file->offset / (float)file->size) * 30);
+	float percentPlayed = (float)(((float)mp3_ring_tell() / (float)file->size) * 30);
 	txtbuffer[(int)percentPlayed] = '*';
 	DrawAddChild(player, DrawStyledLabel(640/2, 210, txtbuffer, 1.0f, true, defaultColor));
 	DrawAddChild(player, DrawStyledLabel(640/2, 300, "(<-) Rewind (->) Forward (X) Vol+ (Y) Vol-", 1.0f, true, defaultColor));
@@ -40,7 +172,7 @@ uiDrawObj_t* updatescreen_mp3(file_handle *file, int state, int numFiles, int cu
 
 int play_mp3(file_handle *file, int numFiles, int curMP3) {
 	int ret = PLAYER_NEXT;
-	file->offset = 0;
+	mp3_ring_start(file);
 	MP3Player_PlayFile(file, &mp3Reader, NULL);
 	uiDrawObj_t* player = NULL;
 	while(MP3Player_IsPlaying() || ret == PLAYER_PAUSE ) {
@@ -80,8 +212,8 @@ int play_mp3(file_handle *file, int numFiles, int curMP3) {
 		}
 		else if(buttons & PAD_BUTTON_RIGHT) {		// Fwd
 			MP3Player_Stop();
-			if(file->offset+0x8000 < file->size) {
-				file->offset += 0x8000;
+			if(mp3_ring_tell()+0x8000 < file->size) {
+				mp3_ring_seek(mp3_ring_tell()+0x8000);
 				MP3Player_PlayFile(file, &mp3Reader, NULL);
 			}
 			else {
@@ -91,8 +223,8 @@ int play_mp3(file_handle *file, int numFiles, int curMP3) {
 		}
 		else if(buttons & PAD_BUTTON_LEFT) {		// Rewind
 			MP3Player_Stop();
-			if(file->offset-0x10000 > 0) file->offset -= 0x10000;
-			else file->offset = 0;
+			if(mp3_ring_tell() > 0x10000) mp3_ring_seek(mp3_ring_tell()-0x10000);
+			else mp3_ring_seek(0);
 			MP3Player_PlayFile(file, &mp3Reader, NULL);
 		}
 		else if(buttons & PAD_TRIGGER_Z) {		// Toggle Shuffle
@@ -109,6 +241,8 @@ int play_mp3(file_handle *file, int numFiles, int curMP3) {
 	}
 	if(player != NULL)
 		DrawDispose(player);
+	MP3Player_Stop();
+	mp3_ring_stop();
 	return ret;
 }
 
@@ -0,0 +1,347 @@
+/* prefetch.c
+	- records what a game reads as it boots, and has it waiting in ARAM the next time
+ */
+
+#include <gccore.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <sys/param.h>
+#include <ogc/aram.h>
+#include "swiss.h"
+#include "files.h"
+#include "config.h"
+#include "prefetch.h"
+#include "ssaram.h"
+#include "FrameBufferMagic.h"
+
+#define PREFETCH_DIR "swiss/settings/prefetch"
+#define PREFETCH_FILE "swiss/patches/prefetch.bin"	// Where the patches store the reads of the boot
+#define PREFETCH_GAP_MAX (64*1024)	// Holes up to this size are read through rather than split around
+
+#define SECTOR_FLOOR(x) ((x) & ~(PREFETCH_SECTOR_SIZE - 1))
+#define SECTOR_CEIL(x) (((x) + PREFETCH_SECTOR_SIZE - 1) & ~(PREFETCH_SECTOR_SIZE - 1))
+#define TABLE_SIZE ((sizeof(prefetch_table) + 31) & ~31)
+#define SUMS_SIZE(bytes) (((bytes) / PREFETCH_SECTOR_SIZE * sizeof(u32) + 31) & ~31)
+
+// Has to match the patches, word by word
+static u32 prefetch_checksum(const void *data, u32 length) {
+	const u32 *word = data;
+	u32 sum = 0x811C9DC5;
+	for(; length >= 4; length -= 4) {
+		sum = (sum ^ *word++) * 0x01000193;
+	}
+	return sum;
+}
+
+static u32 trace_checksum(prefetch_trace *trace) {
+	return prefetch_checksum(trace->id, offsetof(prefetch_trace, reads) - offsetof(prefetch_trace, id) + trace->count * sizeof(prefetch_read));
+}
+
+static bool trace_valid(prefetch_trace *trace, u32 size) {
+	return size >= offsetof(prefetch_trace, reads) && trace->magic == PREFETCH_TRACE_MAGIC &&
+		trace->count && trace->count <= PREFETCH_TRACE_MAX &&
+		size >= offsetof(prefetch_trace, reads) + trace->count * sizeof(prefetch_read) &&
+		trace->checksum == trace_checksum(trace);
+}
+
+static void profile_handle(file_handle *file, const u8 *id) {
+	memset(file, 0, sizeof(file_handle));
+	concat_path(file->name, devices[DEVICE_CONFIG]->initial->name, PREFETCH_DIR);
+	snprintf(file->name + strlen(file->name), PATHNAME_MAX - strlen(file->name), "/%.6s-%02X%02X.bin", id, id[6], id[7]);
+}
+
+// Reads the patches left in their file on the patches device, stored by the next prefetch_warm
+static prefetch_trace *leftTrace;
+
+static void profile_store(prefetch_trace *trace) {
+	u32 size = offsetof(prefetch_trace, reads) + trace->count * sizeof(prefetch_read);
+	if(config_set_device()) {
+		ensure_path(DEVICE_CONFIG, PREFETCH_DIR, NULL);
+		file_handle *file = calloc(1, sizeof(file_handle));
+		if(file) {
+			profile_handle(file, trace->id);
+			devices[DEVICE_CONFIG]->deleteFile(file);
+			if(devices[DEVICE_CONFIG]->writeFile(file, trace, size) == size &&
+				!devices[DEVICE_CONFIG]->closeFile(file)) {
+				print_gecko("profile_store: %i reads stored to %s\r\n", trace->count, file->name);
+			}
+			devices[DEVICE_CONFIG]->closeFile(file);
+			free(file);
+		}
+		config_unset_device();
+	}
+}
+
+void prefetch_collect(void) {
+	prefetch_trace *trace = memalign(32, sizeof(prefetch_trace));
+	if(!trace) {
+		return;
+	}
+	AR_Init(NULL, 0);
+	ARAMFetch((unsigned char*)trace, (char*)PREFETCH_ARAM_TRACE, sizeof(prefetch_trace));
+	if(!trace_valid(trace, sizeof(prefetch_trace))) {
+		free(trace);
+		return;
+	}
+
+	// A reset left the reads in ARAM to be stored here
+	profile_store(trace);
+
+	// Only ever stored once
+	memset(trace, 0, 32);
+	ARAMPut((unsigned char*)trace, (char*)PREFETCH_ARAM_TRACE, 32);
+	free(trace);
+}
+
+static prefetch_trace *profile_load(const u8 *id) {
+	prefetch_trace *trace = NULL;
+	if(!config_set_device()) {
+		return NULL;
+	}
+	file_handle *file = calloc(1, sizeof(file_handle));
+	if(file) {
+		profile_handle(file, id);
+		if(devices[DEVICE_CONFIG]->readFile(file, NULL, 0) == 0 && file->size <= sizeof(prefetch_trace)) {
+			trace = calloc(1, sizeof(prefetch_trace));
+			if(trace && (devices[DEVICE_CONFIG]->readFile(file, trace, file->size) != file->size ||
+				!trace_valid(trace, file->size) || memcmp(trace->id, id, sizeof(trace->id)))) {
+				free(trace);
+				trace = NULL;
+			}
+		}
+		devices[DEVICE_CONFIG]->closeFile(file);
+		free(file);
+	}
+	config_unset_device();
+	return trace;
+}
+
+static int extent_compare(const void *a, const void *b) {
+	const prefetch_extent *extentA = a, *extentB = b;
+	return extentA->offset < extentB->offset ? -1 : extentA->offset > extentB->offset;
+}
+
+// Cuts [start, end) out of the sorted extents, returns the new count
+static int extents_remove(prefetch_extent *extents, int count, int max, u32 start, u32 end) {
+	for(int i = 0; i < count; i++) {
+		u32 extentEnd = extents[i].offset + extents[i].size;
+		if(end <= extents[i].offset || start >= extentEnd) {
+			continue;
+		}
+		if(start > extents[i].offset && end < extentEnd) {
+			// Split in two, the tail is dropped if there's no room for it
+			if(count < max) {
+				memmove(&extents[i + 2], &extents[i + 1], (count - i - 1) * sizeof(prefetch_extent));
+				extents[i + 1].offset = end;
+				extents[i + 1].size = extentEnd - end;
+				count++;
+			}
+			extents[i].size = start - extents[i].offset;
+			i++;
+		}
+		else if(start > extents[i].offset) {
+			extents[i].size = start - extents[i].offset;
+		}
+		else if(end < extentEnd) {
+			extents[i].size = extentEnd - end;
+			extents[i].offset = end;
+		}
+		else {
+			extents[i].size = 0;
+		}
+	}
+	int kept = 0;
+	for(int i = 0; i < count; i++) {
+		if(extents[i].size) {
+			extents[kept++] = extents[i];
+		}
+	}
+	return kept;
+}
+
+// Turns the recorded reads into sorted sector aligned extents to fill at most budget bytes
+static int extents_build(prefetch_trace *trace, prefetch_extent *extents, u32 fileSize, u32 budget) {
+	int count = 0;
+	u32 total = 0;
+	// Earliest reads first, only they are guaranteed a place
+	for(int i = 0; i < trace->count && total < budget; i++) {
+		u32 start = SECTOR_FLOOR(trace->reads[i].offset);
+		u32 end = SECTOR_CEIL(MIN((u64)trace->reads[i].offset + trace->reads[i].length, fileSize));
+		if(start >= end) {
+			continue;
+		}
+		end = MIN(end, start + budget - total);
+		extents[count].offset = start;
+		extents[count].size = end - start;
+		total += end - start;
+		count++;
+	}
+	if(!count) {
+		return 0;
+	}
+	qsort(extents, count, sizeof(prefetch_extent), extent_compare);
+
+	int merged = 0;
+	for(int i = 1; i < count; i++) {
+		prefetch_extent *last = &extents[merged];
+		u32 lastEnd = last->offset + last->size;
+		if(extents[i].offset <= lastEnd + PREFETCH_GAP_MAX) {
+			last->size = MAX(lastEnd, extents[i].offset + extents[i].size) - last->offset;
+		}
+		else {
+			extents[++merged] = extents[i];
+		}
+	}
+	count = merged + 1;
+
+	// Ranges the patches replace are never read from the disc image
+	const file_frag *frags = *(file_frag**)VAR_FRAG_LIST;
+	const file_frag *disc = NULL;
+	for(int i = 0; frags && frags[i].size; i++) {
+		if(frags[i].fileNum == FRAGS_DISC_1) {
+			disc = &frags[i];
+		}
+	}
+	for(int i = 0; disc && frags[i].size; i++) {
+		if(frags[i].fileNum == FRAGS_DISC_1 && (frags[i].devNum != disc->devNum || frags[i].fileBase != disc->fileBase)) {
+			count = extents_remove(extents, count, PREFETCH_TRACE_MAX, SECTOR_FLOOR(frags[i].offset), SECTOR_CEIL(frags[i].offset + frags[i].size));
+		}
+	}
+
+	// Gaps read through may have taken it over budget
+	count = MIN(count, PREFETCH_EXTENTS_MAX);
+	total = 0;
+	for(int i = 0; i < count; i++) {
+		if(total + extents[i].size >= budget) {
+			extents[i].size = budget - total;
+			count = extents[i].size ? i + 1 : i;
+			break;
+		}
+		total += extents[i].size;
+	}
+	return count;
+}
+
+void prefetch_setup(file_frag **fragList, u32 *numFrags) {
+	if(!swissSettings.bootPrefetch) {
+		return;
+	}
+	file_handle *file = calloc(1, sizeof(file_handle));
+	prefetch_trace *trace = memalign(32, PREFETCH_TRACE_SIZE);
+	if(!file || !trace) {
+		free(trace);
+		free(file);
+		return;
+	}
+	concat_path(file->name, devices[DEVICE_PATCHES]->initial->name, PREFETCH_FILE);
+	if(devices[DEVICE_PATCHES]->readFile(file, trace, PREFETCH_TRACE_SIZE) == PREFETCH_TRACE_SIZE && trace_valid(trace, PREFETCH_TRACE_SIZE)) {
+		free(leftTrace);
+		leftTrace = trace;
+		trace = memalign(32, PREFETCH_TRACE_SIZE);
+	}
+
+	// Blank for this boot, the patches write it sector by sector once the game has booted
+	if(trace) {
+		memset(trace, 0, PREFETCH_TRACE_SIZE);
+		devices[DEVICE_PATCHES]->deleteFile(file);
+		devices[DEVICE_PATCHES]->seekFile(file, 0, DEVICE_HANDLER_SEEK_SET);
+		if(devices[DEVICE_PATCHES]->writeFile(file, trace, PREFETCH_TRACE_SIZE) == PREFETCH_TRACE_SIZE &&
+			!devices[DEVICE_PATCHES]->closeFile(file)) {
+			getFragments(DEVICE_PATCHES, file, fragList, numFrags, FRAGS_PREFETCH, 0, 0);
+		}
+		devices[DEVICE_PATCHES]->closeFile(file);
+	}
+	free(trace);
+	free(file);
+}
+
+void prefetch_warm(file_handle *file, u32 aramLow) {
+	*(vu8*)VAR_PREFETCH_SIZE = 0;
+	*(vu8*)VAR_PREFETCH_WARM = 0;
+	if(leftTrace) {
+		profile_store(leftTrace);
+		free(leftTrace);
+		leftTrace = NULL;
+	}
+	if(!swissSettings.bootPrefetch || !(devices[DEVICE_CUR]->emulable & EMU_BOOT_PREFETCH)) {
+		return;
+	}
+	u32 size = 1 << swissSettings.bootPrefetch;
+	*(vu8*)VAR_PREFETCH_SIZE = size;
+
+	// Whatever is staged to boot stays below the data
+	aramLow = SECTOR_CEIL(aramLow);
+	if(!aramLow || aramLow >= PREFETCH_ARAM_SUMS) {
+		return;
+	}
+	u32 budget = MIN(size << 20, PREFETCH_ARAM_SUMS - aramLow);
+
+	const u8 *id = (const u8*)0x80000000;
+	prefetch_trace *trace = profile_load(id);
+	if(!trace) {
+		return;
+	}
+	prefetch_extent *extents = calloc(PREFETCH_TRACE_MAX, sizeof(prefetch_extent));
+	prefetch_table *table = memalign(32, TABLE_SIZE);
+	u32 *sums = memalign(32, SUMS_SIZE(budget));
+	u8 *buffer = memalign(32, READ_CHUNK_SIZE);
+	int count = extents ? extents_build(trace, extents, file->size, budget) : 0;
+	if(!count || !table || !sums || !buffer) {
+		goto out;
+	}
+
+	u32 total = 0;
+	for(int i = 0; i < count; i++) {
+		total += extents[i].size;
+	}
+	memset(table, 0, TABLE_SIZE);
+	table->magic = PREFETCH_TABLE_MAGIC;
+	table->count = count;
+	memcpy(table->id, id, sizeof(table->id));
+
+	uiDrawObj_t *progBar = DrawPublish(DrawProgressBar(false, 0, "Loading boot prefetch"));
+	AR_Init(NULL, 0);
+	u32 aram = PREFETCH_ARAM_SUMS - total, done = 0;
+	bool ok = true;
+	for(int i = 0; i < count && ok; i++) {
+		extents[i].aram = aram + done;
+		extents[i].sum = done / PREFETCH_SECTOR_SIZE;
+		table->extents[i] = extents[i];
+		for(u32 offset = 0; offset < extents[i].size && ok; ) {
+			u32 length = MIN(extents[i].size - offset, READ_CHUNK_SIZE);
+			u32 position = extents[i].offset + offset;
+			// The last sector is padded past the end of the disc
+			u32 available = position < file->size ? MIN(length, file->size - position) : 0;
+			memset(buffer + available, 0, length - available);
+			devices[DEVICE_CUR]->seekFile(file, position, DEVICE_HANDLER_SEEK_SET);
+			if(available && devices[DEVICE_CUR]->readFile(file, buffer, available) != available) {
+				ok = false;
+				break;
+			}
+			for(u32 sector = 0; sector < length; sector += PREFETCH_SECTOR_SIZE) {
+				sums[(done + sector) / PREFETCH_SECTOR_SIZE] = prefetch_checksum(buffer + sector, PREFETCH_SECTOR_SIZE);
+			}
+			ARAMPut(buffer, (char*)(aram + done), length);
+			offset += length;
+			done += length;
+			DrawUpdateProgressBar(progBar, (int)((u64)done * 100 / total));
+		}
+	}
+	if(ok) {
+		ARAMPut((unsigned char*)sums, (char*)PREFETCH_ARAM_SUMS, SUMS_SIZE(total));
+		ARAMPut((unsigned char*)table, (char*)PREFETCH_ARAM_TABLE, TABLE_SIZE);
+		*(vu8*)VAR_PREFETCH_WARM = 1;
+	}
+	DrawDispose(progBar);
+	print_gecko("prefetch_warm: %i extents, %i bytes at %08X%s\r\n", count, total, aram, ok ? "" : " failed");
+
+out:
+	free(buffer);
+	free(sums);
+	free(table);
+	free(extents);
+	free(trace);
+}
@@ -38,6 +38,9 @@
 #include "gcm.h"
 #include "mp3.h"
 #include "nkit.h"
+#include "filejob.h"
+#include "prefetch.h"
+#include "tasks.h"
 #include "wkf.h"
 #include "cheats.h"
 #include "settings.h"
@@ -823,13 +826,27 @@ ExecutableFile* select_alt_dol(ExecutableFile *filesToPatch, int num_files) {
 	
 }
 
+typedef struct {
+	DEVICEHANDLER_INTERFACE *device;
+	file_handle *file;
+} app_stream;
+
+static s32 app_stream_read(void *ctx, void *dst, u32 offset, u32 len)
+{
+	app_stream *stream = ctx;
+	
+	stream->device->seekFile(stream->file, offset, DEVICE_HANDLER_SEEK_SET);
+	return stream->device->readFile(stream->file, dst, len);
+}
+
 void load_app(ExecutableFile *fileToPatch)
 {
 	uiDrawObj_t* progBox = NULL;
 	char* gameID = (char*)0x80000000;
-	void* buffer;
+	void* buffer = NULL;
 	u32 sizeToRead;
 	int type;
+	bool staged = false;
 	
 	// Clear OSLoMem
 	asm volatile("mtdabr %0" :: "r" (0));
@@ -918,25 +935,40 @@ void load_app(ExecutableFile *fileToPatch)
 		type = fileToPatch->type;
 		print_gecko("DOL size %i\r\n", sizeToRead);
 		
-		buffer = memalign(32, sizeToRead);
-		print_gecko("DOL buffer %08X\r\n", (u32)buffer);
-		if(buffer == NULL) return;
-		
-		if(fileToPatch->patchFile != NULL) {
-			devices[DEVICE_PATCHES]->seekFile(fileToPatch->patchFile,0,DEVICE_HANDLER_SEEK_SET);
-			if(devices[DEVICE_PATCHES]->readFile(fileToPatch->patchFile,buffer,sizeToRead) != sizeToRead) {
+		if(fileToPatch->patchFile != NULL && (type == PATCH_DOL || type == PATCH_ELF)) {
+			// Already patched, so stage it section by section straight from the patch file
+			app_stream stream = { devices[DEVICE_PATCHES], fileToPatch->patchFile };
+			if(type == PATCH_DOL) {
+				staged = DOLStreamToARAM(app_stream_read, &stream);
+			}
+			else {
+				staged = ELFStreamToARAM(app_stream_read, &stream);
+			}
+			if(!staged) {
 				DrawPublish(DrawMessageBox(D_FAIL, "Failed to read DOL"));
 				while(1);
 			}
 		}
 		else {
-			devices[DEVICE_CUR]->seekFile(fileToPatch->file,fileToPatch->offset,DEVICE_HANDLER_SEEK_SET);
-			if(devices[DEVICE_CUR]->readFile(fileToPatch->file,buffer,sizeToRead) != sizeToRead) {
-				DrawPublish(DrawMessageBox(D_FAIL, "Failed to read DOL"));
-				while(1);
+			buffer = memalign(32, sizeToRead);
+			print_gecko("DOL buffer %08X\r\n", (u32)buffer);
+			if(buffer == NULL) return;
+			
+			if(fileToPatch->patchFile != NULL) {
+				devices[DEVICE_PATCHES]->seekFile(fileToPatch->patchFile,0,DEVICE_HANDLER_SEEK_SET);
+				if(devices[DEVICE_PATCHES]->readFile(fileToPatch->patchFile,buffer,sizeToRead) != sizeToRead) {
+					DrawPublish(DrawMessageBox(D_FAIL, "Failed to read DOL"));
+					while(1);
+				}
+			}
+			else {
+				devices[DEVICE_CUR]->seekFile(fileToPatch->file,fileToPatch->offset,DEVICE_HANDLER_SEEK_SET);
+				if(readFileHashed(DEVICE_CUR,fileToPatch->file,buffer,sizeToRead,&fileToPatch->hash) != sizeToRead) {
+					DrawPublish(DrawMessageBox(D_FAIL, "Failed to read DOL"));
+					while(1);
+				}
+				gameID_set(&GCMDisk, fileToPatch->hash);
 			}
-			fileToPatch->hash = XXH3_64bits(buffer, sizeToRead);
-			gameID_set(&GCMDisk, fileToPatch->hash);
 		}
 	}
 	else {
@@ -967,8 +999,10 @@ void load_app(ExecutableFile *fileToPatch)
 		Patch_ExecutableFile(&buffer, &sizeToRead, gameID, type);
 	}
 	
-	DCFlushRange(buffer, sizeToRead);
-	ICInvalidateRange(buffer, sizeToRead);
+	if(!staged) {
+		DCFlushRange(buffer, sizeToRead);
+		ICInvalidateRange(buffer, sizeToRead);
+	}
 	
 	// See if the combination of our patches has exhausted our play area.
 	if(!install_code(0)) {
@@ -980,6 +1014,9 @@ void load_app(ExecutableFile *fileToPatch)
 		return;
 	}
 	
+	// Fill the boot prefetch while the device is still up, clear of what's to be booted from ARAM
+	prefetch_warm(&curFile, fileToPatch == NULL ? 0 : staged ? ARAMStagedEnd(NULL) : type == PATCH_DOL ? ARAMStagedEnd(buffer) : 0);
+	
 	// Don't spin down the drive when running something from it...
 	if(devices[DEVICE_CUR] != &__device_dvd) {
 		devices[DEVICE_CUR]->deinit(&curFile);
@@ -1013,7 +1050,10 @@ void load_app(ExecutableFile *fileToPatch)
 		print_gecko("set size\r\n");
 		sdgecko_setPageSize(devices[DEVICE_PATCHES] == &__device_sd_a ? EXI_CHANNEL_0:(devices[DEVICE_PATCHES] == &__device_sd_b ? EXI_CHANNEL_1:EXI_CHANNEL_2), 512);
 	}
-	if(type == PATCH_BS2) {
+	if(staged) {
+		ARAMBootStaged(0, NULL);
+	}
+	else if(type == PATCH_BS2) {
 		BINtoARAM(buffer, sizeToRead, 0x81300000);
 	}
 	else if(type == PATCH_DOL) {
@@ -1024,40 +1064,89 @@ void load_app(ExecutableFile *fileToPatch)
 	}
 }
 
+typedef struct {
+	file_handle *file;
+	XXH3_state_t *hash;
+	u32 hashed;
+	u8 *scratch;
+	uiDrawObj_t *progBar;
+} dol_stream;
+
+#define DOL_STREAM_SCRATCH 0x8000
+
+// Hash everything up to offset, reading over any gap the loader skipped
+static bool dol_stream_hash_to(dol_stream *stream, u32 offset)
+{
+	while(stream->hashed < offset) {
+		u32 size = MIN(offset - stream->hashed, DOL_STREAM_SCRATCH);
+		devices[DEVICE_CUR]->seekFile(stream->file, stream->hashed, DEVICE_HANDLER_SEEK_SET);
+		if(devices[DEVICE_CUR]->readFile(stream->file, stream->scratch, size) != size) {
+			return false;
+		}
+		XXH3_64bits_update(stream->hash, stream->scratch, size);
+		stream->hashed += size;
+	}
+	return true;
+}
+
+// Reader handed to sidestep, sections arrive mostly in file order
+static s32 dol_stream_read(void *ctx, void *dst, u32 offset, u32 len)
+{
+	dol_stream *stream = ctx;
+	
+	if(offset + len > stream->file->size || !dol_stream_hash_to(stream, offset)) {
+		return -1;
+	}
+	devices[DEVICE_CUR]->seekFile(stream->file, offset, DEVICE_HANDLER_SEEK_SET);
+	if(devices[DEVICE_CUR]->readFile(stream->file, dst, len) != len) {
+		return -1;
+	}
+	if(offset + len > stream->hashed) {
+		XXH3_64bits_update(stream->hash, (u8*)dst + (stream->hashed - offset), offset + len - stream->hashed);
+		stream->hashed = offset + len;
+	}
+	DrawUpdateProgressBar(stream->progBar, (int)((u64)stream->hashed * 100 / stream->file->size));
+	return len;
+}
+
 void boot_dol()
 { 
-	unsigned char *dol_buffer;
-	unsigned char *ptr;
-  
-	dol_buffer = (unsigned char*)memalign(32,curFile.size);
-	if(!dol_buffer) {
-		uiDrawObj_t *msgBox = DrawMessageBox(D_FAIL,"DOL is too big. Press A.");
+	dol_stream stream = { .file = &curFile };
+	char magic[SELFMAG];
+	int staged = 0;
+	
+	stream.hash = XXH3_createState();
+	stream.scratch = memalign(32, DOL_STREAM_SCRATCH);
+	if(stream.hash && stream.scratch) {
+		XXH3_64bits_reset(stream.hash);
+		stream.progBar = DrawPublish(DrawProgressBar(false, 0, "Loading DOL"));
+		
+		// Stage straight into ARAM, the DOL never has to fit in main memory
+		if(dol_stream_read(&stream, magic, 0, SELFMAG) == SELFMAG) {
+			if(!memcmp(magic, ELFMAG, SELFMAG)) {
+				staged = ELFStreamToARAM(dol_stream_read, &stream);
+			}
+			else {
+				staged = DOLStreamToARAM(dol_stream_read, &stream);
+			}
+		}
+		if(staged) {
+			staged = dol_stream_hash_to(&stream, curFile.size);
+		}
+		DrawDispose(stream.progBar);
+	}
+	if(staged) {
+		gameID_set(NULL, XXH3_64bits_digest(stream.hash));
+	}
+	free(stream.scratch);
+	XXH3_freeState(stream.hash);
+	if(!staged) {
+		uiDrawObj_t *msgBox = DrawMessageBox(D_FAIL,"Failed to read DOL. Press A.");
 		DrawPublish(msgBox);
 		wait_press_A();
 		DrawDispose(msgBox);
 		return;
 	}
-		
-	int i=0;
-	ptr = dol_buffer;
-	uiDrawObj_t* progBar = DrawProgressBar(false, 0, "Loading DOL");
-	DrawPublish(progBar);
-	for(i = 0; i < curFile.size; i+= 131072) {
-		DrawUpdateProgressBar(progBar, (int)((float)((float)i/(float)curFile.size)*100));
-		
-		devices[DEVICE_CUR]->seekFile(&curFile,i,DEVICE_HANDLER_SEEK_SET);
-		int size = i+131072 > curFile.size ? curFile.size-i : 131072; 
-		if(devices[DEVICE_CUR]->readFile(&curFile,ptr,size)!=size) {
-			uiDrawObj_t *msgBox = DrawMessageBox(D_FAIL,"Failed to read DOL. Press A.");
-			DrawPublish(msgBox);
-			wait_press_A();
-			DrawDispose(msgBox);
-			return;
-		}
-  		ptr+=size;
-	}
-	gameID_set(NULL, XXH3_64bits(dol_buffer, curFile.size));
-	DrawDispose(progBar);
 	
 	if(devices[DEVICE_CONFIG] != NULL) {
 		// Update the recent list.
@@ -1069,7 +1158,7 @@ void boot_dol()
 	}
 	
 	// Build a command line to pass to the DOL
-	int argc = 0;
+	int i, argc = 0;
 	char *argv[1024];
 
 	u32 readTest;
@@ -1154,22 +1243,89 @@ void boot_dol()
 
 	if(devices[DEVICE_CUR] != NULL) devices[DEVICE_CUR]->deinit( devices[DEVICE_CUR]->initial );
 	// Boot
-	if(!memcmp(dol_buffer, ELFMAG, SELFMAG)) {
-		ELFtoARAM(dol_buffer, argc, argc == 0 ? NULL : argv);
+	ARAMBootStaged(argc, argc == 0 ? NULL : argv);
+}
+
+/* Manage file  - The user will be asked what they want to do with the currently selected file - copy/move/delete*/
+typedef struct {
+	uiDrawObj_t *progBar;
+	u64 startTime;
+	u64 lastTime;
+	u64 lastBytes;
+	int speed;
+	int timeremain;
+} file_job_ui;
+
+static bool file_job_update(void *ctx, file_job *job)
+{
+	file_job_ui *ui = ctx;
+	
+	if(PAD_ButtonsHeld(0) & PAD_BUTTON_B) {
+		return false;
 	}
-	else {
-		DOLtoARAM(dol_buffer, argc, argc == 0 ? NULL : argv);
+	if(!job->totalBytes) {
+		DrawUpdateProgressBar(ui->progBar, (int)(job->next * 100 / job->numOps));
+		return true;
+	}
+	u32 timeDiff = diff_msec(ui->lastTime, gettime());
+	u32 timeStart = diff_msec(ui->startTime, gettime());
+	if(timeDiff >= 1000) {
+		ui->speed = (int)((float)(job->doneBytes-ui->lastBytes) / (float)(timeDiff/1000.0f));
+		ui->timeremain = ui->speed ? (job->totalBytes - job->doneBytes) / ui->speed : 0;
+		ui->lastTime = gettime();
+		ui->lastBytes = job->doneBytes;
 	}
+	DrawUpdateProgressBarDetail(ui->progBar, (int)(job->doneBytes * 100 / job->totalBytes), ui->speed, timeStart/1000, ui->timeremain);
+	return true;
+}
 
-	free(dol_buffer);
+// Runs a job under a progress bar, a cancelled or failed job can be picked up where it stopped
+static bool run_file_job(file_job *job, const char *title)
+{
+	file_job_ui ui;
+	while(1) {
+		memset(&ui, 0, sizeof(file_job_ui));
+		ui.progBar = DrawPublish(DrawProgressBar(false, 0, title));
+		ui.startTime = ui.lastTime = gettime();
+		ui.lastBytes = job->doneBytes;
+		int ret = file_job_run(job, file_job_update, &ui);
+		DrawDispose(ui.progBar);
+		if(ret == FILE_JOB_DONE) {
+			return true;
+		}
+		do {VIDEO_WaitVSync();} while (PAD_ButtonsHeld(0) & PAD_BUTTON_B);
+		if(ret == FILE_JOB_FAILED) {
+			sprintf(txtbuffer, "Failed on:\n%s\n \nPress A to retry, or B to stop.", getRelativeName(job->failed->name));
+		}
+		else {
+			sprintf(txtbuffer, "Stopped at:\n%s\n \nPress A to resume, or B to stop.", getRelativeName((char*)file_job_current(job)));
+		}
+		uiDrawObj_t *msgBox = DrawPublish(DrawMessageBox(ret == FILE_JOB_FAILED ? D_FAIL : D_INFO, txtbuffer));
+		bool resume = false;
+		while(1) {
+			u16 btns = PAD_ButtonsHeld(0);
+			if(btns & PAD_BUTTON_A) {
+				resume = true;
+				break;
+			}
+			else if(btns & PAD_BUTTON_B) {
+				break;
+			}
+			VIDEO_WaitVSync();
+		}
+		do {VIDEO_WaitVSync();} while (PAD_ButtonsHeld(0) & (PAD_BUTTON_A|PAD_BUTTON_B));
+		DrawDispose(msgBox);
+		if(!resume) {
+			return false;
+		}
+	}
 }
 
-/* Manage file  - The user will be asked what they want to do with the currently selected file - copy/move/delete*/
 bool manage_file() {
 	bool isFile = curFile.fileAttrib == IS_FILE;
 	bool canWrite = devices[DEVICE_CUR]->features & FEAT_WRITE;
-	bool canMove = canWrite && isFile;
-	bool canCopy = isFile;
+	bool canMove = canWrite;
+	bool canCopy = true;
 	bool canDelete = canWrite;
 	bool canRename = canWrite && devices[DEVICE_CUR]->renameFile;
 	
@@ -1268,9 +1424,10 @@ bool manage_file() {
 	}
 	// Handle deletes (dir or file)
 	else if(option == DELETE_OPTION) {
-		uiDrawObj_t *progBar = DrawPublish(DrawProgressBar(true, 0, "Deleting ..."));
-		bool deleted = deleteFileOrDir(&curFile);
-		DrawDispose(progBar);
+		file_job job;
+		bool deleted = file_job_init(&job, FILE_JOB_DELETE, devices[DEVICE_CUR], &curFile, NULL, NULL) &&
+						run_file_job(&job, "Deleting ...");
+		file_job_free(&job);
 		sprintf(txtbuffer, "%s %s\nPress A to continue.", isFile ? "File" : "Directory", deleted ? "deleted successfully" : "failed to delete!");
 		uiDrawObj_t *msgBox = DrawPublish(DrawMessageBox(deleted ? D_INFO : D_FAIL, txtbuffer));
 		wait_press_A();
@@ -1322,6 +1479,25 @@ bool manage_file() {
 		destFile->offset = 0;
 		destFile->size = 0;
 		destFile->fileAttrib = IS_FILE;
+		if(!isFile) {
+			char *message = NULL;
+			size_t len = strlen(curFile.name);
+			if(!devices[DEVICE_DEST]->makeDir) {
+				message = "Directories can't be copied to this device!";
+			}
+			else if(devices[DEVICE_CUR] == devices[DEVICE_DEST] && !strncmp(curFile.name, destFile->name, len) &&
+					(destFile->name[len] == '/' || destFile->name[len] == '\0')) {
+				message = "Can't copy a directory into itself!";
+			}
+			if(message) {
+				uiDrawObj_t *msgBox = DrawMessageBox(D_INFO, message);
+				DrawPublish(msgBox);
+				wait_press_A();
+				DrawDispose(msgBox);
+				free(destFile);
+				return false;
+			}
+		}
 		// Create a GCI if something is coming out from CARD to another device
 		if(isSrcCard && !isDestCard) {
 			strlcat(destFile->name, ".gci", PATHNAME_MAX);
@@ -1438,6 +1614,24 @@ bool manage_file() {
 			wait_press_A();
 			DrawDispose(msgBox);
 		}
+		// Directories go through a job, files are copied below
+		else if(!isFile) {
+			char title[64];
+			snprintf(title, sizeof(title), "%s to: %s", (option == MOVE_OPTION) ? "Moving" : "Copying", getRelativeName(destFile->name));
+			file_job job;
+			bool done = file_job_init(&job, (option == MOVE_OPTION) ? FILE_JOB_MOVE : FILE_JOB_COPY, devices[DEVICE_CUR], &curFile, devices[DEVICE_DEST], destFile->name) &&
+						run_file_job(&job, title);
+			file_job_free(&job);
+			free(destFile);
+			if(option == MOVE_OPTION) {
+				needsRefresh=1;
+			}
+			sprintf(txtbuffer, "%s %s.\nPress A to continue", (option == MOVE_OPTION) ? "Move" : "Copy", done ? "complete" : "stopped");
+			uiDrawObj_t *msgBox = DrawMessageBox(done ? D_INFO : D_FAIL,txtbuffer);
+			DrawPublish(msgBox);
+			wait_press_A();
+			DrawDispose(msgBox);
+		}
 		else {
 			// If we're copying out from memory card, make a .GCI
 			if(isSrcCard) {
@@ -1580,55 +1774,59 @@ bool manage_file() {
 	return true;
 }
 
+typedef struct {
+	u32 crc;
+	uiDrawObj_t *progBar;
+	u64 startTime;
+	u64 lastTime;
+	u32 lastOffset;
+	int speed;
+	int timeremain;
+} verify_state;
+
+static bool verify_chunk(void *ctx, void *data, u32 offset, u32 length)
+{
+	verify_state *state = ctx;
+	
+	u32 buttons = PAD_ButtonsHeld(0);
+	if(buttons & PAD_BUTTON_B) {
+		return false;
+	}
+	u32 timeDiff = diff_msec(state->lastTime, gettime());
+	u32 timeStart = diff_msec(state->startTime, gettime());
+	if(timeDiff >= 1000) {
+		state->speed = (int)((float)(offset-state->lastOffset) / (float)(timeDiff/1000.0f));
+		state->timeremain = (curFile.size - offset) / state->speed;
+		state->lastTime = gettime();
+		state->lastOffset = offset;
+	}
+	DrawUpdateProgressBarDetail(state->progBar, (int)((float)((float)offset/(float)curFile.size)*100), state->speed, timeStart/1000, state->timeremain);
+	state->crc = crc32(state->crc,data,length);
+	return true;
+}
+
 void verify_game()
 {
-	u32 crc = 0;
-	u32 curOffset = 0, cancelled = 0, chunkSize = (32*1024);
-	unsigned char *readBuffer = (unsigned char*)memalign(32,chunkSize);
-	uiDrawObj_t* progBar = DrawProgressBar(false, 0, "Verifying ...");
-	DrawPublish(progBar);
-	
-	u64 startTime = gettime();
-	u64 lastTime = gettime();
-	u32 lastOffset = 0;
-	int speed = 0;
-	int timeremain = 0;
-	while(curOffset < curFile.size) {
-		u32 buttons = PAD_ButtonsHeld(0);
-		if(buttons & PAD_BUTTON_B) {
-			cancelled = 1;
-			break;
-		}
-		u32 timeDiff = diff_msec(lastTime, gettime());
-		u32 timeStart = diff_msec(startTime, gettime());
-		if(timeDiff >= 1000) {
-			speed = (int)((float)(curOffset-lastOffset) / (float)(timeDiff/1000.0f));
-			timeremain = (curFile.size - curOffset) / speed;
-			lastTime = gettime();
-			lastOffset = curOffset;
-		}
-		DrawUpdateProgressBarDetail(progBar, (int)((float)((float)curOffset/(float)curFile.size)*100), speed, timeStart/1000, timeremain);
-		u32 amountToRead = curOffset + chunkSize > curFile.size ? curFile.size - curOffset : chunkSize;
-		devices[DEVICE_CUR]->seekFile(&curFile, curOffset, DEVICE_HANDLER_SEEK_SET);
-		u32 ret = devices[DEVICE_CUR]->readFile(&curFile, readBuffer, amountToRead);
-		if(ret != amountToRead) {
-			DrawDispose(progBar);
-			free(readBuffer);
-			sprintf(txtbuffer, "Failed to Read! (%d %d)\n%s",amountToRead,ret, &curFile.name[0]);
-			uiDrawObj_t *msgBox = DrawMessageBox(D_FAIL,txtbuffer);
-			DrawPublish(msgBox);
-			wait_press_A();
-			DrawDispose(msgBox);
-			return;
-		}
-		crc = crc32(crc,readBuffer,amountToRead);
-		curOffset+=amountToRead;
+	verify_state state = { .crc = 0 };
+	state.progBar = DrawProgressBar(false, 0, "Verifying ...");
+	DrawPublish(state.progBar);
+	
+	state.startTime = state.lastTime = gettime();
+	// The next chunk is read while this one is checked
+	devices[DEVICE_CUR]->seekFile(&curFile, 0, DEVICE_HANDLER_SEEK_SET);
+	s32 ret = readFileChunked(DEVICE_CUR, &curFile, NULL, curFile.size, 32*1024, verify_chunk, &state);
+	DrawDispose(state.progBar);
+	if(ret < 0) {
+		sprintf(txtbuffer, "Failed to Read! (%d)\n%s",ret, &curFile.name[0]);
+		uiDrawObj_t *msgBox = DrawMessageBox(D_FAIL,txtbuffer);
+		DrawPublish(msgBox);
+		wait_press_A();
+		DrawDispose(msgBox);
+		return;
 	}
-	DrawDispose(progBar);
-	free(readBuffer);
-	if(!cancelled) {
+	if(ret == curFile.size) {
 		uiDrawObj_t *msgBox = NULL;
-		if(valid_gcm_crc32(&GCMDisk, crc)) {
+		if(valid_gcm_crc32(&GCMDisk, state.crc)) {
 			msgBox = DrawMessageBox(D_PASS,"Passed integrity verification!\nPress A to continue.");
 		}
 		else {
@@ -1765,29 +1963,16 @@ void load_game() {
 	// setup the video mode before we kill libOGC kernel
 	ogc_video__reset();
 	
-	// Auto load cheats if the set to auto load and if any are found
-	if(swissSettings.autoCheats) {
-		if(findCheats(true) > 0) {
-			int appliedCount = applyAllCheats();
-			sprintf(txtbuffer, "Applied %i cheats", appliedCount);
-			msgBox = DrawPublish(DrawMessageBox(D_INFO, txtbuffer));
-			sleep(1);
-			DrawDispose(msgBox);
-		}
-	}
-	if(swissSettings.wiirdDebug || getEnabledCheatsSize() > 0) {
-		setTopAddr(WIIRD_ENGINE);
-	}
-	else {
-		setTopAddr(0x81800000);
-	}
-	
 	int numToPatch = 0;
 	ExecutableFile *filesToPatch = memalign(32, sizeof(ExecutableFile)*512);
 	memset(filesToPatch, 0, sizeof(ExecutableFile)*512);
 
 	// Report to the user the patch status of this GCM/ISO file
 	numToPatch = check_game(&curFile, disc2File, filesToPatch);
+	if(numToPatch < 0) {
+		free(filesToPatch);
+		goto fail;
+	}
 	
 	// Prompt for DOL selection if multi-dol
 	ExecutableFile *fileToPatch = NULL;
@@ -1944,99 +2129,207 @@ void load_file()
 
 }
 
-int check_game(file_handle *file, file_handle *file2, ExecutableFile *filesToPatch)
-{ 	
+// What the game check tasks share
+typedef struct {
+	file_handle *file;
+	file_handle *file2;
+	ExecutableFile *filesToPatch;
+	int numToPatch;
+	GCMCache cache;
+	GCMCache cache2;
+	const char *error;	// A read the game can't be booted without failed
+	char *cheats;		// Found on a device off the current one's EXI channel
+	int cheatsFound;	// The search device those came from, see readCheats
+	int numCheats;
+} game_check;
+
+enum {
+	CHECK_READ = 0,
+	CHECK_PARSE,
+	CHECK_FIND_CHEATS,
+	CHECK_CHEATS,
+	CHECK_TASKS
+};
+
+// Everything the parse needs off the disc, in one go
+static bool check_read(void *ctx) {
+	game_check *check = ctx;
+	if(tgcFile.magic == TGC_MAGIC) {
+		return true;
+	}
+	check->error = gcm_cache_read(&check->cache, check->file, &GCMDisk);
+	if(!check->error && check->file2) {
+		check->error = gcm_cache_read(&check->cache2, check->file2, NULL);
+	}
+	return !check->error;
+}
+
+static bool check_parse(void *ctx) {
+	game_check *check = ctx;
 	char* gameID = (char*)&GCMDisk;
-	uiDrawObj_t *msgBox = DrawPublish(DrawProgressBar(true, 0, "Checking Game .."));
-	
+	ExecutableFile *filesToPatch = check->filesToPatch;
 	int numToPatch;
 	if(tgcFile.magic == TGC_MAGIC) {
-		numToPatch = parse_tgc(file, filesToPatch, 0, getRelativeName(file->name));
+		numToPatch = parse_tgc(check->file, filesToPatch, 0, getRelativeName(check->file->name));
 	}
 	else {
-		numToPatch = parse_gcm(file, file2, filesToPatch);
+		numToPatch = parse_gcm(&check->cache, check->file2 ? &check->cache2 : NULL, filesToPatch);
 		
 		if(!strncmp(gameID, "GCCE01", 6) || !strncmp(gameID, "GCCJGC", 6) || !strncmp(gameID, "GCCP01", 6)) {
-			parse_gcm_add(file, filesToPatch, &numToPatch, "ffcc_cli.bin");
+			parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "ffcc_cli.bin");
 		}
 		else if(!strncmp(gameID, "GHAE08", 6) || !strncmp(gameID, "GHAJ08", 6)) {
-			parse_gcm_add(file, filesToPatch, &numToPatch, "claire.rel");
-			parse_gcm_add(file, filesToPatch, &numToPatch, "leon.rel");
+			parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire.rel");
+			parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon.rel");
 		}
 		else if(!strncmp(gameID, "GHAP08", 6)) {
 			switch(swissSettings.sramLanguage) {
 				case SYS_LANG_ENGLISH:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon.rel");
 					break;
 				case SYS_LANG_GERMAN:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_g.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_g.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_g.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_g.rel");
 					break;
 				case SYS_LANG_FRENCH:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_f.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_f.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_f.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_f.rel");
 					break;
 				case SYS_LANG_SPANISH:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_s.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_s.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_s.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_s.rel");
 					break;
 				case SYS_LANG_ITALIAN:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_i.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_i.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_i.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_i.rel");
 					break;
 				default:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_f.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_g.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_i.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "claire_s.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_f.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_g.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_i.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "leon_s.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_f.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_g.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_i.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "claire_s.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_f.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_g.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_i.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "leon_s.rel");
 					break;
 			}
 		}
 		else if(!strncmp(gameID, "GLEP08", 6)) {
 			switch(swissSettings.sramLanguage) {
 				case SYS_LANG_ENGLISH:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "eng.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "eng.rel");
 					break;
 				case SYS_LANG_GERMAN:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "ger.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "ger.rel");
 					break;
 				case SYS_LANG_FRENCH:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "fra.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "fra.rel");
 					break;
 				case SYS_LANG_SPANISH:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "spa.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "spa.rel");
 					break;
 				case SYS_LANG_ITALIAN:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "ita.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "ita.rel");
 					break;
 				default:
-					parse_gcm_add(file, filesToPatch, &numToPatch, "eng.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "fra.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "ger.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "ita.rel");
-					parse_gcm_add(file, filesToPatch, &numToPatch, "spa.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "eng.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "fra.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "ger.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "ita.rel");
+					parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "spa.rel");
 					break;
 			}
 		}
 		if(swissSettings.disableVideoPatches < 1) {
 			if(!strncmp(gameID, "GS8P7D", 6)) {
-				parse_gcm_add(file, filesToPatch, &numToPatch, "SPYROCFG_NGC.CFG");
+				parse_gcm_add(&check->cache, filesToPatch, &numToPatch, "SPYROCFG_NGC.CFG");
 			}
 		}
 	}
+	check->numToPatch = numToPatch;
+	return true;
+}
+
+// The other devices cheats are looked for on, while the current one is busy with the disc.
+// Those sharing an EXI channel with the current device are left for check_cheats
+static bool check_find_cheats(void *ctx) {
+	game_check *check = ctx;
+	check->cheats = readCheats(cheatsSearchIndependent(), &check->cheatsFound);
+	return true;
+}
+
+// Cheats on the current device come first, then on those sharing its EXI channel ahead of what was found
+static bool check_cheats(void *ctx) {
+	game_check *check = ctx;
+	char *cheats = readCheats(CHEATS_SEARCH_ALL & ~cheatsSearchIndependent() & ((1 << check->cheatsFound) - 1), NULL);
+	if(cheats) {
+		free(check->cheats);
+		check->cheats = cheats;
+	}
+	check->numCheats = loadCheats(check->cheats, true);
+	check->cheats = NULL;
+	return true;
+}
+
+static bool check_game_progress(void *ctx) {
+	VIDEO_WaitVSync();
+	return !(PAD_ButtonsHeld(0) & PAD_BUTTON_B);
+}
+
+// Returns the number of filesToPatch, or -1 if cancelled
+int check_game(file_handle *file, file_handle *file2, ExecutableFile *filesToPatch)
+{ 	
+	uiDrawObj_t *msgBox = DrawPublish(DrawProgressBar(true, 0, "Checking Game (B to cancel) .."));
+	
+	game_check check = {
+		.file = file,
+		.file2 = file2,
+		.filesToPatch = filesToPatch,
+	};
+	// The disc is read on one lane, the cheats search on another only touches devices on other EXI channels
+	task tasks[CHECK_TASKS] = {
+		[CHECK_READ] = { .run = check_read },
+		[CHECK_PARSE] = { .run = check_parse, .deps = 1 << CHECK_READ },
+		[CHECK_FIND_CHEATS] = { .run = check_find_cheats, .lane = 1 },
+		[CHECK_CHEATS] = { .run = check_cheats, .deps = 1 << CHECK_FIND_CHEATS },
+	};
+	// Auto load cheats if the set to auto load and if any are found
+	int ret = tasks_run(tasks, swissSettings.autoCheats ? CHECK_TASKS : CHECK_FIND_CHEATS, &check, check_game_progress, NULL);
+	gcm_cache_free(&check.cache);
+	gcm_cache_free(&check.cache2);
+	free(check.cheats);
 	DrawDispose(msgBox);
 	
+	if(check.error) {
+		DrawPublish(DrawMessageBox(D_FAIL, check.error));
+		while(1);
+	}
+	if(ret == TASKS_CANCELLED) {
+		return -1;
+	}
+	
+	if(check.numCheats > 0) {
+		int appliedCount = applyAllCheats();
+		sprintf(txtbuffer, "Applied %i cheats", appliedCount);
+		msgBox = DrawPublish(DrawMessageBox(D_INFO, txtbuffer));
+		sleep(1);
+		DrawDispose(msgBox);
+	}
+	if(swissSettings.wiirdDebug || getEnabledCheatsSize() > 0) {
+		setTopAddr(WIIRD_ENGINE);
+	}
+	else {
+		setTopAddr(0x81800000);
+	}
+	
 	if(devices[DEVICE_CUR]->features & FEAT_HYPERVISOR) {
-		patch_gcm(filesToPatch, numToPatch);
+		patch_gcm(filesToPatch, check.numToPatch);
 	}
-	return numToPatch;
+	return check.numToPatch;
 }
 
 uiDrawObj_t* draw_game_info() {
@@ -0,0 +1,165 @@
+/* tasks.c
+	- runs a small graph of dependent tasks, a thread per lane
+	- lanes that can't have a thread of their own are run on the calling thread
+ */
+
+#include <gccore.h>
+#include <string.h>
+#include "tasks.h"
+
+#define TASK_STACK_SIZE	(32*1024)
+#define TASK_PRIORITY	50
+
+typedef struct {
+	task *tasks;
+	int count;
+	void *ctx;
+	int running;		// Lanes yet to get through all of their tasks
+	bool cancel;
+	mutex_t mutex;
+	cond_t cond;
+} task_runner;
+
+typedef struct {
+	task_runner *runner;
+	u32 lanes;			// Lanes whose tasks this worker runs, one bit each
+} task_lane;
+
+static u8 task_stacks[TASK_LANES_MAX][TASK_STACK_SIZE];
+static bool task_stacks_busy = false;
+
+// Pending while any of deps is, done once they all are, skipped if any of them wasn't done
+static u8 deps_state(task_runner *runner, u32 deps) {
+	u8 state = TASK_DONE;
+	for(int i = 0; i < runner->count; i++) {
+		if(deps & (1 << i)) {
+			if(runner->tasks[i].state == TASK_PENDING) {
+				state = TASK_PENDING;
+			}
+			else if(runner->tasks[i].state != TASK_DONE) {
+				return TASK_SKIPPED;
+			}
+		}
+	}
+	return state;
+}
+
+static void *lane_worker(void *arg) {
+	task_lane *lane = arg;
+	task_runner *runner = lane->runner;
+
+	LWP_MutexLock(runner->mutex);
+	for(int i = 0; i < runner->count; i++) {
+		task *t = &runner->tasks[i];
+		if(!(lane->lanes & (1 << t->lane))) {
+			continue;
+		}
+		u8 state;
+		while((state = deps_state(runner, t->deps)) == TASK_PENDING && !runner->cancel) {
+			LWP_CondWait(runner->cond, runner->mutex);
+		}
+		if(runner->cancel) {
+			state = TASK_SKIPPED;
+		}
+		else if(state == TASK_DONE) {
+			LWP_MutexUnlock(runner->mutex);
+			state = t->run(runner->ctx) ? TASK_DONE : TASK_FAILED;
+			LWP_MutexLock(runner->mutex);
+		}
+		t->state = state;
+		LWP_CondBroadcast(runner->cond);
+	}
+	runner->running--;
+	LWP_CondBroadcast(runner->cond);
+	LWP_MutexUnlock(runner->mutex);
+	return NULL;
+}
+
+// Runs the tasks to completion, those a failed one depends on are skipped.
+// Only ever depending on earlier tasks keeps the lanes from waiting on each other for good,
+// and lets one worker run the tasks of several lanes in order when there's no thread for each.
+// Cancelling lets whatever is running finish, and skips the rest.
+int tasks_run(task *tasks, int count, void *ctx, tasks_progress progress, void *progressCtx) {
+	task_runner runner = {
+		.tasks = tasks,
+		.count = count,
+		.ctx = ctx,
+	};
+	task_lane lanes[TASK_LANES_MAX];
+	lwp_t threads[TASK_LANES_MAX];
+	int numLanes = 0;
+	u32 inlineLanes = 0;
+
+	if(count > TASKS_MAX) {
+		return TASKS_FAILED;
+	}
+	for(int i = 0; i < count; i++) {
+		// A dep on itself or a later task could leave its lane waiting for good
+		if(tasks[i].lane >= TASK_LANES_MAX || (tasks[i].deps >> i)) {
+			return TASKS_FAILED;
+		}
+		tasks[i].state = TASK_PENDING;
+		if(tasks[i].lane >= numLanes) {
+			numLanes = tasks[i].lane + 1;
+		}
+	}
+	LWP_MutexInit(&runner.mutex, false);
+	LWP_CondInit(&runner.cond);
+	// The lane stacks are shared, a nested run gets by on the calling thread alone
+	bool useThreads = !task_stacks_busy;
+	task_stacks_busy = true;
+	LWP_MutexLock(runner.mutex);
+	runner.running = numLanes;
+	for(int i = 0; i < numLanes; i++) {
+		lanes[i] = (task_lane){ .runner = &runner, .lanes = 1 << i };
+		threads[i] = LWP_THREAD_NULL;
+		if(!useThreads || LWP_CreateThread(&threads[i], lane_worker, &lanes[i], task_stacks[i], TASK_STACK_SIZE, TASK_PRIORITY) < 0) {
+			threads[i] = LWP_THREAD_NULL;
+			inlineLanes |= 1 << i;
+			runner.running--;
+		}
+	}
+	LWP_MutexUnlock(runner.mutex);
+
+	// Progress isn't reported while these run
+	if(inlineLanes) {
+		task_lane lane = { .runner = &runner, .lanes = inlineLanes };
+		LWP_MutexLock(runner.mutex);
+		runner.running++;
+		LWP_MutexUnlock(runner.mutex);
+		lane_worker(&lane);
+	}
+
+	LWP_MutexLock(runner.mutex);
+	while(runner.running) {
+		LWP_MutexUnlock(runner.mutex);
+		bool keepGoing = progress(progressCtx);
+		LWP_MutexLock(runner.mutex);
+		if(!keepGoing && !runner.cancel) {
+			runner.cancel = true;
+			LWP_CondBroadcast(runner.cond);
+		}
+	}
+	LWP_MutexUnlock(runner.mutex);
+
+	for(int i = 0; i < numLanes; i++) {
+		if(threads[i] != LWP_THREAD_NULL) {
+			LWP_JoinThread(threads[i], NULL);
+		}
+	}
+	LWP_CondDestroy(runner.cond);
+	LWP_MutexDestroy(runner.mutex);
+	if(useThreads) {
+		task_stacks_busy = false;
+	}
+
+	if(runner.cancel) {
+		return TASKS_CANCELLED;
+	}
+	for(int i = 0; i < count; i++) {
+		if(tasks[i].state != TASK_DONE) {
+			return TASKS_FAILED;
+		}
+	}
+	return TASKS_DONE;
+}
@@ -0,0 +1,15 @@
+/* Host stand-in for cube/patches/base/common.h */
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdint.h>
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+extern volatile uint32_t EXI[3][5];
+extern char VAR_CARD_IDS[2];
+
+#define FRAGS_CARD(n) (4 + (n))
+
+#endif /* COMMON_H */
@@ -0,0 +1,18 @@
+/* Host stand-in for cube/patches/base/dolphin/exi.h */
+#ifndef DOLPHIN_EXI_H
+#define DOLPHIN_EXI_H
+
+enum {
+	EXI_READ = 0,
+	EXI_WRITE,
+	EXI_READ_WRITE,
+};
+
+enum {
+	EXI_CHANNEL_0 = 0,
+	EXI_CHANNEL_1,
+	EXI_CHANNEL_2,
+	EXI_CHANNEL_MAX
+};
+
+#endif /* DOLPHIN_EXI_H */
@@ -0,0 +1,10 @@
+/* Host stand-in for cube/patches/base/dolphin/os.h */
+#ifndef DOLPHIN_OS_H
+#define DOLPHIN_OS_H
+
+#include <stdint.h>
+
+void *OSPhysicalToUncached(uint32_t address);
+#define OSCachedToUncached(address) ((void *)(address))
+
+#endif /* DOLPHIN_OS_H */
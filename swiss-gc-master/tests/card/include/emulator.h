@@ -0,0 +1,10 @@
+/* Host stand-in for cube/patches/base/emulator.h */
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+void exi_interrupt(unsigned chan);
+void exi_complete_transfer(unsigned chan);
+void exi0_complete_transfer(void);
+void exi1_complete_transfer(void);
+
+#endif /* EMULATOR_H */
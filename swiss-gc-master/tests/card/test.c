@@ -0,0 +1,285 @@
+/*
+ * Memory card emulation against a simulated patch device.
+ *
+ * The device completes one queued sector per tick and can be told to
+ * fail writes. A game-like workload programs and reads pages on both
+ * slots and checks every read against a reference image; the device
+ * image has to match it once card_fini has drained the cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "common.h"
+#include "dolphin/exi.h"
+#include "dolphin/os.h"
+#include "emulator_card.h"
+#include "frag.h"
+
+#define CARD_SIZE (64 * 8192)
+#define QUEUE_SIZE 2
+
+volatile uint32_t EXI[3][5];
+char VAR_CARD_IDS[2];
+
+static uint8_t mem[1 << 20];
+static uint8_t dev[2][CARD_SIZE], ref[2][CARD_SIZE];
+static int fail, complete[2], failures;
+
+static struct {
+	void *buffer;
+	uint32_t length;
+	uint32_t offset;
+	int chan;
+	bool write;
+	frag_callback callback;
+} queue[QUEUE_SIZE];
+static int queued;
+
+void *OSPhysicalToUncached(uint32_t address) { return mem + address; }
+void exi_interrupt(unsigned chan) {}
+void exi_complete_transfer(unsigned chan) { complete[chan]++; }
+void exi0_complete_transfer(void) { exi_complete_transfer(0); }
+void exi1_complete_transfer(void) { exi_complete_transfer(1); }
+
+static bool write_fails(void)
+{
+	if (rand() % 100 < fail) {
+		failures++;
+		return true;
+	}
+	return false;
+}
+
+bool frag_read_write_async(int file, void *buffer, uint32_t length, uint32_t offset, bool write, frag_callback callback)
+{
+	if (queued == QUEUE_SIZE || (write && write_fails()))
+		return false;
+
+	queue[queued].buffer = buffer;
+	queue[queued].length = MIN(length, 512 - offset % 512);
+	queue[queued].offset = offset;
+	queue[queued].chan = file - FRAGS_CARD(0);
+	queue[queued].write = write;
+	queue[queued].callback = callback;
+	queued++;
+	return true;
+}
+
+int frag_read_write(int file, void *buffer, uint32_t length, uint32_t offset, bool write)
+{
+	int chan = file - FRAGS_CARD(0);
+
+	length = MIN(length, 512 - offset % 512);
+
+	if (write) {
+		if (write_fails())
+			return 0;
+		memcpy(dev[chan] + offset, buffer, length);
+	} else
+		memcpy(buffer, dev[chan] + offset, length);
+
+	return length;
+}
+
+static void tick(void)
+{
+	if (!queued)
+		return;
+
+	typeof(queue[0]) op = queue[0];
+	memmove(queue, queue + 1, sizeof(queue[0]) * --queued);
+
+	if (op.write) {
+		if (write_fails()) {
+			op.callback(op.buffer, 0);
+			return;
+		}
+		memcpy(dev[op.chan] + op.offset, op.buffer, op.length);
+	} else
+		memcpy(op.buffer, dev[op.chan] + op.offset, op.length);
+
+	op.callback(op.buffer, op.length);
+}
+
+static void command(unsigned chan, uint8_t cmd, uint32_t offset)
+{
+	card_imm(chan, cmd);
+	card_imm(chan, (offset >> 17) & 0x7F);
+	card_imm(chan, (offset >> 9) & 0xFF);
+	card_imm(chan, (offset >> 7) & 0x3);
+	card_imm(chan, offset & 0x7F);
+}
+
+/* Returns whether the transfer completed before the device ran. */
+static bool transfer(unsigned chan, uint8_t cmd, uint32_t offset, uint32_t address, uint32_t length, int type)
+{
+	int before = complete[chan];
+
+	command(chan, cmd, offset);
+
+	if (!card_dma(chan, address, length, type))
+		complete[chan]++;
+
+	bool early = complete[chan] != before;
+
+	while (complete[chan] == before) {
+		if (!queued) {
+			printf("card: transfer %02X at %05X never completed\n", cmd, offset);
+			exit(1);
+		}
+		tick();
+	}
+
+	card_deselect(chan);
+	return early;
+}
+
+static uint8_t status(unsigned chan)
+{
+	card_imm(chan, 0x83);
+	uint8_t status = card_imm(chan, 0);
+	card_deselect(chan);
+	return status;
+}
+
+static void clear_status(unsigned chan)
+{
+	card_imm(chan, 0x89);
+	card_deselect(chan);
+}
+
+/* Programs one page the way the SDK does, retrying it on error. */
+static void program(unsigned chan, uint32_t offset, uint32_t address)
+{
+	for (;;) {
+		for (int i = 0; i < 4; i++)
+			transfer(chan, 0xF2, offset + i * 128, address + i * 128, 128, EXI_WRITE);
+		if (!(status(chan) & 0b00001000))
+			break;
+		clear_status(chan);
+	}
+	memcpy(ref[chan] + offset, mem + address, 512);
+}
+
+/* Each test starts from a freshly booted emulator, the way a reset leaves it. */
+static int run(const char *name, bool (*test)(int, int), int failrate, int idle)
+{
+	int status = 1;
+	pid_t pid;
+
+	fflush(stdout);
+	pid = fork();
+
+	if (pid == 0) {
+		void *arenaLo = NULL, *arenaHi = malloc(1 << 16) + (1 << 16);
+
+		VAR_CARD_IDS[0] = VAR_CARD_IDS[1] = 1;
+		card_init(&arenaLo, &arenaHi);
+
+		for (int chan = 0; chan < 2; chan++)
+			for (int i = 0; i < CARD_SIZE; i++)
+				dev[chan][i] = ref[chan][i] = rand();
+
+		exit(!test(failrate, idle));
+	}
+
+	if (pid > 0)
+		waitpid(pid, &status, 0);
+
+	printf("%s: %s\n", name, status == 0 ? "ok" : "FAILED");
+	return status != 0;
+}
+
+static bool test_workload(int failrate, int idle)
+{
+	int mismatches = 0;
+
+	fail = failrate;
+
+	for (int iter = 0; iter < 4000; iter++) {
+		unsigned chan = rand() % 2;
+		int r = rand() % 10;
+
+		if (r < 4) {
+			/* data blocks, then the directory and FAT copies */
+			for (int b = 0, n = 1 + rand() % 3; b < n + 2; b++) {
+				uint32_t block = b < n ? (5 + rand() % 59) * 8192 : (b == n ? 1 + rand() % 2 : 3 + rand() % 2) * 8192;
+				int first = rand() % 2 ? 0 : rand() % 16;
+				int last = rand() % 2 ? 15 : first + rand() % (16 - first);
+
+				for (int i = 0; i < 8192; i++)
+					mem[0x10000 + i] = rand();
+				for (int page = first; page <= last; page++)
+					program(chan, block + page * 512, 0x10000 + page * 512);
+			}
+		} else if (r < 9) {
+			uint32_t length = rand() % 2 ? 512 : 128 << (rand() % 7);
+			uint32_t offset = (rand() % (CARD_SIZE / 128)) * 128;
+
+			if (offset + length > CARD_SIZE)
+				offset = CARD_SIZE - length;
+
+			memset(mem + 0x40000, 0xAA, length);
+			transfer(chan, 0x52, offset, 0x40000, length, EXI_READ);
+			if (memcmp(mem + 0x40000, ref[chan] + offset, length))
+				mismatches++;
+		} else {
+			for (int n = rand() % idle; n; n--)
+				tick();
+		}
+	}
+
+	/* reset while the last save may still be in the cache */
+	fail = 0;
+	card_fini();
+
+	return !memcmp(dev, ref, sizeof(dev)) && !mismatches;
+}
+
+/* Once writes keep failing, programs must not complete ahead of the card. */
+static bool test_error_state(int failrate, int idle)
+{
+	bool ok = true;
+	uint32_t offset = 9 * 8192;
+
+	for (int i = 0; i < 512; i++)
+		mem[0x10000 + i] = rand();
+
+	fail = failrate;
+	for (int i = 0; i < 4; i++)
+		transfer(0, 0xF2, offset + i * 128, 0x10000 + i * 128, 128, EXI_WRITE);
+	ok &= (status(0) & 0b00001000) != 0;
+
+	/* the card is still in its error state for the next program */
+	fail = 0;
+	for (int i = 0; i < 4; i++) {
+		bool early = transfer(0, 0xF2, offset + i * 128, 0x10000 + i * 128, 128, EXI_WRITE);
+		if (i == 0)
+			ok &= !early;
+	}
+	ok &= !memcmp(dev[0] + offset, mem + 0x10000, 512);
+
+	clear_status(0);
+	memcpy(ref[0] + offset, mem + 0x10000, 512);
+	card_fini();
+
+	return ok && !memcmp(dev, ref, sizeof(dev));
+}
+
+int main(int argc, char **argv)
+{
+	int failed = 0;
+
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	failed += run("card: saves with a reliable device", test_workload, 0, 5000);
+	failed += run("card: saves with failing writes", test_workload, 10, 5000);
+	failed += run("card: reset with saves still cached", test_workload, 0, 2);
+	failed += run("card: programs wait for the card after errors", test_error_state, 100, 0);
+
+	return failed != 0;
+}
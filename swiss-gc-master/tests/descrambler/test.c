@@ -0,0 +1,130 @@
+/*
+ * IPL descrambler against the original bit-serial routine.
+ *
+ * bitserial_descrambler is the version the checkpointed one replaced. It
+ * produces the reference image once; the new descrambler has to match it
+ * for random-offset reads made before anything is checkpointed, for the
+ * whole range in one call, and for a sequential dump in 2 KiB reads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "descrambler.h"
+
+#define IPL_SIZE 0x200000
+#define READS    3000
+
+// bootrom descrambler reversed by segher
+// Copyright 2008 Segher Boessenkool <segher@kernel.crashing.org>
+static void bitserial_descrambler(unsigned int offset, void* buffer, unsigned int length) {
+	unsigned char* data = buffer;
+	unsigned int descrambled_length = 0x100;
+
+	unsigned char acc = 0;
+	unsigned char nacc = 0;
+
+	unsigned short t = 0x2953;
+	unsigned short u = 0xd9c2;
+	unsigned short v = 0x3ff1;
+
+	unsigned char x = 1;
+	unsigned int it = offset < 0x100 ? 0x100 - offset : 0;
+
+	while (it < length) {
+		int t0 = t & 1;
+		int t1 = (t >> 1) & 1;
+		int u0 = u & 1;
+		int u1 = (u >> 1) & 1;
+		int v0 = v & 1;
+
+		x ^= t1 ^ v0;
+		x ^= (u0 | u1);
+		x ^= (t0 ^ u1 ^ v0) & (t0 ^ u0);
+
+		if (t0 == u0) {
+			v >>= 1;
+			if (v0)
+				v ^= 0xb3d0;
+		}
+
+		if (t0 == 0) {
+			u >>= 1;
+			if (u0)
+				u ^= 0xfb10;
+		}
+
+		t >>= 1;
+		if (t0)
+			t ^= 0xa740;
+
+		nacc++;
+		acc = 2*acc + x;
+		if (nacc == 8) {
+			if (descrambled_length >= 0x1aff00)
+				it++;
+			else if (descrambled_length >= offset)
+				data[it++] ^= acc;
+			descrambled_length++;
+			nacc = 0;
+		}
+	}
+}
+
+static unsigned char scrambled[IPL_SIZE], reference[IPL_SIZE], image[IPL_SIZE];
+
+int main(void)
+{
+	int failed = 0, bad = 0;
+
+	srand(1);
+	for (int i = 0; i < IPL_SIZE; i++)
+		scrambled[i] = rand();
+
+	memcpy(reference, scrambled, IPL_SIZE);
+	bitserial_descrambler(0, reference, IPL_SIZE);
+
+	// the reference stands in for calling the bit-serial routine at each offset
+	for (int i = 0; i < 4; i++) {
+		unsigned int offset = rand() % IPL_SIZE, length = rand() % 0x1000;
+		unsigned char buffer[0x1000];
+
+		if (offset + length > IPL_SIZE)
+			length = IPL_SIZE - offset;
+		memcpy(buffer, scrambled + offset, length);
+		bitserial_descrambler(offset, buffer, length);
+		bad += memcmp(buffer, reference + offset, length) != 0;
+	}
+
+	// random reads first, while checkpoints are still being recorded out of order
+	for (int i = 0; i < READS; i++) {
+		unsigned int offset = rand() % IPL_SIZE, length = rand() % 0x3000;
+		unsigned char buffer[0x3000];
+
+		if (i % 10 == 0)
+			offset = rand() % 2 ? rand() % 0x200 : 0x1AFF00 - 0x100 + rand() % 0x200;
+		if (offset + length > IPL_SIZE)
+			length = IPL_SIZE - offset;
+		memcpy(buffer, scrambled + offset, length);
+		descrambler(offset, buffer, length);
+		bad += memcmp(buffer, reference + offset, length) != 0;
+	}
+	printf("descrambler: %d random reads, %d mismatched\n", READS, bad);
+	failed |= bad != 0;
+
+	memcpy(image, scrambled, IPL_SIZE);
+	descrambler(0, image, IPL_SIZE);
+	bad = memcmp(image, reference, IPL_SIZE) != 0;
+	printf("descrambler: whole image in one read %s\n", bad ? "differs" : "matches");
+	failed |= bad;
+
+	memcpy(image, scrambled, IPL_SIZE);
+	for (unsigned int offset = 0; offset < IPL_SIZE; offset += 0x800)
+		descrambler(offset, image + offset, 0x800);
+	bad = memcmp(image, reference, IPL_SIZE) != 0;
+	printf("descrambler: sequential 2 KiB reads %s\n", bad ? "differ" : "match");
+	failed |= bad;
+
+	printf("descrambler: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
@@ -0,0 +1,104 @@
+/*
+ * Fixed-point DVD timing model against the double precision one.
+ *
+ * DVDMath.c is built with DVD_MATH_FIXED, which still carries the double
+ * precision Calculate*Time functions next to the fixed-point tick ones.
+ * Random offsets across the first layer bound the error of each tick
+ * function, and both paths are timed per call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "DVDMath.h"
+
+#define DISC_LAYER_SIZE 0x57058000
+#define BLOCK_SIZE      0x8000
+
+#define MAX_SEEK_ERROR     2.0   // ticks
+#define MAX_LATENCY_ERROR 80.0   // ticks
+#define MAX_READ_ERROR    20.0   // ticks per block
+
+#define SAMPLES 2000000
+
+static u32 offsets[2][SAMPLES];
+static OSTime times[SAMPLES];
+
+static u32 random_offset(void)
+{
+	return ((u64)rand() * rand()) % DISC_LAYER_SIZE & ~(BLOCK_SIZE - 1);
+}
+
+static double seconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	double seek = 0, latency = 0, read = 0;
+	double per_rotation = OS_TIMER_CLOCK / 28.5;
+	int failed = 0;
+
+	srand(1);
+
+	for (int i = 0; i < SAMPLES; i++) {
+		offsets[0][i] = random_offset();
+		offsets[1][i] = i % 7 ? random_offset() : offsets[0][i] + BLOCK_SIZE;
+		times[i] = (((u64)rand() << 16) ^ rand()) % ((u64)OS_TIMER_CLOCK * 3600 * 24);
+	}
+
+	for (int i = 0; i < SAMPLES; i++) {
+		u32 from = offsets[0][i], to = offsets[1][i];
+		double d;
+
+		d = fabs(CalculateSeekTime(from, to) * OS_TIMER_CLOCK - CalculateSeekTicks(from, to));
+		seek = fmax(seek, d);
+
+		// latencies that land either side of a full rotation are the same
+		d = fabs(CalculateRotationalLatency(to, (double)times[i] / OS_TIMER_CLOCK) * OS_TIMER_CLOCK -
+			CalculateRotationalLatencyTicks(to, times[i]));
+		if (d > per_rotation / 2)
+			d = per_rotation - d;
+		latency = fmax(latency, d);
+
+		d = fabs(CalculateRawDiscReadTime(from, BLOCK_SIZE) * OS_TIMER_CLOCK - CalculateRawDiscReadTicks(from, BLOCK_SIZE));
+		read = fmax(read, d);
+	}
+
+	// the last block of the layer still has table entries to interpolate from
+	u32 last = DISC_LAYER_SIZE - BLOCK_SIZE;
+	read = fmax(read, fabs(CalculateRawDiscReadTime(last, BLOCK_SIZE) * OS_TIMER_CLOCK - CalculateRawDiscReadTicks(last, BLOCK_SIZE)));
+
+	printf("dvdmath: max error %.2f seek, %.2f latency, %.2f read ticks\n", seek, latency, read);
+	failed |= seek > MAX_SEEK_ERROR || latency > MAX_LATENCY_ERROR || read > MAX_READ_ERROR;
+
+	volatile double sink_double = 0;
+	volatile OSTick sink_ticks = 0;
+	double start, fixed, floating;
+
+	start = seconds();
+	for (int i = 0; i < SAMPLES; i++) {
+		sink_ticks += CalculateSeekTicks(offsets[0][i], offsets[1][i]);
+		sink_ticks += CalculateRotationalLatencyTicks(offsets[1][i], times[i]);
+		sink_ticks += CalculateRawDiscReadTicks(offsets[1][i], BLOCK_SIZE);
+	}
+	fixed = seconds() - start;
+
+	start = seconds();
+	for (int i = 0; i < SAMPLES; i++) {
+		sink_double += CalculateSeekTime(offsets[0][i], offsets[1][i]);
+		sink_double += CalculateRotationalLatency(offsets[1][i], (double)times[i] / OS_TIMER_CLOCK);
+		sink_double += CalculateRawDiscReadTime(offsets[1][i], BLOCK_SIZE);
+	}
+	floating = seconds() - start;
+
+	printf("dvdmath: %.1f ns per block fixed, %.1f ns per block double (host)\n",
+		fixed * 1e9 / SAMPLES, floating * 1e9 / SAMPLES);
+
+	printf("dvdmath: %s\n", failed ? "FAILED" : "ok");
+	return failed;
+}
@@ -0,0 +1,60 @@
+/* Host stand-in for swiss/source/devices/deviceHandler.h, with the FatFs directory calls */
+#ifndef DEVICE_HANDLER_H
+#define DEVICE_HANDLER_H
+
+#include <gccore.h>
+
+#define PATHNAME_MAX 1024
+
+#define IS_FILE 1
+#define IS_DIR 2
+#define IS_SPECIAL 3
+
+#define FEAT_FAT_FUNCS 0x40
+
+#define DEVICE_HANDLER_SEEK_SET 0
+
+typedef struct {
+	char name[PATHNAME_MAX];
+	uint64_t fileBase;
+	u32 offset;
+	u32 size;
+	s32 fileAttrib;
+	void *fp;
+} file_handle;
+
+typedef struct {
+	u32 features;
+	s32 (*makeDir)(file_handle *file);
+	s32 (*readDir)(file_handle *file, file_handle **dir, u32 type);
+	s64 (*seekFile)(file_handle *file, s64 where, u32 type);
+	s32 (*readFile)(file_handle *file, void *buffer, u32 length);
+	s32 (*writeFile)(file_handle *file, void *buffer, u32 length);
+	s32 (*closeFile)(file_handle *file);
+	s32 (*deleteFile)(file_handle *file);
+} DEVICEHANDLER_INTERFACE;
+
+typedef enum {
+	FR_OK = 0,
+	FR_NO_PATH = 5
+} FRESULT;
+
+#define AM_HID 0x02
+#define AM_DIR 0x10
+
+typedef struct {
+	void *dir;
+	char path[PATHNAME_MAX];
+} DIRF;
+
+typedef struct {
+	u64 fsize;
+	u8 fattrib;
+	char fname[256];
+} FILINFO;
+
+FRESULT f_opendir(DIRF *dp, const char *path);
+FRESULT f_readdir(DIRF *dp, FILINFO *fno);
+FRESULT f_closedir(DIRF *dp);
+
+#endif
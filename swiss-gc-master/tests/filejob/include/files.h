@@ -0,0 +1,7 @@
+/* Host stand-in for swiss/include/files.h */
+#ifndef FILES_H
+#define FILES_H
+
+void concat_path(char *pathName, const char *dirName, const char *baseName);
+
+#endif
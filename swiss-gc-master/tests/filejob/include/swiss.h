@@ -0,0 +1,17 @@
+/* Host stand-in for swiss/include/swiss.h */
+#ifndef SWISS_H
+#define SWISS_H
+
+#include <stdio.h>
+#include "deviceHandler.h"
+
+typedef struct {
+	bool showHiddenFiles;
+	bool hideUnknownFileTypes;
+} SwissSettings;
+
+extern SwissSettings swissSettings;
+
+#define print_gecko(...) ((void)0)
+
+#endif
@@ -0,0 +1,7 @@
+/* Host stand-in for swiss/include/util.h */
+#ifndef UTIL_H
+#define UTIL_H
+
+char *getRelativeName(char *path);
+
+#endif
@@ -0,0 +1,366 @@
+/*
+ * File jobs against directory trees on the host file system.
+ *
+ * One device stands in for FAT and is walked through the FatFs directory
+ * calls, the other only has readDir and filters its listings the way the
+ * FAT handler does for the browser. Copies are cancelled at random and
+ * see injected read and write failures, then resumed until done; the
+ * result has to match the source tree byte for byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "swiss.h"
+#include "util.h"
+#include "files.h"
+#include "filejob.h"
+
+#define WORK "build/filejob/work"
+
+SwissSettings swissSettings = { false, true };
+
+static long failReads = -1, failWrites = -1;
+static int listings, biggestListing;
+static int cancelAt;
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t length = strlen(src);
+	if (size) {
+		size_t n = length < size - 1 ? length : size - 1;
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return length;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+	size_t length = strlen(dst);
+	return length + strlcpy(dst + length, src, size > length ? size - length : 0);
+}
+
+char *getRelativeName(char *path)
+{
+	char *name = strrchr(path, '/');
+	return name ? name + 1 : path;
+}
+
+void concat_path(char *pathName, const char *dirName, const char *baseName)
+{
+	size_t length = pathName == dirName ? strlen(pathName) : strlcpy(pathName, dirName, PATHNAME_MAX);
+	if (length && pathName[length - 1] != '/' && baseName[0] != '/') {
+		pathName[length++] = '/';
+		pathName[length] = '\0';
+	}
+	strlcat(pathName, baseName, PATHNAME_MAX);
+}
+
+static bool is_dir(const char *path)
+{
+	struct stat st;
+	return !stat(path, &st) && S_ISDIR(st.st_mode);
+}
+
+FRESULT f_opendir(DIRF *dp, const char *path)
+{
+	dp->dir = opendir(path);
+	snprintf(dp->path, sizeof(dp->path), "%s", path);
+	return dp->dir ? FR_OK : FR_NO_PATH;
+}
+
+FRESULT f_readdir(DIRF *dp, FILINFO *fno)
+{
+	struct dirent *entry;
+	char path[PATHNAME_MAX * 2];
+	struct stat st;
+
+	do {
+		entry = readdir(dp->dir);
+	} while (entry && (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")));
+
+	memset(fno, 0, sizeof(*fno));
+	if (entry) {
+		snprintf(path, sizeof(path), "%s/%s", dp->path, entry->d_name);
+		stat(path, &st);
+		snprintf(fno->fname, sizeof(fno->fname), "%s", entry->d_name);
+		fno->fsize = st.st_size;
+		fno->fattrib = (S_ISDIR(st.st_mode) ? AM_DIR : 0) | (entry->d_name[0] == '.' ? AM_HID : 0);
+	}
+	return FR_OK;
+}
+
+FRESULT f_closedir(DIRF *dp)
+{
+	closedir(dp->dir);
+	return FR_OK;
+}
+
+/* Like deviceHandler_FAT_readDir, hidden files and unknown file types are left out for the browser */
+static s32 dev_readDir(file_handle *file, file_handle **dir, u32 type)
+{
+	DIRF dp;
+	FILINFO entry;
+	int count = 1;
+
+	if (f_opendir(&dp, file->name) != FR_OK)
+		return -1;
+
+	*dir = calloc(1, sizeof(file_handle));
+	concat_path((*dir)[0].name, file->name, "..");
+	(*dir)[0].fileAttrib = IS_SPECIAL;
+
+	while (f_readdir(&dp, &entry) == FR_OK && entry.fname[0]) {
+		if (!swissSettings.showHiddenFiles && (entry.fattrib & AM_HID))
+			continue;
+		if (swissSettings.hideUnknownFileTypes && !(entry.fattrib & AM_DIR) && !strstr(entry.fname, ".dol"))
+			continue;
+
+		*dir = realloc(*dir, (count + 1) * sizeof(file_handle));
+		memset(&(*dir)[count], 0, sizeof(file_handle));
+		concat_path((*dir)[count].name, file->name, entry.fname);
+		(*dir)[count].size = entry.fsize;
+		(*dir)[count].fileAttrib = (entry.fattrib & AM_DIR) ? IS_DIR : IS_FILE;
+		count++;
+	}
+	f_closedir(&dp);
+
+	listings++;
+	if (count > biggestListing)
+		biggestListing = count;
+	return count;
+}
+
+static s64 dev_seekFile(file_handle *file, s64 where, u32 type)
+{
+	file->offset = where;
+	return where;
+}
+
+static s32 dev_readFile(file_handle *file, void *buffer, u32 length)
+{
+	if (failReads >= 0 && !failReads--)
+		return -1;
+	if (!file->fp && !(file->fp = fopen(file->name, "rb")))
+		return -1;
+
+	fseek(file->fp, file->offset, SEEK_SET);
+	size_t n = fread(buffer, 1, length, file->fp);
+	file->offset += n;
+	return n;
+}
+
+static s32 dev_writeFile(file_handle *file, void *buffer, u32 length)
+{
+	if (failWrites >= 0 && !failWrites--)
+		return -1;
+	if (!file->fp && !(file->fp = fopen(file->name, file->offset ? "r+b" : "wb")))
+		return -1;
+	if (!length)
+		return fflush(file->fp) ? -1 : 0;
+
+	fseek(file->fp, file->offset, SEEK_SET);
+	size_t n = fwrite(buffer, 1, length, file->fp);
+	file->offset += n;
+	return n;
+}
+
+static s32 dev_closeFile(file_handle *file)
+{
+	if (file->fp) {
+		fclose(file->fp);
+		file->fp = NULL;
+	}
+	return 0;
+}
+
+static s32 dev_deleteFile(file_handle *file)
+{
+	dev_closeFile(file);
+	return file->fileAttrib == IS_DIR ? rmdir(file->name) : unlink(file->name);
+}
+
+static s32 dev_makeDir(file_handle *file)
+{
+	return mkdir(file->name, 0755);
+}
+
+static DEVICEHANDLER_INTERFACE fat = {
+	FEAT_FAT_FUNCS, dev_makeDir, dev_readDir, dev_seekFile, dev_readFile, dev_writeFile, dev_closeFile, dev_deleteFile
+};
+
+static DEVICEHANDLER_INTERFACE other = {
+	0, dev_makeDir, dev_readDir, dev_seekFile, dev_readFile, dev_writeFile, dev_closeFile, dev_deleteFile
+};
+
+/* Files of all sizes, hidden ones and ones the browser wouldn't show, and a directory of many */
+static void make_tree(const char *path, int depth)
+{
+	char child[PATHNAME_MAX];
+	int files = depth == 1 ? 600 : rand() % 6;
+
+	mkdir(path, 0755);
+	for (int i = 0; i < files; i++) {
+		snprintf(child, sizeof(child), "%s/%sf%d.%s", path, rand() % 4 ? "" : ".", i, rand() % 2 ? "dol" : "bin");
+		FILE *fp = fopen(child, "wb");
+		int size = depth == 1 ? rand() % 64 : rand() % 3 ? rand() % 5000 : rand() % 900000;
+		for (int j = 0; j < size; j++)
+			fputc(rand(), fp);
+		fclose(fp);
+	}
+	if (depth < 5) {
+		for (int i = 0, dirs = depth ? rand() % 4 : 3; i < dirs; i++) {
+			snprintf(child, sizeof(child), "%s/%sd%d", path, i == 2 ? "." : "", i);
+			make_tree(child, depth + 1);
+		}
+	}
+}
+
+static void remove_tree(const char *path)
+{
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+	char child[PATHNAME_MAX];
+
+	if (!dir) {
+		unlink(path);
+		return;
+	}
+	while ((entry = readdir(dir)))
+		if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+			remove_tree(child);
+		}
+	closedir(dir);
+	rmdir(path);
+}
+
+/* Whether both trees hold the same entries and bytes */
+static bool same_tree(const char *a, const char *b)
+{
+	if (is_dir(a) != is_dir(b))
+		return false;
+
+	if (!is_dir(a)) {
+		FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+		bool same = fa && fb;
+		int ca, cb;
+		while (same && (ca = fgetc(fa)) == (cb = fgetc(fb)) && ca != EOF);
+		same = same && ca == cb;
+		if (fa) fclose(fa);
+		if (fb) fclose(fb);
+		return same;
+	}
+
+	int entries[2] = {0, 0};
+	const char *paths[2] = {a, b};
+	for (int side = 0; side < 2; side++) {
+		DIR *dir = opendir(paths[side]);
+		struct dirent *entry;
+		char child[2][PATHNAME_MAX];
+
+		while ((entry = readdir(dir))) {
+			if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+				continue;
+			entries[side]++;
+			snprintf(child[0], PATHNAME_MAX, "%s/%s", paths[side], entry->d_name);
+			snprintf(child[1], PATHNAME_MAX, "%s/%s", paths[!side], entry->d_name);
+			if (!side && !same_tree(child[0], child[1])) {
+				closedir(dir);
+				return false;
+			}
+		}
+		closedir(dir);
+	}
+	return entries[0] == entries[1];
+}
+
+static bool progress(void *ctx, file_job *job)
+{
+	return --cancelAt != 0;
+}
+
+/* Runs a job until it's done, resuming it after every cancel and failure */
+static int run(file_job *job)
+{
+	int resumes = 0;
+
+	while (file_job_run(job, progress, NULL) != FILE_JOB_DONE) {
+		if (++resumes > 10000) {
+			printf("filejob: job never finished\n");
+			exit(1);
+		}
+		cancelAt = rand() % 40 ? rand() % 300 : -1;
+	}
+	return resumes;
+}
+
+static int report(const char *name, bool ok)
+{
+	printf("filejob: %s: %s\n", name, ok ? "ok" : "FAILED");
+	return !ok;
+}
+
+int main(int argc, char **argv)
+{
+	file_handle src = { WORK "/src" }, copy = { WORK "/copy" }, single = { WORK "/ref/f0.bin" };
+	file_job job;
+	int failed = 0, resumes = 0;
+	bool ok;
+
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+	remove_tree(WORK);
+	mkdir(WORK, 0755);
+	make_tree(WORK "/src", 0);
+	src.fileAttrib = copy.fileAttrib = IS_DIR;
+	single.fileAttrib = IS_FILE;
+
+	// FAT is walked an entry at a time and sees everything, whatever the browser shows
+	ok = file_job_init(&job, FILE_JOB_COPY, &fat, &src, &fat, WORK "/copy");
+	cancelAt = rand() % 300;
+	failReads = rand() % 50;
+	failWrites = rand() % 50;
+	if (ok)
+		resumes += run(&job);
+	file_job_free(&job);
+	ok = ok && same_tree(WORK "/src", WORK "/copy") && !listings;
+	ok = ok && !swissSettings.showHiddenFiles && swissSettings.hideUnknownFileTypes;
+	failed += report("copy on FAT, cancelled and failing", ok);
+
+	// Other devices list each directory whole with readDir
+	mkdir(WORK "/ref", 0755);
+	cancelAt = failReads = failWrites = -1;
+	ok = file_job_init(&job, FILE_JOB_COPY, &fat, &src, &fat, WORK "/ref/src") && !run(&job);
+	file_job_free(&job);
+	ok = ok && file_job_init(&job, FILE_JOB_MOVE, &other, &copy, &other, WORK "/moved");
+	cancelAt = rand() % 300;
+	if (ok)
+		resumes += run(&job);
+	file_job_free(&job);
+	ok = ok && same_tree(WORK "/ref/src", WORK "/moved") && !is_dir(WORK "/copy") && listings;
+	ok = ok && !swissSettings.showHiddenFiles && swissSettings.hideUnknownFileTypes;
+	failed += report("move with readDir listings", ok);
+
+	ok = file_job_init(&job, FILE_JOB_DELETE, &fat, &src, NULL, NULL);
+	cancelAt = rand() % 300;
+	if (ok)
+		resumes += run(&job);
+	file_job_free(&job);
+	failed += report("delete a tree", ok && access(WORK "/src", F_OK));
+
+	fclose(fopen(single.name, "wb"));
+	ok = file_job_init(&job, FILE_JOB_DELETE, &fat, &single, NULL, NULL);
+	cancelAt = -1;
+	if (ok)
+		run(&job);
+	file_job_free(&job);
+	failed += report("delete a single file", ok && access(single.name, F_OK));
+
+	printf("filejob: %d resumes, biggest readDir listing %d entries\n", resumes, biggestListing);
+	remove_tree(WORK);
+	return failed != 0;
+}
@@ -0,0 +1,56 @@
+/* Host stand-in for swiss/source/devices/deviceHandler.h */
+#ifndef DEVICE_HANDLER_H
+#define DEVICE_HANDLER_H
+
+#include <gccore.h>
+
+#define PATHNAME_MAX 1024
+
+#define FEAT_HYPERVISOR 0x80
+
+#define LOC_MEMCARD_SLOT_A 0x1
+#define LOC_MEMCARD_SLOT_B 0x2
+#define LOC_DVD_CONNECTOR  0x4
+#define LOC_SERIAL_PORT_1  0x8
+#define LOC_SERIAL_PORT_2  0x10
+#define LOC_SYSTEM         0x40
+
+#define DEVICE_HANDLER_SEEK_SET 0
+
+typedef struct {
+	char name[PATHNAME_MAX];
+	uint64_t fileBase;
+	u32 offset;
+	u32 size;
+	s32 fileAttrib;
+} file_handle;
+
+typedef struct {
+	u32 features;
+	u32 location;
+	file_handle *initial;
+	s32 (*init)(file_handle *file);
+	s32 (*makeDir)(file_handle *file);
+	s64 (*seekFile)(file_handle *file, s64 where, u32 type);
+	s32 (*readFile)(file_handle *file, void *buffer, u32 length);
+} DEVICEHANDLER_INTERFACE;
+
+enum DEVICE_SLOTS {
+	DEVICE_CUR,
+	DEVICE_DEST,
+	DEVICE_TEMP,
+	DEVICE_CONFIG,
+	DEVICE_PATCHES,
+	MAX_DEVICE_SLOTS
+};
+
+extern DEVICEHANDLER_INTERFACE __device_dvd;
+extern DEVICEHANDLER_INTERFACE __device_sd_a;
+extern DEVICEHANDLER_INTERFACE __device_sd_b;
+extern DEVICEHANDLER_INTERFACE __device_sd_c;
+extern DEVICEHANDLER_INTERFACE *devices[MAX_DEVICE_SLOTS];
+
+void deviceHandler_setStatEnabled(int enable);
+s32 getExiChannelByLocation(u32 location);
+
+#endif
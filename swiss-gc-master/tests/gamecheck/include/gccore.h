@@ -0,0 +1,74 @@
+/* Host stand-in for libogc's gccore.h, with LWP threads on pthreads */
+#ifndef __GCCORE_H__
+#define __GCCORE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#define EXI_CHANNEL_0 0
+#define EXI_CHANNEL_1 1
+#define EXI_CHANNEL_2 2
+
+typedef pthread_t lwp_t;
+typedef pthread_mutex_t *mutex_t;
+typedef pthread_cond_t *cond_t;
+
+#define LWP_THREAD_NULL 0
+
+/* Threads numbered by the bits set here fail to be created, in the order they're asked for */
+extern u32 failThreads;
+
+static inline s32 LWP_MutexInit(mutex_t *mutex, bool recursive)
+{
+	*mutex = malloc(sizeof(pthread_mutex_t));
+	return pthread_mutex_init(*mutex, NULL);
+}
+
+static inline s32 LWP_MutexLock(mutex_t mutex) { return pthread_mutex_lock(mutex); }
+static inline s32 LWP_MutexUnlock(mutex_t mutex) { return pthread_mutex_unlock(mutex); }
+
+static inline s32 LWP_MutexDestroy(mutex_t mutex)
+{
+	pthread_mutex_destroy(mutex);
+	free(mutex);
+	return 0;
+}
+
+static inline s32 LWP_CondInit(cond_t *cond)
+{
+	*cond = malloc(sizeof(pthread_cond_t));
+	return pthread_cond_init(*cond, NULL);
+}
+
+static inline s32 LWP_CondWait(cond_t cond, mutex_t mutex) { return pthread_cond_wait(cond, mutex); }
+static inline s32 LWP_CondBroadcast(cond_t cond) { return pthread_cond_broadcast(cond); }
+
+static inline s32 LWP_CondDestroy(cond_t cond)
+{
+	pthread_cond_destroy(cond);
+	free(cond);
+	return 0;
+}
+
+static inline s32 LWP_CreateThread(lwp_t *thread, void *(*entry)(void *), void *arg, void *stackbase, u32 stack_size, u8 prio)
+{
+	bool fail = failThreads & 1;
+	failThreads >>= 1;
+	if (fail || pthread_create(thread, NULL, entry, arg))
+		return -1;
+	return 0;
+}
+
+static inline s32 LWP_JoinThread(lwp_t thread, void **value_ptr) { return pthread_join(thread, value_ptr); }
+
+#endif
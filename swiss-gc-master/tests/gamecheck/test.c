@@ -0,0 +1,493 @@
+/*
+ * Game check against mock devices with latency.
+ *
+ * check_game and what it calls are taken from swiss.c, gcm.c and cheats.c
+ * (see the Makefile and host.sed) and run on tasks.c over pthreads. The
+ * disc is read from a slow network device while cheats are looked for on
+ * SD in every slot; the files to patch and the cheats found have to match
+ * a run with every lane on the calling thread, the cheats search has to
+ * overlap the disc reads, and no two requests may ever be on the same EXI
+ * channel at once. The task runner's own rules are checked after.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "gcm.h"
+#include "elf.h"
+#include "cheats.h"
+#include "tasks.h"
+
+#define DISC_SIZE (8 << 20)
+
+#define FST_ENTRY_SIZE 12
+
+#define TGC_MAGIC    0xAE0F38A2
+#define WIIRD_ENGINE 0x80001800
+
+#define GAMECUBE_DISC  1
+#define MULTIDISC_DISC 2
+
+#define D_FAIL 0
+#define D_INFO 1
+
+#define PAD_BUTTON_A 0x0100
+#define PAD_BUTTON_B 0x0200
+#define PAD_BUTTON_Y 0x0800
+
+#define print_gecko(...)
+
+/* The "Applied %i cheats" message stays up for a second on the console */
+#define sleep(seconds)
+
+enum {
+	PATCH_APPLOADER = 0,
+	PATCH_BS2,
+	PATCH_DOL,
+	PATCH_DOL_PRS,
+	PATCH_ELF,
+	PATCH_OTHER,
+	PATCH_OTHER_PRS
+};
+
+enum {
+	SYS_LANG_ENGLISH = 0,
+	SYS_LANG_GERMAN,
+	SYS_LANG_FRENCH,
+	SYS_LANG_SPANISH,
+	SYS_LANG_ITALIAN,
+	SYS_LANG_DUTCH
+};
+
+typedef struct {
+	int autoCheats;
+	int sramLanguage;
+	int disableVideoPatches;
+	int wiirdDebug;
+} SwissSettings;
+
+typedef struct uiDrawObj uiDrawObj_t;
+
+SwissSettings swissSettings;
+TGCHeader tgcFile;
+DiskHeader GCMDisk;
+CheatEntries _cheats;
+char txtbuffer[2048];
+int dvdDiscTypeInt;
+u32 failThreads;
+
+typedef struct {
+	DEVICEHANDLER_INTERFACE *device;
+	int reqUs;			// Per request
+	int nsPerByte;
+	int mountMs;
+	int cheats;			// In its cheats file, 0 for none, -1 if it can't be mounted
+	int busy;
+	int reqs;
+} mock_device;
+
+static u8 *disc;
+static double started;
+static int cancelAfterMs = -1;
+static int active, concurrent, channelBusy[3], channelOverlaps;
+
+DEVICEHANDLER_INTERFACE __device_fsp, __device_dvd, __device_sd_a, __device_sd_b, __device_sd_c;
+DEVICEHANDLER_INTERFACE *devices[MAX_DEVICE_SLOTS];
+
+static mock_device mocks[] = {
+	{ &__device_fsp },
+	{ &__device_sd_a },
+	{ &__device_sd_b },
+	{ &__device_sd_c },
+	{ &__device_dvd },
+};
+
+#define NUM_MOCKS (sizeof(mocks) / sizeof(mocks[0]))
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+}
+
+uiDrawObj_t *DrawPublish(uiDrawObj_t *obj) { return obj; }
+uiDrawObj_t *DrawProgressBar(bool indeterminate, int percent, const char *message) { return NULL; }
+uiDrawObj_t *DrawMessageBox(int type, const char *message) { return NULL; }
+void DrawDispose(uiDrawObj_t *obj) {}
+void VIDEO_WaitVSync(void) { usleep(16667); }
+void setTopAddr(u32 addr) {}
+void deviceHandler_setStatEnabled(int enable) {}
+
+u32 PAD_ButtonsHeld(int chan)
+{
+	return cancelAfterMs >= 0 && now() - started >= cancelAfterMs ? PAD_BUTTON_B : 0;
+}
+
+int DVD_Read(void *dst, u64 offset, int len) { return -1; }
+u64 get_gcm_boot_hash(DiskHeader *header) { return 0x123456789ABCDEF0ULL; }
+bool valid_gcm_magic(DiskHeader *header) { return header->DVDMagicWord == 0xC2339F3D; }
+int valid_elf_image(void *addr) { return 0; }
+int parse_tgc(file_handle *file, ExecutableFile *filesToPatch, u32 tgc_base, char *tgcname) { return 0; }
+int patch_gcm(ExecutableFile *filesToPatch, int numToPatch) { return 0; }
+char *getRelativeName(char *name) { return name; }
+
+bool endsWith(char *str, char *end)
+{
+	size_t a = strlen(str), b = strlen(end);
+	return a >= b && !strcasecmp(str + a - b, end);
+}
+
+void concatf_path(char *path, const char *base, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	strcpy(path, base);
+	vsprintf(path + strlen(path), format, args);
+	va_end(args);
+}
+
+u32 DOLSize(DOLHEADER *dol)
+{
+	u32 size = 0;
+	for (int i = 0; i < MAXTEXTSECTION; i++)
+		if (dol->textOffset[i] + dol->textLength[i] > size)
+			size = dol->textOffset[i] + dol->textLength[i];
+	for (int i = 0; i < MAXDATASECTION; i++)
+		if (dol->dataOffset[i] + dol->dataLength[i] > size)
+			size = dol->dataOffset[i] + dol->dataLength[i];
+	return size;
+}
+
+/* The cheats files say how many cheats they hold */
+void parseCheats(char *contents)
+{
+	memset(&_cheats, 0, sizeof(_cheats));
+	_cheats.num_cheats = atoi(contents);
+}
+
+int applyAllCheats() { return _cheats.num_cheats; }
+int getEnabledCheatsSize(void) { return 0; }
+
+static mock_device *mock_for(file_handle *file)
+{
+	for (int i = 0; i < NUM_MOCKS; i++) {
+		const char *root = mocks[i].device->initial->name;
+		if (!strncmp(file->name, root, strlen(root)))
+			return &mocks[i];
+	}
+	abort();
+}
+
+/* Holds the device, and its EXI channel, for as long as the request takes */
+static void request(mock_device *mock, int us)
+{
+	s32 channel = getExiChannelByLocation(mock->device->location);
+
+	if (__sync_fetch_and_add(&active, 1))
+		__sync_fetch_and_add(&concurrent, 1);
+	if (channel >= 0 && __sync_fetch_and_add(&channelBusy[channel], 1))
+		__sync_fetch_and_add(&channelOverlaps, 1);
+	__sync_fetch_and_add(&mock->busy, 1);
+	__sync_fetch_and_add(&mock->reqs, 1);
+	usleep(us);
+	__sync_fetch_and_sub(&mock->busy, 1);
+	if (channel >= 0)
+		__sync_fetch_and_sub(&channelBusy[channel], 1);
+	__sync_fetch_and_sub(&active, 1);
+}
+
+static s32 mock_init(file_handle *file)
+{
+	mock_device *mock = mock_for(file);
+	request(mock, mock->mountMs * 1000);
+	return mock->cheats >= 0;
+}
+
+static s32 mock_makeDir(file_handle *file)
+{
+	mock_device *mock = mock_for(file);
+	request(mock, mock->reqUs);
+	return 0;
+}
+
+void ensure_device_path(DEVICEHANDLER_INTERFACE *device, char *path, char *oldPath)
+{
+	file_handle dir;
+	concatf_path(dir.name, device->initial->name, "%s", path);
+	device->makeDir(&dir);
+}
+
+static s64 mock_seekFile(file_handle *file, s64 where, u32 type)
+{
+	file->offset = where;
+	return where;
+}
+
+static s32 mock_readFile(file_handle *file, void *buffer, u32 length)
+{
+	mock_device *mock = mock_for(file);
+	const void *data = disc;
+	u32 size = DISC_SIZE;
+	char cheats[64];
+
+	request(mock, mock->reqUs + (u64)length * mock->nsPerByte / 1000);
+	if (endsWith(file->name, ".txt")) {
+		if (mock->cheats <= 0)
+			return -1;
+		file->size = size = sprintf(cheats, "%d cheats", mock->cheats);
+		data = cheats;
+	}
+	if (file->offset > size)
+		return -1;
+	if (length > size - file->offset)
+		length = size - file->offset;
+	memcpy(buffer, data + file->offset, length);
+	file->offset += length;
+	return length;
+}
+
+#include "check.inc"
+
+static void mock_devices(void)
+{
+	static file_handle roots[NUM_MOCKS] = { { "fsp:/" }, { "sda:/" }, { "sdb:/" }, { "sdc:/" }, { "dvd:/" } };
+	static const u32 locations[NUM_MOCKS] = { LOC_SERIAL_PORT_1, LOC_MEMCARD_SLOT_A, LOC_MEMCARD_SLOT_B, LOC_SERIAL_PORT_2, LOC_DVD_CONNECTOR };
+
+	for (int i = 0; i < NUM_MOCKS; i++) {
+		*mocks[i].device = (DEVICEHANDLER_INTERFACE){
+			.location = locations[i],
+			.initial = &roots[i],
+			.init = mock_init,
+			.makeDir = mock_makeDir,
+			.seekFile = mock_seekFile,
+			.readFile = mock_readFile,
+		};
+		mocks[i].reqUs = 300;
+		mocks[i].nsPerByte = 100;
+		mocks[i].mountMs = 40;
+		mocks[i].cheats = 0;
+	}
+	// A slow network share for the disc, and a card slow to mount
+	mocks[0].reqUs = 1500;
+	mocks[0].nsPerByte = 10000;
+	mocks[2].mountMs = 100;
+	devices[DEVICE_CUR] = &__device_fsp;
+}
+
+static void build_disc(void)
+{
+	static const char *named[] = {
+		"a.dol", "b.dol", "c.dol", "eng.rel", "fra.rel",
+		"claire.rel", "claire_f.rel", "claire_g.rel", "claire_i.rel", "claire_s.rel",
+		"leon.rel", "leon_f.rel", "leon_g.rel", "leon_i.rel", "leon_s.rel",
+	};
+	const int numNamed = sizeof(named) / sizeof(named[0]), numFiles = 280;
+
+	disc = calloc(1, DISC_SIZE);
+	DiskHeader *header = (DiskHeader *)disc;
+	memcpy(header, "GHAP08", 6);
+	header->DVDMagicWord = 0xC2339F3D;
+	header->DOLOffset = 0x10000;
+	header->FSTOffset = 0x40000;
+	header->MaxFSTSize = 0x8000;
+	((ApploaderHeader *)(disc + 0x2440))->size = 0x1000;
+
+	DOLHEADER *dol = (DOLHEADER *)(disc + header->DOLOffset);
+	dol->textOffset[0] = 0x100;
+	dol->textAddress[0] = 0x80004000;
+	dol->textLength[0] = 0x20000;
+	dol->entryPoint = 0x80004000;
+
+	u8 *fst = disc + header->FSTOffset;
+	u32 entries = numFiles + 1;
+	char *strings = (char *)fst + entries * 12;
+	u32 nameOffset = 0;
+	fst[0] = 1;
+	*(u32 *)(fst + 8) = entries;
+	for (int i = 0; i < numFiles; i++) {
+		u8 *entry = fst + (i + 1) * 12;
+		u32 offset = 0x100000 + i * 0x8000;
+		char name[32];
+
+		if (i < numNamed)
+			strcpy(name, named[i]);
+		else
+			sprintf(name, "data%03d.bin", i);
+		entry[1] = nameOffset >> 16;
+		entry[2] = nameOffset >> 8;
+		entry[3] = nameOffset;
+		*(u32 *)(entry + 4) = offset;
+		*(u32 *)(entry + 8) = 0x4000;
+		strcpy(strings + nameOffset, name);
+		nameOffset += strlen(name) + 1;
+
+		if (endsWith(name, ".dol")) {
+			dol = (DOLHEADER *)(disc + offset);
+			dol->textOffset[0] = 0x100;
+			dol->textAddress[0] = 0x80004000;
+			dol->textLength[0] = 0x1000 + i * 0x20;
+			dol->entryPoint = 0x80004000;
+		}
+	}
+	header->FSTSize = entries * 12 + nameOffset;
+}
+
+typedef struct {
+	int numFiles;
+	ExecutableFile files[64];
+	int numCheats;
+	double ms;
+	int sdReqs;
+} result;
+
+static file_handle file = { "fsp:/game.iso", 0, 0, DISC_SIZE }, file2 = { "fsp:/game2.iso", 0, 0, DISC_SIZE };
+
+static void check(bool withDisc2, result *r)
+{
+	memset(r, 0, sizeof(*r));
+	memset(&_cheats, 0, sizeof(_cheats));
+	for (int i = 0; i < NUM_MOCKS; i++)
+		mocks[i].reqs = 0;
+	concurrent = channelOverlaps = 0;
+	// load_game has read the disc header before any of this
+	memcpy(&GCMDisk, disc, sizeof(DiskHeader));
+	started = now();
+	r->numFiles = check_game(&file, withDisc2 ? &file2 : NULL, r->files);
+	r->ms = now() - started;
+	r->numCheats = _cheats.num_cheats;
+	r->sdReqs = mocks[1].reqs + mocks[2].reqs + mocks[3].reqs;
+}
+
+static bool same_result(result *a, result *b)
+{
+	if (a->numFiles != b->numFiles || a->numCheats != b->numCheats)
+		return false;
+	for (int i = 0; i < a->numFiles; i++) {
+		ExecutableFile *x = &a->files[i], *y = &b->files[i];
+		if (x->file != y->file || x->offset != y->offset || x->size != y->size ||
+			x->type != y->type || x->hash != y->hash || strcmp(x->name, y->name))
+			return false;
+	}
+	return true;
+}
+
+/* The same check, threaded and with every lane on the calling thread */
+static bool check_both(bool withDisc2, result *threaded, result *inlined)
+{
+	failThreads = (1 << TASK_LANES_MAX) - 1;
+	check(withDisc2, inlined);
+	failThreads = 0;
+	check(withDisc2, threaded);
+	return same_result(threaded, inlined);
+}
+
+static int report(const char *name, bool ok)
+{
+	printf("gamecheck: %s: %s\n", name, ok ? "ok" : "FAILED");
+	return !ok;
+}
+
+static int ran;
+
+static bool task_ok(void *ctx) { __sync_fetch_and_add(&ran, 1); return true; }
+static bool task_fail(void *ctx) { __sync_fetch_and_add(&ran, 1); return false; }
+
+static bool tasks_wait(void *ctx)
+{
+	usleep(1000);
+	return true;
+}
+
+static pthread_t outerThread, innerThread;
+
+static bool task_inner(void *ctx)
+{
+	innerThread = pthread_self();
+	return true;
+}
+
+static bool task_outer(void *ctx)
+{
+	task inner[2] = { { .run = task_inner }, { .run = task_ok, .lane = 1, .deps = 1 << 0 } };
+	outerThread = pthread_self();
+	return tasks_run(inner, 2, NULL, tasks_wait, NULL) == TASKS_DONE;
+}
+
+int main(int argc, char **argv)
+{
+	static result threaded, inlined, first;
+	int failed = 0;
+	bool ok;
+
+	build_disc();
+	mock_devices();
+	swissSettings.autoCheats = 1;
+	swissSettings.sramLanguage = SYS_LANG_DUTCH;
+
+	mocks[2].cheats = 4;
+	ok = check_both(false, &threaded, &inlined) && threaded.numFiles == 16 && threaded.numCheats == 4;
+	failed += report("cheats searched alongside the disc reads", ok && concurrent && !channelOverlaps);
+	printf("gamecheck: %.0f ms threaded, %.0f ms on the calling thread\n", threaded.ms, inlined.ms);
+	first = inlined;
+
+	mocks[0].cheats = 5;
+	ok = check_both(false, &threaded, &inlined) && threaded.numCheats == 5;
+	failed += report("cheats on the current device come first", ok && !channelOverlaps);
+	mocks[0].cheats = 0;
+
+	mocks[1].cheats = 3;
+	ok = check_both(false, &threaded, &inlined) && threaded.numCheats == 3;
+	failed += report("cheats on its EXI channel come ahead of those found", ok && !channelOverlaps);
+	mocks[1].cheats = 0;
+
+	__device_fsp.location = LOC_SERIAL_PORT_2;
+	mocks[2].cheats = -1;
+	mocks[3].cheats = 6;
+	ok = check_both(false, &threaded, &inlined) && threaded.numCheats == 6;
+	failed += report("current device on another EXI channel", ok && concurrent && !channelOverlaps);
+	__device_fsp.location = LOC_SERIAL_PORT_1;
+	mocks[2].cheats = 4;
+	mocks[3].cheats = 0;
+
+	ok = check_both(true, &threaded, &inlined) && threaded.numFiles == 22;
+	failed += report("second disc", ok && !channelOverlaps);
+
+	failThreads = 1 << 1;
+	check(false, &threaded);
+	failThreads = 0;
+	failed += report("lane without a thread", same_result(&threaded, &first) && !channelOverlaps);
+
+	swissSettings.autoCheats = 0;
+	check(false, &threaded);
+	failed += report("cheats off", threaded.numFiles == 16 && !threaded.numCheats && !threaded.sdReqs);
+	swissSettings.autoCheats = 1;
+
+	cancelAfterMs = 0;
+	check(false, &threaded);
+	cancelAfterMs = -1;
+	failed += report("cancelled", threaded.numFiles == -1 && !threaded.numCheats);
+
+	task forward[2] = { { .run = task_ok, .deps = 1 << 1 }, { .run = task_ok, .lane = 1 } };
+	task self[1] = { { .run = task_ok, .deps = 1 << 0 } };
+	ran = 0;
+	ok = tasks_run(forward, 2, NULL, tasks_wait, NULL) == TASKS_FAILED && tasks_run(self, 1, NULL, tasks_wait, NULL) == TASKS_FAILED;
+	failed += report("deps on itself or later tasks refused", ok && !ran);
+
+	task failing[3] = { { .run = task_fail }, { .run = task_ok, .deps = 1 << 0 }, { .run = task_ok, .lane = 1 } };
+	ran = 0;
+	ok = tasks_run(failing, 3, NULL, tasks_wait, NULL) == TASKS_FAILED;
+	ok = ok && failing[0].state == TASK_FAILED && failing[1].state == TASK_SKIPPED && failing[2].state == TASK_DONE;
+	failed += report("failed task skips its dependents", ok && ran == 2);
+
+	task outer[1] = { { .run = task_outer } };
+	ok = tasks_run(outer, 1, NULL, tasks_wait, NULL) == TASKS_DONE;
+	failed += report("nested run on the calling thread", ok && pthread_equal(outerThread, innerThread));
+
+	return failed != 0;
+}
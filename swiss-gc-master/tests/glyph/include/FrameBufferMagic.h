@@ -0,0 +1,7 @@
+/* Host stand-in for gui/FrameBufferMagic.h; the font code only needs GX */
+#ifndef FRAMEBUFFERMAGIC_H
+#define FRAMEBUFFERMAGIC_H
+
+#include <gccore.h>
+
+#endif
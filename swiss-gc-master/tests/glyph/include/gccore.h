@@ -0,0 +1,144 @@
+/* Host stand-in for libogc's gccore.h, recording what the font code sends to GX */
+#ifndef __GCCORE_H__
+#define __GCCORE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int16_t s16;
+typedef int32_t s32;
+
+typedef struct { u8 r, g, b, a; } GXColor;
+typedef struct { u32 val[8]; } GXTexObj;
+typedef float Mtx[3][4];
+typedef float Mtx44[4][4];
+
+typedef struct {
+	u16 font_type, first_char, last_char, inval_char, asc, desc, width, leading;
+	u16 cell_width, cell_height;
+	u32 sheet_size;
+	u16 sheet_format, sheet_column, sheet_row, sheet_width, sheet_height, width_table;
+	u32 sheet_image, sheet_fullsize;
+	u8 c0, c1, c2, c3;
+} sys_fontheader;
+
+enum {
+	GX_DISABLE, GX_ENABLE, GX_FALSE = 0, GX_TRUE, GX_CLIP_ENABLE = 0,
+	GX_ALWAYS = 7, GX_AOP_AND = 0, GX_TEXMTX0 = 30, GX_MTX2x4 = 1, GX_PNMTX0 = 0, GX_ORTHOGRAPHIC = 1,
+	GX_VA_PTNMTXIDX = 0, GX_VA_TEX0MTXIDX, GX_VA_POS = 9, GX_VA_CLR0 = 11, GX_VA_TEX0 = 13,
+	GX_DIRECT = 1, GX_VTXFMT1 = 1, GX_POS_XYZ = 1, GX_S16 = 3, GX_U16 = 2, GX_CLR_RGBA = 1, GX_RGBA8 = 5, GX_TEX_ST = 1,
+	GX_TEXCOORD0 = 0, GX_TG_MTX2x4 = 1, GX_TG_TEX0 = 4, GX_IDENTITY = 60, GX_TF_I4 = 0, GX_CLAMP = 0,
+	GX_LINEAR = 1, GX_ANISO_4 = 2, GX_TEXMAP0 = 0, GX_TEVSTAGE0 = 0, GX_TEVSTAGE1, GX_COLOR0A0 = 4,
+	GX_CC_CPREV = 0, GX_CC_TEXC = 8, GX_CC_RASC = 10, GX_CC_RASA, GX_CC_ZERO = 15,
+	GX_CA_APREV = 0, GX_CA_TEXA = 4, GX_CA_RASA, GX_CA_ZERO = 7,
+	GX_TEV_ADD = 0, GX_TB_ZERO = 0, GX_CS_SCALE_1 = 0, GX_TEVPREV = 0,
+	GX_BM_BLEND = 1, GX_BL_ONE = 1, GX_BL_INVSRCALPHA = 5, GX_LO_CLEAR = 0, GX_CULL_NONE = 0, GX_QUADS = 0x80
+};
+
+#define GX_STUB(...) static inline void __VA_ARGS__ {}
+GX_STUB(GX_SetCoPlanar(u8 enable))
+GX_STUB(GX_SetClipMode(u8 mode))
+GX_STUB(GX_SetAlphaCompare(u8 comp0, u8 ref0, u8 aop, u8 comp1, u8 ref1))
+GX_STUB(guMtxIdentity(Mtx mt))
+GX_STUB(guOrtho(Mtx44 mt, float t, float b, float l, float r, float n, float f))
+GX_STUB(GX_LoadTexMtxImm(Mtx mt, u32 texidx, u8 type))
+GX_STUB(GX_LoadPosMtxImm(Mtx mt, u32 pnidx))
+GX_STUB(GX_LoadProjectionMtx(Mtx44 mt, u8 type))
+GX_STUB(GX_SetZMode(u8 enable, u8 func, u8 update_enable))
+GX_STUB(GX_ClearVtxDesc(void))
+GX_STUB(GX_SetVtxDesc(u8 attr, u8 type))
+GX_STUB(GX_SetVtxAttrFmt(u8 vtxfmt, u32 vtxattr, u32 comptype, u32 compsize, u32 frac))
+GX_STUB(GX_SetNumChans(u8 num))
+GX_STUB(GX_SetNumTexGens(u32 nr))
+GX_STUB(GX_SetTexCoordGen(u16 texcoord, u32 tgen_typ, u32 tgen_src, u32 mtxsrc))
+GX_STUB(GX_InvalidateTexAll(void))
+GX_STUB(GX_InitTexObj(GXTexObj *obj, void *img_ptr, u16 wd, u16 ht, u8 fmt, u8 wrap_s, u8 wrap_t, u8 mipmap))
+GX_STUB(GX_InitTexObjLOD(GXTexObj *obj, u8 minfilt, u8 magfilt, float minlod, float maxlod, float lodbias, u8 biasclamp, u8 edgelod, u8 maxaniso))
+GX_STUB(GX_LoadTexObj(GXTexObj *obj, u8 mapid))
+GX_STUB(GX_SetNumTevStages(u32 num))
+GX_STUB(GX_SetTevOrder(u8 tevstage, u8 texcoord, u32 texmap, u8 color))
+GX_STUB(GX_SetTevColorIn(u8 tevstage, u8 a, u8 b, u8 c, u8 d))
+GX_STUB(GX_SetTevColorOp(u8 tevstage, u8 tevop, u8 tevbias, u8 tevscale, u8 clamp, u8 tevregid))
+GX_STUB(GX_SetTevAlphaIn(u8 tevstage, u8 a, u8 b, u8 c, u8 d))
+GX_STUB(GX_SetTevAlphaOp(u8 tevstage, u8 tevop, u8 tevbias, u8 tevscale, u8 clamp, u8 tevregid))
+GX_STUB(GX_SetBlendMode(u8 type, u8 src_fact, u8 dst_fact, u8 op))
+GX_STUB(GX_SetColorUpdate(u8 enable))
+GX_STUB(GX_SetCullMode(u8 mode))
+GX_STUB(DCFlushRange(void *startaddress, u32 len))
+
+/* Every vertex sent between GX_Begin and GX_End, with the texture
+ * coordinates the GPU ends up with */
+typedef struct {
+	s16 x, y;
+	GXColor color;
+	float s, t;
+} gx_vertex;
+
+typedef struct {
+	gx_vertex *vertices;
+	int numVertices, maxVertices;
+	long begins, sent;
+	int expected;
+	bool mismatch;
+} gx_recorder;
+
+extern gx_recorder gx;
+
+static inline gx_vertex *gx_vertex_next(void)
+{
+	if (gx.numVertices < gx.maxVertices)
+		return &gx.vertices[gx.numVertices];
+	return NULL;
+}
+
+static inline void GX_Begin(u8 primitve, u8 vtxfmt, u16 vtxcnt)
+{
+	gx.begins++;
+	gx.expected += vtxcnt;
+}
+
+static inline void GX_End(void)
+{
+	if (gx.expected)
+		gx.mismatch = true;
+}
+
+static inline void GX_Position3s16(s16 x, s16 y, s16 z)
+{
+	gx_vertex *v = gx_vertex_next();
+	if (v) {
+		v->x = x;
+		v->y = y;
+	}
+	gx.sent++;
+	gx.expected--;
+}
+
+static inline void GX_Color4u8(u8 r, u8 g, u8 b, u8 a)
+{
+	gx_vertex *v = gx_vertex_next();
+	if (v)
+		v->color = (GXColor){r, g, b, a};
+}
+
+static inline void GX_TexCoord2f32(float s, float t)
+{
+	gx_vertex *v = gx_vertex_next();
+	if (v) {
+		v->s = s;
+		v->t = t;
+	}
+	gx.numVertices++;
+}
+
+/* Fixed point with 9 fractional bits, as set up by drawFontInit */
+static inline void GX_TexCoord2u16(u16 s, u16 t)
+{
+	GX_TexCoord2f32(s / 512.f, t / 512.f);
+}
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * Batched glyph drawing against the per-glyph drawing it replaced.
+ *
+ * The reference functions below are the old drawString, drawStringWithCaret
+ * and drawStringEllipsis, which sent every glyph in its own GX_Begin. The
+ * batched versions have to send the same vertices in the same order, and a
+ * textLayout_t has to draw exactly what drawString draws for it. A browser
+ * page is then timed both ways.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "IPLFontWrite.h"
+
+#define STRHEIGHT_OFFSET 0
+#define MAX_VERTICES (1 << 16)
+
+#include "charinfo.inc"
+
+extern CHAR_INFO fontChars;
+gx_recorder gx;
+char txtbuffer[2048];
+
+void __SYS_ReadROM(void *buf, u32 len, u32 offset) {}
+void drawFontInit(void);
+int GetCharsThatFitInWidth(char *string, int max, float scale);
+
+static void ref_drawString(int x, int y, char *string, float scale, bool centered, GXColor fontColor)
+{
+	if(string == NULL) {
+		return;
+	}
+	drawFontInit();
+	if(centered)
+	{
+		int strWidth = 0;
+		int strHeight = (fontChars.fheight+STRHEIGHT_OFFSET) * scale;
+		char* string_work = string;
+		while(*string_work)
+		{
+			unsigned char c = *string_work;
+			strWidth += (int) fontChars.font_size[c] * scale;
+			string_work++;
+		}
+		x = (int) x - strWidth/2;
+		y = (int) y - strHeight/2;
+	}
+
+	while (*string)
+	{
+		unsigned char c = *string;
+		if(c == '\n') break;
+		int i;
+		GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
+		for (i=0; i<4; i++) {
+			int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
+			int t = (i & 2) ? fontChars.fheight : 1;
+			float s0 = ((float) (fontChars.s[c] + s))/512;
+			float t0 = ((float) (fontChars.t[c] + t))/512;
+			s = (int) s * scale;
+			t = (int) t * scale;
+			GX_Position3s16(x + s, y + t, 0);
+			GX_Color4u8(fontColor.r, fontColor.g, fontColor.b, fontColor.a);
+			GX_TexCoord2f32(s0, t0);
+		}
+		GX_End();
+
+		x += (int) fontChars.font_size[c] * scale;
+		string++;
+	}
+}
+
+static void ref_drawStringWithCaret(int x, int y, char *string, float scale, bool centered, GXColor fontColor, int caretPosition, GXColor caretColor)
+{
+	if(string == NULL) {
+		string = "";
+	}
+	drawFontInit();
+	if(centered)
+	{
+		int strWidth = 0;
+		int strHeight = (fontChars.fheight+STRHEIGHT_OFFSET) * scale;
+		char* string_work = string;
+		while(*string_work)
+		{
+			unsigned char c = *string_work;
+			strWidth += (int) fontChars.font_size[c] * scale;
+			string_work++;
+		}
+		x = (int) x - strWidth/2;
+		y = (int) y - strHeight/2;
+	}
+
+	int pos = 0;
+	while (*string || pos <= caretPosition)
+	{
+		unsigned char c = *string;
+		if(pos == caretPosition) {
+			c = '|';
+		}
+		if(c == '\n') break;
+		int i;
+		GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
+		for (i=0; i<4; i++) {
+			int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
+			int t = (i & 2) ? fontChars.fheight : 1;
+			float s0 = ((float) (fontChars.s[c] + s))/512;
+			float t0 = ((float) (fontChars.t[c] + t))/512;
+			s = (int) s * scale;
+			t = (int) t * scale;
+			GX_Position3s16(x + s, y + t, 0);
+			if(pos == caretPosition)
+				GX_Color4u8(caretColor.r, caretColor.g, caretColor.b, caretColor.a);
+			else
+				GX_Color4u8(fontColor.r, fontColor.g, fontColor.b, fontColor.a);
+			GX_TexCoord2f32(s0, t0);
+		}
+		GX_End();
+
+		x += (int) fontChars.font_size[c] * scale;
+		if(pos != caretPosition)
+			string++;
+		pos++;
+	}
+}
+
+static void ref_drawStringEllipsis(int x, int y, char *string, float scale, bool centered, GXColor fontColor, bool rotateVertical, int maxSize)
+{
+	if(string == NULL) {
+		return;
+	}
+	drawFontInit();
+	if(centered)
+	{
+		int strWidth = 0;
+		int strHeight = (fontChars.fheight+STRHEIGHT_OFFSET) * scale;
+		char* string_work = string;
+		while(*string_work)
+		{
+			unsigned char c = *string_work;
+			strWidth += (int) fontChars.font_size[c] * scale;
+			string_work++;
+		}
+		x = (int) x - strWidth/2;
+		y = (int) y - strHeight/2;
+	}
+
+	int len = strlen(string);
+	int chars_to_draw = GetCharsThatFitInWidth(string, maxSize-12, scale);
+	int dots_to_write = 0;
+	while (*string || dots_to_write)
+	{
+		unsigned char c = *string;
+		if(dots_to_write) {
+			c = '.';
+			dots_to_write --;
+			if(!dots_to_write) {
+				break;
+			}
+		}
+		if(c == '\n') break;
+
+		int i;
+		GX_Begin(GX_QUADS, GX_VTXFMT1, 4);
+		for (i=0; i<4; i++) {
+			int s = (i & 1) ^ ((i & 2) >> 1) ? fontChars.font_size[c] : 1;
+			int t = (i & 2) ? fontChars.fheight : 1;
+			float s0 = ((float) (fontChars.s[c] + s))/512;
+			float t0 = ((float) (fontChars.t[c] + t))/512;
+			s = (int) s * scale;
+			t = (int) t * scale;
+			if(rotateVertical) {
+				GX_Position3s16(x + t, y - s, 0);
+			} else {
+				GX_Position3s16(x + s, y + t, 0);
+			}
+			GX_Color4u8(fontColor.r, fontColor.g, fontColor.b, fontColor.a);
+			GX_TexCoord2f32(s0, t0);
+		}
+		GX_End();
+
+		if(rotateVertical) {
+			y -= (int) fontChars.font_size[c] * scale;
+		} else {
+			x += (int) fontChars.font_size[c] * scale;
+		}
+
+		string++;
+		len--;
+		chars_to_draw--;
+		maxSize -= (int) fontChars.font_size[c] * scale;
+
+		// check if we've started (or about to start) our ellipses abbreviation
+		if(len > 0 && chars_to_draw == 0) {
+			if(dots_to_write == 0) {
+				dots_to_write = 4;
+			}
+		}
+	}
+}
+
+static gx_vertex ref[MAX_VERTICES], out[MAX_VERTICES];
+
+static void record(gx_vertex *vertices)
+{
+	if (vertices)
+		memset(vertices, 0, MAX_VERTICES * sizeof(gx_vertex));
+	gx.vertices = vertices;
+	gx.maxVertices = vertices ? MAX_VERTICES : 0;
+	gx.numVertices = 0;
+	gx.begins = gx.sent = 0;
+	gx.expected = 0;
+	gx.mismatch = false;
+}
+
+static void stop(void)
+{
+	gx.vertices = NULL;
+	gx.maxVertices = 0;
+}
+
+static bool same(int numRef, int numOut)
+{
+	return numRef == numOut && !memcmp(ref, out, numRef * sizeof(gx_vertex));
+}
+
+static void random_string(char *buf, int n)
+{
+	for (int i = 0; i < n; i++) {
+		buf[i] = 32 + rand() % 95;
+		if (rand() % 40 == 0)
+			buf[i] = '\n';
+	}
+	buf[n] = 0;
+}
+
+/* Every way of drawing a string has to send what the per-glyph code sent,
+ * with the pen kept in positive screen coordinates like the old code did. */
+static int test_streams(void)
+{
+	static const float scales[] = {1.0f, 0.6f, 0.55f, 0.45f, 0.75f, 1.5f, 0.3333f};
+	GXColor color = {255, 255, 255, 200}, caret = {1, 2, 3, 4};
+	int failed = 0, glyphs = 0;
+	char buf[300];
+
+	for (int k = 0; k < 3000; k++) {
+		int n = rand() % (k % 100 ? 120 : 290);
+		random_string(buf, n);
+
+		float scale = scales[rand() % 7];
+		int x = 3000 + rand() % 640, y = 3000 + rand() % 480;
+		bool centered = rand() & 1;
+		int kind = rand() % 3;
+		int caretPosition = n ? rand() % (n + 1) : 0;
+		bool rotateVertical = rand() & 1;
+		int maxSize = rand() % 3 ? rand() % 400 : 0;
+		long begins;
+		int numRef;
+
+		record(ref);
+		switch (kind) {
+			case 0: ref_drawString(x, y, buf, scale, centered, color); break;
+			case 1: ref_drawStringWithCaret(x, y, buf, scale, centered, color, caretPosition, caret); break;
+			case 2: ref_drawStringEllipsis(x, y, buf, scale, centered, color, rotateVertical, maxSize); break;
+		}
+		numRef = gx.numVertices;
+
+		record(out);
+		switch (kind) {
+			case 0: drawString(x, y, buf, scale, centered, color); break;
+			case 1: drawStringWithCaret(x, y, buf, scale, centered, color, caretPosition, caret); break;
+			case 2: drawStringEllipsis(x, y, buf, scale, centered, color, rotateVertical, maxSize); break;
+		}
+		begins = gx.begins;
+
+		if (!same(numRef, gx.numVertices) || gx.mismatch || begins > 1) {
+			if (failed++ < 5)
+				printf("glyph: string %d (kind %d, %d chars) drawn differently\n", k, kind, n);
+		}
+		glyphs += numRef / 4;
+	}
+	stop();
+
+	printf("glyph: %d strings, %d glyphs, %d mismatches\n", 3000, glyphs, failed);
+	return failed;
+}
+
+/* A layout draws what drawString draws at the scale it was fitted to. */
+static int test_layouts(void)
+{
+	GXColor color = {255, 255, 255, 255};
+	int failed = 0;
+	char buf[300];
+
+	for (int k = 0; k < 1000; k++) {
+		int n = rand() % 120;
+		random_string(buf, n);
+
+		int fitWidth = rand() % 2 ? 100 + rand() % 400 : 0;
+		float scale = 0.3f + (rand() % 100) / 100.f;
+		bool centered = rand() & 1;
+		int x = 3000 + rand() % 640, y = 3000 + rand() % 480;
+		textLayout_t *layout = LayoutText(buf, scale, fitWidth, centered);
+		int numRef;
+
+		if (fitWidth)
+			scale = GetTextScaleToFitInWidthWithMax(buf, fitWidth, scale);
+
+		record(ref);
+		drawString(x, y, buf, scale, centered, color);
+		numRef = gx.numVertices;
+
+		record(out);
+		drawTextLayout(layout, x, y, color);
+
+		if (!layout || layout->width != GetTextSizeInPixels(buf) || !same(numRef, gx.numVertices)) {
+			if (failed++ < 5)
+				printf("glyph: layout %d (%d chars) drawn differently\n", k, n);
+		}
+		FreeTextLayout(layout);
+	}
+	stop();
+
+	printf("glyph: 1000 layouts, %d mismatches\n", failed);
+	return failed;
+}
+
+#define FRAMES 600
+#define ROWS 20
+
+/* A page of the file browser: a fitted name and a size label on each row. */
+static void benchmark(void)
+{
+	GXColor color = {255, 255, 255, 255};
+	char names[ROWS][48];
+	textLayout_t *nameLayouts[ROWS], *sizeLayouts[ROWS];
+	clock_t start;
+
+	for (int i = 0; i < ROWS; i++) {
+		for (int j = 0; j < 40; j++)
+			names[i][j] = 'a' + rand() % 26;
+		names[i][40] = 0;
+		nameLayouts[i] = LayoutText(names[i], 0.6f, 400, false);
+		sizeLayouts[i] = LayoutText("1.35 GB", 0.45f, 0, false);
+	}
+
+	record(NULL);
+	start = clock();
+	for (int f = 0; f < FRAMES; f++)
+		for (int i = 0; i < ROWS; i++) {
+			ref_drawString(100, 40 + i * 20, names[i], GetTextScaleToFitInWidthWithMax(names[i], 400, 0.6f), false, color);
+			ref_drawString(500, 40 + i * 20, "1.35 GB", 0.45f, false, color);
+		}
+	printf("glyph: per glyph   %4ld GX_Begin, %5ld vertices, %6.1f us per frame\n",
+		gx.begins / FRAMES, gx.sent / FRAMES, (double)(clock() - start) / CLOCKS_PER_SEC * 1e6 / FRAMES);
+
+	record(NULL);
+	start = clock();
+	for (int f = 0; f < FRAMES; f++)
+		for (int i = 0; i < ROWS; i++) {
+			drawString(100, 40 + i * 20, names[i], GetTextScaleToFitInWidthWithMax(names[i], 400, 0.6f), false, color);
+			drawString(500, 40 + i * 20, "1.35 GB", 0.45f, false, color);
+		}
+	printf("glyph: per string  %4ld GX_Begin, %5ld vertices, %6.1f us per frame\n",
+		gx.begins / FRAMES, gx.sent / FRAMES, (double)(clock() - start) / CLOCKS_PER_SEC * 1e6 / FRAMES);
+
+	record(NULL);
+	start = clock();
+	for (int f = 0; f < FRAMES; f++)
+		for (int i = 0; i < ROWS; i++) {
+			drawTextLayout(nameLayouts[i], 100, 40 + i * 20, color);
+			drawTextLayout(sizeLayouts[i], 500, 40 + i * 20, color);
+		}
+	printf("glyph: laid out    %4ld GX_Begin, %5ld vertices, %6.1f us per frame\n",
+		gx.begins / FRAMES, gx.sent / FRAMES, (double)(clock() - start) / CLOCKS_PER_SEC * 1e6 / FRAMES);
+
+	for (int i = 0; i < ROWS; i++) {
+		FreeTextLayout(nameLayouts[i]);
+		FreeTextLayout(sizeLayouts[i]);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int failed = 0;
+
+	srand(argc > 1 ? atoi(argv[1]) : 1);
+
+	/* A 21 column sheet of 24 pixel cells with varying advances, like the IPL fonts */
+	for (int i = 0; i < 256; i++) {
+		fontChars.s[i] = (i % 21) * 24;
+		fontChars.t[i] = (i / 21) * 24;
+		fontChars.font_size[i] = 6 + rand() % 18;
+	}
+	fontChars.fheight = 24;
+
+	failed += test_streams();
+	failed += test_layouts();
+	benchmark();
+
+	printf("glyph: %s\n", failed ? "FAILED" : "ok");
+	return failed != 0;
+}
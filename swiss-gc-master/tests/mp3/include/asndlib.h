@@ -0,0 +1,7 @@
+/* Host stand-in for libogc's asndlib.h */
+#ifndef __ASNDLIB_H__
+#define __ASNDLIB_H__
+
+void ASND_Init(void);
+
+#endif
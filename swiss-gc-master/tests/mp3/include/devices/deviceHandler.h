@@ -0,0 +1,29 @@
+/* Host stand-in for swiss/source/devices/deviceHandler.h */
+#ifndef DEVICE_HANDLER_H
+#define DEVICE_HANDLER_H
+
+#include <gccore.h>
+
+#define PATHNAME_MAX 1024
+
+#define DEVICE_HANDLER_SEEK_SET 0
+
+typedef struct {
+	char name[PATHNAME_MAX];
+	u32 offset;
+	u32 size;
+} file_handle;
+
+typedef struct {
+	s64 (*seekFile)(file_handle *file, s64 where, u32 type);
+	s32 (*readFile)(file_handle *file, void *buffer, u32 length);
+} DEVICEHANDLER_INTERFACE;
+
+enum DEVICE_SLOTS {
+	DEVICE_CUR,
+	MAX_DEVICE_SLOTS
+};
+
+extern DEVICEHANDLER_INTERFACE *devices[MAX_DEVICE_SLOTS];
+
+#endif
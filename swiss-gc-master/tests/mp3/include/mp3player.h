@@ -0,0 +1,13 @@
+/* Host stand-in for libogc's mp3player.h, the decoder pulls from the reader on a thread of its own */
+#ifndef __MP3PLAYER_H__
+#define __MP3PLAYER_H__
+
+#include <gccore.h>
+
+void MP3Player_Init(void);
+s32 MP3Player_PlayFile(void *cb_data, s32 (*reader)(void *, void *, s32), void *filterfunc);
+void MP3Player_Stop(void);
+bool MP3Player_IsPlaying(void);
+void MP3Player_Volume(u32 volume);
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * MP3 read-ahead ring against a device with latency.
+ *
+ * The ring and play_mp3 are taken from mp3.c (see the Makefile) and fed
+ * to a stand-in decoder that pulls small frames through mp3Reader at a
+ * steady pace, checking every byte against the file. The song is played
+ * through the ring, with seeks, a read error and a stop, and straight
+ * from the device when there's no memory for the ring or no producer
+ * thread; every way has to play what's in the file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "mp3.h"
+
+#define SONG_SIZE  (768 * 1024 + 1234)
+#define FRAME_SIZE 2048
+#define FRAME_US   2000
+
+typedef struct uiDrawObj uiDrawObj_t;
+
+bool failThreads;
+
+static bool failAlloc;
+static int latencyUs, nsPerByte;
+static long failAt = -1;
+static int reads;
+static u8 *song;
+
+static u32 padCalls;
+static const u32 (*padScript)[2];
+
+static struct {
+	pthread_t thread;
+	s32 (*reader)(void *, void *, s32);
+	volatile bool playing, stop;
+	u32 pos;
+	s32 last;
+	int mismatches;
+	double stalled;
+} decoder;
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+}
+
+static s64 mock_seekFile(file_handle *file, s64 where, u32 type)
+{
+	file->offset = where;
+	return where;
+}
+
+static s32 mock_readFile(file_handle *file, void *buffer, u32 length)
+{
+	__sync_fetch_and_add(&reads, 1);
+	usleep(latencyUs + (u64)length * nsPerByte / 1000);
+	if (failAt >= 0 && file->offset + length > failAt)
+		return -1;
+	if (file->offset > file->size)
+		return -1;
+	if (length > file->size - file->offset)
+		length = file->size - file->offset;
+	memcpy(buffer, song + file->offset, length);
+	file->offset += length;
+	return length;
+}
+
+static DEVICEHANDLER_INTERFACE device = { mock_seekFile, mock_readFile };
+DEVICEHANDLER_INTERFACE *devices[MAX_DEVICE_SLOTS] = { &device };
+
+static void *mock_memalign(size_t alignment, size_t size)
+{
+	return failAlloc ? NULL : memalign(alignment, size);
+}
+
+#define memalign mock_memalign
+
+void VIDEO_WaitVSync(void) { usleep(16667); }
+uiDrawObj_t *DrawPublish(uiDrawObj_t *obj) { return obj; }
+void DrawDispose(uiDrawObj_t *obj) {}
+uiDrawObj_t *updatescreen_mp3(file_handle *file, int state, int numFiles, int curMP3) { return NULL; }
+
+/* Presses each button for a single call, at the call given */
+u32 PAD_ButtonsHeld(int chan)
+{
+	padCalls++;
+	for (int i = 0; padScript && padScript[i][0]; i++)
+		if (padScript[i][0] == padCalls)
+			return padScript[i][1];
+	return 0;
+}
+
+#include "mp3.inc"
+
+static void *decode(void *arg)
+{
+	u8 frame[FRAME_SIZE];
+
+	while (!decoder.stop) {
+		double started = now();
+		s32 ret = decoder.reader(NULL, frame, sizeof(frame));
+		if (now() - started > 0.5)
+			decoder.stalled += now() - started;
+		decoder.last = ret;
+		if (ret <= 0)
+			break;
+		if (memcmp(frame, song + decoder.pos, ret))
+			decoder.mismatches++;
+		decoder.pos += ret;
+		usleep(FRAME_US);
+	}
+	decoder.playing = false;
+	return NULL;
+}
+
+void MP3Player_Init(void) {}
+void MP3Player_Volume(u32 volume) {}
+bool MP3Player_IsPlaying(void) { return decoder.playing; }
+
+s32 MP3Player_PlayFile(void *cb_data, s32 (*reader)(void *, void *, s32), void *filterfunc)
+{
+	MP3Player_Stop();
+	decoder.reader = reader;
+	decoder.pos = mp3_ring_tell();
+	decoder.stop = false;
+	decoder.playing = true;
+	pthread_create(&decoder.thread, NULL, decode, NULL);
+	return 0;
+}
+
+void MP3Player_Stop(void)
+{
+	if (decoder.thread) {
+		decoder.stop = true;
+		pthread_join(decoder.thread, NULL);
+		decoder.thread = 0;
+	}
+	decoder.playing = false;
+}
+
+static file_handle file = { "fsp:/song.mp3", 0, SONG_SIZE };
+
+static int play(const u32 (*script)[2])
+{
+	decoder.mismatches = 0;
+	decoder.stalled = 0;
+	decoder.last = 0;
+	reads = 0;
+	padCalls = 0;
+	padScript = script;
+	return play_mp3(&file, 1, 0);
+}
+
+static int report(const char *name, bool ok)
+{
+	printf("mp3: %s: %s\n", name, ok ? "ok" : "FAILED");
+	return !ok;
+}
+
+int main(int argc, char **argv)
+{
+	static const u32 seeks[][2] = { { 20, PAD_BUTTON_RIGHT }, { 40, PAD_BUTTON_LEFT }, { 45, PAD_BUTTON_RIGHT }, { 80, PAD_BUTTON_LEFT }, { 0 } };
+	static const u32 stop[][2] = { { 20, PAD_BUTTON_B }, { 0 } };
+	int failed = 0, ret, directReads;
+	double directStalled;
+	bool ok;
+
+	song = malloc(SONG_SIZE);
+	for (int i = 0; i < SONG_SIZE; i++)
+		song[i] = rand();
+
+	// A network share, 2 ms a request and 2 MB/s
+	latencyUs = 2000;
+	nsPerByte = 500;
+
+	failAlloc = true;
+	ret = play(NULL);
+	failAlloc = false;
+	ok = ret == PLAYER_NEXT && decoder.pos == SONG_SIZE && !decoder.last && !decoder.mismatches;
+	failed += report("no memory for the ring, straight from the device", ok);
+	directReads = reads;
+	directStalled = decoder.stalled;
+
+	ret = play(NULL);
+	ok = ret == PLAYER_NEXT && decoder.pos == SONG_SIZE && !decoder.last && !decoder.mismatches;
+	failed += report("whole song through the ring", ok && reads * 8 < directReads && decoder.stalled < directStalled);
+	printf("mp3: %d reads, %.0f ms stalled through the ring, %d reads, %.0f ms stalled straight from the device\n",
+		reads, decoder.stalled, directReads, directStalled);
+
+	ret = play(seeks);
+	ok = ret == PLAYER_NEXT && decoder.pos == SONG_SIZE && !decoder.last && !decoder.mismatches;
+	failed += report("seeks forward and back", ok);
+
+	ret = play(stop);
+	failed += report("stopped", ret == PLAYER_STOP && decoder.pos < SONG_SIZE && !decoder.mismatches);
+
+	failAt = SONG_SIZE / 2;
+	ret = play(NULL);
+	failAt = -1;
+	ok = ret == PLAYER_NEXT && decoder.last < 0 && decoder.pos <= SONG_SIZE / 2 && !decoder.mismatches;
+	failed += report("read error ends the song", ok);
+
+	latencyUs = nsPerByte = 0;
+	failThreads = true;
+	ret = play(NULL);
+	failThreads = false;
+	ok = ret == PLAYER_NEXT && decoder.pos == SONG_SIZE && !decoder.last && !decoder.mismatches;
+	failed += report("no producer thread, straight from the device", ok);
+
+	// Stopped with the producer mid-read and the decoder gone
+	latencyUs = 2000;
+	for (int i = 0; i < 50; i++) {
+		mp3_ring_start(&file);
+		usleep(rand() % 5000);
+		mp3_ring_seek(rand() % SONG_SIZE);
+		usleep(rand() % 3000);
+		mp3_ring_stop();
+	}
+	failed += report("stopped with a read in flight", true);
+
+	return failed != 0;
+}
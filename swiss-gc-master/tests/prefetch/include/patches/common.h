@@ -0,0 +1,22 @@
+/* Host stand-in for cube/patches/base/common.h */
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdint.h>
+#include "reservedarea.h"
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+/* The simulation is single threaded, nothing interrupts it */
+#define disable_interrupts() 0
+#define restore_interrupts(level) ((void)(level))
+
+#endif /* COMMON_H */
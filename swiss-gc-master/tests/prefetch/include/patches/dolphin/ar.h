@@ -0,0 +1,18 @@
+/* Host stand-in for cube/patches/base/dolphin/ar.h */
+#ifndef DOLPHIN_AR_H
+#define DOLPHIN_AR_H
+
+#include <stdint.h>
+
+#define ARAM_DIR_MRAM_TO_ARAM 0
+#define ARAM_DIR_ARAM_TO_MRAM 1
+
+uint32_t ARGetDMAStatus(void);
+void ARStartDMA(uint32_t type, uint32_t mainmem_addr, uint32_t aram_addr, uint32_t length);
+void ARClearInterrupt(void);
+uint32_t ARGetInterruptStatus(void);
+
+#define ARStartDMARead(mmaddr, raddr, length) ARStartDMA(ARAM_DIR_ARAM_TO_MRAM, mmaddr, raddr, length)
+#define ARStartDMAWrite(mmaddr, raddr, length) ARStartDMA(ARAM_DIR_MRAM_TO_ARAM, mmaddr, raddr, length)
+
+#endif /* DOLPHIN_AR_H */
@@ -0,0 +1,29 @@
+/* Host stand-in for cube/patches/base/dolphin/os.h, with ticks in milliseconds */
+#ifndef DOLPHIN_OS_H
+#define DOLPHIN_OS_H
+
+#include <stdint.h>
+
+typedef int64_t OSTime;
+typedef struct OSContext OSContext;
+typedef struct OSAlarm OSAlarm;
+
+typedef void (*OSAlarmHandler)(OSAlarm *alarm, OSContext *context);
+
+struct OSAlarm {
+	OSAlarmHandler handler;
+	OSTime fire;
+};
+
+#define OSSecondsToTicks(sec) ((sec) * 1000)
+#define OSRoundUp32B(x) (((uint32_t)(x) + 31) & ~31)
+
+void OSCreateAlarm(OSAlarm *alarm);
+void OSSetAlarm(OSAlarm *alarm, OSTime tick, OSAlarmHandler handler);
+void OSCancelAlarm(OSAlarm *alarm);
+
+void DCInvalidateRange(void *addr, uint32_t nbytes);
+void DCFlushRange(void *addr, uint32_t nbytes);
+uint32_t OSCachedToPhysical(void *addr);
+
+#endif /* DOLPHIN_OS_H */
@@ -0,0 +1,14 @@
+/* Host stand-in for swiss/source/gui/FrameBufferMagic.h, progress bars only */
+#ifndef FRAMEBUFFERMAGIC_H
+#define FRAMEBUFFERMAGIC_H
+
+#include <gccore.h>
+
+typedef struct uiDrawObj uiDrawObj_t;
+
+uiDrawObj_t *DrawProgressBar(bool indeterminate, int percent, const char *message);
+uiDrawObj_t *DrawPublish(uiDrawObj_t *evt);
+void DrawUpdateProgressBar(uiDrawObj_t *evt, int percent);
+void DrawDispose(uiDrawObj_t *evt);
+
+#endif
@@ -0,0 +1,10 @@
+/* Host stand-in for swiss/source/config/config.h */
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+
+bool config_set_device(void);
+void config_unset_device(void);
+
+#endif
@@ -0,0 +1,47 @@
+/* Host stand-in for swiss/source/devices/deviceHandler.h */
+#ifndef DEVICE_HANDLER_H
+#define DEVICE_HANDLER_H
+
+#include <gccore.h>
+
+#define PATHNAME_MAX 1024
+#define READ_CHUNK_SIZE (128*1024)
+
+#define DEVICE_CUR 0
+#define DEVICE_PATCHES 2
+#define DEVICE_CONFIG 3
+#define MAX_DEVICE_SLOTS 5
+
+#define DEVICE_HANDLER_SEEK_SET 0
+
+#define EMU_BOOT_PREFETCH 0x20
+
+typedef struct {
+	char name[PATHNAME_MAX];
+	u64 offset;
+	u32 size;
+} file_handle;
+
+typedef struct {
+	u32 offset;
+	u32 size;
+	u64 fileNum  :  8;
+	u64 devNum   :  8;
+	u64 fileBase : 48;
+} file_frag;
+
+typedef struct {
+	file_handle *initial;
+	u32 emulable;
+	s32 (*seekFile)(file_handle *file, s64 where, u32 type);
+	s32 (*readFile)(file_handle *file, void *buffer, u32 length);
+	s32 (*writeFile)(file_handle *file, const void *buffer, u32 length);
+	s32 (*closeFile)(file_handle *file);
+	s32 (*deleteFile)(file_handle *file);
+} DEVICEHANDLER_INTERFACE;
+
+extern DEVICEHANDLER_INTERFACE *devices[MAX_DEVICE_SLOTS];
+
+bool getFragments(int deviceSlot, file_handle *file, file_frag **fragList, u32 *totFrags, u8 fileNum, u32 forceBaseOffset, u32 forceSize);
+
+#endif
@@ -0,0 +1,8 @@
+/* Host stand-in for swiss/include/files.h */
+#ifndef FILES_H
+#define FILES_H
+
+void concat_path(char *pathName, const char *dirName, const char *baseName);
+void ensure_path(int deviceSlot, char *path, char *oldPath);
+
+#endif
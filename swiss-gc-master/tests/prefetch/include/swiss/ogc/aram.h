@@ -0,0 +1,9 @@
+/* Host stand-in for libogc's ogc/aram.h */
+#ifndef __ARAM_H__
+#define __ARAM_H__
+
+#include <gccore.h>
+
+u32 AR_Init(u32 *stack_index, u32 num_entries);
+
+#endif
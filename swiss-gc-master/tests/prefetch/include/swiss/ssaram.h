@@ -0,0 +1,8 @@
+/* Host stand-in for swiss/source/aram/ssaram.h */
+#ifndef SSARAM_H
+#define SSARAM_H
+
+void ARAMPut(unsigned char *src, char *dst, int len);
+void ARAMFetch(unsigned char *dst, char *src, int len);
+
+#endif
@@ -0,0 +1,17 @@
+/* Host stand-in for swiss/include/swiss.h */
+#ifndef SWISS_H
+#define SWISS_H
+
+#include <stdio.h>
+#include "deviceHandler.h"
+#include "reservedarea.h"
+
+typedef struct {
+	int bootPrefetch;
+} SwissSettings;
+
+extern SwissSettings swissSettings;
+
+#define print_gecko(...) ((void)0)
+
+#endif
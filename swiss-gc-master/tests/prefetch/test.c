@@ -0,0 +1,581 @@
+/*
+ * Boot prefetch, Swiss and the FSP patches together, against simulated
+ * devices.
+ *
+ * The disc is read over FSP at a fixed cost per packet, the patches device
+ * is an SD card holding the trace file, and ARAM is shared between both
+ * halves. Each boot runs the patches in a child process, as every boot
+ * starts them afresh, replaying a synthetic game boot through prefetch_read
+ * and checking every byte the game gets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "swiss/deviceHandler.h"
+#include "patches/dolphin/os.h"
+
+#define DISC_SIZE	1459978240u
+#define PATCH_OFF	0x00120000u		/* a patched file inside the disc image */
+#define PATCH_SIZE	0x000C4E00u
+#define DOL_END		0x00400000u		/* what load_app staged in ARAM */
+
+#define FSP_PACKET_MS		0.8		/* one FSP round trip */
+#define FSP_PATCHES_PACKET	1440	/* bytes per packet from the patches */
+#define FSP_SWISS_PACKET	1024	/* bytes per packet from fsplib */
+#define SD_SECTOR_MS		0.05
+#define ARAM_SECTOR_MS		0.03
+
+/* As in reservedarea.h, which the test can't include: VAR_FRAG_LIST holds a host pointer here */
+#define FRAGS_DISC_1	0
+#define FRAGS_PREFETCH	6
+#define PREFETCH_TRACE_SIZE		2560
+#define PREFETCH_TRACE_MAGIC	0x53504654
+#define PREFETCH_ARAM_TRACE		0x0FFF000
+
+#define MAX_READS 1024
+#define MAX_FILES 4
+
+typedef void (*frag_callback)(void *buffer, uint32_t length);
+
+/* Swiss */
+void prefetch_collect(void);
+void prefetch_setup(file_frag **fragList, u32 *numFrags);
+void prefetch_warm(file_handle *file, u32 aramLow);
+
+/* The patches */
+void prefetch_init(void **arenaLo, void **arenaHi);
+bool prefetch_read(int file, void *buffer, uint32_t length, uint32_t offset, frag_callback callback);
+void prefetch_fini(void);
+
+/* Everything that outlives a boot */
+static struct {
+	uint8_t aram[16 << 20];
+	struct {
+		bool used;
+		char name[PATHNAME_MAX];
+		uint32_t size;
+		uint8_t data[8192];
+	} sd[MAX_FILES];
+	struct {
+		int reads, bad;
+		uint64_t fspBytes, aramBytes;
+		double readMs;
+		int sdWrites;
+	} boot;
+} *sim;
+
+char VAR_PREFETCH_SIZE[1], VAR_PREFETCH_WARM[1];
+char VAR_FRAG_LIST[8] __attribute__((aligned(8)));
+
+static struct { uint32_t offset, length; } reads[MAX_READS];
+static int numReads;
+
+static uint8_t disc_byte(uint32_t offset)
+{
+	uint32_t x = (offset >> 2) * 0x9E3779B1u;
+	x ^= x >> 15;
+	x *= 0x85EBCA77u;
+	x ^= x >> 13;
+	return x >> ((offset & 3) * 8);
+}
+
+static uint8_t game_byte(uint32_t offset)
+{
+	if (offset >= PATCH_OFF && offset < PATCH_OFF + PATCH_SIZE)
+		return disc_byte(offset) ^ 0x5A;
+	return disc_byte(offset);
+}
+
+static uint32_t rng(uint32_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static uint32_t rng_range(uint32_t *state, uint32_t lo, uint32_t hi)
+{
+	return lo + rng(state) % (hi - lo + 1);
+}
+
+static void add_read(uint32_t offset, uint32_t length)
+{
+	if (numReads < MAX_READS) {
+		reads[numReads].offset = offset;
+		reads[numReads].length = length;
+		numReads++;
+	}
+}
+
+/* A boot: header probes, archives read in chunks, the odd re-read, and reads
+ * into and across the patched file. vary is how often, in percent, the game
+ * opens something else than on the first boot. */
+static void make_boot(uint32_t seed, int vary)
+{
+	static struct { uint32_t offset, size; } files[90];
+	uint32_t state = 1234, position = 0x00200000;
+	int order[90];
+
+	for (int i = 0; i < 90; i++) {
+		uint32_t size = rng(&state) % 2 ? rng_range(&state, 2, 64) * 1024 : rng_range(&state, 64, 600) * 1024;
+		files[i].offset = position;
+		files[i].size = size;
+		position += size + rng_range(&state, 0, 8) * 2048 + (rng(&state) % 3 ? 0 : 0x100000);
+		order[i] = i;
+	}
+	state = 7;
+	for (int i = 89; i > 0; i--) {
+		int j = rng(&state) % (i + 1), t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+
+	state = seed;
+	numReads = 0;
+	for (int k = 0; k < 48; k++) {
+		int i = rng(&state) % 100 < vary ? order[48 + rng(&state) % 31] : order[k];
+		uint32_t offset = files[i].offset, size = files[i].size;
+
+		if (k == 5)
+			add_read(PATCH_OFF + 0x400, 0x2000);
+		if (k == 15)
+			add_read(PATCH_OFF - 0x800, 0x1800);
+
+		add_read(offset, 32);
+		add_read(offset, size < 0x800 ? size : 0x800);
+		for (uint32_t p = 0; p < size; ) {
+			static const uint32_t chunks[] = {0x8000, 0x10000, 0x20000};
+			uint32_t n = chunks[rng(&state) % 3];
+			n = n < size - p ? n : size - p;
+			add_read(offset + p, n);
+			p += n;
+		}
+		if (rng(&state) % 4 == 0)
+			add_read(offset, size < 0x20000 ? size : 0x20000);
+	}
+}
+
+/* Ends the boot once it has read about this much */
+static void cut_boot(uint32_t bytes)
+{
+	for (int n = 0; n < numReads; n++) {
+		if (reads[n].length > bytes) {
+			numReads = n;
+			break;
+		}
+		bytes -= reads[n].length;
+	}
+}
+
+/*------------------------------------------------------------------
+ * The patches' side
+ */
+static int64_t now;
+static OSAlarm *alarms[4];
+static int intPending;
+static void *physical[16];
+static int numPhysical;
+
+void OSCreateAlarm(OSAlarm *alarm)
+{
+	alarm->handler = NULL;
+}
+
+void OSCancelAlarm(OSAlarm *alarm)
+{
+	for (int i = 0; i < 4; i++)
+		if (alarms[i] == alarm)
+			alarms[i] = NULL;
+}
+
+void OSSetAlarm(OSAlarm *alarm, OSTime tick, OSAlarmHandler handler)
+{
+	OSCancelAlarm(alarm);
+	alarm->handler = handler;
+	alarm->fire = now + tick;
+	for (int i = 0; i < 4; i++)
+		if (!alarms[i]) {
+			alarms[i] = alarm;
+			return;
+		}
+	printf("prefetch: out of alarms\n");
+	exit(1);
+}
+
+static void run_alarms(void)
+{
+	for (int i = 0; i < 4; i++) {
+		OSAlarm *alarm = alarms[i];
+		if (alarm && alarm->fire <= now) {
+			alarms[i] = NULL;
+			alarm->handler(alarm, NULL);
+			i = -1;
+		}
+	}
+}
+
+void DCInvalidateRange(void *addr, uint32_t nbytes) {}
+void DCFlushRange(void *addr, uint32_t nbytes) {}
+
+uint32_t OSCachedToPhysical(void *addr)
+{
+	for (int i = 0; i < numPhysical; i++)
+		if (physical[i] == addr)
+			return i;
+	physical[numPhysical] = addr;
+	return numPhysical++;
+}
+
+uint32_t ARGetDMAStatus(void) { return 0; }
+uint32_t ARGetInterruptStatus(void) { return intPending; }
+void ARClearInterrupt(void) { intPending = 0; }
+
+void ARStartDMA(uint32_t type, uint32_t mainmem_addr, uint32_t aram_addr, uint32_t length)
+{
+	if (aram_addr % 32 || length % 32 || aram_addr + length > sizeof(sim->aram)) {
+		printf("prefetch: bad ARAM DMA %08X+%X\n", aram_addr, length);
+		exit(1);
+	}
+	if (type)
+		memcpy(physical[mainmem_addr], sim->aram + aram_addr, length);
+	else
+		memcpy(sim->aram + aram_addr, physical[mainmem_addr], length);
+}
+
+static int sd_find(const char *name);
+
+/* Only the trace file is ever written, a sector per call as sd.c does */
+bool frag_read_write_async(int file, void *buffer, uint32_t length, uint32_t offset, bool write, frag_callback callback)
+{
+	const file_frag *frags = *(file_frag **)VAR_FRAG_LIST;
+	int sd = sd_find("sda:/swiss/patches/prefetch.bin");
+
+	if (!write || file != FRAGS_PREFETCH)
+		return false;
+	for (; frags && frags->size; frags++)
+		if (frags->fileNum == FRAGS_PREFETCH && frags->devNum == 1)
+			break;
+	if (!frags || !frags->size || sd < 0 || offset % 512 || offset + 512 > sim->sd[sd].size)
+		return false;
+
+	memcpy(sim->sd[sd].data + offset, buffer, 512);
+	sim->boot.sdWrites++;
+	callback(buffer, 512);
+	return true;
+}
+
+static uint32_t got;
+
+static void read_done(void *buffer, uint32_t length)
+{
+	got = length;
+}
+
+/* What frag_read_write_async does for a game read on FSP */
+static void game_read(uint8_t *buffer, uint32_t offset, uint32_t length)
+{
+	for (uint32_t done = 0; done < length; ) {
+		uint32_t position = offset + done, size = length - done;
+
+		if (position >= PATCH_OFF && position < PATCH_OFF + PATCH_SIZE) {
+			// A patch file on the SD card, never asked of the prefetch
+			size = size < PATCH_OFF + PATCH_SIZE - position ? size : PATCH_OFF + PATCH_SIZE - position;
+			for (uint32_t i = 0; i < size; i++)
+				buffer[done + i] = game_byte(position + i);
+			sim->boot.readMs += SD_SECTOR_MS * ((size + 511) / 512);
+			done += size;
+			continue;
+		}
+		if (position < PATCH_OFF && position + size > PATCH_OFF)
+			size = PATCH_OFF - position;
+
+		got = 0;
+		if (prefetch_read(FRAGS_DISC_1, buffer + done, size, position, read_done)) {
+			run_alarms();
+			if (!got) {
+				printf("prefetch: read at %08X never completed\n", position);
+				exit(1);
+			}
+			sim->boot.aramBytes += got;
+			sim->boot.readMs += ARAM_SECTOR_MS * ((got + 2047) / 2048);
+			done += got;
+			continue;
+		}
+
+		for (uint32_t i = 0; i < size; i++)
+			buffer[done + i] = disc_byte(position + i);
+		sim->boot.fspBytes += size;
+		sim->boot.readMs += FSP_PACKET_MS * ((size + FSP_PATCHES_PACKET - 1) / FSP_PATCHES_PACKET);
+		done += size;
+	}
+}
+
+enum { EXIT_POWER_OFF, EXIT_RESET };
+
+/* The game as booted by the patches, the ARAM cache may be overwritten part way */
+static void play(int exitBy, bool takeAram)
+{
+	static uint8_t arena[64 << 10] __attribute__((aligned(32)));
+	static uint8_t buffer[1 << 20];
+	void *arenaLo = arena, *arenaHi = arena + sizeof(arena);
+
+	memset(&sim->boot, 0, sizeof(sim->boot));
+	prefetch_init(&arenaLo, &arenaHi);
+
+	for (int n = 0; n < numReads; n++) {
+		if (takeAram && n == 40)
+			memset(sim->aram + 0xC00000, 0xA5, 2 << 20);
+		if (takeAram && n == 41)
+			intPending = 1;	// the game's own DMA, not yet taken
+		if (takeAram && n == 43)
+			intPending = 0;
+
+		game_read(buffer, reads[n].offset, reads[n].length);
+		for (uint32_t i = 0; i < reads[n].length; i++)
+			if (buffer[i] != game_byte(reads[n].offset + i)) {
+				sim->boot.bad++;
+				break;
+			}
+		sim->boot.reads++;
+
+		now += 2;
+		run_alarms();
+	}
+
+	// The title screen
+	now += 10000;
+	run_alarms();
+
+	if (exitBy == EXIT_RESET)
+		prefetch_fini();
+	else
+		memset(sim->aram, 0, sizeof(sim->aram));
+}
+
+/*------------------------------------------------------------------
+ * Swiss' side
+ */
+struct { int bootPrefetch; } swissSettings;
+DEVICEHANDLER_INTERFACE *devices[MAX_DEVICE_SLOTS];
+static double warmMs;
+
+static int sd_find(const char *name)
+{
+	for (int i = 0; i < MAX_FILES; i++)
+		if (sim->sd[i].used && !strcmp(sim->sd[i].name, name))
+			return i;
+	return -1;
+}
+
+static int32_t dev_seek(file_handle *file, int64_t where, uint32_t type)
+{
+	file->offset = where;
+	return 0;
+}
+
+static int32_t dev_read(file_handle *file, void *buffer, uint32_t length)
+{
+	if (!strncmp(file->name, "fsp:/", 5)) {
+		file->size = DISC_SIZE;
+		for (uint32_t i = 0; i < length; i++)
+			((uint8_t *)buffer)[i] = disc_byte(file->offset + i);
+		warmMs += FSP_PACKET_MS * ((length + FSP_SWISS_PACKET - 1) / FSP_SWISS_PACKET);
+		file->offset += length;
+		return length;
+	}
+
+	int sd = sd_find(file->name);
+	if (sd < 0)
+		return -1;
+	file->size = sim->sd[sd].size;
+	if (file->offset >= file->size)
+		return 0;
+	length = length < file->size - file->offset ? length : file->size - file->offset;
+	memcpy(buffer, sim->sd[sd].data + file->offset, length);
+	file->offset += length;
+	return length;
+}
+
+static int32_t dev_write(file_handle *file, const void *buffer, uint32_t length)
+{
+	int sd = sd_find(file->name);
+
+	if (sd < 0) {
+		for (sd = 0; sd < MAX_FILES && sim->sd[sd].used; sd++);
+		if (sd == MAX_FILES)
+			return -1;
+		sim->sd[sd].used = true;
+		snprintf(sim->sd[sd].name, sizeof(sim->sd[sd].name), "%s", file->name);
+		sim->sd[sd].size = 0;
+	}
+	if (file->offset + length > sizeof(sim->sd[sd].data))
+		return -1;
+	memcpy(sim->sd[sd].data + file->offset, buffer, length);
+	file->offset += length;
+	if (file->offset > sim->sd[sd].size)
+		sim->sd[sd].size = file->offset;
+	return length;
+}
+
+static int32_t dev_close(file_handle *file)
+{
+	file->offset = 0;
+	return 0;
+}
+
+static int32_t dev_delete(file_handle *file)
+{
+	int sd = sd_find(file->name);
+	if (sd >= 0)
+		sim->sd[sd].used = false;
+	return 0;
+}
+
+static file_handle fspRoot = {"fsp:/"}, sdRoot = {"sda:/"};
+static DEVICEHANDLER_INTERFACE fsp = {&fspRoot, EMU_BOOT_PREFETCH, dev_seek, dev_read, dev_write, dev_close, dev_delete};
+static DEVICEHANDLER_INTERFACE sd = {&sdRoot, 0, dev_seek, dev_read, dev_write, dev_close, dev_delete};
+
+void concat_path(char *pathName, const char *dirName, const char *baseName) { sprintf(pathName, "%s%s", dirName, baseName); }
+void ensure_path(int deviceSlot, char *path, char *oldPath) {}
+bool config_set_device(void) { return true; }
+void config_unset_device(void) {}
+uint32_t AR_Init(uint32_t *stack_index, uint32_t num_entries) { return 0x4000; }
+void ARAMPut(unsigned char *src, char *dst, int len) { memcpy(sim->aram + (uintptr_t)dst, src, len); }
+void ARAMFetch(unsigned char *dst, char *src, int len) { memcpy(dst, sim->aram + (uintptr_t)src, len); }
+void *DrawProgressBar(bool indeterminate, int percent, const char *message) { return NULL; }
+void *DrawPublish(void *evt) { return evt; }
+void DrawUpdateProgressBar(void *evt, int percent) {}
+void DrawDispose(void *evt) {}
+
+bool getFragments(int deviceSlot, file_handle *file, file_frag **fragList, uint32_t *totFrags, uint8_t fileNum, uint32_t forceBaseOffset, uint32_t forceSize)
+{
+	if (devices[deviceSlot]->readFile(file, NULL, 0) != 0)
+		return false;
+
+	*fragList = realloc(*fragList, (*totFrags + 1) * sizeof(file_frag));
+	(*fragList)[*totFrags] = (file_frag){forceBaseOffset, forceSize ? forceSize : file->size, fileNum, deviceSlot == 2, 0x1000};
+	(*totFrags)++;
+	return true;
+}
+
+/* Swiss coming up, then booting the game the way FSP's setupFile and load_app do */
+static void boot(int prefetchSize, int exitBy, bool takeAram)
+{
+	static file_handle game = {"fsp:/game.iso"};
+	file_frag *fragList = NULL;
+	u32 numFrags = 0;
+
+	swissSettings.bootPrefetch = prefetchSize;
+	prefetch_collect();
+
+	// A patched file on the SD card
+	fragList = realloc(fragList, sizeof(file_frag));
+	fragList[numFrags++] = (file_frag){PATCH_OFF, PATCH_SIZE, FRAGS_DISC_1, 1, 0x2000};
+	prefetch_setup(&fragList, &numFrags);
+	fragList = realloc(fragList, (numFrags + 2) * sizeof(file_frag));
+	fragList[numFrags++] = (file_frag){0, DISC_SIZE, FRAGS_DISC_1, 0, 0x200000};
+	fragList[numFrags] = (file_frag){0};
+	memcpy(VAR_FRAG_LIST, &fragList, sizeof(fragList));
+
+	warmMs = 0;
+	game.size = DISC_SIZE;
+	prefetch_warm(&game, DOL_END);
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		play(exitBy, takeAram);
+		exit(0);
+	}
+	waitpid(pid, NULL, 0);
+	free(fragList);
+}
+
+static bool trace_stored(const char *name)
+{
+	int file = sd_find(name);
+	if (file < 0)
+		return false;
+
+	// Magic, checksum, ID and a count of reads
+	const uint32_t *trace = (const uint32_t *)sim->sd[file].data;
+	return sim->sd[file].size >= 32 && trace[0] == PREFETCH_TRACE_MAGIC && trace[4];
+}
+
+static void report(const char *name, bool ok)
+{
+	printf("prefetch: %s: %s\n", name, ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char **argv)
+{
+	const char *profile = "sda:/swiss/settings/prefetch/GALE01-0001.bin";
+	int failed = 0;
+	bool ok;
+
+	sim = mmap(NULL, sizeof(*sim), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	uint8_t *lowmem = mmap((void *)0x80000000, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (sim == MAP_FAILED || lowmem != (void *)0x80000000) {
+		printf("prefetch: can't map memory\n");
+		return 1;
+	}
+	memcpy(lowmem, "GALE01\x00\x01", 8);
+
+	devices[0] = &fsp;
+	devices[2] = devices[3] = &sd;
+
+	// With it off, nothing is recorded
+	make_boot(1, 0);
+	boot(0, EXIT_POWER_OFF, false);
+	double coldMs = sim->boot.readMs;
+	int coldBad = sim->boot.bad;
+	ok = !coldBad && !sim->boot.sdWrites && sd_find(profile) < 0;
+	report("off: nothing recorded", ok);
+	failed += !ok;
+
+	// First boot records, goes quiet on the title screen and is switched off
+	cut_boot(6 << 20);
+	boot(3, EXIT_POWER_OFF, false);
+	ok = !sim->boot.bad && sim->boot.sdWrites == PREFETCH_TRACE_SIZE / 512 && trace_stored("sda:/swiss/patches/prefetch.bin");
+	report("trace stored once the game goes quiet", ok);
+	failed += !ok;
+
+	// The next boot stores it as the profile, warms it and reads from ARAM
+	make_boot(2, 10);
+	boot(3, EXIT_RESET, false);
+	double warmCost = warmMs, warmReadMs = sim->boot.readMs;
+	ok = !sim->boot.bad && trace_stored(profile) && sim->boot.aramBytes && warmReadMs < coldMs;
+	report("profile stored and served from ARAM", ok);
+	failed += !ok;
+
+	// That boot read more than its budget, which ended the recording there and then
+	ok = sim->boot.sdWrites == PREFETCH_TRACE_SIZE / 512 && trace_stored("sda:/swiss/patches/prefetch.bin");
+	report("trace stored once the budget is used up", ok);
+	failed += !ok;
+	printf("prefetch: reads %.0f ms cold, %.0f ms warmed after %.0f ms of warming (%.1f MB from ARAM)\n",
+		coldMs, warmReadMs, warmCost, sim->boot.aramBytes / 1048576.0);
+
+	// A reset left it in ARAM as well, Swiss takes it from there once
+	ok = *(uint32_t *)(sim->aram + PREFETCH_ARAM_TRACE) == PREFETCH_TRACE_MAGIC;
+	prefetch_collect();
+	ok &= *(uint32_t *)(sim->aram + PREFETCH_ARAM_TRACE) == 0;
+	report("trace left in ARAM on reset is collected", ok);
+	failed += !ok;
+
+	// The game takes part of ARAM for itself while booting
+	make_boot(3, 10);
+	boot(3, EXIT_RESET, true);
+	ok = !sim->boot.bad;
+	report("reads stay correct when ARAM is taken", ok);
+	failed += !ok;
+
+	printf("prefetch: %s\n", failed ? "FAILED" : "ok");
+	return failed != 0;
+}
@@ -0,0 +1,525 @@
+/*
+ * Trap-site cache of the runtime emulator.
+ *
+ * The trap code and ppc_step are taken from emulator.c, with the special
+ * register reads and cache maintenance replaced (see host.sed). A corpus
+ * of load/store encodings is faulted through service_exception, the site
+ * is patched, and the stub dispatch through service_trap has to leave the
+ * same registers and device accesses as ppc_step did. The stubs and the
+ * trap_fast_path prologue in base.S are run symbolically to check that
+ * they build the ppc_context_t that service_trap and exception_return use.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "context.inc"
+
+#define DTK
+#define OS_BASE_CACHED 0x80000000
+#define OSRoundUp32B(x) (((uint32_t)(x) + 31) & ~31)
+#define ASMV(...)
+
+/* Low memory for code and the trap table, so addresses fit in 32 bits */
+#define LOW_BASE       0x10000000u
+#define TRAP_FAST_PATH (LOW_BASE + 0xD40)
+
+static uint32_t mock_dar, mock_dabr;
+static uint32_t log_[64];
+static int nlog;
+
+static void rec(uint32_t dev, uint32_t index, uint32_t value)
+{
+	log_[nlog++] = dev;
+	log_[nlog++] = index;
+	log_[nlog++] = value;
+}
+
+static void efb_read(uint32_t address, uint32_t *value) { *value = address ^ 0x5A5A; rec(1, address, 0); }
+static void pi_read(unsigned index, uint32_t *value) { *value = 0x1000 + index; rec(2, index, 0); }
+static void di_read(unsigned index, uint32_t *value) { *value = 0x2000 + index; rec(3, index, 0); }
+static void exi_read(unsigned index, uint32_t *value) { *value = 0x3000 + index; rec(4, index, 0); }
+static void dsp_read(unsigned index, uint32_t *value) { *value = 0x4000 + index; rec(5, index, 0); }
+static void pi_write(unsigned index, uint32_t value) { rec(6, index, value); }
+static void di_write(unsigned index, uint32_t value) { rec(7, index, value); }
+static void exi_write(unsigned index, uint32_t value) { rec(8, index, value); }
+static void dsp_write(unsigned index, uint16_t value) { rec(9, index, value); }
+static void vi_write(unsigned index, uint16_t value) { rec(10, index, value); }
+static void reset_devices(void) { rec(11, 0, 0); }
+
+#include "emulator.inc"
+
+static int failures;
+
+static void expect(bool ok, const char *what, uint32_t detail)
+{
+	if (!ok && failures++ < 20)
+		printf("trap: %s (%08X)\n", what, detail);
+}
+
+/*
+ * Symbolic run of the stub and trap_fast_path.
+ */
+enum { V_UNDEF, V_GPR, V_CR, V_LR, V_CTR, V_XER, V_MSR, V_SP, V_IMM };
+
+typedef struct {
+	int kind;
+	int32_t n;
+} sym_t;
+
+static sym_t reg[32];
+#define FRAME_WORDS 128
+
+static sym_t frame[FRAME_WORDS];	/* words below the stack pointer on entry */
+
+static sym_t *slot(sym_t base, int32_t offset)
+{
+	int32_t address = base.n + offset;
+
+	if (base.kind != V_SP || address >= 0 || address < -FRAME_WORDS * 4 || address & 3)
+		return NULL;
+	return &frame[(address + FRAME_WORDS * 4) / 4];
+}
+
+static void store(int rs, int ra, int32_t offset)
+{
+	sym_t *s = slot(reg[ra], offset);
+
+	expect(s != NULL, "store outside the trap frame", offset);
+	if (s)
+		*s = reg[rs];
+}
+
+static bool sym_eq(sym_t a, int kind, int32_t n)
+{
+	return a.kind == kind && a.n == n;
+}
+
+/* Runs a stub from its machine code, returns the branch target. */
+static uint32_t run_stub(const uint32_t *stub)
+{
+	for (int i = 0; i < 4; i++) {
+		uint32_t op = stub[i];
+		int rd = (op >> 21) & 31, ra = (op >> 16) & 31;
+		int16_t d = op;
+
+		switch (op >> 26) {
+			case 37: // stwu
+				store(rd, ra, d);
+				reg[ra].n += d;
+				break;
+			case 36: // stw
+				store(rd, ra, d);
+				break;
+			case 14: // addi
+				if (ra == 0)
+					reg[rd] = (sym_t){V_IMM, d};
+				else
+					reg[rd] = (sym_t){reg[ra].kind, reg[ra].n + d};
+				break;
+			case 18: // b
+				return (uint32_t)(uintptr_t)&stub[i] + ((int32_t)(op << 6) >> 6 & ~3);
+			default:
+				expect(false, "unexpected instruction in stub", op);
+				return 0;
+		}
+	}
+	return 0;
+}
+
+static int parse_reg(const char *s)
+{
+	if (!strcmp(s, "sp"))
+		return 1;
+	if (s[0] == 'r')
+		return atoi(s + 1);
+	return -1;
+}
+
+/* Sums "8 + 168" style operands. */
+static int32_t parse_expr(const char *s)
+{
+	int32_t value = 0, sign = 1;
+
+	while (*s) {
+		if (*s == '+')
+			sign = 1;
+		else if (*s == '-')
+			sign = -1;
+		else if (*s >= '0' && *s <= '9') {
+			value += sign * strtol(s, (char **)&s, 0);
+			continue;
+		}
+		s++;
+	}
+	return value;
+}
+
+/* Splits "op a, b (c)" into its mnemonic and operands. */
+static int split(char *line, char *op, char args[4][64])
+{
+	char *comment = strstr(line, "//");
+	int n = 0;
+
+	if (comment)
+		*comment = '\0';
+	if (sscanf(line, " %31s", op) != 1)
+		return -1;
+
+	char *p = strstr(line, op) + strlen(op);
+	for (char *tok = strtok(p, ","); tok && n < 4; tok = strtok(NULL, ",")) {
+		while (*tok == ' ' || *tok == '\t')
+			tok++;
+		strncpy(args[n], tok, 63);
+		args[n][63] = '\0';
+		for (char *e = args[n] + strlen(args[n]); e > args[n] && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n'); )
+			*--e = '\0';
+		n++;
+	}
+	return n;
+}
+
+/* "8 + 16 (sp)" */
+static int parse_mem(const char *s, int32_t *offset)
+{
+	char expr[64];
+	const char *paren = strchr(s, '(');
+
+	if (!paren || paren - s >= (int)sizeof(expr))
+		return -1;
+	memcpy(expr, s, paren - s);
+	expr[paren - s] = '\0';
+	*offset = parse_expr(expr);
+
+	char name[8];
+	if (sscanf(paren + 1, "%7[^)]", name) != 1)
+		return -1;
+	return parse_reg(name);
+}
+
+static FILE *open_label(const char *label)
+{
+	FILE *f = fopen(BASE_S, "r");
+	char line[256];
+
+	if (!f)
+		return NULL;
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, label, strlen(label)) && line[strlen(label)] == ':')
+			return f;
+	}
+	fclose(f);
+	return NULL;
+}
+
+static void check_fast_path(void)
+{
+	char line[256], op[32], args[4][64];
+	sym_t context = {V_UNDEF}, index = {V_UNDEF};
+	FILE *f;
+
+	for (int i = 0; i < 32; i++)
+		reg[i] = (sym_t){V_GPR, i};
+	reg[1] = (sym_t){V_SP, 0};
+	memset(frame, 0, sizeof(frame));
+
+	/* the stub for entry 5 */
+	uint32_t target = run_stub(trap.entry[5].stub);
+	expect(target == TRAP_FAST_PATH, "stub does not branch to trap_fast_path", target);
+	expect(sym_eq(reg[3], V_IMM, 5), "stub does not pass its index", reg[3].n);
+
+	if (!(f = open_label("trap_fast_path"))) {
+		expect(false, "trap_fast_path not found in " BASE_S, 0);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		int n = split(line, op, args);
+		int32_t offset;
+		int rs, ra;
+
+		if (n < 0)
+			continue;
+		if (!strcmp(op, "stw") && n == 2) {
+			rs = parse_reg(args[0]);
+			ra = parse_mem(args[1], &offset);
+			store(rs, ra, offset);
+		} else if (!strcmp(op, "stm") && n == 2) {
+			rs = parse_reg(args[0]);
+			ra = parse_mem(args[1], &offset);
+			for (int i = rs; i < 32; i++)
+				store(i, ra, offset + (i - rs) * 4);
+		} else if (!strcmp(op, "addi") && n == 3) {
+			ra = parse_reg(args[1]);
+			reg[parse_reg(args[0])] = (sym_t){reg[ra].kind, reg[ra].n + parse_expr(args[2])};
+		} else if (!strcmp(op, "mr") && n == 2) {
+			reg[parse_reg(args[0])] = reg[parse_reg(args[1])];
+		} else if (!strcmp(op, "mfcr")) {
+			reg[parse_reg(args[0])] = (sym_t){V_CR};
+		} else if (!strcmp(op, "mflr")) {
+			reg[parse_reg(args[0])] = (sym_t){V_LR};
+		} else if (!strcmp(op, "mfctr")) {
+			reg[parse_reg(args[0])] = (sym_t){V_CTR};
+		} else if (!strcmp(op, "mfxer")) {
+			reg[parse_reg(args[0])] = (sym_t){V_XER};
+		} else if (!strcmp(op, "mfmsr")) {
+			reg[parse_reg(args[0])] = (sym_t){V_MSR};
+		} else if (!strcmp(op, "rlwinm") || !strcmp(op, "mtmsr")) {
+			if (!strcmp(op, "rlwinm"))
+				reg[parse_reg(args[0])] = (sym_t){V_UNDEF};
+		} else if (!strcmp(op, "bl") && n == 1) {
+			expect(!strcmp(args[0], "service_trap"), "trap_fast_path calls something else", 0);
+			context = reg[3];
+			index = reg[4];
+		} else if (!strcmp(op, "b") && n == 1) {
+			expect(!strcmp(args[0], "exception_return"), "trap_fast_path returns elsewhere", 0);
+			break;
+		} else {
+			expect(false, "unexpected instruction in trap_fast_path", 0);
+			printf("trap:   %s", line);
+		}
+	}
+	fclose(f);
+
+	expect(sym_eq(index, V_IMM, 5), "service_trap gets the wrong index", index.n);
+	expect(context.kind == V_SP, "service_trap gets no context on the stack", context.kind);
+	if (context.kind != V_SP)
+		return;
+
+	/* the context handed to service_trap */
+	for (int i = 0; i < 32; i++) {
+		sym_t *s = slot(context, offsetof(ppc_context_t, gpr[i]));
+		expect(s && (i == 1 ? sym_eq(*s, V_SP, 0) : sym_eq(*s, V_GPR, i)), "context gpr not saved", i);
+	}
+	sym_t *s;
+	s = slot(context, offsetof(ppc_context_t, cr));   expect(s && s->kind == V_CR, "context cr not saved", 0);
+	s = slot(context, offsetof(ppc_context_t, lr));   expect(s && s->kind == V_LR, "context lr not saved", 0);
+	s = slot(context, offsetof(ppc_context_t, ctr));  expect(s && s->kind == V_CTR, "context ctr not saved", 0);
+	s = slot(context, offsetof(ppc_context_t, xer));  expect(s && s->kind == V_XER, "context xer not saved", 0);
+	s = slot(context, offsetof(ppc_context_t, srr1)); expect(s && s->kind == V_MSR, "context srr1 not saved", 0);
+	expect(context.n + (int32_t)sizeof(ppc_context_t) <= 0, "context overlaps the caller's stack", context.n);
+
+	/* exception_return restores from the layout service_trap filled in */
+	static const struct { const char *mt; size_t offset; } restore[] = {
+		{ "mtcr",   offsetof(ppc_context_t, cr)   },
+		{ "mtlr",   offsetof(ppc_context_t, lr)   },
+		{ "mtctr",  offsetof(ppc_context_t, ctr)  },
+		{ "mtxer",  offsetof(ppc_context_t, xer)  },
+		{ "mtsrr0", offsetof(ppc_context_t, srr0) },
+		{ "mtsrr1", offsetof(ppc_context_t, srr1) },
+	};
+	int32_t loaded = -1;
+	int restored = 0;
+
+	if (!(f = open_label("exception_return"))) {
+		expect(false, "exception_return not found in " BASE_S, 0);
+		return;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		int n = split(line, op, args);
+
+		if (n < 0)
+			continue;
+		if (!strcmp(op, "lwz") && n == 2) {
+			expect(parse_mem(args[1], &loaded) == 3, "exception_return loads off another register", 0);
+		} else if (!strcmp(op, "lm") && n == 2) {
+			int32_t offset = -1;
+			expect(parse_reg(args[0]) == 0 && parse_mem(args[1], &offset) == 3 &&
+				offset == offsetof(ppc_context_t, gpr), "exception_return restores gprs from elsewhere", offset);
+		} else if (!strcmp(op, "rfi")) {
+			break;
+		} else {
+			for (int i = 0; i < 6; i++) {
+				if (!strcmp(op, restore[i].mt)) {
+					expect(loaded == restore[i].offset, "exception_return restores from the wrong offset", loaded);
+					restored |= 1 << i;
+				}
+			}
+		}
+	}
+	fclose(f);
+	expect(restored == 0x3F, "exception_return skips a register", restored);
+}
+
+/*
+ * Dispatch against ppc_step.
+ */
+static uint32_t ref_ea(ppc_context_t *c, uint32_t op)
+{
+	int ra = (op >> 16) & 31, rb = (op >> 11) & 31;
+
+	if (op >> 26 == 31)
+		return (ra ? c->gpr[ra] : 0) + c->gpr[rb];
+	return (ra ? c->gpr[ra] : 0) + (int16_t)op;
+}
+
+static uint32_t enc_d(uint32_t op, int rt, int ra, int16_t d) { return op << 26 | rt << 21 | ra << 16 | (uint16_t)d; }
+static uint32_t enc_x(int xo, int rt, int ra, int rb) { return 31u << 26 | rt << 21 | ra << 16 | rb << 11 | xo << 1; }
+
+static const uint32_t bases[] = { 0x0C003000, 0x0C006000, 0x0C006800, 0x0C005000, 0x0C002000, 0x08400000 };
+
+static int check_dispatch(uint32_t *code)
+{
+	int cases = 0;
+
+	for (int n = 0; n < 20000; n++) {
+		int kind = rand() % 9;
+		int rt = rand() % 32, ra = 1 + rand() % 31, rb = rand() % 32;
+		uint32_t op;
+
+		switch (kind) {
+			case 0: op = enc_x(23, rt, ra, rb); break;  // lwzx
+			case 1: op = enc_x(151, rt, ra, rb); break; // stwx
+			case 2: op = enc_x(407, rt, ra, rb); break; // sthx
+			case 3: op = enc_d(32, rt, ra, (rand() % 64) * 4); break; // lwz
+			case 4: op = enc_d(36, rt, ra, (rand() % 64) * 4); break; // stw
+			case 5: op = enc_d(40, rt, ra, (rand() % 64) * 2); break; // lhz
+			case 6: op = enc_d(44, rt, ra, (rand() % 64) * 2); break; // sth
+			case 7: op = enc_d(39, rt, ra, 0); break; // stbu, only ever the DABR
+			default: op = enc_d(36, rt, 0, (int16_t)0x3000); break; // absolute, never a register
+		}
+		if (rb == ra && kind <= 2)
+			continue;
+
+		ppc_context_t c0 = {0};
+		for (int i = 0; i < 32; i++)
+			c0.gpr[i] = rand();
+		c0.gpr[ra] = kind == 7 ? 0x800000E8 : bases[rand() % 6];
+		if (kind != 7)
+			c0.gpr[ra] += (rand() % 16) * 4;
+		if (kind <= 2)
+			c0.gpr[rb] = (rand() % 16) * 4;
+
+		uint32_t ea = ref_ea(&c0, op);
+		uint32_t *site = code + (n % 512) * 2;
+		*site = op;
+		trap_flush();
+
+		/* the exception path decodes it */
+		ppc_context_t c1 = c0;
+		c1.srr0 = (uint32_t)(uintptr_t)site;
+		mock_dar = ea;
+		nlog = 0;
+		if (!ppc_step(&c1, op))
+			continue;
+		cases++;
+
+		c1 = c0;
+		c1.srr0 = (uint32_t)(uintptr_t)site;
+		nlog = 0;
+		service_exception(&c1);
+
+		uint32_t log1[64];
+		int n1 = nlog;
+		memcpy(log1, log_, sizeof(log1));
+
+		bool hw = (ea >> 16) == 0x0C00 || (ea >> 24) == 0x08;
+		expect((*site != op) == hw, "site patched for the wrong address", op);
+		if (!hw || *site == op)
+			continue;
+
+		/* the site now branches to its stub */
+		int32_t off = (int32_t)(*site << 6) >> 6 & ~3;
+		int index = -1;
+		for (int i = 0; i < trap.count; i++)
+			if ((uint32_t *)((uint8_t *)site + off) == trap.entry[i].stub)
+				index = i;
+		expect((*site >> 26) == 18 && !(*site & 3) && index >= 0, "site does not branch to a stub", *site);
+		if (index < 0)
+			continue;
+
+		/* the stub dispatch matches the exception path */
+		ppc_context_t c2 = c0;
+		nlog = 0;
+		service_trap(&c2, index);
+		expect(!memcmp(&c1, &c2, sizeof(c1)) && n1 == nlog && !memcmp(log1, log_, nlog * 4),
+			"stub dispatch differs from ppc_step", op);
+
+		/* plain RAM through the same site puts the instruction back for good */
+		ppc_context_t c3 = c0;
+		c3.gpr[ra] = LOW_BASE + 0x80000;
+		if (kind <= 2)
+			c3.gpr[rb] = 0;
+		service_trap(&c3, index);
+		expect(*site == op && trap.entry[index].native && c3.srr0 == (uint32_t)(uintptr_t)site,
+			"native access not restored", op);
+
+		ppc_context_t c4 = c0;
+		c4.srr0 = (uint32_t)(uintptr_t)site;
+		service_exception(&c4);
+		expect(*site == op, "native site patched again", op);
+
+		/* code replaced with a different instruction reuses the entry */
+		uint32_t op2 = enc_d(32, 3, 4, 0);
+		ppc_context_t c5 = {0};
+		int count = trap.count;
+		*site = op2;
+		c5.gpr[4] = 0x0C006800;
+		c5.srr0 = (uint32_t)(uintptr_t)site;
+		mock_dar = 0x0C006800;
+		service_exception(&c5);
+		expect(trap.count == count && *site != op2 && c5.gpr[3] == 0x3000 && trap.entry[index].opcode == op2,
+			"rewritten site not reused", op2);
+
+		/* flushing only restores sites still holding our branch */
+		trap_flush();
+		expect(*site == op2, "flush did not restore the site", *site);
+	}
+
+	return cases;
+}
+
+static void check_full_table(uint32_t *code)
+{
+	uint32_t op = enc_d(32, 3, 4, 0);
+
+	trap_flush();
+	for (int i = 0; i < TRAP_CACHE_SIZE + 8; i++) {
+		ppc_context_t c = {0};
+		code[i] = op;
+		c.gpr[4] = 0x0C003000;
+		c.srr0 = (uint32_t)(uintptr_t)&code[i];
+		mock_dar = 0x0C003000;
+		nlog = 0;
+		service_exception(&c);
+		expect((code[i] == op) == (i >= TRAP_CACHE_SIZE), "table overflow patched a site", i);
+	}
+	trap_flush();
+	for (int i = 0; i < TRAP_CACHE_SIZE + 8; i++)
+		expect(code[i] == op, "site left patched after flush", i);
+}
+
+int main(void)
+{
+	uint8_t *low = mmap((void *)(uintptr_t)LOW_BASE, 1 << 20, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+	if (low != (void *)(uintptr_t)LOW_BASE) {
+		printf("trap: could not map low memory\n");
+		return 1;
+	}
+
+	void *arenaLo = low, *arenaHi = low + (1 << 20);
+	uint32_t *code = (uint32_t *)(low + 0x1000);
+
+	trap_init(&arenaLo, &arenaHi);
+	expect(!((uintptr_t)arenaHi & 31), "trap table not 32 byte aligned", (uint32_t)(uintptr_t)arenaHi);
+
+	for (int i = 0; i < TRAP_CACHE_SIZE; i++) {
+		uint32_t *stub = trap.entry[i].stub;
+		expect(stub[0] == 0x9421FF50 && stub[1] == 0x90610014 && stub[2] == (0x38600000 | i),
+			"stub prologue", i);
+	}
+
+	check_fast_path();
+
+	srand(7);
+	int cases = check_dispatch(code);
+	check_full_table(code);
+
+	printf("trap: %d encodings compared against ppc_step, %d failures\n", cases, failures);
+	return failures != 0;
+}